@@ -0,0 +1,220 @@
+#include "AnimationCompression.h"
+
+#include <algorithm>
+
+namespace APBuild
+{
+	namespace AnimationCompression
+	{
+		struct TrackKey
+		{
+			float Time;
+			Quaternion Rotation;
+			Vector3 Translation;
+			Vector3 Scale;
+		};
+
+		struct Tolerance
+		{
+			float Distance;
+			float Angle;
+		};
+
+		// splits a scale * rotation * translation matrix into its parts
+		static void Decompose(const Matrix& m, TrackKey& key)
+		{
+			Vector3 r1(m.M11, m.M12, m.M13);
+			Vector3 r2(m.M21, m.M22, m.M23);
+			Vector3 r3(m.M31, m.M32, m.M33);
+
+			Vector3 scale(r1.Length(), r2.Length(), r3.Length());
+
+			// mirrored transforms have a negative determinant; keep the flip in the X scale
+			if (r1.Cross(r2).Dot(r3) < 0)
+				scale.X = -scale.X;
+
+			Matrix rot = Matrix::Identity;
+			if (scale.X != 0) { rot.M11 = r1.X / scale.X; rot.M12 = r1.Y / scale.X; rot.M13 = r1.Z / scale.X; }
+			if (scale.Y != 0) { rot.M21 = r2.X / scale.Y; rot.M22 = r2.Y / scale.Y; rot.M23 = r2.Z / scale.Y; }
+			if (scale.Z != 0) { rot.M31 = r3.X / scale.Z; rot.M32 = r3.Y / scale.Z; rot.M33 = r3.Z / scale.Z; }
+
+			Quaternion::CreateRotationMatrix(key.Rotation, rot);
+			key.Rotation.Normalize();
+
+			key.Translation = m.GetTranslation();
+			key.Scale = scale;
+		}
+
+		static bool IsClose(const TrackKey& value, const Quaternion& rotation, const Vector3& translation, const Vector3& scale, const Tolerance& tol)
+		{
+			float dot = Math::Min(fabs(Quaternion::Dot(value.Rotation, rotation)), 1.0f);
+			if (2 * acosf(dot) > tol.Angle)
+				return false;
+
+			if (Vector3::Distance(value.Translation, translation) > tol.Distance)
+				return false;
+
+			return Vector3::Distance(value.Scale, scale) <= tol.Distance;
+		}
+
+		// checks if interpolating between a and b reproduces mid
+		static bool IsInterpolated(const TrackKey& a, const TrackKey& b, const TrackKey& mid, const Tolerance& tol)
+		{
+			float amount = b.Time > a.Time ? (mid.Time - a.Time) / (b.Time - a.Time) : 0;
+
+			Quaternion rotation;
+			Quaternion::Lerp(rotation, a.Rotation, b.Rotation, amount);
+
+			return IsClose(mid, rotation, Vector3::Lerp(a.Translation, b.Translation, amount), Vector3::Lerp(a.Scale, b.Scale, amount), tol);
+		}
+
+		/**
+		 *  Greedily extends each segment from the last kept key as far as all the keys it skips
+		 *  can be reproduced by interpolation.
+		 */
+		static void ReduceKeys(List<TrackKey>& keys, const Tolerance& tol)
+		{
+			if (keys.getCount() < 2)
+				return;
+
+			List<TrackKey> result;
+			result.Add(keys[0]);
+
+			int32 anchor = 0;
+			for (int32 i = 1; i < keys.getCount() - 1; i++)
+			{
+				bool canSkip = true;
+				for (int32 j = anchor + 1; j <= i && canSkip; j++)
+				{
+					canSkip = IsInterpolated(keys[anchor], keys[i + 1], keys[j], tol);
+				}
+
+				if (!canSkip)
+				{
+					result.Add(keys[i]);
+					anchor = i;
+				}
+			}
+
+			const TrackKey& last = keys.LastItem();
+			if (result.getCount() > 1 || !IsClose(last, result[0].Rotation, result[0].Translation, result[0].Scale, tol))
+			{
+				result.Add(last);
+			}
+
+			keys = result;
+		}
+
+		static uint16 Quantize(float v, float minValue, float step)
+		{
+			if (step <= 0)
+				return 0;
+			return static_cast<uint16>(Math::Clamp(Math::Round((v - minValue) / step), 0, 0xffff));
+		}
+
+		static void QuantizeTrack(int32 objectIndex, const List<TrackKey>& keys, float duration,
+			List<CompressedAnimationClip::Track>& tracks, List<CompressedAnimationClip::Key>& result)
+		{
+			const float steps = (float)CompressedAnimationClip::TimeSteps;
+
+			Vector3 minT = keys[0].Translation;
+			Vector3 maxT = minT;
+			Vector3 minS = keys[0].Scale;
+			Vector3 maxS = minS;
+			for (const TrackKey& k : keys)
+			{
+				minT = Vector3::Minimize(minT, k.Translation);
+				maxT = Vector3::Maximize(maxT, k.Translation);
+				minS = Vector3::Minimize(minS, k.Scale);
+				maxS = Vector3::Maximize(maxS, k.Scale);
+			}
+
+			CompressedAnimationClip::Track track;
+			track.ObjectIndex = objectIndex;
+			track.FirstKey = result.getCount();
+			track.KeyCount = keys.getCount();
+			track.TranslationMin = minT;
+			track.TranslationStep = (maxT - minT) / steps;
+			track.ScaleMin = minS;
+			track.ScaleStep = (maxS - minS) / steps;
+			tracks.Add(track);
+
+			for (const TrackKey& k : keys)
+			{
+				CompressedAnimationClip::Key key;
+				key.Time = duration > 0 ? Quantize(k.Time / duration, 0, 1.0f / steps) : 0;
+
+				CompressedAnimationClip::EncodeRotation(k.Rotation, key.Rotation);
+
+				key.Translation[0] = Quantize(k.Translation.X, minT.X, track.TranslationStep.X);
+				key.Translation[1] = Quantize(k.Translation.Y, minT.Y, track.TranslationStep.Y);
+				key.Translation[2] = Quantize(k.Translation.Z, minT.Z, track.TranslationStep.Z);
+
+				key.Scale[0] = Quantize(k.Scale.X, minS.X, track.ScaleStep.X);
+				key.Scale[1] = Quantize(k.Scale.Y, minS.Y, track.ScaleStep.Y);
+				key.Scale[2] = Quantize(k.Scale.Z, minS.Z, track.ScaleStep.Z);
+
+				result.Add(key);
+			}
+		}
+
+		ModelAnimationClip* Compress(const ModelAnimationClip* clip, const ProjectAnimationCompressionOptions& options)
+		{
+			const List<ModelKeyframe>& keyframes = clip->getKeyframes();
+
+			Tolerance tol;
+			tol.Distance = options.Tolerance;
+			tol.Angle = ToRadian(options.AngleTolerance);
+
+			List<int32> objects;
+			for (const ModelKeyframe& kf : keyframes)
+			{
+				if (objects.IndexOf(kf.getObjectIndex()) == -1)
+					objects.Add(kf.getObjectIndex());
+			}
+			std::sort(objects.begin(), objects.end());
+
+			List<CompressedAnimationClip::Track> tracks;
+			List<CompressedAnimationClip::Key> keys;
+
+			for (int32 obj : objects)
+			{
+				// keyframes are sorted by time, so are the ones of each object
+				List<TrackKey> trackKeys;
+				for (const ModelKeyframe& kf : keyframes)
+				{
+					if (kf.getObjectIndex() == obj)
+					{
+						TrackKey k;
+						k.Time = kf.getTime();
+						Decompose(kf.getTransform(), k);
+						trackKeys.Add(k);
+					}
+				}
+
+				if (options.ReduceKeys)
+					ReduceKeys(trackKeys, tol);
+
+				QuantizeTrack(obj, trackKeys, clip->getDuration(), tracks, keys);
+			}
+
+			return new ModelAnimationClip(new CompressedAnimationClip(clip->getDuration(), tracks, keys));
+		}
+
+		void CompressClips(AnimationData::ClipTable& table, const ProjectAnimationCompressionOptions& options)
+		{
+			if (!options.Enabled)
+				return;
+
+			for (auto e : table)
+			{
+				if (e.Value->getCompressed())
+					continue;
+
+				ModelAnimationClip* compressed = Compress(e.Value, options);
+				delete e.Value;
+				e.Value = compressed;
+			}
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ * 
+ * Copyright (c) 2009-2018 Tao Xin
+ * 
+ * This content of this file is subject to the terms of the Mozilla Public 
+ * License v2.0. If a copy of the MPL was not distributed with this file, 
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful, 
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the 
+ * Mozilla Public License for more details.
+ * 
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef ANIMATIONCOMPRESSION_H
+#define ANIMATIONCOMPRESSION_H
+
+#include "APBCommon.h"
+
+namespace APBuild
+{
+	namespace AnimationCompression
+	{
+		/**
+		 *  Converts a keyframe clip into a CompressedAnimationClip.
+		 *  Each key is decomposed into rotation, translation and scale, then quantized. When enabled in the
+		 *  options, keys that linear interpolation of their neighbors reproduces within the tolerances are removed.
+		 */
+		ModelAnimationClip* Compress(const ModelAnimationClip* clip, const ProjectAnimationCompressionOptions& options);
+
+		/** Replaces all the clips in the table with compressed ones, if compression is enabled. */
+		void CompressClips(AnimationData::ClipTable& table, const ProjectAnimationCompressionOptions& options);
+	}
+}
+
+#endif
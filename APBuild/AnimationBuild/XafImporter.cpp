@@ -16,6 +16,7 @@
 
 #include "XafImporter.h"
 
+#include "AnimationCompression.h"
 #include "BuildConfig.h"
 
 #include <fstream>
@@ -106,6 +107,8 @@ namespace APBuild
 			}
 		}
 
+		AnimationCompression::CompressClips(rigidAnim, config.AnimationCompression);
+
 		animData->setRigidAnimationClips(rigidAnim);
 		return animData;
 	}
@@ -116,6 +116,12 @@ namespace APBuild
 		{
 			NewFormat = PixelFormatUtils::ConvertFormat(tmp);
 		}
+
+		BlockCompression = BlockCompressionQuality::Normal;
+		if (sect->tryGetAttribute(L"BlockCompression", tmp))
+		{
+			BlockCompression = ProjectUtils::BlockCompressionQualityConv.Parse(tmp);
+		}
 		
 		CompressionType = TextureCompressionType::None;
 		if (sect->tryGetAttribute(L"Compression", tmp))
@@ -223,6 +229,7 @@ namespace APBuild
 		SrcFile = sect->getAttribute(L"SourceFile");
 		DstFile = sect->getAttribute(L"DestinationFile");
 		Reverse = sect->GetAttributeBool(L"Reverse");
+		AnimationCompression.Parse(sect);
 
 		for (const ConfigurationSection* ss : sect->getSubSections())
 		{
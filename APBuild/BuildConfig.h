@@ -36,6 +36,7 @@ namespace APBuild
 
 		TextureFilterType ResizeFilterType = TextureFilterType::BSpline;
 		Apoc3D::Graphics::PixelFormat NewFormat = FMT_Unknown;
+		Apoc3D::Graphics::BlockCompressionQuality BlockCompression = Apoc3D::Graphics::BlockCompressionQuality::Normal;
 		
 		TextureCompressionType CompressionType = TextureCompressionType::None;
 
@@ -119,6 +120,8 @@ namespace APBuild
 		String DstFile;
 		bool Reverse;
 
+		ProjectAnimationCompressionOptions AnimationCompression;
+
 		HashMap<String, int> ObjectIndexMapping;
 
 		void Parse(const ConfigurationSection* sect);
@@ -48,6 +48,10 @@ namespace APBuild
 				ep.InstanceBlobIndex = ps->GetAttributeInt(L"BlobIndex");
 			}
 		}
+		else if (ep.Usage == EPUSAGE_Trans_InstanceStream)
+		{
+			ps->TryGetAttributeInt(L"BlobCount", ep.InstanceStreamBlobCount);
+		}
 
 		if (ep.Usage == EPUSAGE_Unknown && usageText.size())
 		{
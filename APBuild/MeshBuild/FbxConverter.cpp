@@ -5,6 +5,7 @@
 #ifndef DISABLE_FBX
 
 #include "MeshBuild.h"
+#include "AnimationBuild/AnimationCompression.h"
 
 #ifdef IOS_REF
 #undef  IOS_REF
@@ -1578,6 +1579,8 @@ namespace APBuild
 		}
 		MeshBuild::ConvertVertexData(&modelData, config);
 		MeshBuild::CollapseMeshs(&modelData, config);
+		MeshBuild::SimplifyMeshs(&modelData, config);
+		MeshBuild::OptimizeMeshs(&modelData, config);
 
 		// animation
 		if (!config.DstAnimationFile.empty())
@@ -1593,6 +1596,9 @@ namespace APBuild
 			}
 
 			fbx.FlattenAnimation(&rigidAnimations);
+
+			AnimationCompression::CompressClips(skeletonAnimations, config.AnimationCompression);
+			AnimationCompression::CompressClips(rigidAnimations, config.AnimationCompression);
 			
 			animData.setBones(bones);
 			animData.setSkinnedAnimationClips(skeletonAnimations);
@@ -1601,7 +1607,7 @@ namespace APBuild
 		}
 
 
-		modelData.Save(FileOutStream(config.DstFile));
+		modelData.Save(FileOutStream(config.DstFile), MeshBuild::GetStorageOptions(config));
 
 		if (!config.DstAnimationFile.empty())
 		{
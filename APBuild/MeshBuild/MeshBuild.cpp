@@ -23,6 +23,8 @@
 #include "XImporter.h"
 #include "FbxConverter.h"
 
+#include "Utils/MeshProcessing.h"
+
 namespace APBuild
 {
 	void BuildByFBX(ProjectResModel& config)
@@ -36,7 +38,7 @@ namespace APBuild
 
 		MeshBuild::PostProcess(data, config);
 
-		data->Save(FileOutStream(config.DstFile));
+		data->Save(FileOutStream(config.DstFile), MeshBuild::GetStorageOptions(config));
 		delete data;
 
 	}
@@ -50,7 +52,7 @@ namespace APBuild
 		if (config.CompactBuild)
 			data->SaveLite(fs);
 		else
-			data->Save(fs);
+			data->Save(fs, MeshBuild::GetStorageOptions(config));
 		delete data;
 	}
 
@@ -109,8 +111,69 @@ namespace APBuild
 
 		MeshBuild::ConvertVertexData(data, config);
 		MeshBuild::CollapseMeshs(data, config);
+		MeshBuild::SimplifyMeshs(data, config);
+		MeshBuild::OptimizeMeshs(data, config);
+	}
 
-		
+	MeshStorageOptions MeshBuild::GetStorageOptions(const ProjectResModel& config)
+	{
+		MeshStorageOptions options;
+		options.SplitIndices = config.SplitIndices;
+		options.HalfTexCoords = config.HalfTexCoords;
+		options.OctahedralNormals = config.OctahedralNormals;
+		return options;
+	}
+
+	void MeshBuild::SimplifyMeshs(ModelData* data, const ProjectResModel& config)
+	{
+		if (config.SimplifyRatio >= 1)
+			return;
+
+		for (MeshData* md : data->Entities)
+		{
+			int32 faceCount = md->Faces.getCount();
+			if (faceCount == 0)
+				continue;
+
+			if (!Utils::meshSimplify(md, config.SimplifyRatio))
+			{
+				BuildSystem::LogWarning(L"Mesh " + md->Name + L" has no float3 positions. Not simplified.", config.SrcFile);
+				continue;
+			}
+
+			BuildSystem::LogInformation(L"Simplified mesh " + md->Name + L": " +
+				StringUtils::IntToString(faceCount) + L" -> " + StringUtils::IntToString(md->Faces.getCount()) + L" faces", config.SrcFile);
+		}
+	}
+
+	void MeshBuild::OptimizeMeshs(ModelData* data, const ProjectResModel& config)
+	{
+		if (!config.OptimizeVertexCache)
+			return;
+
+		auto formatStats = [](const Utils::VertexCacheStatistics& s)
+		{
+			return L"ACMR " + StringUtils::SingleToString(s.ACMR, StrFmt::fpdec<3>::val) +
+				L", ATVR " + StringUtils::SingleToString(s.ATVR, StrFmt::fpdec<3>::val);
+		};
+
+		for (MeshData* md : data->Entities)
+		{
+			if (md->Faces.getCount() == 0)
+				continue;
+
+			Utils::VertexCacheStatistics before = Utils::meshAnalyzeVertexCache(md);
+
+			Utils::meshOptimizeVertexCache(md);
+			if (config.OverdrawThreshold > 0)
+				Utils::meshOptimizeOverdraw(md, config.OverdrawThreshold);
+			Utils::meshOptimizeVertexFetch(md);
+
+			Utils::VertexCacheStatistics after = Utils::meshAnalyzeVertexCache(md);
+
+			BuildSystem::LogInformation(L"Optimized mesh " + md->Name + L": " + 
+				formatStats(before) + L" -> " + formatStats(after), config.SrcFile);
+		}
 	}
 
 	void MeshBuild::ConvertVertexData(ModelData* data, const ProjectResModel& config)
@@ -30,7 +30,11 @@ namespace APBuild
 		void PostProcess(ModelData* data, ProjectResModel& config);
 		void ConvertVertexData(ModelData* data, const ProjectResModel& config);
 		void CollapseMeshs(ModelData* data, const ProjectResModel& config);
+		void SimplifyMeshs(ModelData* data, const ProjectResModel& config);
+		void OptimizeMeshs(ModelData* data, const ProjectResModel& config);
 		void ExecuteMaterialConversion(ModelData* data, const ModelPreset& preset, const ProjectResModel& config);
+
+		MeshStorageOptions GetStorageOptions(const ProjectResModel& config);
 	};
 
 }
@@ -190,11 +190,32 @@ namespace APBuild
 			case TextureFilterType::Nearest: return ILU_NEAREST;
 			case TextureFilterType::Box: return ILU_SCALE_BOX;
 			case TextureFilterType::BSpline: return ILU_SCALE_BSPLINE;
+			case TextureFilterType::Triangle: return ILU_SCALE_TRIANGLE;
+			case TextureFilterType::Lanczos: return ILU_SCALE_LANCZOS3;
+			case TextureFilterType::Kaiser: return ILU_SCALE_LANCZOS3;
 		}
 		AP_EXCEPTION(ErrorID::NotSupported, L"Not supported filter type");
 		return ILU_NEAREST;
 	}
-	void BuildByDevIL(const TextureBuildConfig& config)
+	ResizeFilter ConvertResizeFilter(TextureFilterType flt)
+	{
+		switch (flt)
+		{
+			case TextureFilterType::Nearest:
+			case TextureFilterType::Box: return ResizeFilter::Box;
+			case TextureFilterType::BSpline:
+			case TextureFilterType::Triangle: return ResizeFilter::Triangle;
+			case TextureFilterType::Lanczos: return ResizeFilter::Lanczos;
+			case TextureFilterType::Kaiser: return ResizeFilter::Kaiser;
+		}
+		return ResizeFilter::Kaiser;
+	}
+
+	/**
+	 *  Loads the image with DevIL. With builtInProcessing, resizing and mip maps are done by the 
+	 *  engine's resampler instead of DevIL's.
+	 */
+	void BuildByDevIL(const TextureBuildConfig& config, bool builtInProcessing)
 	{
 		if (config.AssembleCubemap || config.AssembleVolumeMap)
 		{
@@ -212,14 +233,14 @@ namespace APBuild
 		int ilFormat = ilGetInteger(IL_IMAGE_FORMAT);
 
 
-		if (config.GenerateMipmaps)
+		if (config.GenerateMipmaps && !builtInProcessing)
 		{
 			iluBuildMipmaps();
 		}
 
 		ilActiveMipmap(0);
 
-		if (config.Resizing.IsResizing())
+		if (config.Resizing.IsResizing() && !builtInProcessing)
 		{
 			int32 curWidth = ilGetInteger(IL_IMAGE_WIDTH);
 			int32 curHeight = ilGetInteger(IL_IMAGE_HEIGHT);
@@ -339,11 +360,51 @@ namespace APBuild
 
 		ilDeleteImage(image);
 
+		PixelFormat newFormat = config.NewFormat;
+
+		if (builtInProcessing && (config.Resizing.IsResizing() || config.GenerateMipmaps))
+		{
+			// DXT sources are decoded so they can be filtered, then encoded again below
+			if (PixelFormatUtils::IsCompressed(texData.Format) && PixelFormatUtils::CanDecompress(texData.Format, FMT_A8R8G8B8))
+			{
+				PixelFormat originalFormat = texData.Format;
+				texData.ConvertInPlace(FMT_A8R8G8B8);
+
+				if (newFormat == FMT_Unknown)
+					newFormat = originalFormat;
+			}
+
+			if (!PixelFormatUtils::CanResize(texData.Format))
+			{
+				BuildSystem::LogError(L"The pixel format of the image can not be resized.", config.SourceFile);
+				return;
+			}
+
+			ResizeOptions options(ConvertResizeFilter(config.ResizeFilterType));
+
+			if (config.Resizing.IsResizing())
+			{
+				int32 newWidth = config.Resizing.GetResizedWidth(texData.Levels[0].Width);
+				int32 newHeight = config.Resizing.GetResizedHeight(texData.Levels[0].Height);
+				texData.ResizeInPlace(newWidth, newHeight, options);
+			}
+
+			if (config.GenerateMipmaps && !texData.GenerateMipmaps(options))
+			{
+				BuildSystem::LogError(L"Mipmaps can not be generated for this texture.", config.SourceFile);
+			}
+		}
 
-		if (config.NewFormat != FMT_Unknown &&
-			texData.Format != config.NewFormat)
+		if (newFormat != FMT_Unknown &&
+			texData.Format != newFormat)
 		{
-			texData.ConvertInPlace(config.NewFormat);
+			if (!PixelFormatUtils::CanConvert(texData.Format, newFormat))
+			{
+				BuildSystem::LogError(L"The image can not be converted to " + PixelFormatUtils::ToString(newFormat) + L".", config.SourceFile);
+				return;
+			}
+
+			texData.ConvertInPlace(newFormat, BlockCompressionOptions(config.BlockCompression));
 		}
 
 		if (config.CompressionType == TextureCompressionType::RLE)
@@ -389,7 +450,8 @@ namespace APBuild
 		switch (config.Method)
 		{
 			case TextureBuildMethod::D3D: BuildByD3D(config); break;
-			case TextureBuildMethod::Devil: BuildByDevIL(config); break;
+			case TextureBuildMethod::Devil: BuildByDevIL(config, false); break;
+			case TextureBuildMethod::BuiltIn: BuildByDevIL(config, true); break;
 		}
 
 		BuildSystem::LogEntryProcessed(config.DestinationFile, hierarchyPath);
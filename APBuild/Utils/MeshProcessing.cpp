@@ -1,8 +1,14 @@
 #include "MeshProcessing.h"
 
+#include "apoc3d/Graphics/MeshSimplifier.h"
+
 #include <dxsdk/d3d9.h>
 #include <dxsdk/d3dx9mesh.h>
 
+#pragma comment(lib, "dxsdk/d3dx9.lib")
+
+#include <algorithm>
+
 namespace APBuild
 {
 	namespace Utils
@@ -101,6 +107,583 @@ namespace APBuild
 				else break;
 			}
 		}
+
+		/**
+		 *  Orders the faces by material, keeping their order within each material.
+		 *  groupStarts gets the start of each material in the order, plus the end.
+		 */
+		static void GroupFacesByMaterial(const List<MeshFace>& faces, List<int32>& order, List<int32>& groupStarts)
+		{
+			int32 groupCount = 0;
+			for (const MeshFace& f : faces)
+				groupCount = Math::Max(groupCount, f.MaterialID + 1);
+
+			groupStarts.ReserveDiscard(groupCount + 1);
+			for (int32& s : groupStarts)
+				s = 0;
+
+			for (const MeshFace& f : faces)
+				groupStarts[f.MaterialID + 1]++;
+			for (int32 i = 0; i < groupCount; i++)
+				groupStarts[i + 1] += groupStarts[i];
+
+			List<int32> cursor = groupStarts;
+			order.ReserveDiscard(faces.getCount());
+			for (int32 i = 0; i < faces.getCount(); i++)
+				order[cursor[faces[i].MaterialID]++] = i;
+		}
+
+		/**
+		 *  Simulates a FIFO cache with time stamps. A vertex is in the cache if it was put in no more
+		 *  than cacheSize insertions ago. Adding cacheSize + 1 to time empties the cache.
+		 */
+		static int32 SimulateFifoCache(int32 vtx, uint32* timestamps, uint32& time, int32 cacheSize)
+		{
+			if (time - timestamps[vtx] > (uint32)cacheSize)
+			{
+				timestamps[vtx] = time++;
+				return 1;
+			}
+			return 0;
+		}
+
+		VertexCacheStatistics meshAnalyzeVertexCache(const MeshData* mesh, int32 cacheSize)
+		{
+			VertexCacheStatistics result;
+			if (mesh->Faces.getCount() == 0 || mesh->VertexCount == 0)
+				return result;
+
+			List<int32> order;
+			List<int32> groupStarts;
+			GroupFacesByMaterial(mesh->Faces, order, groupStarts);
+
+			uint32* timestamps = new uint32[mesh->VertexCount];
+			bool* used = new bool[mesh->VertexCount];
+			memset(timestamps, 0, sizeof(uint32) * mesh->VertexCount);
+			memset(used, 0, sizeof(bool) * mesh->VertexCount);
+
+			uint32 time = 0;
+			int32 misses = 0;
+			int32 usedCount = 0;
+
+			for (int32 g = 0; g < groupStarts.getCount() - 1; g++)
+			{
+				// each sub mesh is a separate draw call
+				time += cacheSize + 1;
+
+				for (int32 i = groupStarts[g]; i < groupStarts[g + 1]; i++)
+				{
+					const MeshFace& f = mesh->Faces[order[i]];
+					const int32 idx[3] = { f.IndexA, f.IndexB, f.IndexC };
+
+					for (int32 k = 0; k < 3; k++)
+					{
+						misses += SimulateFifoCache(idx[k], timestamps, time, cacheSize);
+
+						if (!used[idx[k]])
+						{
+							used[idx[k]] = true;
+							usedCount++;
+						}
+					}
+				}
+			}
+
+			delete[] timestamps;
+			delete[] used;
+
+			result.ACMR = (float)misses / mesh->Faces.getCount();
+			result.ATVR = (float)misses / usedCount;
+			return result;
+		}
+
+		/************************************************************************/
+		/*  Forsyth vertex cache optimization                                   */
+		/************************************************************************/
+
+		/** The size of the LRU cache modeled when scoring. Larger than the real one, which works better in practice. */
+		const int32 ForsythCacheSize = 32;
+		const float ForsythCacheDecayPower = 1.5f;
+		const float ForsythLastTriScore = 0.75f;
+		const float ForsythValenceBoostScale = 2.0f;
+		const float ForsythValenceBoostPower = 0.5f;
+
+		static float ForsythVertexScore(int32 cachePosition, int32 remainingFaces)
+		{
+			if (remainingFaces == 0)
+				return -1.0f;
+
+			float score = 0;
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+				{
+					// the vertices of the last face. A fixed score so that it does not matter which 
+					// of its 3 vertices are used next.
+					score = ForsythLastTriScore;
+				}
+				else
+				{
+					const float scaler = 1.0f / (ForsythCacheSize - 3);
+					score = powf(1.0f - (cachePosition - 3) * scaler, ForsythCacheDecayPower);
+				}
+			}
+
+			// vertices with fewer faces left get a boost, so that lone faces are not left behind
+			score += ForsythValenceBoostScale * powf((float)remainingFaces, -ForsythValenceBoostPower);
+			return score;
+		}
+
+		/**
+		 *  Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+		 *  Greedily picks the face with the best score among the ones using a cached vertex. 
+		 *  @param indices The faces with vertex indices in [0, vertexCount)
+		 *  @param faceOrder Receives the new order, as indices of the faces.
+		 */
+		static void ForsythOptimize(const int32* indices, int32 faceCount, int32 vertexCount, int32* faceOrder)
+		{
+			List<int32> remaining;
+			List<int32> adjacencyStart;
+			List<int32> adjacency;
+			List<int32> cachePosition;
+			List<float> vertexScore;
+			List<float> faceScore;
+			List<bool> emitted;
+
+			remaining.ReserveDiscard(vertexCount);
+			adjacencyStart.ReserveDiscard(vertexCount + 1);
+			cachePosition.ReserveDiscard(vertexCount);
+			vertexScore.ReserveDiscard(vertexCount);
+			faceScore.ReserveDiscard(faceCount);
+			emitted.ReserveDiscard(faceCount);
+			adjacency.ReserveDiscard(faceCount * 3);
+
+			for (int32 i = 0; i < vertexCount; i++)
+			{
+				remaining[i] = 0;
+				cachePosition[i] = -1;
+			}
+			for (int32 i = 0; i < faceCount * 3; i++)
+				remaining[indices[i]]++;
+
+			adjacencyStart[0] = 0;
+			for (int32 i = 0; i < vertexCount; i++)
+				adjacencyStart[i + 1] = adjacencyStart[i] + remaining[i];
+
+			{
+				List<int32> cursor = adjacencyStart;
+				for (int32 i = 0; i < faceCount * 3; i++)
+					adjacency[cursor[indices[i]]++] = i / 3;
+			}
+
+			for (int32 i = 0; i < vertexCount; i++)
+				vertexScore[i] = ForsythVertexScore(-1, remaining[i]);
+
+			int32 bestFace = -1;
+			float bestScore = -1;
+			for (int32 i = 0; i < faceCount; i++)
+			{
+				emitted[i] = false;
+				faceScore[i] = vertexScore[indices[i * 3]] + vertexScore[indices[i * 3 + 1]] + vertexScore[indices[i * 3 + 2]];
+
+				if (faceScore[i] > bestScore)
+				{
+					bestScore = faceScore[i];
+					bestFace = i;
+				}
+			}
+
+			int32 cache[ForsythCacheSize + 3];
+			int32 cacheCount = 0;
+			int32 scanCursor = 0;
+
+			for (int32 n = 0; n < faceCount; n++)
+			{
+				if (bestFace < 0)
+				{
+					// nothing in the cache has faces left, continue with the next face not yet emitted
+					while (emitted[scanCursor])
+						scanCursor++;
+					bestFace = scanCursor;
+				}
+
+				faceOrder[n] = bestFace;
+				emitted[bestFace] = true;
+
+				const int32* fi = indices + bestFace * 3;
+
+				// remove the face from the adjacency of its vertices
+				for (int32 k = 0; k < 3; k++)
+				{
+					int32 v = fi[k];
+					int32 start = adjacencyStart[v];
+					int32 last = start + remaining[v] - 1;
+
+					for (int32 j = start; j <= last; j++)
+					{
+						if (adjacency[j] == bestFace)
+						{
+							adjacency[j] = adjacency[last];
+							break;
+						}
+					}
+					remaining[v]--;
+				}
+
+				// move the face's vertices to the front of the LRU cache
+				int32 newCache[ForsythCacheSize + 3];
+				int32 newCacheCount = 0;
+
+				for (int32 k = 0; k < 3; k++)
+				{
+					if ((k < 1 || fi[k] != fi[0]) && (k < 2 || fi[k] != fi[1]))
+						newCache[newCacheCount++] = fi[k];
+				}
+				for (int32 i = 0; i < cacheCount; i++)
+				{
+					int32 v = cache[i];
+					if (v != fi[0] && v != fi[1] && v != fi[2])
+						newCache[newCacheCount++] = v;
+				}
+
+				// update the vertices in the cache, and the ones just pushed out of it
+				for (int32 i = 0; i < newCacheCount; i++)
+				{
+					int32 v = newCache[i];
+					cachePosition[v] = i < ForsythCacheSize ? i : -1;
+					vertexScore[v] = ForsythVertexScore(cachePosition[v], remaining[v]);
+				}
+
+				bestFace = -1;
+				bestScore = -1;
+				for (int32 i = 0; i < newCacheCount; i++)
+				{
+					int32 v = newCache[i];
+					int32 start = adjacencyStart[v];
+
+					for (int32 j = start; j < start + remaining[v]; j++)
+					{
+						int32 f = adjacency[j];
+						const int32* ai = indices + f * 3;
+
+						float score = vertexScore[ai[0]] + vertexScore[ai[1]] + vertexScore[ai[2]];
+						faceScore[f] = score;
+
+						if (score > bestScore)
+						{
+							bestScore = score;
+							bestFace = f;
+						}
+					}
+				}
+
+				cacheCount = Math::Min(newCacheCount, ForsythCacheSize);
+				memcpy(cache, newCache, sizeof(int32) * cacheCount);
+			}
+		}
+
+		void meshOptimizeVertexCache(MeshData* mesh)
+		{
+			if (mesh->Faces.getCount() == 0)
+				return;
+
+			List<int32> order;
+			List<int32> groupStarts;
+			GroupFacesByMaterial(mesh->Faces, order, groupStarts);
+
+			// the vertices used by each sub mesh are numbered from 0, to keep the work proportional to its size
+			int32* localIndex = new int32[mesh->VertexCount];
+			for (uint32 i = 0; i < mesh->VertexCount; i++)
+				localIndex[i] = -1;
+
+			List<MeshFace> newFaces(mesh->Faces.getCount());
+			List<int32> localIndices;
+			List<int32> localVertices;
+			List<int32> faceOrder;
+
+			for (int32 g = 0; g < groupStarts.getCount() - 1; g++)
+			{
+				int32 start = groupStarts[g];
+				int32 faceCount = groupStarts[g + 1] - start;
+				if (faceCount == 0)
+					continue;
+
+				localIndices.ReserveDiscard(faceCount * 3);
+				localVertices.Clear();
+
+				for (int32 i = 0; i < faceCount; i++)
+				{
+					const MeshFace& f = mesh->Faces[order[start + i]];
+					const int32 idx[3] = { f.IndexA, f.IndexB, f.IndexC };
+
+					for (int32 k = 0; k < 3; k++)
+					{
+						int32& li = localIndex[idx[k]];
+						if (li < 0)
+						{
+							li = localVertices.getCount();
+							localVertices.Add(idx[k]);
+						}
+						localIndices[i * 3 + k] = li;
+					}
+				}
+
+				faceOrder.ReserveDiscard(faceCount);
+				ForsythOptimize(localIndices.getElements(), faceCount, localVertices.getCount(), faceOrder.getElements());
+
+				for (int32 i = 0; i < faceCount; i++)
+					newFaces.Add(mesh->Faces[order[start + faceOrder[i]]]);
+
+				for (int32 v : localVertices)
+					localIndex[v] = -1;
+			}
+
+			delete[] localIndex;
+
+			mesh->Faces = newFaces;
+		}
+
+		/************************************************************************/
+		/*  Overdraw                                                            */
+		/************************************************************************/
+
+		/** The size of the FIFO cache assumed when cutting the faces into clusters. */
+		const int32 OverdrawCacheSize = 16;
+
+		struct FaceCluster
+		{
+			int32 Start;
+			int32 Count;
+			float SortKey;
+		};
+
+		void meshOptimizeOverdraw(MeshData* mesh, float threshold)
+		{
+			if (mesh->Faces.getCount() == 0)
+				return;
+
+			int32 positionOffset = -1;
+			for (const VertexElement& ve : mesh->VertexElements)
+			{
+				if (ve.getUsage() == VEU_Position && ve.getIndex() == 0 &&
+					(ve.getType() == VEF_Vector3 || ve.getType() == VEF_Vector4))
+				{
+					positionOffset = ve.getOffset();
+					break;
+				}
+			}
+			if (positionOffset < 0)
+				return;
+
+			auto getPosition = [mesh, positionOffset](int32 vtx)
+			{
+				Vector3 p;
+				memcpy(&p, mesh->VertexData + vtx * mesh->VertexSize + positionOffset, sizeof(Vector3));
+				return p;
+			};
+
+			List<int32> order;
+			List<int32> groupStarts;
+			GroupFacesByMaterial(mesh->Faces, order, groupStarts);
+
+			uint32* timestamps = new uint32[mesh->VertexCount];
+			memset(timestamps, 0, sizeof(uint32) * mesh->VertexCount);
+			uint32 time = 0;
+
+			auto faceMisses = [&](const MeshFace& f)
+			{
+				return SimulateFifoCache(f.IndexA, timestamps, time, OverdrawCacheSize) +
+					SimulateFifoCache(f.IndexB, timestamps, time, OverdrawCacheSize) +
+					SimulateFifoCache(f.IndexC, timestamps, time, OverdrawCacheSize);
+			};
+
+			List<MeshFace> newFaces(mesh->Faces.getCount());
+			List<int32> hardBoundaries;
+			List<FaceCluster> clusters;
+
+			for (int32 g = 0; g < groupStarts.getCount() - 1; g++)
+			{
+				int32 groupStart = groupStarts[g];
+				int32 groupEnd = groupStarts[g + 1];
+				if (groupStart == groupEnd)
+					continue;
+
+				// Hard boundaries are where all 3 vertices of a face miss. The cache is
+				// effectively empty there, so cutting costs nothing.
+				hardBoundaries.Clear();
+				time += OverdrawCacheSize + 1;
+				for (int32 i = groupStart; i < groupEnd; i++)
+				{
+					if (faceMisses(mesh->Faces[order[i]]) == 3)
+						hardBoundaries.Add(i);
+				}
+				hardBoundaries.Add(groupEnd);
+
+				// Soft boundaries cut the hard clusters further, as soon as the ACMR of the part so far 
+				// is within the threshold of the whole hard cluster's.
+				clusters.Clear();
+				for (int32 h = 0; h < hardBoundaries.getCount() - 1; h++)
+				{
+					int32 start = hardBoundaries[h];
+					int32 end = hardBoundaries[h + 1];
+
+					time += OverdrawCacheSize + 1;
+					int32 clusterMisses = 0;
+					for (int32 i = start; i < end; i++)
+						clusterMisses += faceMisses(mesh->Faces[order[i]]);
+
+					float clusterThreshold = threshold * clusterMisses / (end - start);
+
+					time += OverdrawCacheSize + 1;
+					int32 misses = 0;
+					int32 softStart = start;
+					for (int32 i = start; i < end; i++)
+					{
+						misses += faceMisses(mesh->Faces[order[i]]);
+
+						if (i + 1 < end && (float)misses / (i + 1 - softStart) <= clusterThreshold)
+						{
+							clusters.Add({ softStart, i + 1 - softStart, 0 });
+							softStart = i + 1;
+							misses = 0;
+							time += OverdrawCacheSize + 1;
+						}
+					}
+					clusters.Add({ softStart, end - softStart, 0 });
+				}
+
+				// Clusters facing away from the center of the sub mesh are likely to cover the
+				// rest, so those are drawn first.
+				Vector3 meshCenter = Vector3::Zero;
+				float meshArea = 0;
+
+				List<Vector3> clusterCenters(clusters.getCount());
+				List<Vector3> clusterNormals(clusters.getCount());
+
+				for (const FaceCluster& c : clusters)
+				{
+					Vector3 center = Vector3::Zero;
+					Vector3 normal = Vector3::Zero;
+					float area = 0;
+
+					for (int32 i = c.Start; i < c.Start + c.Count; i++)
+					{
+						const MeshFace& f = mesh->Faces[order[i]];
+						Vector3 a = getPosition(f.IndexA);
+						Vector3 b = getPosition(f.IndexB);
+						Vector3 c2 = getPosition(f.IndexC);
+
+						Vector3 n = Vector3::Cross(b - a, c2 - a);
+						float faceArea = n.Length();
+
+						center += (a + b + c2) * (faceArea / 3.0f);
+						normal += n;
+						area += faceArea;
+					}
+
+					meshCenter += center;
+					meshArea += area;
+
+					clusterCenters.Add(area > 0 ? center / area : center);
+					clusterNormals.Add(normal);
+				}
+
+				if (meshArea > 0)
+					meshCenter /= meshArea;
+
+				for (int32 i = 0; i < clusters.getCount(); i++)
+				{
+					Vector3 n = clusterNormals[i];
+					float len = n.Length();
+					if (len > 0)
+						n /= len;
+
+					clusters[i].SortKey = Vector3::Dot(clusterCenters[i] - meshCenter, n);
+				}
+
+				std::stable_sort(clusters.begin(), clusters.end(), [](const FaceCluster& a, const FaceCluster& b) { return a.SortKey > b.SortKey; });
+
+				for (const FaceCluster& c : clusters)
+				{
+					for (int32 i = c.Start; i < c.Start + c.Count; i++)
+						newFaces.Add(mesh->Faces[order[i]]);
+				}
+			}
+
+			delete[] timestamps;
+
+			mesh->Faces = newFaces;
+		}
+
+		void meshOptimizeVertexFetch(MeshData* mesh)
+		{
+			if (mesh->Faces.getCount() == 0)
+				return;
+
+			int32* remap = new int32[mesh->VertexCount];
+			for (uint32 i = 0; i < mesh->VertexCount; i++)
+				remap[i] = -1;
+
+			int32 nextIndex = 0;
+			for (MeshFace& f : mesh->Faces)
+			{
+				int32* idx[3] = { &f.IndexA, &f.IndexB, &f.IndexC };
+				for (int32 k = 0; k < 3; k++)
+				{
+					int32& r = remap[*idx[k]];
+					if (r < 0)
+						r = nextIndex++;
+					*idx[k] = r;
+				}
+			}
+
+			for (uint32 i = 0; i < mesh->VertexCount; i++)
+			{
+				if (remap[i] < 0)
+					remap[i] = nextIndex++;
+			}
+
+			char* newVertexData = new char[mesh->VertexSize * mesh->VertexCount];
+			for (uint32 i = 0; i < mesh->VertexCount; i++)
+			{
+				memcpy(newVertexData + remap[i] * mesh->VertexSize, mesh->VertexData + i * mesh->VertexSize, mesh->VertexSize);
+			}
+
+			delete[] remap;
+			delete[] mesh->VertexData;
+			mesh->VertexData = newVertexData;
+		}
+
+		bool meshSimplify(MeshData* mesh, float faceRatio)
+		{
+			const VertexElement* posElem = VertexElement::FindElementBySemantic(mesh->VertexElements, VEU_Position);
+			if (posElem == nullptr || posElem->getType() != VEF_Vector3)
+				return false;
+
+			if (mesh->Faces.getCount() == 0 || faceRatio >= 1)
+				return true;
+
+			List<Vector3> positions(mesh->VertexCount);
+			for (uint32 i = 0; i < mesh->VertexCount; i++)
+				positions.Add(*reinterpret_cast<const Vector3*>(mesh->VertexData + i * mesh->VertexSize + posElem->getOffset()));
+
+			List<int32> targets;
+			targets.Add((int32)(mesh->Faces.getCount() * faceRatio));
+
+			List<List<MeshFace>> lods;
+			MeshSimplifier::GenerateLODChain(positions, mesh->Faces, targets, lods);
+
+			mesh->Faces = std::move(lods[0]);
+
+			// the vertex fetch order puts the unused vertices at the end
+			meshOptimizeVertexFetch(mesh);
+
+			uint32 usedCount = 0;
+			for (const MeshFace& f : mesh->Faces)
+				usedCount = Math::Max(usedCount, (uint32)Math::Max(f.IndexA, Math::Max(f.IndexB, f.IndexC)) + 1);
+			mesh->VertexCount = usedCount;
+			return true;
+		}
 	}
 
 }
\ No newline at end of file
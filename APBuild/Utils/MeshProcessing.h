@@ -54,6 +54,45 @@ namespace APBuild
 		}
 
 		void meshGenerateVertexElements(uint32 fvf, List<VertexElement>& elements);
+
+		/** Post-transform vertex cache statistics of a mesh, drawn one sub mesh at a time. */
+		struct VertexCacheStatistics
+		{
+			/** Average cache miss ratio, the number of transformed vertices per triangle. 0.5 at best, 3 at worst. */
+			float ACMR = 0;
+			/** Average transform to vertex ratio, the number of transformed vertices per vertex used. 1 at best. */
+			float ATVR = 0;
+		};
+
+		/** Simulates a FIFO post-transform cache of the given size over the faces of each sub mesh. */
+		VertexCacheStatistics meshAnalyzeVertexCache(const MeshData* mesh, int32 cacheSize = 16);
+
+		/**
+		 *  Reorders the faces of each sub mesh for post-transform cache locality, with Tom Forsyth's
+		 *  linear-speed vertex cache optimization. The faces are also grouped by material.
+		 */
+		void meshOptimizeVertexCache(MeshData* mesh);
+
+		/**
+		 *  Reorders clusters of faces in each sub mesh so the ones facing out of the mesh are drawn 
+		 *  first, to reduce overdraw. The clusters are cut where the vertex cache order allows, 
+		 *  which should be done first with meshOptimizeVertexCache.
+		 *  @param threshold How much the ACMR can get worse for smaller clusters, 1.05 allows 5%.
+		 */
+		void meshOptimizeOverdraw(MeshData* mesh, float threshold);
+
+		/**
+		 *  Reorders the vertices in the order they are first used by the faces, for locality
+		 *  in vertex fetching. Vertices not used by any face are kept at the end.
+		 */
+		void meshOptimizeVertexFetch(MeshData* mesh);
+
+		/**
+		 *  Reduces the faces of a mesh to about the given fraction with MeshSimplifier's quadric edge
+		 *  collapse, and removes the vertices no longer used.
+		 *  @return false if the mesh has no float3 positions to simplify with.
+		 */
+		bool meshSimplify(MeshData* mesh, float faceRatio);
 		
 	}
 }
\ No newline at end of file
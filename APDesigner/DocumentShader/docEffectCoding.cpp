@@ -164,6 +164,10 @@ namespace APDesigner
 		{
 			ep.InstanceBlobIndex = ps->GetAttributeInt(L"BlobIndex");
 		}
+		else if (ep.Usage == EPUSAGE_Trans_InstanceStream)
+		{
+			ps->TryGetAttributeInt(L"BlobCount", ep.InstanceStreamBlobCount);
+		}
 	}
 	void EffectDocument::LoadRes()
 	{
@@ -225,6 +229,8 @@ namespace APDesigner
 				sect->AddAttributeString(L"CustomUsage", ep.CustomMaterialParamName);
 			else if (ep.Usage == EPUSAGE_CustomMaterialParam)
 				sect->AddAttributeString(L"BlobIndex", StringUtils::IntToString(ep.InstanceBlobIndex));
+			else if (ep.Usage == EPUSAGE_Trans_InstanceStream)
+				sect->AddAttributeString(L"BlobCount", StringUtils::IntToString(ep.InstanceStreamBlobCount));
 
 			//if (ep.RegisterIndex == 99)
 			ep.SamplerState.Save(sect);
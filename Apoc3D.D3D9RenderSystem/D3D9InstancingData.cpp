@@ -61,6 +61,13 @@ namespace Apoc3D
 				{
 					decl->Release();
 				}
+				for (auto& table : m_streamDeclExpansionTables)
+				{
+					for (IDirect3DVertexDeclaration9* decl : table.getValueAccessor())
+					{
+						decl->Release();
+					}
+				}
 				m_vertexBuffer->Release();
 				m_vertexBuffer = 0;
 			}
@@ -100,6 +107,50 @@ namespace Apoc3D
 				}
 				return result;
 			}
+			IDirect3DVertexDeclaration9* D3D9InstancingData::ExpandVertexDeclForStream(VertexDeclaration* decl, int32 blobValueCount)
+			{
+				HashMap<VertexDeclaration*, IDirect3DVertexDeclaration9*>& table = m_streamDeclExpansionTables[blobValueCount];
+
+				IDirect3DVertexDeclaration9* result;
+				if (!table.TryGetValue(decl, result))
+				{
+					int32 instanceElementCount = InstanceStreamTransformSize + blobValueCount;
+
+					D3DVERTEXELEMENT9* elems = new D3DVERTEXELEMENT9[decl->getElementCount() + instanceElementCount + 1];
+					for (int i = 0; i < decl->getElementCount(); i++)
+					{
+						const VertexElement& e = decl->getElement(i);
+						elems[i].Method = D3DDECLMETHOD_DEFAULT;
+						elems[i].Stream = 0;
+						elems[i].Offset = (WORD)e.getOffset();
+						elems[i].Usage = (BYTE)D3D9Utils::ConvertVertexElementUsage(e.getUsage());
+						elems[i].Type = (BYTE)D3D9Utils::ConvertVertexElementFormat(e.getType());
+						elems[i].UsageIndex = (BYTE)e.getIndex();
+					}
+
+					for (int32 i = 0; i < instanceElementCount; i++)
+					{
+						D3DVERTEXELEMENT9& ie = elems[decl->getElementCount() + i];
+						ie.Method = D3DDECLMETHOD_DEFAULT;
+						ie.Stream = 1;
+						ie.Offset = (WORD)(i * sizeof(Vector4));
+						ie.Usage = D3DDECLUSAGE_TEXCOORD;
+						ie.Type = D3DDECLTYPE_FLOAT4;
+						ie.UsageIndex = (BYTE)(InstanceStreamTexCoordIndex + i);
+					}
+
+					elems[decl->getElementCount() + instanceElementCount] = InstanceVertexElements[1];
+
+					HRESULT hr = m_d3ddev->getDevice()->CreateVertexDeclaration(elems, &result);
+					assert(SUCCEEDED(hr));
+
+					table.Add(decl, result);
+
+					delete[] elems;
+				}
+				return result;
+			}
+
 			int D3D9InstancingData::Setup(const RenderOperation* op, int count, int beginIndex)
 			{
 				// In d3d no more setup is needed
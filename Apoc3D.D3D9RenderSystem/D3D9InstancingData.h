@@ -51,9 +51,13 @@ namespace Apoc3D
 				IDirect3DVertexBuffer9* GetInstanceBuffer() const { return m_vertexBuffer; }
 				IDirect3DVertexDeclaration9* ExpandVertexDecl(VertexDeclaration* decl);
 
+				/** Adds the elements of the instance stream in stream 1, with the given number of instance blob values. */
+				IDirect3DVertexDeclaration9* ExpandVertexDeclForStream(VertexDeclaration* decl, int32 blobValueCount);
+
 				int getInstanceDataSize() const { return sizeof(float); }
 			private:
 				HashMap<VertexDeclaration*, IDirect3DVertexDeclaration9*> m_vtxDeclExpansionTable;
+				HashMap<VertexDeclaration*, IDirect3DVertexDeclaration9*> m_streamDeclExpansionTables[MaxInstanceStreamBlobValues + 1];
 
 				/** Per-instance index stored in this vertex buffer */
 				IDirect3DVertexBuffer9* m_vertexBuffer;
@@ -438,12 +438,81 @@ namespace Apoc3D
 
 				D3DDevice* d3dd = getDevice();
 
+				// the whole group goes in the instance stream once, and is drawn in one call for each pass
+				bool streamInstancing = fx->SupportsStreamInstancing();
+				InstanceStreamRange instanceRange;
+				if (streamInstancing)
+				{
+					instanceRange = m_instancingData->FillInstanceStream(op, count, fx->getInstanceStreamBlobValueCount());
+				}
+				else if (!fx->SupportsInstancing())
+				{
+					fx->Prepare(mtrl, op, count);
+				}
+
 				int passCount = fx->Begin();
 				for (int p = 0; p < passCount; p++)
 				{
 					fx->BeginPass(p);
 
-					if (fx->SupportsInstancing())
+					if (streamInstancing)
+					{
+						const GeometryData* gm = op[0].GeometryData;
+
+						m_primitiveCount += gm->PrimitiveCount*count;
+						m_vertexCount += gm->VertexCount*count;
+
+						fx->Setup(mtrl, op, count);
+
+						VertexDeclaration* vtxDecl = static_cast<D3D9VertexDeclaration*>(gm->VertexDecl);
+						d3dd->SetVertexDeclaration(m_instancingData->ExpandVertexDeclForStream(vtxDecl, instanceRange.BlobValueCount));
+
+						D3D9VertexBuffer* dvb = static_cast<D3D9VertexBuffer*>(gm->VertexBuffer);
+						D3D9VertexBuffer* instanceBuffer = static_cast<D3D9VertexBuffer*>(m_instancingData->getInstanceStream());
+
+						d3dd->SetStreamSource(0, dvb->getD3DBuffer(), 0, gm->VertexSize);
+
+						if (gm->usesIndex())
+						{
+							D3D9IndexBuffer* dib = static_cast<D3D9IndexBuffer*>(gm->IndexBuffer);
+							d3dd->SetIndices(dib->getD3DBuffer());
+							d3dd->SetStreamSource(1, instanceBuffer->getD3DBuffer(), instanceRange.Offset, instanceRange.Stride);
+
+							d3dd->SetStreamSourceFreq(0, (D3DSTREAMSOURCE_INDEXEDDATA | (uint32)instanceRange.InstanceCount));
+							d3dd->SetStreamSourceFreq(1, (D3DSTREAMSOURCE_INSTANCEDATA | 1U));
+
+							int32 vertexRangeStart, vertexRangeCount;
+							GetLegitVertexRangeUsed(gm, dvb, vertexRangeStart, vertexRangeCount);
+
+							d3dd->DrawIndexedPrimitive(D3D9Utils::ConvertPrimitiveType(gm->PrimitiveType),
+								gm->BaseVertex,
+								vertexRangeStart, vertexRangeCount,
+								gm->StartIndex,
+								gm->PrimitiveCount);
+
+							m_batchCount++;
+
+							d3dd->SetStreamSourceFreq(0, 1);
+							d3dd->SetStreamSourceFreq(1, 1);
+						}
+						else
+						{
+							// D3D9 only instances indexed draws. Each instance is drawn on its own instead, with
+							// a zero stride so every vertex reads the same instance from the stream
+							d3dd->SetIndices(0);
+
+							for (int32 j = 0; j < instanceRange.InstanceCount; j++)
+							{
+								d3dd->SetStreamSource(1, instanceBuffer->getD3DBuffer(), instanceRange.Offset + j * instanceRange.Stride, 0);
+
+								d3dd->DrawPrimitive(D3D9Utils::ConvertPrimitiveType(gm->PrimitiveType),
+									gm->BaseVertex, gm->PrimitiveCount);
+
+								m_batchCount++;
+							}
+						}
+					}
+					else if (fx->SupportsInstancing())
 					{
 						// here the input render operation list is guaranteed to have the same geometry data,
 						// instancing drawing is done here once the effect supports it
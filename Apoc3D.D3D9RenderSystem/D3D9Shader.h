@@ -67,6 +67,8 @@ namespace Apoc3D
 				bool TryGetParamIndex(const String& paramName, int& result) override;
 				bool TryGetSamplerIndex(const String& paramName, int& result) override;
 
+				bool HasLinearRegisters() const override { return true; }
+
 				void SetVector2(int32 reg, const Vector2& value) override;
 				void SetVector3(int32 reg, const Vector3& value) override;
 				void SetVector4(int32 reg, const Vector4& value) override;
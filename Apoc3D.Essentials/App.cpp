@@ -3,6 +3,7 @@
 
 #include "apoc3d/Core/AppTime.h"
 #include "apoc3d/Core/ResourceManager.h"
+#include "apoc3d/Core/TaskScheduler.h"
 #include "apoc3d/Config/XmlConfigurationFormat.h"
 
 #include "apoc3d/Graphics/RenderSystem/RenderWindow.h"
@@ -118,6 +119,8 @@ namespace Apoc3D
 		SystemUI::Update(time);
 
 		ResourceManager::PerformAllPostSync(time->ElapsedRealTime);
+
+		TaskScheduler::getSingleton().RunMainThreadTasks();
 	}
 
 	const AppTime* Application::GetRecordCorrectedTime(const AppTime* time)
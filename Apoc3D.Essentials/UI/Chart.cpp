@@ -63,7 +63,7 @@ namespace Apoc3D
 		}
 
 		Chart::DataSource::DataSource(DataSource&& o)
-			: m_desc(o.m_desc), m_points(std::move(o.m_points))
+			: m_desc(o.m_desc), m_points(std::move(o.m_points)), m_viewDependent(o.m_viewDependent)
 		{
 			o.m_desc.m_data = nullptr;
 		}
@@ -131,7 +131,7 @@ namespace Apoc3D
 
 		ChartBackgroundUpdater::ChartBackgroundUpdater()
 		{
-			StartBackground(L"Chart worker", 1);
+			StartPooled();
 		}
 
 		ChartBackgroundUpdater::~ChartBackgroundUpdater()
@@ -346,7 +346,8 @@ namespace Apoc3D
 
 		void Chart::Update(const AppTime* time)
 		{
-			if (m_scrollable && IsInteractive)
+			// while a refresh is pending the background task owns the view and the cached points
+			if (m_scrollable && IsInteractive && m_isReady)
 			{
 				Mouse* mouse = InputAPIManager::getSingleton().getMouse();
 
@@ -367,6 +368,9 @@ namespace Apoc3D
 
 						m_xStart += xShift;
 
+						if (xShift != 0)
+							_RecacheViewDependentData();
+
 						if (m_autoFitYLocal || m_autoFitYGlobal)
 							_CalculateAutoYRange();
 					}
@@ -393,6 +397,8 @@ namespace Apoc3D
 						m_xStart = xStart;
 						m_xZoom = m_size.X / xSpan;
 
+						_RecacheViewDependentData();
+
 						if (m_autoFitYLocal || m_autoFitYGlobal)
 							_CalculateAutoYRange();
 					}
@@ -416,29 +422,10 @@ namespace Apoc3D
 
 		void Chart::BackgroundDataThread(bool init)
 		{
+			_RecalculateDomain();
+
 			if (init)
 			{
-				bool noData = true;
-
-				for (DataSource& src : m_data)
-				{
-					double xMin, xMax;
-					if (src.m_desc.m_data->GetDomain(xMin, xMax))
-					{
-						if (noData)
-						{
-							noData = false;
-							m_xLowbound = xMin;
-							m_xHighbound = xMax;
-						}
-						else
-						{
-							m_xLowbound = Math::Min(xMin, m_xLowbound);
-							m_xHighbound = Math::Max(xMin, m_xHighbound);
-						}
-					}
-				}
-
 				m_xStart = m_xHighbound - m_size.X / m_xZoom;
 			}
 
@@ -450,6 +437,30 @@ namespace Apoc3D
 			m_isReady = true;
 		}
 
+		void Chart::_RecalculateDomain()
+		{
+			bool noData = true;
+
+			for (DataSource& src : m_data)
+			{
+				double xMin, xMax;
+				if (src.m_desc.m_data->GetDomain(xMin, xMax))
+				{
+					if (noData)
+					{
+						noData = false;
+						m_xLowbound = xMin;
+						m_xHighbound = xMax;
+					}
+					else
+					{
+						m_xLowbound = Math::Min(xMin, m_xLowbound);
+						m_xHighbound = Math::Max(xMax, m_xHighbound);
+					}
+				}
+			}
+		}
+
 		void Chart::_RecacheData()
 		{
 			double xStart = getXStart();
@@ -457,10 +468,26 @@ namespace Apoc3D
 
 			for (DataSource& ds : m_data)
 			{
+				ds.m_viewDependent = ds.m_desc.m_data->SetResolution(1.0 / m_xZoom);
 				ds.RecacheData(xStart, xEnd);
 			}
 		}
 
+		void Chart::_RecacheViewDependentData()
+		{
+			double xStart = getXStart();
+			double xEnd = getXEnd();
+
+			for (DataSource& ds : m_data)
+			{
+				if (ds.m_viewDependent)
+				{
+					ds.m_desc.m_data->SetResolution(1.0 / m_xZoom);
+					ds.RecacheData(xStart, xEnd);
+				}
+			}
+		}
+
 		void Chart::_CalculateAutoYRange()
 		{
 			const double xStart = getXStart();
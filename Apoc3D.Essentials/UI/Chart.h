@@ -214,6 +214,9 @@ namespace Apoc3D
 				double m_currentXStart = 0;
 				double m_currentXEnd = 0;
 
+				/** The source decimates to the chart's resolution, so its points are fetched again after each pan and zoom. */
+				bool m_viewDependent = false;
+
 				DataSource(ChartDataSourceDesc info);
 				~DataSource();
 
@@ -234,7 +237,9 @@ namespace Apoc3D
 			Point Transform(const ChartDataPoint& pt) const;
 			
 			void BackgroundDataThread(bool init);
+			void _RecalculateDomain();
 			void _RecacheData();
+			void _RecacheViewDependentData();
 			void _CalculateAutoYRange();
 
 			List<DataSource> m_data;
@@ -245,7 +250,7 @@ namespace Apoc3D
 			double m_xLowbound = 0;
 			double m_xHighbound = 0;
 
-			bool m_isReady = false;
+			std::atomic<bool> m_isReady = false;
 			bool m_scrollable = false;
 			bool m_cachedRender = false;
 			bool m_autoFitX = false;
@@ -1,5 +1,7 @@
 #include "ChartDataSource.h"
 
+#include "apoc3d/Math/Math.h"
+
 namespace Apoc3D
 {
 	namespace UI
@@ -45,6 +47,246 @@ namespace Apoc3D
 			return false;
 		}
 
+#pragma endregion
+
+#pragma region PyramidDataSource
+		//////////////////////////////////////////////////////////////////////////
+
+		PyramidDataSource::PyramidDataSource(double xStart, double xStep, ChartDecimationMode mode)
+			: m_xStart(xStart), m_xStep(xStep), m_mode(mode) { }
+
+		PyramidDataSource::~PyramidDataSource()
+		{
+
+		}
+
+		void PyramidDataSource::Append(double y)
+		{
+			m_samples.Add(y);
+
+			if (m_samples.getCount() % Fanout == 0)
+				CompleteNode(0);
+		}
+
+		void PyramidDataSource::Append(const double* y, int32 count)
+		{
+			for (int32 i = 0; i < count; i++)
+				Append(y[i]);
+		}
+
+		void PyramidDataSource::Clear()
+		{
+			m_samples.Clear();
+			for (List<Summary>& lvl : m_levels)
+				lvl.Clear();
+		}
+
+		void PyramidDataSource::CompleteNode(int32 level)
+		{
+			Summary s = EmptySummary();
+
+			if (level == 0)
+			{
+				for (int32 i = m_samples.getCount() - Fanout; i < m_samples.getCount(); i++)
+				{
+					double v = m_samples[i];
+					if (v < s.Min) { s.Min = v; s.MinIndex = i; }
+					if (v > s.Max) { s.Max = v; s.MaxIndex = i; }
+					s.Sum += v;
+				}
+			}
+			else
+			{
+				const List<Summary>& below = m_levels[level - 1];
+				for (int32 i = below.getCount() - Fanout; i < below.getCount(); i++)
+					Merge(s, below[i]);
+			}
+
+			m_levels[level].Add(s);
+
+			if (level + 1 < MaxLevels && m_levels[level].getCount() % Fanout == 0)
+				CompleteNode(level + 1);
+		}
+
+		PyramidDataSource::Summary PyramidDataSource::EmptySummary()
+		{
+			Summary s;
+			s.Min = std::numeric_limits<double>::infinity();
+			s.Max = -std::numeric_limits<double>::infinity();
+			s.Sum = 0;
+			s.MinIndex = s.MaxIndex = -1;
+			return s;
+		}
+
+		void PyramidDataSource::Merge(Summary& dst, const Summary& src)
+		{
+			if (src.Min < dst.Min) { dst.Min = src.Min; dst.MinIndex = src.MinIndex; }
+			if (src.Max > dst.Max) { dst.Max = src.Max; dst.MaxIndex = src.MaxIndex; }
+			dst.Sum += src.Sum;
+		}
+
+		PyramidDataSource::Summary PyramidDataSource::Summarize(int32 start, int32 end) const
+		{
+			Summary r = EmptySummary();
+
+			int32 i = start;
+			while (i < end)
+			{
+				// take the largest complete node that starts at i and ends within the range
+				int32 level = -1;
+				int64 span = 1;
+
+				while (level + 1 < MaxLevels)
+				{
+					int64 nextSpan = span * Fanout;
+					if (i % nextSpan != 0 || i + nextSpan > end || i / nextSpan >= m_levels[level + 1].getCount())
+						break;
+
+					level++;
+					span = nextSpan;
+				}
+
+				if (level < 0)
+				{
+					double v = m_samples[i];
+
+					Summary s;
+					s.Min = s.Max = s.Sum = v;
+					s.MinIndex = s.MaxIndex = i;
+					Merge(r, s);
+				}
+				else
+				{
+					Merge(r, m_levels[level][(int32)(i / span)]);
+				}
+
+				i += (int32)span;
+			}
+			return r;
+		}
+
+		ChartDataPoint PyramidDataSource::MakePoint(int32 index) const
+		{
+			ChartDataPoint p;
+			p.m_x = m_xStart + index * m_xStep;
+			p.m_y = m_samples[index];
+			p.m_y_open = p.m_y_low = p.m_y_high = p.m_y;
+			return p;
+		}
+
+		void PyramidDataSource::GetData(double start, double end, List<ChartDataPoint>& data)
+		{
+			const int32 count = m_samples.getCount();
+			if (count == 0)
+				return;
+
+			int32 first = (int32)Math::Clamp(ceil((start - m_xStart) / m_xStep), 0.0, (double)count);
+			int32 last = (int32)Math::Clamp(floor((end - m_xStart) / m_xStep), -1.0, (double)(count - 1));
+			if (first > last)
+				return;
+
+			double samplesPerPixel = m_xPerPixel / m_xStep;
+			if (samplesPerPixel < 2)
+			{
+				for (int32 i = first; i <= last; i++)
+					data.Add(MakePoint(i));
+				return;
+			}
+
+			// buckets are aligned to the start of the series, so panning gives the same points
+			const int32 bucketSize = (int32)Math::Min(samplesPerPixel, (double)count);
+			const int32 firstBucket = first / bucketSize;
+			const int32 lastBucket = last / bucketSize;
+
+			if (m_mode == ChartDecimationMode::LTTB)
+			{
+				int32 curStart = firstBucket * bucketSize;
+				int32 curEnd = Math::Min(count, curStart + bucketSize);
+				Summary cur = Summarize(curStart, curEnd);
+
+				double prevX = curStart;
+				double prevY = m_samples[curStart];
+
+				for (int32 b = firstBucket; b <= lastBucket; b++)
+				{
+					int32 nextStart = curEnd;
+					int32 nextEnd = Math::Min(count, nextStart + bucketSize);
+
+					Summary next;
+					double avgX, avgY;
+					if (nextStart < nextEnd)
+					{
+						next = Summarize(nextStart, nextEnd);
+						avgX = (nextStart + nextEnd - 1) * 0.5;
+						avgY = next.Sum / (nextEnd - nextStart);
+					}
+					else
+					{
+						avgX = curEnd - 1;
+						avgY = m_samples[curEnd - 1];
+					}
+
+					// keep the candidate forming the largest triangle with the previous point and the next bucket's average
+					double areaMin = fabs((prevX - avgX) * (cur.Min - prevY) - (prevX - cur.MinIndex) * (avgY - prevY));
+					double areaMax = fabs((prevX - avgX) * (cur.Max - prevY) - (prevX - cur.MaxIndex) * (avgY - prevY));
+					int32 chosen = areaMax > areaMin ? cur.MaxIndex : cur.MinIndex;
+
+					data.Add(MakePoint(chosen));
+
+					prevX = chosen;
+					prevY = m_samples[chosen];
+
+					cur = next;
+					curEnd = nextEnd;
+				}
+				return;
+			}
+
+			for (int32 b = firstBucket; b <= lastBucket; b++)
+			{
+				int32 s = b * bucketSize;
+				int32 e = Math::Min(count, s + bucketSize);
+				Summary sum = Summarize(s, e);
+
+				if (m_mode == ChartDecimationMode::OHLC)
+				{
+					ChartDataPoint p;
+					p.m_x = m_xStart + s * m_xStep;
+					p.m_y_open = m_samples[s];
+					p.m_y = m_samples[e - 1];
+					p.m_y_low = sum.Min;
+					p.m_y_high = sum.Max;
+					data.Add(p);
+				}
+				else
+				{
+					int32 a = Math::Min(sum.MinIndex, sum.MaxIndex);
+					int32 z = Math::Max(sum.MinIndex, sum.MaxIndex);
+
+					data.Add(MakePoint(a));
+					if (z != a)
+						data.Add(MakePoint(z));
+				}
+			}
+		}
+
+		bool PyramidDataSource::GetDomain(double& minX, double& maxX)
+		{
+			if (m_samples.getCount() > 0)
+			{
+				minX = m_xStart;
+				maxX = m_xStart + m_samples.getCount() * m_xStep;
+				return true;
+			}
+			return false;
+		}
+
+		bool PyramidDataSource::SetResolution(double xPerPixel)
+		{
+			m_xPerPixel = xPerPixel;
+			return true;
+		}
+
 #pragma endregion
 	}
 }
\ No newline at end of file
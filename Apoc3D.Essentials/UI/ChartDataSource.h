@@ -16,6 +16,13 @@ namespace Apoc3D
 
 			virtual void GetData(double start, double end, List<ChartDataPoint>& data) = 0;
 			virtual bool GetDomain(double& minX, double& maxX) = 0;
+
+			/**
+			 *  Tells the source the x span of one pixel of the chart, before data is fetched.
+			 *  Returns true if GetData depends on it, which makes the chart fetch again after
+			 *  every pan and zoom.
+			 */
+			virtual bool SetResolution(double xPerPixel) { return false; }
 		};
 
 		class RawDataSource : public IChartDataSource
@@ -33,5 +40,76 @@ namespace Apoc3D
 			bool m_noTime = false;
 		};
 
+		enum struct ChartDecimationMode
+		{
+			/** The lowest and highest sample of each pixel, in the order they appear. */
+			MinMax,
+			/** One sample per pixel, chosen among its lowest and highest by largest triangle three buckets. */
+			LTTB,
+			/** One point per pixel with open, high, low and close, for candlestick series. */
+			OHLC
+		};
+
+		/**
+		 *  A series of evenly spaced samples, kept with a pyramid of min/max summaries.
+		 *
+		 *  Each level summarizes groups of Fanout nodes of the level below, so the samples in any
+		 *  range can be summarized from a few nodes. GetData returns one group of points per pixel
+		 *  of the chart, and only returns the raw samples when there are fewer of them than pixels.
+		 *  Appending a sample only completes the upper nodes once every Fanout samples of the level
+		 *  below, so it is O(1) amortized.
+		 */
+		class PyramidDataSource : public IChartDataSource
+		{
+		public:
+			static const int32 Fanout = 16;
+			static const int32 MaxLevels = 8;
+
+			PyramidDataSource(double xStart = 0, double xStep = 1, ChartDecimationMode mode = ChartDecimationMode::MinMax);
+			~PyramidDataSource();
+
+			void Append(double y);
+			void Append(const double* y, int32 count);
+			void Clear();
+
+			void GetData(double start, double end, List<ChartDataPoint>& data) override;
+			bool GetDomain(double& minX, double& maxX) override;
+			bool SetResolution(double xPerPixel) override;
+
+			int32 getSampleCount() const { return m_samples.getCount(); }
+
+			ChartDecimationMode getMode() const { return m_mode; }
+			void setMode(ChartDecimationMode mode) { m_mode = mode; }
+
+		private:
+			struct Summary
+			{
+				double Min;
+				double Max;
+				double Sum;
+				int32 MinIndex;
+				int32 MaxIndex;
+			};
+
+			static Summary EmptySummary();
+			static void Merge(Summary& dst, const Summary& src);
+
+			void CompleteNode(int32 level);
+
+			/** Summarizes the samples in [start, end) */
+			Summary Summarize(int32 start, int32 end) const;
+
+			ChartDataPoint MakePoint(int32 index) const;
+
+			double m_xStart;
+			double m_xStep;
+			double m_xPerPixel = 0;
+			ChartDecimationMode m_mode;
+
+			List<double> m_samples;
+			/** Level i has one node for every Fanout^(i+1) samples, only for the complete ones. */
+			List<Summary> m_levels[MaxLevels];
+		};
+
 	}
 }
\ No newline at end of file
@@ -30,7 +30,7 @@ namespace Apoc3D
 
 		TabLoadingQueue::TabLoadingQueue()
 		{
-			StartBackground(L"Tab loader", 1);
+			StartPooled();
 		}
 
 		TabLoadingQueue::~TabLoadingQueue()
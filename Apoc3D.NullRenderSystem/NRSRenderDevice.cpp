@@ -236,12 +236,36 @@ namespace Apoc3D
 				}
 
 
+				// the whole group goes in the instance stream once, and is drawn in one call for each pass
+				bool streamInstancing = fx->SupportsStreamInstancing();
+				InstanceStreamRange instanceRange;
+				if (streamInstancing)
+				{
+					instanceRange = m_instancingData->FillInstanceStream(op, count, fx->getInstanceStreamBlobValueCount());
+				}
+				else if (!fx->SupportsInstancing())
+				{
+					fx->Prepare(mtrl, op, count);
+				}
+
 				int passCount = fx->Begin();
 				for (int p = 0; p < passCount; p++)
 				{
 					fx->BeginPass(p);
 
-					if (fx->SupportsInstancing())
+					if (streamInstancing)
+					{
+						const GeometryData* gm = op[0].GeometryData;
+
+						m_primitiveCount += gm->PrimitiveCount*instanceRange.InstanceCount;
+						m_vertexCount += gm->VertexCount*instanceRange.InstanceCount;
+
+						fx->Setup(mtrl, op, count);
+
+						// non-indexed geometry is drawn one instance at a time, as in the D3D9 device
+						m_batchCount += gm->usesIndex() ? 1 : instanceRange.InstanceCount;
+					}
+					else if (fx->SupportsInstancing())
 					{
 						// here the input render operation list is guaranteed to have the same geometry data,
 						// instancing drawing is done here once the effect supports it
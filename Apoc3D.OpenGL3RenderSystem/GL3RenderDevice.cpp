@@ -350,6 +350,10 @@ namespace Apoc3D
 						m_nativeState->SetColorWriteMasks(i, masks);
 				}
 
+				if (!fx->SupportsInstancing())
+				{
+					fx->Prepare(mtrl, op, count);
+				}
 
 				int passCount = fx->Begin();
 				for (int p = 0; p < passCount; p++)
@@ -20,8 +20,16 @@
 
 #define APOC3D_DEFAULT 0
 #define APOC3D_SSE 1
+
+// The SSE layout for Matrix and Vectors is not maintained. SIMD is used through Matrix::Multiply
+// and the batched functions in Math/MathBatch.h instead.
 #define APOC3D_MATH_IMPL APOC3D_DEFAULT
 
+// Builds the AVX2/FMA kernels for the batched math functions and pixel conversion. They are only picked when the CPU supports them.
+#ifndef APOC3D_MATH_AVX2
+#define APOC3D_MATH_AVX2 1
+#endif
+
 #define APOC3D_PLATFORM_WINDOWS 0
 #define APOC3D_PLATFORM_MAC 1
 #define APOC3D_PLATFORM_LINUX 2
@@ -253,6 +261,9 @@ namespace Apoc3D
 
 		class LogSet;
 
+		class TaskScheduler;
+		class TaskHandle;
+
 		struct CommandDescription;
 
 		namespace Streaming
@@ -261,6 +272,10 @@ namespace Apoc3D
 
 			class AsyncProcessor;
 			class GenerationTable;
+			class StreamingScheduler;
+			class PostSyncQueue;
+			struct PostSyncState;
+			struct PostSyncStatistics;
 		};
 	};
 	namespace Config
@@ -373,6 +388,7 @@ namespace Apoc3D
 		class SimpleSceneNode;
 		class OctreeSceneManager;
 		class OctreeSceneNode;
+		class FlatOctreeCuller;
 		class SceneObject;
 		class BatchData;
 		class DynamicObject;
@@ -413,6 +429,7 @@ namespace Apoc3D
 			class RootAnimationPlayer;
 			class RigidAnimationPlayer;
 			class SkinnedAnimationPlayer;
+			class SkinningBatch;
 			class MaterialAnimationPlayer;
 		}
 
@@ -508,8 +525,11 @@ namespace Apoc3D
 		class ScrollBar;
 		class TreeView;
 		class TreeViewNode;
+		class VirtualTreeView;
+		class TreeViewDataSource;
 		class ListBox;
 		class ListView;
+		class ListViewDataSource;
 		class TextBox;
 		class CheckBox;
 		class CheckboxGroup;
@@ -21,6 +21,7 @@
 
 #include "apoc3d/ApocCommon.h"
 #include "apoc3d/Collections/Queue.h"
+#include "apoc3d/Core/TaskScheduler.h"
 #include "apoc3d/Platform/Thread.h"
 #include "apoc3d/Utility/StringUtils.h"
 
@@ -42,6 +43,9 @@ namespace Apoc3D
 				{
 					bool isIdle = QueryTaskCount() == 0;
 
+					if (isIdle && m_drainActive)
+						isIdle = false;
+
 					if (isIdle)
 					{
 						// check waiting threads
@@ -91,8 +95,41 @@ namespace Apoc3D
 					m_threads.Add(th);
 				}
 			}
+
+			/**
+			 *  Processes the work items on the TaskScheduler's threads instead of threads of its own.
+			 *  Items are still processed one at a time, in the order they are added. When the scheduler
+			 *  has no workers, they are processed as the main thread calls TaskScheduler::RunMainThreadTasks.
+			 *  BackgroundMainBegining/BackgroundMainEnding are not called in this mode.
+			 */
+			void StartPooled()
+			{
+				StopBackground();
+
+				m_terminating = false;
+				m_pooled = true;
+			}
+
 			void StopBackground()
 			{
+				if (m_pooled)
+				{
+					TaskHandle drain;
+					{
+						std::lock_guard<std::mutex> lock(m_queueMutex);
+						m_terminating = true;
+						drain = m_drainTask;
+					}
+
+					// the drain task stops after the item in progress
+					if (TaskScheduler::isInitialized())
+						TaskScheduler::getSingleton().Wait(drain);
+					assert(drain.isDone());
+
+					m_drainTask = TaskHandle();
+					m_pooled = false;
+				}
+
 				if (m_threads.getCount())
 				{
 					m_terminating = true;
@@ -110,6 +147,9 @@ namespace Apoc3D
 
 			void StopBackgroundAsync()
 			{
+				if (m_pooled)
+					m_terminating = true;
+
 				if (m_threads.getCount())
 				{
 					m_terminating = true;
@@ -123,6 +163,7 @@ namespace Apoc3D
 				m_taskQueue.Enqueue(item);
 
 				m_queueEmptyWait.notify_all();
+				SubmitDrain();
 				m_queueMutex.unlock();
 			}
 
@@ -132,6 +173,7 @@ namespace Apoc3D
 				m_taskQueue.Enqueue(std::move(item));
 
 				m_queueEmptyWait.notify_all();
+				SubmitDrain();
 				m_queueMutex.unlock();
 			}
 
@@ -173,6 +215,9 @@ namespace Apoc3D
 			bool IsStopping() const { return m_terminating && IsRunning(); }
 			bool IsRunning() const 
 			{
+				if (m_pooled)
+					return !m_terminating || m_drainActive;
+
 				for (const ThreadData& td : m_threadData)
 				{
 					if (td.m_isRunning)
@@ -255,6 +300,36 @@ namespace Apoc3D
 				BackgroundMainEnding();
 			}
 
+			/** Starts a task processing the queue, if pooled and none is active. Called with m_queueMutex held. */
+			void SubmitDrain()
+			{
+				if (m_pooled && !m_terminating && !m_drainActive)
+				{
+					m_drainActive = true;
+					m_drainTask = TaskScheduler::getSingleton().Submit([this]() { DrainPooled(); });
+				}
+			}
+
+			void DrainPooled()
+			{
+				for (;;)
+				{
+					T task;
+					{
+						std::lock_guard<std::mutex> lock(m_queueMutex);
+
+						if (m_terminating || m_taskQueue.getCount() == 0)
+						{
+							m_drainActive = false;
+							break;
+						}
+						task = m_taskQueue.Dequeue();
+					}
+
+					BackgroundMainProcess(task);
+				}
+			}
+
 			std::condition_variable m_queueEmptyWait;
 			std::mutex m_queueMutex;
 			Apoc3D::Collections::Queue<T> m_taskQueue;
@@ -264,6 +339,12 @@ namespace Apoc3D
 
 			std::atomic<bool> m_terminating = true;
 			std::atomic<bool> m_autoStop = false;
+
+			std::atomic<bool> m_pooled = false;
+			/** Whether a scheduler task is processing the queue in pooled mode */
+			std::atomic<bool> m_drainActive = false;
+			/** The last drain task submitted. Guarded by m_queueMutex */
+			TaskHandle m_drainTask;
 		};
 	}
 }
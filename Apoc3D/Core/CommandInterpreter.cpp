@@ -449,6 +449,8 @@ namespace Apoc3D
 
 				if (fx->SupportsInstancing())
 					msg.append(L" [Instancing] ");
+				else if (fx->SupportsStreamInstancing())
+					msg.append(L" [Stream Instancing] ");
 
 				LogManager::getSingleton().Write(LOG_CommandResponse, msg, LOGLVL_Infomation);
 
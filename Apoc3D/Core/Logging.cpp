@@ -15,19 +15,29 @@
  */
 
 #include "Logging.h"
+#include "TaskScheduler.h"
 
 #if APOC3D_PLATFORM == APOC3D_PLATFORM_WINDOWS
 #include <Windows.h>
 #endif
 
 #include "apoc3d/Collections/List.h"
+#include "apoc3d/IOLib/Streams.h"
+#include "apoc3d/Math/Math.h"
 #include "apoc3d/Utility/StringUtils.h"
 #include "apoc3d/Collections/CollectionsCommon.h"
+#include "apoc3d/Vfs/File.h"
 
+#include <chrono>
+#include <cstdio>
 #include <ctime>
 #include <iostream>
+#include <memory>
+#include <thread>
 
+using namespace Apoc3D::IO;
 using namespace Apoc3D::Utility;
+using namespace Apoc3D::VFS;
 
 namespace Apoc3D
 {
@@ -44,9 +54,213 @@ namespace Apoc3D
 
 		SINGLETON_IMPL(LogManager);
 
-		static uint64 LogItemSerialCounter = 1;
+		static std::atomic<uint64> LogItemSerialCounter(1);
+
+		/************************************************************************/
+		/*   Asynchronous mode                                                  */
+		/************************************************************************/
+
+		/**
+		 *  The queue of messages written by one thread. Only that thread adds to it and only the
+		 *  drain thread takes from it, so the two ends are synchronized by their indices alone.
+		 */
+		struct ThreadLogQueue
+		{
+			/** Messages up to this length are copied into the record. Longer ones are allocated. */
+			static const int32 InlineLength = 96;
+
+			struct Record
+			{
+				uint64 Sequence;
+				time_t Time;
+				LogType Type;
+				LogMessageLevel Level;
+				int32 Length;
+				String* LongText;
+				wchar_t Text[InlineLength];
+			};
+
+			ThreadLogQueue(int32 length, int32 session)
+				: Session(session)
+			{
+				uint32 capacity = 2;
+				while (capacity < (uint32)length)
+					capacity <<= 1;
+
+				Records = new Record[capacity];
+				Mask = capacity - 1;
+			}
+			~ThreadLogQueue()
+			{
+				for (uint32 i = Head; i != Tail; i++)
+					delete Records[i & Mask].LongText;
+				delete[] Records;
+			}
+
+			/** The next record to read. Written by the drain task. */
+			std::atomic<uint32> Head{ 0 };
+			char m_pad0[60];
+			/** The next record to write. Written by the owning thread. */
+			std::atomic<uint32> Tail{ 0 };
+			char m_pad1[60];
+
+			// only the owning thread writes the counters
+			std::atomic<uint64> Queued{ 0 };
+			std::atomic<uint64> Dropped{ 0 };
+			std::atomic<int64> TotalWriteTime{ 0 };
+			std::atomic<int64> MaxWriteTime{ 0 };
+
+			/** Set when the owning thread exits. The drain task frees the queue after emptying it. */
+			std::atomic<bool> Abandoned{ false };
+
+			/** Held by the owning thread while it adds a message, so StopAsync can wait for the writes in progress */
+			std::mutex WriteLock;
+
+			Record* Records;
+			uint32 Mask;
+			int32 Session;
+		};
+
+		/** Holds a thread's queue, and tells the drain task when the thread is gone. */
+		struct ThreadLogQueueRef
+		{
+			std::shared_ptr<ThreadLogQueue> Queue;
+
+			~ThreadLogQueueRef()
+			{
+				if (Queue)
+					Queue->Abandoned.store(true, std::memory_order_release);
+			}
+		};
+
+		static thread_local ThreadLogQueueRef CurrentThreadLogQueue;
+
+		/** Set while the thread is in DrainQueues. Logging from an eventNewLogWritten handler must not drain again */
+		static thread_local bool IsDrainingThread = false;
+
+		/** Writes lines to a file, which is renamed to make room for a new one once it grows too big */
+		class RotatingLogFile
+		{
+		public:
+			RotatingLogFile(const String& path, int64 maxSize, int32 maxCount)
+				: m_path(path), m_maxSize(maxSize), m_maxCount(maxCount)
+			{
+				Open();
+			}
+			~RotatingLogFile()
+			{
+				delete m_file;
+			}
+
+			void Write(const String& line)
+			{
+				std::string utf8 = StringUtils::UTF16toUTF8(line);
+				utf8.append("\r\n");
+
+				if (m_size > 0 && m_size + (int64)utf8.size() > m_maxSize)
+				{
+					Rotate();
+				}
+
+				m_file->Write(utf8.c_str(), utf8.size());
+				m_size += utf8.size();
+			}
+
+			void Flush() { m_file->Flush(); }
+
+		private:
+			void Open()
+			{
+				m_size = File::GetFileSize(m_path);
+				if (m_size > 0)
+				{
+					m_file = new FileOutStream(m_path, true);
+					m_file->Seek(0, SeekMode::End);
+				}
+				else
+				{
+					m_file = new FileOutStream(m_path);
+				}
+			}
+
+			void Rotate()
+			{
+				delete m_file;
+				m_file = nullptr;
+
+				// shift the old files up by one, the oldest one falls off the end
+				for (int32 i = m_maxCount; i > 0; i--)
+				{
+					std::string from = StringUtils::toPlatformNarrowString(i > 1 ? GetRotatedName(i - 1) : m_path);
+					std::string to = StringUtils::toPlatformNarrowString(GetRotatedName(i));
+
+					remove(to.c_str());
+					rename(from.c_str(), to.c_str());
+				}
+				if (m_maxCount <= 0)
+					remove(StringUtils::toPlatformNarrowString(m_path).c_str());
+
+				Open();
+			}
+
+			String GetRotatedName(int32 index) const { return m_path + L"." + StringUtils::IntToString(index); }
+
+			String m_path;
+			int64 m_maxSize;
+			int32 m_maxCount;
+
+			FileOutStream* m_file = nullptr;
+			int64 m_size = 0;
+		};
+
+		struct LogManager::AsyncState
+		{
+			/** Identifies the StartAsync call the queues were made for, so queues made before a restart are replaced. */
+			int32 Session = 0;
+			AsyncLogOptions Options;
+
+			std::mutex QueuesLock;
+			List<std::shared_ptr<ThreadLogQueue>> Queues;
+
+			/** The counters of the queues already freed */
+			AsyncLogStats RetiredStats;
+
+			std::atomic<uint64> NextSequence{ 0 };
+			std::atomic<uint64> ProcessedCount{ 0 };
+
+			std::atomic<bool> Stopping{ false };
+
+			/** Set while a drain task is queued or running. StopAsync keeps it set so no more are started. */
+			std::atomic<bool> DrainScheduled{ false };
+			/** Guards DrainTasks, and submitting a drain task */
+			std::mutex DrainTasksLock;
+			/** The drain tasks not known to be done yet */
+			List<TaskHandle> DrainTasks;
+			/** Held while taking messages off the queues, so they are processed in order */
+			std::mutex DrainLock;
+
+			RotatingLogFile* LogFile = nullptr;
+		};
+
+		static void AddQueueStats(AsyncLogStats& stats, const ThreadLogQueue& queue)
+		{
+			stats.Queued += queue.Queued;
+			stats.Dropped += queue.Dropped;
+			stats.TotalWriteTime += queue.TotalWriteTime;
+			stats.MaxWriteTime = Math::Max(stats.MaxWriteTime, queue.MaxWriteTime.load());
+		}
+
+		struct QueuedLogMessage
+		{
+			uint64 Sequence;
+			time_t Time;
+			LogType Type;
+			LogMessageLevel Level;
+			String Content;
+		};
 
 		LogManager::LogManager()
+			: m_asyncActive(false)
 		{
 			for (size_t i = 0; i < LOG_Count; i++)
 			{
@@ -55,6 +269,10 @@ namespace Apoc3D
 		}
 		LogManager::~LogManager()
 		{
+			StopAsync();
+			delete m_async;
+			m_async = nullptr;
+
 			for (size_t i = 0; i < LOG_Count; i++)
 			{
 				delete m_logs[i];
@@ -63,9 +281,20 @@ namespace Apoc3D
 		}
 
 		void LogManager::Write(LogType type, const String& message, LogMessageLevel level)
+		{
+			if (m_asyncActive.load(std::memory_order_acquire))
+			{
+				WriteAsync(type, message, level);
+				return;
+			}
+
+			Process(type, message, level, time(0));
+		}
+
+		void LogManager::Process(LogType type, const String& message, LogMessageLevel level, time_t time)
 		{
 			bool ret = m_logs[static_cast<int32>(type)]->Write(message, level, 
-				type != LOG_CommandResponse && type != LOG_Command && type != LOG_App);
+				type != LOG_CommandResponse && type != LOG_Command && type != LOG_App, time);
 
 			if (ret)
 			{
@@ -75,20 +304,27 @@ namespace Apoc3D
 
 				eventNewLogWritten.Invoke(lastest);
 				
-				if (WriteLogToStd)
+				if (WriteLogToStd || (m_async && m_async->LogFile))
 				{
 					String msg = lastest.ToString();
-					if (!StringUtils::EndsWith(msg, L"\n"))
-						msg.append(L"\n");
+
+					if (m_async && m_async->LogFile)
+						m_async->LogFile->Write(msg);
+
+					if (WriteLogToStd)
+					{
+						if (!StringUtils::EndsWith(msg, L"\n"))
+							msg.append(L"\n");
 
 #if APOC3D_PLATFORM == APOC3D_PLATFORM_WINDOWS
 #if _DEBUG
-					OutputDebugString(msg.c_str());
+						OutputDebugString(msg.c_str());
 #endif
-					
+
 #endif
 
-					std::wcout << ( msg );
+						std::wcout << (msg);
+					}
 				}
 
 				m_lock.unlock();
@@ -96,6 +332,367 @@ namespace Apoc3D
 
 		}
 
+		void LogManager::WriteAsync(LogType type, const String& message, LogMessageLevel level)
+		{
+			typedef std::chrono::steady_clock Clock;
+			const Clock::time_point start = Clock::now();
+
+			AsyncState& async = *m_async;
+
+			ThreadLogQueue* queue = CurrentThreadLogQueue.Queue.get();
+			if (queue == nullptr || queue->Session != async.Session)
+			{
+				async.QueuesLock.lock();
+
+				// StopAsync only drains the queues it can see. A queue added after it would never be read
+				if (!m_asyncActive.load(std::memory_order_acquire))
+				{
+					async.QueuesLock.unlock();
+					Process(type, message, level, time(0));
+					return;
+				}
+
+				if (CurrentThreadLogQueue.Queue)
+					CurrentThreadLogQueue.Queue->Abandoned.store(true, std::memory_order_release);
+
+				CurrentThreadLogQueue.Queue = std::make_shared<ThreadLogQueue>(async.Options.ThreadQueueLength, async.Session);
+				async.Queues.Add(CurrentThreadLogQueue.Queue);
+
+				async.QueuesLock.unlock();
+
+				queue = CurrentThreadLogQueue.Queue.get();
+			}
+
+			std::unique_lock<std::mutex> writeLock(queue->WriteLock);
+			if (!m_asyncActive.load(std::memory_order_acquire))
+			{
+				// StopAsync has drained this queue already, or is waiting for the lock to do so
+				writeLock.unlock();
+				Process(type, message, level, time(0));
+				return;
+			}
+
+			const uint32 tail = queue->Tail.load(std::memory_order_relaxed);
+			uint32 head = queue->Head.load(std::memory_order_acquire);
+
+			bool dropped = false;
+			if (tail - head > queue->Mask)
+			{
+				if (async.Options.DropWhenFull || IsDrainingThread)
+				{
+					// when called from a handler of the messages being drained, DrainLock is already held here
+					ScheduleDrain();
+					dropped = true;
+				}
+				else
+				{
+					// the drain task may be queued behind this thread's own work, so the messages are taken
+					// off here instead. Not holding the write lock, as processing them may write more
+					writeLock.unlock();
+					DrainQueues();
+					writeLock.lock();
+
+					if (!m_asyncActive.load(std::memory_order_acquire))
+					{
+						writeLock.unlock();
+						Process(type, message, level, time(0));
+						return;
+					}
+				}
+			}
+
+			if (!dropped)
+			{
+				ThreadLogQueue::Record& rec = queue->Records[tail & queue->Mask];
+				rec.Sequence = async.NextSequence.fetch_add(1, std::memory_order_relaxed);
+				rec.Time = time(0);
+				rec.Type = type;
+				rec.Level = level;
+				rec.Length = (int32)message.size();
+
+				if (rec.Length <= ThreadLogQueue::InlineLength)
+				{
+					rec.LongText = nullptr;
+					memcpy(rec.Text, message.c_str(), rec.Length * sizeof(wchar_t));
+				}
+				else
+				{
+					rec.LongText = new String(message);
+				}
+
+				// sequentially consistent, pairing with DrainTask clearing DrainScheduled then looking at the queues
+				queue->Tail.store(tail + 1);
+				queue->Queued.store(queue->Queued.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+				ScheduleDrain();
+			}
+			else
+			{
+				queue->Dropped.store(queue->Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			const int64 elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+			queue->TotalWriteTime.store(queue->TotalWriteTime.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+			if (elapsed > queue->MaxWriteTime.load(std::memory_order_relaxed))
+				queue->MaxWriteTime.store(elapsed, std::memory_order_relaxed);
+		}
+
+		void LogManager::ScheduleDrain()
+		{
+			AsyncState& async = *m_async;
+
+			if (async.DrainScheduled.load())
+				return;
+
+			// submitted under the lock, so StopAsync sees every task started
+			std::lock_guard<std::mutex> lock(async.DrainTasksLock);
+			if (async.DrainScheduled.exchange(true))
+				return;
+
+			for (int32 i = async.DrainTasks.getCount() - 1; i >= 0; i--)
+			{
+				if (async.DrainTasks[i].isDone())
+					async.DrainTasks.RemoveAtSwapping(i);
+			}
+			async.DrainTasks.Add(TaskScheduler::getSingleton().Submit([this]() { DrainTask(); }, TaskAffinity::Background));
+		}
+
+		void LogManager::DrainTask()
+		{
+			AsyncState& async = *m_async;
+
+			do
+			{
+				DrainQueues();
+				async.DrainScheduled.store(false);
+
+				// a message added after the queues were read, but before the flag was cleared, started no drain of its own
+			} while (HasQueuedMessages() && !async.DrainScheduled.exchange(true));
+		}
+
+		void LogManager::WaitForDrainTasks()
+		{
+			AsyncState& async = *m_async;
+
+			List<TaskHandle> tasks;
+			{
+				std::lock_guard<std::mutex> lock(async.DrainTasksLock);
+				tasks = async.DrainTasks;
+			}
+
+			// the scheduler runs what is left when it is finalized
+			if (TaskScheduler::isInitialized())
+				TaskScheduler::getSingleton().WaitAll(tasks.getElements(), tasks.getCount());
+		}
+
+		bool LogManager::HasQueuedMessages()
+		{
+			AsyncState& async = *m_async;
+
+			std::lock_guard<std::mutex> lock(async.QueuesLock);
+			for (const std::shared_ptr<ThreadLogQueue>& queue : async.Queues)
+			{
+				if (queue->Head.load(std::memory_order_relaxed) != queue->Tail.load())
+					return true;
+			}
+			return false;
+		}
+
+		int32 LogManager::DrainQueues()
+		{
+			AsyncState& async = *m_async;
+
+			std::lock_guard<std::mutex> drainLock(async.DrainLock);
+
+			struct DrainingScope
+			{
+				DrainingScope() { IsDrainingThread = true; }
+				~DrainingScope() { IsDrainingThread = false; }
+			} drainingScope;
+
+			List<QueuedLogMessage> messages;
+
+			async.QueuesLock.lock();
+			for (int32 i = 0; i < async.Queues.getCount(); i++)
+			{
+				ThreadLogQueue* queue = async.Queues[i].get();
+
+				// checked first, so every message of a thread that is gone is seen below
+				const bool abandoned = queue->Abandoned.load(std::memory_order_acquire);
+
+				uint32 head = queue->Head.load(std::memory_order_relaxed);
+				const uint32 tail = queue->Tail.load(std::memory_order_acquire);
+
+				for (; head != tail; head++)
+				{
+					ThreadLogQueue::Record& rec = queue->Records[head & queue->Mask];
+
+					QueuedLogMessage msg;
+					msg.Sequence = rec.Sequence;
+					msg.Time = rec.Time;
+					msg.Type = rec.Type;
+					msg.Level = rec.Level;
+
+					if (rec.LongText)
+					{
+						msg.Content = std::move(*rec.LongText);
+						delete rec.LongText;
+						rec.LongText = nullptr;
+					}
+					else
+					{
+						msg.Content.assign(rec.Text, rec.Length);
+					}
+
+					messages.Add(std::move(msg));
+				}
+
+				queue->Head.store(head, std::memory_order_release);
+
+				if (abandoned)
+				{
+					AddQueueStats(async.RetiredStats, *queue);
+					async.Queues.RemoveAt(i--);
+				}
+			}
+			async.QueuesLock.unlock();
+
+			if (messages.getCount() == 0)
+				return 0;
+
+			// each queue is in order, the sequence numbers put the queues together again
+			List<const QueuedLogMessage*> order(messages.getCount());
+			for (const QueuedLogMessage& msg : messages)
+				order.Add(&msg);
+
+			auto comparer = [](const QueuedLogMessage* a, const QueuedLogMessage* b)->int
+			{
+				return Apoc3D::Collections::OrderComparer(a->Sequence, b->Sequence);
+			};
+			order.Sort(comparer);
+
+			for (const QueuedLogMessage* msg : order)
+			{
+				Process(msg->Type, msg->Content, msg->Level, msg->Time);
+			}
+
+			m_lock.lock();
+			if (async.LogFile)
+				async.LogFile->Flush();
+			m_lock.unlock();
+
+			async.ProcessedCount.fetch_add(messages.getCount());
+
+			return messages.getCount();
+		}
+
+		void LogManager::StartAsync(const AsyncLogOptions& options)
+		{
+			StopAsync();
+
+			if (!TaskScheduler::isInitialized() || TaskScheduler::getSingleton().getWorkerCount() == 0)
+				return;
+
+			if (m_async == nullptr)
+				m_async = new AsyncState();
+
+			AsyncState& async = *m_async;
+
+			async.QueuesLock.lock();
+			async.Session++;
+			async.Options = options;
+			async.RetiredStats = AsyncLogStats();
+			async.QueuesLock.unlock();
+
+			if (!options.FilePath.empty())
+				async.LogFile = new RotatingLogFile(options.FilePath, options.MaxFileSize, options.MaxFileCount);
+
+			async.Stopping = false;
+			async.DrainScheduled = false;
+
+			m_asyncActive.store(true, std::memory_order_release);
+		}
+
+		void LogManager::StopAsync()
+		{
+			if (!m_asyncActive)
+				return;
+
+			m_asyncActive.store(false, std::memory_order_release);
+
+			AsyncState& async = *m_async;
+			async.Stopping = true;
+
+			// once the flag is taken, no more drain tasks are started
+			while (async.DrainScheduled.exchange(true))
+				WaitForDrainTasks();
+			WaitForDrainTasks();
+
+			// writes that started before asynchronous mode was turned off may still be adding to the queues.
+			// Once each queue's lock has been taken, later writes see the flag and are processed directly
+			async.QueuesLock.lock();
+			for (const std::shared_ptr<ThreadLogQueue>& queue : async.Queues)
+			{
+				queue->WriteLock.lock();
+				queue->WriteLock.unlock();
+			}
+			async.QueuesLock.unlock();
+
+			DrainQueues();
+
+			// the queues are empty now. Threads writing again after a restart make new ones
+			async.QueuesLock.lock();
+			for (const std::shared_ptr<ThreadLogQueue>& queue : async.Queues)
+			{
+				AddQueueStats(async.RetiredStats, *queue);
+			}
+			async.Queues.Clear();
+			async.QueuesLock.unlock();
+
+			// Process looks at the file under the same lock
+			m_lock.lock();
+			delete async.LogFile;
+			async.LogFile = nullptr;
+			m_lock.unlock();
+		}
+
+		void LogManager::Flush()
+		{
+			// a handler of a message being drained would wait on itself
+			if (!m_asyncActive || IsDrainingThread)
+				return;
+
+			AsyncState& async = *m_async;
+			const uint64 target = async.NextSequence.load();
+
+			// drained here rather than waiting on the drain task, which only idle workers run
+			while (async.ProcessedCount.load() < target && !async.Stopping)
+			{
+				DrainQueues();
+				if (async.ProcessedCount.load() < target)
+					std::this_thread::yield();
+			}
+		}
+
+		AsyncLogStats LogManager::getAsyncStats()
+		{
+			AsyncLogStats result;
+			if (m_async == nullptr)
+				return result;
+
+			AsyncState& async = *m_async;
+
+			async.QueuesLock.lock();
+			result = async.RetiredStats;
+			for (const std::shared_ptr<ThreadLogQueue>& queue : async.Queues)
+			{
+				AddQueueStats(result, *queue);
+			}
+			async.QueuesLock.unlock();
+
+			return result;
+		}
+
 		void LogManager::DumpLogs(String& result, bool lastFirst)
 		{
 			int32 totalEntryCount = 0;
@@ -147,6 +744,11 @@ namespace Apoc3D
 		}
 
 		bool LogSet::Write(const String& message, LogMessageLevel level, bool checkDuplicate)
+		{
+			return Write(message, level, checkDuplicate, time(0));
+		}
+
+		bool LogSet::Write(const String& message, LogMessageLevel level, bool checkDuplicate, time_t t)
 		{
 			bool result = false;
 			m_lock.lock();
@@ -162,8 +764,6 @@ namespace Apoc3D
 
 			if (!discard)
 			{
-				time_t t = time(0);
-
 				while (m_entries.getCount() > MaxEntries)
 				{
 					m_entries.PopFront();
@@ -20,6 +20,8 @@
 #include "apoc3d/Meta/EventDelegate.h"
 #include "apoc3d/Collections/LinkedList.h"
 
+#include <atomic>
+
 using namespace Apoc3D::Collections;
 
 namespace Apoc3D
@@ -71,6 +73,40 @@ namespace Apoc3D
 
 		typedef EventDelegate<LogEntry> NewLogWrittenHandler;
 
+		/** Settings of LogManager's asynchronous mode. See LogManager::StartAsync. */
+		struct AsyncLogOptions
+		{
+			/** The number of messages each writing thread can have waiting. Rounded up to a power of 2. */
+			int32 ThreadQueueLength = 1024;
+
+			/**
+			 *  Drops a message when the writing thread's queue is full, so Write never waits for the queues to be drained.
+			 *  Otherwise the writer processes the queued messages itself to make room, except in an
+			 *  eventNewLogWritten handler run by the drain, where the message is still dropped.
+			 */
+			bool DropWhenFull = true;
+
+			/** When not empty, messages are also appended to this file in UTF-8. */
+			String FilePath;
+			/** Once the file grows beyond this many bytes, it is renamed to FilePath.1 and a new one is started. */
+			int64 MaxFileSize = 4 * 1024 * 1024;
+			/** The number of renamed files kept as FilePath.1 ... FilePath.N, the oldest having the biggest number */
+			int32 MaxFileCount = 3;
+		};
+
+		/** Counters of LogManager's asynchronous mode since StartAsync, summed over all writing threads */
+		struct AsyncLogStats
+		{
+			/** Messages put on the queues */
+			uint64 Queued = 0;
+			/** Messages dropped because a queue was full */
+			uint64 Dropped = 0;
+			/** The total time spent in Write by writing threads, in nanoseconds */
+			int64 TotalWriteTime = 0;
+			/** The longest time a single Write took, in nanoseconds */
+			int64 MaxWriteTime = 0;
+		};
+
 		/** 
 		 *  A singleton providing possibilities to log messages anywhere in the code.
 		 */
@@ -86,13 +122,48 @@ namespace Apoc3D
 			void Write(LogType type, const String& message, LogMessageLevel level = LOGLVL_Infomation);
 
 			void DumpLogs(String& result, bool lastFirst);
-			
+
+			/**
+			 *  Switches to asynchronous mode. Write then only copies the message to a lock-free queue
+			 *  owned by the calling thread. A Background TaskScheduler task takes the messages off all queues in the
+			 *  order they were written, and adds them to the LogSets, fires eventNewLogWritten, and writes
+			 *  them to the standard output and the log file.
+			 *  Stays synchronous when the TaskScheduler is not initialized or has no workers to run the task.
+			 *  Messages written while StartAsync or StopAsync is running may go either way.
+			 */
+			void StartAsync(const AsyncLogOptions& options = AsyncLogOptions());
+			/**
+			 *  Writes out all queued messages, including ones other threads are adding while it runs,
+			 *  then goes back to processing them in Write.
+			 */
+			void StopAsync();
+			/** In asynchronous mode, processes the queued messages on the calling thread until everything written before the call is done. */
+			void Flush();
+
+			bool isAsync() const { return m_asyncActive; }
+			AsyncLogStats getAsyncStats();
+
 			bool WriteLogToStd;
 			NewLogWrittenHandler eventNewLogWritten;
 		private:
+			struct AsyncState;
+
+			void Process(LogType type, const String& message, LogMessageLevel level, time_t time);
+			void WriteAsync(LogType type, const String& message, LogMessageLevel level);
+
+			/** Submits a drain task, unless one is queued or running already. */
+			void ScheduleDrain();
+			void DrainTask();
+			void WaitForDrainTasks();
+			int32 DrainQueues();
+			bool HasQueuedMessages();
+
 			LogSet* m_logs[LOG_Count];
 
 			std::mutex m_lock;
+
+			std::atomic<bool> m_asyncActive;
+			AsyncState* m_async = nullptr;
 		};
 
 		inline void ApocLog(LogType type, const String& message, LogMessageLevel level = LOGLVL_Infomation);
@@ -124,6 +195,8 @@ namespace Apoc3D
 			int getCount();
 
 			bool Write(const String& message, LogMessageLevel level = LOGLVL_Infomation, bool checkDuplicate = true);
+			/** Writes a message that was logged at a given time */
+			bool Write(const String& message, LogMessageLevel level, bool checkDuplicate, time_t time);
 
 		private:			
 			LogType m_type;
@@ -17,8 +17,7 @@
 #include "Resource.h"
 #include "ResourceManager.h"
 #include "Streaming/GenerationTable.h"
-
-#include <ctime>
+#include "Streaming/PostSyncQueue.h"
 
 using namespace Apoc3D::Math;
 using namespace Apoc3D::Core::Streaming;
@@ -36,8 +35,6 @@ namespace Apoc3D
 			{
 				if (m_manager->usesAsync())
 				{
-					m_generation = new GenerationCalculator(manager->m_generationTable);
-
 					m_lock = new std::mutex();
 				}
 			}
@@ -49,7 +46,6 @@ namespace Apoc3D
 			{
 				m_manager->NotifyReleaseResource(this);
 			}
-			DELETE_AND_NULL(m_generation);
 
 			if (isManaged() && m_manager->usesAsync())
 				m_manager->RemoveTask(this);
@@ -63,7 +59,7 @@ namespace Apoc3D
 			{
 				if (m_manager->usesAsync())
 				{
-					m_generation->Use(this);
+					m_manager->m_generationTable->Touch(this);
 
 					if (getState() == ResourceState::Unloaded)
 						Load();
@@ -78,8 +74,6 @@ namespace Apoc3D
 		{
 			if (isManaged())
 			{
-				//m_generation->Use(this);
-
 				LoadSync();
 			}
 		}
@@ -208,8 +202,8 @@ namespace Apoc3D
 
 		int Resource::GetGeneration() const
 		{
-			if (m_generation)
-				return m_generation->Generation;
+			if (isManaged() && m_manager->usesAsync())
+				return m_manager->m_generationTable->GetGeneration(this);
 			return -1;
 		}
 
@@ -254,6 +248,17 @@ namespace Apoc3D
 			}
 		}
 
+		void Resource::setStreamingPriority(float priority)
+		{
+			if (m_streamingPriority != priority)
+			{
+				m_streamingPriority = priority;
+
+				if (isManaged() && m_manager->usesAsync())
+					m_manager->Reprioritize(this, priority);
+			}
+		}
+
 		void Resource::Lock_Unloadable() { if (m_lock){ m_lock->lock(); m_unloadableLock = true; m_lock->unlock(); } }
 		void Resource::Unlock_Unloadable() { if (m_lock) { m_lock->lock(); m_unloadableLock = false; m_lock->unlock(); } }
 
@@ -278,7 +283,11 @@ namespace Apoc3D
 			{
 				ResourceState state = res->getState();
 				if (state != ResourceState::Loaded)
+				{
+					if (res->m_manager)
+						res->m_manager->NotifyUnloadCanceled(res);
 					return;
+				}
 				res->setState(ResourceState::Unloading);
 				res->unload();
 				res->setState(ResourceState::Unloaded);
@@ -288,116 +297,39 @@ namespace Apoc3D
 			}
 			else assert(0);
 		}
-		void Resource::ProcessResourceOperationPostSyc(const ResourceOperation& resOp, int32 percentage)
+		bool Resource::ProcessResourceOperationPostSync(const ResourceOperation& resOp, PostSyncState& state)
 		{
 			Resource* res = resOp.Subject;
 
 			if (resOp.Type == ResourceOperation::RESOP_Load)
 			{
 				assert(res->getState() == ResourceState::Loaded);
-				res->loadPostSync(percentage);
+				return res->processPostSync(true, state);
 			}
 			else if (resOp.Type == ResourceOperation::RESOP_Unload)
 			{
 				assert(res->getState() == ResourceState::Unloaded);
-				res->unloadPostSync(percentage);
+				return res->processPostSync(false, state);
 			}
-			else assert(0);
+			assert(0);
+			return true;
 		}
 
-		/************************************************************************/
-		/*   Resource::GenerationCalculator                                     */
-		/************************************************************************/
-
-		Resource::GenerationCalculator::GenerationCalculator(const GenerationTable* table)
-			: m_table(table), Generation(GenerationTable::MaxGeneration - 1)
-		{
-			
-		}
-		Resource::GenerationCalculator::~GenerationCalculator()
-		{
-			
-		}
-
-		void Resource::GenerationCalculator::Use(Resource* resource)
-		{
-			clock_t t = clock();
-
-			m_queueLock.lock();
-			m_timeQueue.Enqueue((float)t / CLOCKS_PER_SEC);
-			while (m_timeQueue.getCount()>5)
-				m_timeQueue.Dequeue();
-			m_queueLock.unlock();
-		}
-		void Resource::GenerationCalculator::UpdateGeneration(float time)
+		bool Resource::processPostSync(bool isLoading, PostSyncState& state)
 		{
-			float result = -9999999;
-
-			m_queueLock.lock();
-
-			if (m_timeQueue.getCount())
+			// loadPostSync can not resume part way, so it is all done in one step
+			if (isLoading)
 			{
-				result = 0;
-				for (int i = 0; i < m_timeQueue.getCount(); i++)
-				{
-					result += m_timeQueue[i];
-				}
-				result /= (float)m_timeQueue.getCount();
-			}
-			m_queueLock.unlock();
-
-			//clock_t t = clock();
-
-			//result = (float)t/ CLOCKS_PER_SEC - result;
-			result = time - result;
-			if (result > GenerationTable::GenerationLifeTime[0])
-			{
-				if (result > GenerationTable::GenerationLifeTime[1])
-				{
-					if (result > GenerationTable::GenerationLifeTime[2])
-					{
-						Generation = 3;
-					}
-					else
-					{
-						Generation = 2;
-					}
-				}
-				else
-				{
-					Generation = 1;
-				}
+				loadPostSync(100);
+				state.BytesUploaded = getSize();
 			}
 			else
 			{
-				Generation = 0;
+				unloadPostSync(100);
 			}
-		}
-
-		bool Resource::GenerationCalculator::IsGenerationOutOfTime(float time)
-		{
-			volatile bool notEmpty;
-			volatile float topVal = 0;
-			m_queueLock.lock();
-			notEmpty = !!m_timeQueue.getCount();
-			if (notEmpty)
-				topVal = m_timeQueue.Tail();
-			m_queueLock.unlock();
 
-			if (notEmpty)
-			{
-				float interval = time - topVal;
-
-				if (Generation < GenerationTable::MaxGeneration && 
-					interval > GenerationTable::GenerationLifeTime[Generation]) // become older
-				{
-					return true;
-				}
-				// become younger
-				return Generation >0 && interval <= GenerationTable::GenerationLifeTime[Generation-1];
-
-			}
-			return Generation == GenerationTable::MaxGeneration -1;
+			state.Progress++;
+			return true;
 		}
 	}
 }
\ No newline at end of file
@@ -24,6 +24,8 @@
 
 #include "apoc3d/Collections/Queue.h"
 
+#include <atomic>
+
 using namespace Apoc3D::Collections;
 using namespace Apoc3D::Core::Streaming;
 
@@ -70,13 +72,13 @@ namespace Apoc3D
 		 */
 		class APAPI Resource
 		{
-			friend class GenerationTable;
+			friend class Streaming::GenerationTable;
 		public: 
 			
 			virtual ~Resource();
 			
 			/** 
-			 *  Get the generation number.
+			 *  Get the generation number, which grows as the resource stays unused.
 			 *  Only returns valid if the resource is managed and async.
 			 */
 			int GetGeneration() const;
@@ -134,6 +136,14 @@ namespace Apoc3D
 			/** Gets the resource's current state. */
 			ResourceState getState() const;
 
+			/**
+			 *  [ASync resource only]
+			 *  Sets the urgency of this resource's pending load/unload operations. Operations with higher
+			 *  priority are processed earlier. For instance, the negative distance to the camera can be used.
+			 */
+			void setStreamingPriority(float priority);
+			float getStreamingPriority() const { return m_streamingPriority; }
+
 			bool isIndependent() const { return m_isIndependent; }
 			bool isPostSyncNeeded() const { return m_requiresPostSync; }
 
@@ -160,7 +170,11 @@ namespace Apoc3D
 			}
 
 			static void ProcessResourceOperation(const ResourceOperation& resOp);
-			static void ProcessResourceOperationPostSyc(const ResourceOperation& resOp, int32 percentage);
+			/**
+			 *  Performs one step of post sync processing for a ResourceOperation.
+			 *  @return True if the post sync processing is finished.
+			 */
+			static bool ProcessResourceOperationPostSync(const ResourceOperation& resOp, PostSyncState& state);
 		protected:
 			
 			/** Create a unmanaged resource */
@@ -177,47 +191,43 @@ namespace Apoc3D
 
 			virtual void loadPostSync(int32 percentage) { load(); }
 			virtual void unloadPostSync(int32 percentage) { unload(); }
+
+			/**
+			 *  Implement to do post sync processing in steps, for instance uploading a large texture a few
+			 *  levels per frame. Each call should advance state.Progress and report state.BytesUploaded.
+			 *  The default implementation calls loadPostSync/unloadPostSync once with 100 percentage, and
+			 *  reports getSize() when loading.
+			 *
+			 *  @return True when finished.
+			 */
+			virtual bool processPostSync(bool isLoading, PostSyncState& state);
 			
 		private:
 			Resource& operator=(const Resource &rhs) = delete;
 
-			ResourceOperation GetLoadOperation() { return ResourceOperation(this, ResourceOperation::RESOP_Load); }
-			ResourceOperation GetUnloadOperation() { return ResourceOperation(this, ResourceOperation::RESOP_Unload); }
+			ResourceOperation GetLoadOperation() { return ResourceOperation(this, ResourceOperation::RESOP_Load, m_streamingPriority); }
+			ResourceOperation GetUnloadOperation() { return ResourceOperation(this, ResourceOperation::RESOP_Unload, m_streamingPriority); }
 
 			void LoadSync();
 
 			void setState(ResourceState st);
 
-			/** A utility used for calculating generation number for resources based on the visit history. */
-			class GenerationCalculator
-			{
-			public:
-				GenerationCalculator(const GenerationTable* table);
-				~GenerationCalculator();
-
-				void Use(Resource* resource);
-				void UpdateGeneration(float time);
-
-				bool IsGenerationOutOfTime(float time);
-			public:
-				volatile int Generation;
-			private:
-				const GenerationTable* m_table;
-				Queue<float> m_timeQueue;
-
-				std::mutex m_queueLock;
-			};
-
-
-			GenerationCalculator* m_generation = nullptr;
 			ResourceManager* m_manager = nullptr;
 
 			const String m_hashString;
 
+			/** The GenerationTable epoch when the resource is last used */
+			std::atomic<uint32> m_lastUseEpoch = { 0 };
+			/** The index in the GenerationTable's clock ring */
+			int32 m_clockSlot = -1;
+			int64 m_clockEvictSize = 0;
+			bool m_clockEvicting = false;
+
 			int m_refCount = 0;
 			
 
 			volatile ResourceState m_state = ResourceState::Unloaded;
+			volatile float m_streamingPriority = 0;
 
 			std::mutex* m_lock = nullptr;
 
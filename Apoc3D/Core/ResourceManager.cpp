@@ -20,6 +20,9 @@
 #include "Logging.h"
 #include "Streaming/AsyncProcessor.h"
 #include "Streaming/GenerationTable.h"
+#include "Streaming/PostSyncQueue.h"
+
+#include <chrono>
 
 namespace Apoc3D
 {
@@ -29,13 +32,74 @@ namespace Apoc3D
 	{
 		ResourceManager::ManagerList ResourceManager::s_managers;
 
+		/** Once a queue gets no progress for this many frames, one step is done regardless of the budget. */
+		static const int32 MaxPostSyncStarvedFrames = 4;
+
+		static PostSyncStatistics s_allPostSyncStats;
+		static int32 s_allPostSyncStarvedFrames = 0;
+
+		static int64 RunPostSync(PostSyncQueue* const* queues, int32 count, int64 budget, int64 byteBudget, int32& starvedFrames)
+		{
+			using namespace std::chrono;
+
+			for (int32 i = 0; i < count; i++)
+				queues[i]->BeginFrame();
+
+			high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+			int64 timeUsed = 0;
+			int64 bytesUploaded = 0;
+			int32 steps = 0;
+			for (;;)
+			{
+				// the most urgent across all queues goes first
+				PostSyncQueue* best = nullptr;
+				float bestPriority = 0;
+				for (int32 i = 0; i < count; i++)
+				{
+					float p;
+					if (queues[i]->PeekPriority(p) && (best == nullptr || p > bestPriority))
+					{
+						best = queues[i];
+						bestPriority = p;
+					}
+				}
+
+				if (best == nullptr)
+					break;
+
+				bool forced = steps == 0 && starvedFrames >= MaxPostSyncStarvedFrames;
+				if (!forced && timeUsed + best->getEstimatedStepTime() > budget)
+					break;
+				if (!forced && byteBudget > 0 && bytesUploaded >= byteBudget)
+					break;
+
+				int64 bytesBefore = best->getFrameStatistics().BytesUploaded;
+				best->ProcessStep();
+				bytesUploaded += best->getFrameStatistics().BytesUploaded - bytesBefore;
+				steps++;
+
+				timeUsed = duration_cast<microseconds>(high_resolution_clock::now() - t1).count();
+			}
+
+			bool hasDeferred = false;
+			for (int32 i = 0; i < count; i++)
+			{
+				queues[i]->EndFrame();
+				hasDeferred |= queues[i]->getFrameStatistics().ItemsDeferred > 0;
+			}
+
+			starvedFrames = (steps == 0 && hasDeferred) ? starvedFrames + 1 : 0;
+			return timeUsed;
+		}
+
 		ResourceManager::ResourceManager(const String& name, int64 cacheSize, bool useAsync)
 			: m_name(name), m_totalCacheSize(cacheSize), m_curUsedCache(0), m_isShutDown(false)
 		{
 			if (useAsync)
 			{
 				m_generationTable = new GenerationTable(this);
-				m_asyncProc = new AsyncProcessor(m_generationTable, m_name + L" Async ResourceLoader", true);
+				m_asyncProc = new AsyncProcessor(m_generationTable, true);
 			}
 			else
 			{
@@ -105,7 +169,19 @@ namespace Apoc3D
 		void ResourceManager::ProcessPostSync(float& timeLeft)
 		{
 			CheckAsync();
-			m_asyncProc->ProcessPostSync(timeLeft);
+
+			PostSyncQueue* queue = m_asyncProc->getPostSyncQueue();
+			int64 timeUsed = RunPostSync(&queue, 1, (int64)(timeLeft * 1000000), 0, m_postSyncStarvedFrames);
+
+			timeLeft -= timeUsed / 1000000.0f;
+			if (timeLeft < 0)
+				timeLeft = 0;
+		}
+
+		const PostSyncStatistics& ResourceManager::getPostSyncStatistics() const
+		{
+			CheckAsync();
+			return m_asyncProc->getPostSyncQueue()->getFrameStatistics();
 		}
 
 		Resource* ResourceManager::Exists(const String& hashString)
@@ -163,27 +239,63 @@ namespace Apoc3D
 		
 		void ResourceManager::PerformAllPostSync(float timelimit)
 		{
-			const ResourceManager::ManagerList& mgrList = ResourceManager::getManagerInstances();
-			for (int32 i = 0; i < mgrList.getCount(); i++)
+			PerformAllPostSyncWithBudget((int64)(timelimit * 1000000));
+		}
+
+		void ResourceManager::PerformAllPostSyncWithBudget(int64 budgetMicroseconds, int64 budgetBytes)
+		{
+			// only used on the main thread; kept to avoid allocating every frame
+			static List<PostSyncQueue*> queues;
+			queues.Clear();
+
+			for (ResourceManager* mgr : s_managers)
 			{
-				if (mgrList[i]->usesAsync())
-					mgrList[i]->ProcessPostSync(timelimit);
+				if (mgr->usesAsync())
+					queues.Add(mgr->m_asyncProc->getPostSyncQueue());
 			}
+
+			RunPostSync(queues.getElements(), queues.getCount(), budgetMicroseconds, budgetBytes, s_allPostSyncStarvedFrames);
+
+			StreamingScheduler::Update();
+
+			s_allPostSyncStats.Reset();
+			for (PostSyncQueue* q : queues)
+				s_allPostSyncStats.Accumulate(q->getFrameStatistics());
 		}
 
+		const PostSyncStatistics& ResourceManager::getAllPostSyncStatistics() { return s_allPostSyncStats; }
+
 		void ResourceManager::NotifyResourceLoaded(Resource* res)
 		{
 			m_curUsedCache += res->getSize();
+
+			if (m_generationTable && m_curUsedCache > m_totalCacheSize)
+				m_generationTable->EvictToBudget();
 		}
 
 		void ResourceManager::NotifyResourceUnloaded(Resource* res)
 		{
 			m_curUsedCache -= res->getSize();
+
+			if (m_generationTable)
+				m_generationTable->NotifyUnloadProcessed(res);
+		}
+
+		void ResourceManager::NotifyUnloadCanceled(Resource* res)
+		{
+			if (m_generationTable)
+				m_generationTable->NotifyUnloadProcessed(res);
 		}
 
 		bool ResourceManager::NeutralizeTask(const ResourceOperation& op) const
 		{
-			return m_asyncProc->NeutralizeTask(op);
+			bool passed = m_asyncProc->NeutralizeTask(op);
+
+			// a canceled unload may have been issued by the eviction
+			if (passed && op.Type == ResourceOperation::RESOP_Load)
+				m_generationTable->NotifyUnloadProcessed(op.Subject);
+
+			return passed;
 		}
 
 		void ResourceManager::AddTask(const ResourceOperation& op) const
@@ -204,6 +316,12 @@ namespace Apoc3D
 			m_asyncProc->RemoveTask(res);
 		}
 
+		void ResourceManager::Reprioritize(Resource* res, float priority) const
+		{
+			CheckAsync();
+			m_asyncProc->Reprioritize(res, priority);
+		}
+
 		void ResourceManager::CheckAsync() const
 		{
 			if (!m_asyncProc)
@@ -21,6 +21,8 @@
 #include "apoc3d/Collections/HashMap.h"
 #include "apoc3d/Collections/List.h"
 
+#include <atomic>
+
 using namespace Apoc3D::Collections;
 using namespace Apoc3D::Core::Streaming;
 
@@ -83,8 +85,19 @@ namespace Apoc3D
 			*/
 			int GetCurrentOperationCount() const;
 
+			/**
+			 *  [Only applicable when working in async mode.]
+			 *  Performs post sync processing of this manager's resources within the given time in seconds. 
+			 *  The time used is subtracted from timeLeft.
+			 */
 			void ProcessPostSync(float& timeLeft);
 
+			/**
+			 *  [Only applicable when working in async mode.]
+			 *  Gets the post sync counters of this manager in the last frame.
+			 */
+			const PostSyncStatistics& getPostSyncStatistics() const;
+
 			/**
 			 * Check if a resource identified by a string is already loaded before.
 			 *
@@ -111,7 +124,7 @@ namespace Apoc3D
 			/**
 			 *  [Only applicable when working in async mode.]
 			 *  Sets the reference limits that resources can use. 
-			 *  Once the space usage is over using, the resource manager will unload the inactive resources.
+			 *  Once the space usage is over using, the resource manager will unload the least recently used resources.
 			 */
 			void setTotalCacheSize(int64 size) { m_totalCacheSize = size; }
 			/**
@@ -123,6 +136,17 @@ namespace Apoc3D
 			int32 getResourceCount() const { return m_hashTable.getCount(); }
 
 			static void PerformAllPostSync(float timelimit);
+
+			/**
+			 *  Performs post sync processing of all async resource managers, the most urgent first, 
+			 *  without exceeding the given budget in microseconds. Unfinished work is deferred to later frames.
+			 *  Also starts the periodic collection of the generation tables when it is due.
+			 *  @param budgetBytes When positive, also stops once this many bytes are uploaded in the frame.
+			 */
+			static void PerformAllPostSyncWithBudget(int64 budgetMicroseconds, int64 budgetBytes = 0);
+
+			/** Gets the post sync counters of all resource managers in the last frame. */
+			static const PostSyncStatistics& getAllPostSyncStatistics();
 			static const ManagerList& getManagerInstances() { return s_managers; }
 
 		protected:
@@ -135,6 +159,8 @@ namespace Apoc3D
 
 			void NotifyResourceLoaded(Resource* res);
 			void NotifyResourceUnloaded(Resource* res);
+			/** Notifies an unload operation is skipped as the resource is not loaded. */
+			void NotifyUnloadCanceled(Resource* res);
 
 		private:
 			
@@ -162,12 +188,18 @@ namespace Apoc3D
 
 			void RemoveTask(Resource* res) const;
 
+			/**
+			 *  [Only applicable when working in async mode.]
+			 *  Updates the priority of queued tasks of a resource.
+			 */
+			void Reprioritize(Resource* res, float priority) const;
+
 			void CheckAsync() const; 
 
 			ResHashTable m_hashTable;
 			
 			int64 m_totalCacheSize;
-			int64 m_curUsedCache;
+			std::atomic<int64> m_curUsedCache;
 
 			GenerationTable* m_generationTable;
 			AsyncProcessor* m_asyncProc;
@@ -176,6 +208,8 @@ namespace Apoc3D
 
 			bool m_isShutDown;
 
+			int32 m_postSyncStarvedFrames = 0;
+
 			
 			static ManagerList s_managers;
 		};
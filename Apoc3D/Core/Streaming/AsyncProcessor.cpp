@@ -15,13 +15,10 @@
  */
 
 #include "AsyncProcessor.h"
-#include "apoc3d/Platform/Thread.h"
 #include "GenerationTable.h"
+#include "PostSyncQueue.h"
 #include "apoc3d/Core/Resource.h"
 
-#include <chrono>
-
-using namespace Apoc3D::Platform;
 
 namespace Apoc3D
 {
@@ -30,92 +27,31 @@ namespace Apoc3D
 		namespace Streaming
 		{
 			
-			AsyncProcessor::AsyncProcessor(GenerationTable* gtable, const String& name, bool isThreaded)
-				: m_genTable(gtable)
+			AsyncProcessor::AsyncProcessor(GenerationTable* gtable, bool isThreaded)
+				: m_genTable(gtable), m_isThreaded(isThreaded)
 			{
-				if (isThreaded)
+				m_postSyncQueue = new PostSyncQueue();
+
+				if (isThreaded && TaskScheduler::isInitialized())
 				{
-					m_queueMutex = new std::mutex();
-					m_processThread = new std::thread(&AsyncProcessor::ThreadEntry, this);
-					SetThreadName(m_processThread, name);
+					m_scheduler = StreamingScheduler::Attach(this);
+
+					// without workers the operations would only run when the main thread gets to them
+					m_isThreaded = TaskScheduler::getSingleton().getWorkerCount() > 0;
+				}
+				else
+				{
+					m_isThreaded = false;
 				}
 			}
 
 			AsyncProcessor::~AsyncProcessor(void)
 			{
-				DELETE_AND_NULL(m_processThread);
-				DELETE_AND_NULL(m_queueMutex);
-			}
-
-			void AsyncProcessor::ThreadEntry(void* arg) { static_cast<AsyncProcessor*>(arg)->Main(); }
-
-			void AsyncProcessor::Main()
-			{
-				const float CollectInterval = 1;
-				const float GenUpdateInterval = 0.25f;
-
-				float accumulatedCollectWaitingTime = 0;
-				float accumulatedGenUpdateWaitingTime = 0;
-
-
-				float timeStart1 = (float)clock() / CLOCKS_PER_SEC;
-				float timeStart2 = timeStart1;
-
-				while (!m_closed)
-				{
-					bool haveRest = true;
-
-					ResourceOperation resOp;
-					m_queueMutex->lock();
-					if (m_opQueue.getCount() > 0)
-					{
-						resOp = m_opQueue.Dequeue();
-					}
-
-					m_queueMutex->unlock();
-
-					if (resOp.isValid())
-					{
-						Resource::ProcessResourceOperation(resOp);
-
-						if (resOp.Subject->isPostSyncNeeded())
-						{
-							m_postSyncQueue.Enqueue(resOp);
-						}
-
-						haveRest = false;
-					}
-					
-					float t = (float)clock() / CLOCKS_PER_SEC;
-					float timeSpent1 = t - timeStart1;
-					if (timeSpent1<0) timeSpent1 = 0;
-					float timeSpent2 = t - timeStart2;
-					if (timeSpent2<0) timeSpent2 = 0;
-
+				if (!m_closed)
+					Shutdown();
 
-					accumulatedCollectWaitingTime += timeSpent1;
-					accumulatedGenUpdateWaitingTime += timeSpent2;
-					timeStart1 = t;
-					timeStart2 = t;
-
-					if (accumulatedGenUpdateWaitingTime > GenUpdateInterval)
-					{
-						m_genTable->SubTask_GenUpdate();
-						accumulatedGenUpdateWaitingTime = 0;
-						if (!haveRest) ApocSleep(10);
-					}
-
-
-					if (accumulatedCollectWaitingTime > CollectInterval)
-					{
-						m_genTable->SubTask_Collect();
-						accumulatedCollectWaitingTime = 0;
-						if (!haveRest) ApocSleep(10);
-					}
-
-					if (haveRest) ApocSleep(10);
-					
-				}
+				m_chains.DeleteValuesAndClear();
+				DELETE_AND_NULL(m_postSyncQueue);
 			}
 
 			bool AsyncProcessor::NeutralizeTask(const ResourceOperation& op)
@@ -126,161 +62,259 @@ namespace Apoc3D
 
 				if (res && res->isIndependent())
 				{
+					std::lock_guard<std::mutex> lock(m_queueMutex);
+
 					if (op.Type == ResourceOperation::RESOP_Load)
 					{
-						LockQueue();
-
 						passed = ClearMatchingResourceOperation(res, ResourceOperation::RESOP_Unload);
-
-						UnlockQueue();
 					}
 					else if (op.Type == ResourceOperation::RESOP_Unload)
 					{
-						LockQueue();
-
 						passed = ClearMatchingResourceOperation(res, ResourceOperation::RESOP_Load);
-
-						UnlockQueue();
 					}
 				}
 				return passed;
 			}
 			void AsyncProcessor::AddTask(const ResourceOperation& op)
 			{
-				LockQueue();
+				if (!m_isThreaded)
+				{
+					// not threaded, process right away
+					ProcessOperation(op);
+					return;
+				}
+
+				StreamingTask task;
+				{
+					std::lock_guard<std::mutex> lock(m_queueMutex);
+
+					// rejected, as the scheduler is detached already
+					assert(!m_closed);
+					if (m_closed)
+						return;
 
-				m_opQueue.Enqueue(op);
+					OperationChain* chain;
+					if (!m_chains.TryGetValue(op.Subject, chain))
+					{
+						chain = new OperationChain();
+						m_chains.Add(op.Subject, chain);
+					}
+
+					chain->Operations.Enqueue(op);
+					m_pendingCount++;
+
+					if (chain->Running || chain->Scheduled)
+						return;
+
+					task = ScheduleHead(op.Subject, chain);
+				}
 
-				UnlockQueue();
+				m_scheduler->Submit(task);
 			}
 			void AsyncProcessor::RemoveTask(const ResourceOperation& op)
 			{
-				LockQueue();
+				std::lock_guard<std::mutex> lock(m_queueMutex);
 
-				for (int32 i = 0; i < m_opQueue.getCount(); i++)
+				OperationChain* chain;
+				if (m_chains.TryGetValue(op.Subject, chain))
 				{
-					ResourceOperation& e = m_opQueue[i];
-					if (e == op)
+					Queue<ResourceOperation>& ops = chain->Operations;
+					for (int32 i = ops.getCount() - 1; i >= 0; i--)
 					{
-						e.Invalidate();
+						if (ops[i] == op)
+						{
+							ops.RemoveAt(i);
+							m_pendingCount--;
+						}
 					}
+
+					ReleaseChain(op.Subject, chain);
 				}
 
-				UnlockQueue();
+				NotifyIfIdle();
 			}
 			void AsyncProcessor::RemoveTask(Resource* res)
 			{
-				LockQueue();
+				m_postSyncQueue->Remove(res);
+
+				std::lock_guard<std::mutex> lock(m_queueMutex);
 
-				for (int32 i = 0; i < m_opQueue.getCount(); i++)
+				OperationChain* chain;
+				if (m_chains.TryGetValue(res, chain))
 				{
-					ResourceOperation& e = m_opQueue[i];
-					if (e.Subject == res)
-					{
-						e.Invalidate();
-					}
+					m_pendingCount -= chain->Operations.getCount();
+					chain->Operations.Clear();
+
+					ReleaseChain(res, chain);
 				}
 
-				UnlockQueue();
+				NotifyIfIdle();
+			}
+
+			void AsyncProcessor::Reprioritize(Resource* res, float priority)
+			{
+				StreamingTask task;
+				{
+					std::lock_guard<std::mutex> lock(m_queueMutex);
+
+					OperationChain* chain;
+					if (!m_chains.TryGetValue(res, chain))
+						return;
+
+					Queue<ResourceOperation>& ops = chain->Operations;
+					for (int32 i = 0; i < ops.getCount(); i++)
+						ops[i].Priority = priority;
+
+					// the old task becomes stale once a new ticket is issued
+					if (!chain->Scheduled || m_closed)
+						return;
+
+					task = ScheduleHead(res, chain);
+				}
+
+				m_scheduler->Submit(task);
 			}
 
 			bool AsyncProcessor::TaskCompleted()
 			{
-				volatile bool result;
-				LockQueue();
-				result = m_opQueue.getCount() == 0;
-				UnlockQueue();
-				return result;
+				std::lock_guard<std::mutex> lock(m_queueMutex);
+				return m_pendingCount + m_runningCount == 0;
 			}
 			int AsyncProcessor::GetOperationCount()
 			{
-				volatile int result;
-				LockQueue();
-				result = m_opQueue.getCount();
-				UnlockQueue();
-				return result;
+				std::lock_guard<std::mutex> lock(m_queueMutex);
+				return m_pendingCount + m_runningCount;
 			}
 			void AsyncProcessor::WaitForCompletion()
 			{
-				assert(m_processThread);
-				while (!TaskCompleted())
-				{
-					ApocSleep(10);
-				}
+				std::unique_lock<std::mutex> lock(m_queueMutex);
+				m_idleCondition.wait(lock, [this]() { return m_pendingCount + m_runningCount == 0 || m_closed; });
 			}
 			void AsyncProcessor::Shutdown()
 			{
-				m_closed = true;
+				{
+					std::lock_guard<std::mutex> lock(m_queueMutex);
+					if (m_closed)
+						return;
+					m_closed = true;
+				}
+				m_idleCondition.notify_all();
+
 				m_genTable->ShutDown();
-				if (m_processThread)
+
+				if (m_scheduler)
 				{
-					m_processThread->join();
+					StreamingScheduler::Detach(this);
+					m_scheduler = nullptr;
 				}
 			}
 
-			void AsyncProcessor::ProcessPostSync(float& timeLeft)
+			void AsyncProcessor::Execute(const StreamingTask& task)
 			{
-				using namespace std::chrono;
-				
-				if (m_postSyncQueue.getCount()>0)
+				Resource* res = task.Subject;
+				OperationChain* chain;
+				ResourceOperation op;
 				{
-					high_resolution_clock::time_point t1 = high_resolution_clock::now();
+					std::lock_guard<std::mutex> lock(m_queueMutex);
+
+					if (m_closed)
+						return;
+
+					if (!m_chains.TryGetValue(res, chain) || !chain->Scheduled || chain->Ticket != task.Ticket)
+						return; // stale
 
-					bool processed = false;
-					while (m_postSyncQueue.getCount() > 0)
+					chain->Scheduled = false;
+					if (chain->Operations.getCount() == 0)
 					{
-						const ResourceOperation& resop = m_postSyncQueue.Head();
+						ReleaseChain(res, chain);
+						return;
+					}
 
-						for (int32 i = 0; i < 5; i++)
-						{
-							processed = true;
+					op = chain->Operations.Dequeue();
+					m_pendingCount--;
+					m_runningCount++;
+					chain->Running = true;
+				}
 
-							Resource::ProcessResourceOperationPostSyc(resop, i * 25);
+				ProcessOperation(op);
 
-							high_resolution_clock::time_point t2 = high_resolution_clock::now();
-							duration<float> time_span = duration_cast<duration<float>>(t2 - t1);
+				StreamingTask next;
+				bool hasNext = false;
+				{
+					std::lock_guard<std::mutex> lock(m_queueMutex);
 
-							if (time_span.count() >= timeLeft)
-							{
-								timeLeft = 0;
-								break;
-							}
-						}
-					}
+					chain->Running = false;
+					m_runningCount--;
 
-					if (processed && timeLeft > 0)
+					if (chain->Operations.getCount() && !m_closed)
 					{
-						high_resolution_clock::time_point t2 = high_resolution_clock::now();
-						duration<float> time_span = duration_cast<duration<float>>(t2 - t1);
-						timeLeft -= time_span.count();
+						next = ScheduleHead(res, chain);
+						hasNext = true;
 					}
+					else
+					{
+						ReleaseChain(res, chain);
+					}
+
+					NotifyIfIdle();
 				}
-				
+
+				if (hasNext)
+					m_scheduler->Submit(next);
 			}
 
-			void AsyncProcessor::LockQueue()
+			void AsyncProcessor::Housekeep()
 			{
-				if (m_queueMutex)
-				{
-					m_queueMutex->lock();
-				}
+				m_genTable->SubTask_Collect();
 			}
-			void AsyncProcessor::UnlockQueue()
+
+			void AsyncProcessor::ProcessOperation(const ResourceOperation& op)
 			{
-				if (m_queueMutex)
+				Resource::ProcessResourceOperation(op);
+
+				if (op.Subject->isPostSyncNeeded())
+					m_postSyncQueue->Enqueue(op);
+			}
+
+			StreamingTask AsyncProcessor::ScheduleHead(Resource* res, OperationChain* chain)
+			{
+				chain->Ticket = ++m_ticketCounter;
+				chain->Scheduled = true;
+				return StreamingTask(this, res, chain->Ticket, chain->Operations.Head().Priority);
+			}
+
+			void AsyncProcessor::ReleaseChain(Resource* res, OperationChain* chain)
+			{
+				// a running chain is released by the worker when the operation is done
+				if (chain->Operations.getCount() == 0 && !chain->Running)
 				{
-					m_queueMutex->unlock();
+					m_chains.Remove(res);
+					delete chain;
 				}
 			}
 
+			void AsyncProcessor::NotifyIfIdle()
+			{
+				if (m_pendingCount + m_runningCount == 0)
+					m_idleCondition.notify_all();
+			}
+
 			bool AsyncProcessor::ClearMatchingResourceOperation(Resource* res, ResourceOperation::OperationType type)
 			{
-				for (int i = 0; i < m_opQueue.getCount(); i++)
+				OperationChain* chain;
+				if (!m_chains.TryGetValue(res, chain))
+					return false;
+
+				Queue<ResourceOperation>& ops = chain->Operations;
+				for (int32 i = 0; i < ops.getCount(); i++)
 				{
-					ResourceOperation& other = m_opQueue[i];
-					if (other.Subject == res && other.Type == type)
+					if (ops[i].Type == type)
 					{
-						other.Invalidate();
+						ops.RemoveAt(i);
+						m_pendingCount--;
+
+						ReleaseChain(res, chain);
+						NotifyIfIdle();
 						return true;
 					}
 				}
@@ -21,6 +21,10 @@
 
 #include "apoc3d/ApocCommon.h"
 #include "apoc3d/Collections/Queue.h"
+#include "apoc3d/Collections/HashMap.h"
+#include "StreamingScheduler.h"
+
+#include <condition_variable>
 
 using namespace Apoc3D::Collections;
 
@@ -44,9 +48,12 @@ namespace Apoc3D
 
 				Resource* Subject = nullptr;
 
+				/** Operations with higher priority are processed first. See Resource::setStreamingPriority */
+				float Priority = 0;
+
 				ResourceOperation() { }
-				ResourceOperation(Resource* res, OperationType type)
-					: Subject(res), Type(type) { }
+				ResourceOperation(Resource* res, OperationType type, float priority = 0)
+					: Subject(res), Type(type), Priority(priority) { }
 
 				void Invalidate() { Subject = nullptr; }
 				bool isValid() const { return Subject != nullptr; }
@@ -56,13 +63,22 @@ namespace Apoc3D
 			};
 
 			/**
-			 *  This is used to initialize a thread for resource collection and processing.
-			 *  At the same time it keeps track of current ResourceOperations and process queued ones in background .
+			 *  Keeps track of the ResourceOperations of a resource manager, and dispatches them to the 
+			 *  shared StreamingScheduler for processing in background.
+			 *
+			 *  Operations on the same resource are kept in a chain and processed strictly in the order they
+			 *  are added, one at a time; while operations on different resources are processed in parallel
+			 *  in the order of their priorities.
 			 */
 			class APAPI AsyncProcessor
 			{
+				friend class StreamingScheduler;
 			public:
-				AsyncProcessor(GenerationTable* gTable, const String& name, bool isThreaded);
+				/**
+				 *  @param isThreaded Processes the operations on the StreamingScheduler. When the TaskScheduler is not
+				 *		initialized or has no workers, they are processed right away in AddTask instead.
+				 */
+				AsyncProcessor(GenerationTable* gTable, bool isThreaded);
 				~AsyncProcessor(void);
 
 				/**
@@ -72,7 +88,8 @@ namespace Apoc3D
 				bool NeutralizeTask(const ResourceOperation& op);
 
 				/**
-				 *  Adds a ResourceOperation object to the queue.
+				 *  Adds a ResourceOperation object to the queue. 
+				 *  Operations added after Shutdown are rejected and never processed.
 				 */
 				void AddTask(const ResourceOperation& op);
 				/**
@@ -83,11 +100,16 @@ namespace Apoc3D
 				void RemoveTask(Resource* res);
 
 				/**
-				 *  Check if there is no queued ResourceOperations at the moment.
+				 *  Changes the priority of the queued ResourceOperations of the given resource.
+				 */
+				void Reprioritize(Resource* res, float priority);
+
+				/**
+				 *  Check if there is no queued or running ResourceOperations at the moment.
 				 */
 				bool TaskCompleted();
 				/**
-				 *  Gets the current number of queued ResourceOperations.
+				 *  Gets the current number of queued or running ResourceOperations.
 				 */
 				int GetOperationCount();
 
@@ -97,32 +119,52 @@ namespace Apoc3D
 				void WaitForCompletion();
 				
 				/**
-				 *  Shuts down the AsyncProcessor. Terminating the background thread.
+				 *  Shuts down the AsyncProcessor. Detaching from the StreamingScheduler.
 				 */
 				void Shutdown();
 
 
-				void ProcessPostSync(float& timeLeft);
+				/** The ResourceOperations waiting for post sync processing on the main thread. */
+				PostSyncQueue* getPostSyncQueue() const { return m_postSyncQueue; }
 
 
 			private:
-				void LockQueue();
-				void UnlockQueue();
+				/** The pending operations on one resource. */
+				struct OperationChain
+				{
+					Queue<ResourceOperation> Operations;
+					uint32 Ticket = 0;
+					bool Scheduled = false;
+					bool Running = false;
+				};
+
+				StreamingTask ScheduleHead(Resource* res, OperationChain* chain);
+				void ReleaseChain(Resource* res, OperationChain* chain);
+				void NotifyIfIdle();
 
 				bool ClearMatchingResourceOperation(Resource* res, ResourceOperation::OperationType type);
 
+				void ProcessOperation(const ResourceOperation& op);
 
-				static void ThreadEntry(void* arg);
-				void Main();
+				/** Called by StreamingScheduler's tasks */
+				void Execute(const StreamingTask& task);
+				void Housekeep();
+
+				HashMap<Resource*, OperationChain*> m_chains;
+				int32 m_pendingCount = 0;
+				int32 m_runningCount = 0;
+				uint32 m_ticketCounter = 0;
 
-				Queue<ResourceOperation> m_opQueue;
 				GenerationTable* m_genTable = nullptr;
-				std::thread* m_processThread = nullptr;
-				std::mutex* m_queueMutex = nullptr;
+				StreamingScheduler* m_scheduler = nullptr;
+
+				std::mutex m_queueMutex;
+				std::condition_variable m_idleCondition;
 
-				Queue<ResourceOperation> m_postSyncQueue;
+				PostSyncQueue* m_postSyncQueue = nullptr;
 
 				bool m_closed = false;
+				bool m_isThreaded = false;
 
 			};
 		}
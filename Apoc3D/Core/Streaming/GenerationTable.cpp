@@ -15,16 +15,8 @@
  */
 
 #include "GenerationTable.h"
-#include "apoc3d/Platform/Thread.h"
 #include "apoc3d/Core/ResourceManager.h"
 #include "apoc3d/Core/Resource.h"
-#include "apoc3d/Core/Logging.h"
-#include "apoc3d/Utility/StringUtils.h"
-
-#include <ctime>
-
-using namespace Apoc3D::Platform;
-using namespace Apoc3D::Utility;
 
 namespace Apoc3D
 {
@@ -32,97 +24,149 @@ namespace Apoc3D
 	{
 		namespace Streaming
 		{
-			const float GenerationTable::GenerationLifeTime[MaxGeneration] = { 3, 10, 20, 30 };
+			const int32 GenerationTable::GenerationLifeTime[MaxGeneration] = { 3, 10, 20, 30 };
+
+			/** The number of ring entries examined in one hold of the lock. */
+			static const int32 EvictBatchSize = 64;
+
+			/** The minimum number of ring entries aged in one SubTask_Collect */
+			static const int32 MinCollectStep = 256;
+
+			/**
+			 *  The minimum ages of resources unloaded in each revolution of an eviction. The first revolution
+			 *  only considers resources not used lately, the last one those not used in the current epoch.
+			 *  Resources used in the current epoch are never evicted, as they would be loaded again right
+			 *  away; the cache goes over the budget instead until they age.
+			 */
+			static const int32 EvictionMinAges[] = { 2, 1 };
 
 			GenerationTable::GenerationTable(ResourceManager* mgr)
-				: m_manager(mgr), m_isShutdown(false), m_generationList(100)
+				: m_manager(mgr), m_isShutdown(false), m_clock(100), 
+				m_pendingEvictionSize(0), m_epoch(1), m_evicting(false)
 			{
-				m_generations = new HashSet<Resource*>[MaxGeneration];
+
 			}
 			GenerationTable::~GenerationTable()
 			{
-				delete[] m_generations;
+
 			}
 
-			void GenerationTable::SubTask_GenUpdate()
+			void GenerationTable::SubTask_Collect()
 			{
-				clock_t timeStart = clock();
+				if (m_isShutdown)
+					return;
+
+				m_epoch++;
 
-				int count;
-				m_genLock.lock();
-				count = m_generationList.getCount();
-				m_genLock.unlock();
+				// in case the budget is changed
+				EvictToBudget();
 
+				List<Resource*> victims;
 				{
-					for (int j=0;j<count;j++)
+					std::lock_guard<std::mutex> lock(m_genLock);
+
+					int32 count = m_clock.getCount();
+					int32 step = count / 8;
+					if (step < MinCollectStep) step = MinCollectStep;
+					if (step > count) step = count;
+
+					for (int32 i = 0; i < step; i++)
 					{
-						Resource* res;
-						{
-							std::lock_guard<std::mutex> lock(m_genLock);
-							count = m_generationList.getCount();
-							if (j < count)
-								res = m_generationList[j];
-							else
-								break;
-						}
+						if (m_collectHand >= m_clock.getCount())
+							m_collectHand = 0;
 
-						if (res->m_generation->IsGenerationOutOfTime((float)timeStart/CLOCKS_PER_SEC))
+						Resource* r = m_clock[m_collectHand++];
+						if (!r->getReferenceCount() && GetGeneration(r) == MaxGeneration - 1)
 						{
-							int og = res->m_generation->Generation;
-							res->m_generation->UpdateGeneration((float)timeStart/CLOCKS_PER_SEC);
-							int ng = res->m_generation->Generation;
-							if (ng!=og)
-							{
-								UpdateGeneration(og,ng,res);
-			//#ifdef _DEBUG
-								//LogManager::getSingleton().Write(LOG_System, L"GEN_CHG" + StringUtils::ToString(ng) +L" ("+ res->getHashString() + L")", LOGLVL_Default);
-			//#endif
-							}
+							TryEvict(r, victims);
 						}
 					}
 				}
+
+				UnloadVictims(victims);
 			}
-			void GenerationTable::SubTask_Collect()
+
+			void GenerationTable::EvictToBudget()
 			{
-				int64 predictSize = m_manager->getUsedCacheSize();
+				if (m_isShutdown)
+					return;
+
+				// one sweep at a time, the others will be covered by it
+				bool expected = false;
+				if (!m_evicting.compare_exchange_strong(expected, true))
+					return;
+
+				auto isWithinBudget = [this]()
+				{
+					return m_manager->getUsedCacheSize() - m_pendingEvictionSize <= m_manager->getTotalCacheSize();
+				};
+
+				const uint32 epoch = m_epoch;
 
-				if (predictSize>m_manager->getTotalCacheSize())
+				List<Resource*> victims(EvictBatchSize);
+
+				for (int32 minAge : EvictionMinAges)
 				{
-					for (int i=MaxGeneration-1;i>1 && predictSize > m_manager->getTotalCacheSize(); i--)
+					int32 scanned = 0;
+					bool finished = isWithinBudget();
+
+					while (!finished)
 					{
-						m_genLock.lock();
-						for (Resource* r : m_generations[i])
 						{
+							std::lock_guard<std::mutex> lock(m_genLock);
 
-							if (CanUnload(r) && r->IsUnloadable())
+							int32 count = m_clock.getCount();
+							for (int32 i = 0; i < EvictBatchSize; i++)
 							{
-								predictSize -= r->getSize();
-								r->Unload();
-
-								if (predictSize <= m_manager->getTotalCacheSize())
+								if (scanned >= count || isWithinBudget())
 								{
+									finished = true;
 									break;
 								}
+
+								if (m_evictHand >= count)
+									m_evictHand = 0;
+
+								Resource* r = m_clock[m_evictHand++];
+								scanned++;
+
+								if ((int32)(epoch - r->m_lastUseEpoch) >= minAge)
+									TryEvict(r, victims);
 							}
 						}
-						m_genLock.unlock();
+
+						UnloadVictims(victims);
 					}
+
+					if (isWithinBudget())
+						break;
 				}
+
+				m_evicting = false;
+			}
+
+			bool GenerationTable::TryEvict(Resource* res, List<Resource*>& victims)
+			{
+				if (!res->m_clockEvicting && CanUnload(res) && res->IsUnloadable())
 				{
-					m_genLock.lock();
-					for (Resource* r : m_generations[MaxGeneration - 1])
-					{
-						if (!r->getReferenceCount())
-						{
-							if (CanUnload(r) && r->IsUnloadable())
-							{
-								r->Unload();
-							}
-						}
-					}
-					m_genLock.unlock();
+					res->m_clockEvicting = true;
+					res->m_clockEvictSize = res->getSize();
+					m_pendingEvictionSize += res->m_clockEvictSize;
+
+					victims.Add(res);
+					return true;
 				}
+				return false;
+			}
+
+			void GenerationTable::UnloadVictims(List<Resource*>& victims)
+			{
+				// without the lock, as an unload processed right away comes back through NotifyUnloadProcessed
+				for (Resource* res : victims)
+					res->Unload();
+				victims.Clear();
 			}
+
 			bool GenerationTable::CanUnload(Resource* res) const
 			{
 				ResourceState state = res->getState();
@@ -131,42 +175,66 @@ namespace Apoc3D
 
 			void GenerationTable::AddResource(Resource* res)
 			{
-				int g = res->GetGeneration();
-				if (g != -1)
-				{
-					m_genLock.lock();
-					m_generations[g].Add(res);
-					m_generationList.Add(res);
-					m_genLock.unlock();
-				}
+				std::lock_guard<std::mutex> lock(m_genLock);
+
+				assert(res->m_clockSlot == -1);
+
+				res->m_lastUseEpoch = m_epoch.load();
+				res->m_clockSlot = m_clock.getCount();
+				m_clock.Add(res);
 			}
 
 			void GenerationTable::RemoveResource(Resource* res)
 			{
-				int g = res->GetGeneration();
-				if (g != -1)
+				std::lock_guard<std::mutex> lock(m_genLock);
+
+				int32 slot = res->m_clockSlot;
+				if (slot != -1)
+				{
+					assert(m_clock[slot] == res);
+
+					m_clock.RemoveAtSwapping(slot);
+					if (slot < m_clock.getCount())
+						m_clock[slot]->m_clockSlot = slot;
+
+					res->m_clockSlot = -1;
+				}
+
+				if (res->m_clockEvicting)
 				{
-					m_genLock.lock();
-					m_generations[g].Remove(res);
-					m_generationList.Remove(res);
-					m_genLock.unlock();
+					res->m_clockEvicting = false;
+					m_pendingEvictionSize -= res->m_clockEvictSize;
 				}
 			}
 
-			void GenerationTable::UpdateGeneration(int oldGeneration, int newGeneration, Resource* resource)
+			void GenerationTable::Touch(Resource* res) const
 			{
-				m_genLock.lock();
+				uint32 epoch = m_epoch.load(std::memory_order_relaxed);
 
-				if (oldGeneration != -1 && m_generations[oldGeneration].Contains(resource))
-				{
-					m_generations[oldGeneration].Remove(resource);
-				}
-				if (!m_generations[newGeneration].Contains(resource))
+				// avoid writing to the shared cache line when not needed
+				if (res->m_lastUseEpoch.load(std::memory_order_relaxed) != epoch)
+					res->m_lastUseEpoch.store(epoch, std::memory_order_relaxed);
+			}
+
+			void GenerationTable::NotifyUnloadProcessed(Resource* res)
+			{
+				std::lock_guard<std::mutex> lock(m_genLock);
+
+				if (res->m_clockEvicting)
 				{
-					m_generations[newGeneration].Add(resource);
+					res->m_clockEvicting = false;
+					m_pendingEvictionSize -= res->m_clockEvictSize;
 				}
+			}
+
+			int32 GenerationTable::GetGeneration(const Resource* res) const
+			{
+				int32 age = (int32)(m_epoch - res->m_lastUseEpoch);
 
-				m_genLock.unlock();
+				int32 gen = 0;
+				while (gen < MaxGeneration - 1 && age > GenerationLifeTime[gen])
+					gen++;
+				return gen;
 			}
 		}
 	}
@@ -23,6 +23,8 @@
 #include "apoc3d/Collections/List.h"
 #include "apoc3d/Collections/HashMap.h"
 
+#include <atomic>
+
 using namespace Apoc3D::Core;
 using namespace Apoc3D::Collections;
 
@@ -33,59 +35,77 @@ namespace Apoc3D
 		namespace Streaming
 		{
 			/**
-			 *  A GenerationTable puts resources with different gen numbers into different tables,
-			 *  and works on resource collecting and gen number updating based on the them.
+			 *  A GenerationTable keeps all resources of an async resource manager in a clock ring, and
+			 *  decides which to unload.
+			 *
+			 *  Using a resource only stamps it with the current epoch, which is lock free. The epoch advances
+			 *  on every SubTask_Collect, so the age of a resource is the number of epochs since its last use.
+			 *  As soon as the manager's used cache size goes over the budget, the clock hand sweeps the ring
+			 *  and unloads the oldest resources it meets, until the predicted size is within the budget again.
+			 *  Resources used in the current epoch are left alone, even if that leaves the cache over the budget.
+			 *  SubTask_Collect also ages a slice of the ring and unloads long unused and unreferenced resources.
 			 */
 			class APAPI GenerationTable
 			{
 			public:
 				static const int32 MaxGeneration = 4;
 
-				static const float GenerationLifeTime[];
+				/** The ages in epochs(seconds) where the generation numbers change. */
+				static const int32 GenerationLifeTime[];
 
 			public:
 
 				GenerationTable(ResourceManager* mgr);
 				~GenerationTable();
 
-
-				void SubTask_GenUpdate();
+				/** Advances the epoch, and collects long unused resources incrementally. */
 				void SubTask_Collect();
 
-
-				//ExistTable<Resource*>& getGeneration(int index) const { return m_generations[index]; }
+				/** Unloads the least recently used resources until the predicted cache usage is within the budget. */
+				void EvictToBudget();
 
 				void AddResource(Resource* res);
 				void RemoveResource(Resource* res);
 
-				/**
-				 *  Remove the resource from the table with oldGeneration number in m_generations, and add to the new table of newGeneration.
-				 */
-				void UpdateGeneration(int oldGeneration, int newGeneration, Resource* resource);
+				/** Marks the resource used in the current epoch. */
+				void Touch(Resource* res) const;
+
+				/** Called when an unload operation on the resource is done, or canceled. */
+				void NotifyUnloadProcessed(Resource* res);
+
+				/** Gets the generation number of a resource from its age. */
+				int32 GetGeneration(const Resource* res) const;
+
+				uint32 getEpoch() const { return m_epoch; }
 
 				void ShutDown() 
 				{
 					m_isShutdown = true;
-
-					//m_thread->join();
 				}
 
 			private:
+				bool CanUnload(Resource* res) const;
+				/** Marks a resource for eviction and adds it to victims, to be unloaded once m_genLock is released. */
+				bool TryEvict(Resource* res, List<Resource*>& victims);
+				void UnloadVictims(List<Resource*>& victims);
+
 				/**
-				 *  An array of tables represents that resources with gen i are in i+1 th table.
-				 */
-				HashSet<Resource*>* m_generations;
-				/**
-				 *  A list of all pointers to resource objects.
+				 *  All resources in the clock ring. A resource knows its slot in the ring, so 
+				 *  adding and removing are O(1).
 				 */
-				List<Resource*> m_generationList;
-				
+				List<Resource*> m_clock;
+				int32 m_evictHand = 0;
+				int32 m_collectHand = 0;
+
+				/** The size of resources pending to be unloaded by eviction */
+				std::atomic<int64> m_pendingEvictionSize;
+				std::atomic<uint32> m_epoch;
+				std::atomic<bool> m_evicting;
+
 				ResourceManager* m_manager;
 
 				bool m_isShutdown;
 				std::mutex m_genLock;
-
-				bool CanUnload(Resource* res) const;
 			};
 		}
 		
@@ -0,0 +1,167 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2010-2017 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "PostSyncQueue.h"
+#include "apoc3d/Core/Resource.h"
+
+#include <chrono>
+
+namespace Apoc3D
+{
+	namespace Core
+	{
+		namespace Streaming
+		{
+			void PostSyncQueue::Enqueue(const ResourceOperation& op)
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				m_incoming.Add(op);
+			}
+
+			void PostSyncQueue::Remove(Resource* res)
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				for (int32 i = m_incoming.getCount() - 1; i >= 0; i--)
+				{
+					if (m_incoming[i].Subject == res)
+						m_incoming.RemoveAt(i);
+				}
+				for (int32 i = m_items.getCount() - 1; i >= 0; i--)
+				{
+					if (m_items[i].Operation.Subject == res)
+						m_items.RemoveAt(i);
+				}
+
+				if (m_processing == res)
+					m_processingRemoved = true;
+			}
+
+			void PostSyncQueue::BeginFrame()
+			{
+				m_frameStats.Reset();
+
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				for (const ResourceOperation& op : m_incoming)
+				{
+					Item item;
+					item.Operation = op;
+					item.Sequence = m_sequence++;
+					m_items.Add(item);
+				}
+				m_incoming.Clear();
+
+				if (m_items.getCount() > 1)
+				{
+					// priorities may have changed since last frame
+					for (Item& item : m_items)
+						item.Operation.Priority = item.Operation.Subject->getStreamingPriority();
+
+					m_items.Sort<Comparer>();
+				}
+			}
+
+			void PostSyncQueue::EndFrame()
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				m_frameStats.ItemsDeferred = m_items.getCount() + m_incoming.getCount();
+			}
+
+			bool PostSyncQueue::PeekPriority(float& priority)
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				if (m_items.getCount() == 0)
+					return false;
+
+				priority = m_items.LastItem().Operation.Priority;
+				return true;
+			}
+
+			int64 PostSyncQueue::ProcessStep()
+			{
+				using namespace std::chrono;
+
+				Item item;
+				{
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					if (m_items.getCount() == 0)
+						return 0;
+
+					item = m_items.LastItem();
+					m_items.RemoveAt(m_items.getCount() - 1);
+
+					m_processing = item.Operation.Subject;
+					m_processingRemoved = false;
+				}
+
+				high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+				item.State.BytesUploaded = 0;
+				bool finished = Resource::ProcessResourceOperationPostSync(item.Operation, item.State);
+
+				high_resolution_clock::time_point t2 = high_resolution_clock::now();
+				int64 timeSpent = duration_cast<microseconds>(t2 - t1).count();
+
+				if (m_frameStats.StepsProcessed == 0 && m_averageStepTime == 0)
+					m_averageStepTime = (float)timeSpent;
+				else
+					m_averageStepTime = m_averageStepTime * 0.8f + timeSpent * 0.2f;
+
+				m_frameStats.TimeUsed += timeSpent;
+				m_frameStats.StepsProcessed++;
+				m_frameStats.BytesUploaded += item.State.BytesUploaded;
+
+				{
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					if (finished)
+					{
+						m_frameStats.ItemsCompleted++;
+					}
+					else if (!m_processingRemoved)
+					{
+						// still the most urgent, continue with it next time
+						m_items.Add(item);
+					}
+
+					m_processing = nullptr;
+				}
+
+				return timeSpent;
+			}
+
+			int32 PostSyncQueue::getPendingCount()
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				return m_items.getCount() + m_incoming.getCount();
+			}
+
+			int32 PostSyncQueue::Comparer(const Item& a, const Item& b)
+			{
+				if (a.Operation.Priority < b.Operation.Priority) return -1;
+				if (a.Operation.Priority > b.Operation.Priority) return 1;
+
+				// earlier ones go towards the end
+				if (a.Sequence > b.Sequence) return -1;
+				if (a.Sequence < b.Sequence) return 1;
+				return 0;
+			}
+		}
+	}
+}
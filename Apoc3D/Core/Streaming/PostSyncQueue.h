@@ -0,0 +1,139 @@
+#pragma once
+
+#ifndef APOC3D_POSTSYNCQUEUE_H
+#define APOC3D_POSTSYNCQUEUE_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2010-2017 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+#include "apoc3d/Collections/List.h"
+#include "AsyncProcessor.h"
+
+using namespace Apoc3D::Collections;
+
+namespace Apoc3D
+{
+	namespace Core
+	{
+		namespace Streaming
+		{
+			/**
+			 *  The progress of a resource's post sync processing. Kept between frames so
+			 *  large uploads can be split into several steps.
+			 */
+			struct PostSyncState
+			{
+				/** Resource defined progress. Starts from 0. */
+				int32 Progress = 0;
+				/** Bytes uploaded by the last step. To be filled by the resource. */
+				int64 BytesUploaded = 0;
+			};
+
+			/** Counters of the post sync stage over a frame. */
+			struct PostSyncStatistics
+			{
+				/** Time spent in microseconds */
+				int64 TimeUsed = 0;
+				int32 StepsProcessed = 0;
+				int32 ItemsCompleted = 0;
+				/** Number of items left for later frames */
+				int32 ItemsDeferred = 0;
+				int64 BytesUploaded = 0;
+
+				void Reset() { *this = PostSyncStatistics(); }
+				void Accumulate(const PostSyncStatistics& o)
+				{
+					TimeUsed += o.TimeUsed;
+					StepsProcessed += o.StepsProcessed;
+					ItemsCompleted += o.ItemsCompleted;
+					ItemsDeferred += o.ItemsDeferred;
+					BytesUploaded += o.BytesUploaded;
+				}
+			};
+
+			/**
+			 *  Holds the ResourceOperations waiting for post sync processing on the main thread.
+			 *
+			 *  Operations can be added from any thread. Every frame, the pending ones are ordered by their
+			 *  resource's streaming priority, and processed one step at a time until the frame's budget
+			 *  is used up. An unfinished operation keeps its PostSyncState and continues in later frames.
+			 */
+			class APAPI PostSyncQueue
+			{
+			public:
+				PostSyncQueue() { }
+				~PostSyncQueue() { }
+
+				PostSyncQueue(const PostSyncQueue&) = delete;
+				PostSyncQueue& operator=(const PostSyncQueue&) = delete;
+
+				void Enqueue(const ResourceOperation& op);
+				void Remove(Resource* res);
+
+				/** Takes in newly added operations, and orders all pending ones by priority. */
+				void BeginFrame();
+				/** Records the number of deferred items into the frame's statistics. */
+				void EndFrame();
+
+				/**
+				 *  Gets the priority of the most urgent pending operation.
+				 *  @return false if nothing is pending.
+				 */
+				bool PeekPriority(float& priority);
+
+				/**
+				 *  Processes one step of the most urgent pending operation.
+				 *  @return The time spent in microseconds.
+				 */
+				int64 ProcessStep();
+
+				/** The expected time in microseconds of a step, from the recent history. */
+				int64 getEstimatedStepTime() const { return (int64)m_averageStepTime; }
+				int32 getPendingCount();
+
+				const PostSyncStatistics& getFrameStatistics() const { return m_frameStats; }
+
+			private:
+				struct Item
+				{
+					ResourceOperation Operation;
+					PostSyncState State;
+					uint64 Sequence = 0;
+				};
+
+				static int32 Comparer(const Item& a, const Item& b);
+
+				std::mutex m_lock;
+				List<ResourceOperation> m_incoming;
+
+				/** Sorted so that the last item is the most urgent */
+				List<Item> m_items;
+
+				/** The resource being processed out of the lock */
+				Resource* m_processing = nullptr;
+				bool m_processingRemoved = false;
+
+				uint64 m_sequence = 0;
+				float m_averageStepTime = 0;
+
+				PostSyncStatistics m_frameStats;
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,219 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2010-2017 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "StreamingScheduler.h"
+#include "AsyncProcessor.h"
+
+#include <algorithm>
+
+namespace Apoc3D
+{
+	namespace Core
+	{
+		namespace Streaming
+		{
+			static bool TaskHeapLess(const StreamingTask& a, const StreamingTask& b) { return b.isPriorTo(a); }
+
+			static const std::chrono::duration<float> CollectInterval(1.0f);
+
+			int32 StreamingScheduler::WorkerCount = 0;
+
+			std::mutex StreamingScheduler::s_instanceLock;
+			StreamingScheduler* StreamingScheduler::s_instance = nullptr;
+
+			StreamingScheduler* StreamingScheduler::Attach(AsyncProcessor* proc)
+			{
+				std::lock_guard<std::mutex> lock(s_instanceLock);
+
+				if (s_instance == nullptr)
+				{
+					int32 count = WorkerCount;
+					if (count <= 0)
+					{
+						count = TaskScheduler::getSingleton().getWorkerCount();
+						if (count > 4) count = 4;
+						if (count < 1) count = 1;
+					}
+					s_instance = new StreamingScheduler(count);
+				}
+
+				s_instance->m_ownerLock.lock();
+				s_instance->m_owners.Add(proc);
+				s_instance->m_ownerLock.unlock();
+
+				return s_instance;
+			}
+
+			void StreamingScheduler::Detach(AsyncProcessor* proc)
+			{
+				StreamingScheduler* sch;
+				{
+					std::lock_guard<std::mutex> lock(s_instanceLock);
+
+					sch = s_instance;
+					if (sch == nullptr)
+						return;
+
+					// after this, housekeeping will not touch the processor anymore
+					sch->m_ownerLock.lock();
+					bool found = sch->m_owners.Remove(proc);
+					bool noOwners = sch->m_owners.getCount() == 0;
+					sch->m_ownerLock.unlock();
+
+					if (!found)
+						return;
+
+					{
+						// tasks taken out before purging may still be running, and may submit more
+						std::unique_lock<std::mutex> heapLock(sch->m_heapLock);
+						for (;;)
+						{
+							sch->PurgeLocked(proc);
+							if (!sch->m_running.Contains(proc))
+								break;
+							sch->m_taskDone.wait(heapLock);
+						}
+					}
+
+					if (!noOwners)
+						return;
+
+					s_instance = nullptr;
+				}
+
+				delete sch;
+			}
+
+			void StreamingScheduler::Update()
+			{
+				using namespace std::chrono;
+
+				std::lock_guard<std::mutex> lock(s_instanceLock);
+
+				StreamingScheduler* sch = s_instance;
+				if (sch == nullptr || !sch->m_housekeeping.isDone())
+					return;
+
+				steady_clock::time_point now = steady_clock::now();
+				if (now - sch->m_lastHousekeep > CollectInterval)
+				{
+					sch->m_lastHousekeep = now;
+					sch->m_housekeeping = TaskScheduler::getSingleton().Submit([sch]() { sch->Housekeep(); }, TaskAffinity::Background);
+				}
+			}
+
+			StreamingScheduler::StreamingScheduler(int32 maxRunners)
+				: m_maxRunners(maxRunners), m_lastHousekeep(std::chrono::steady_clock::now()), m_queuedCount(0)
+			{
+
+			}
+
+			StreamingScheduler::~StreamingScheduler()
+			{
+				// with no owners left the queue is empty, and the runners are leaving
+				if (TaskScheduler::isInitialized())
+				{
+					TaskScheduler& ts = TaskScheduler::getSingleton();
+					ts.WaitAll(m_runners.getElements(), m_runners.getCount());
+					ts.Wait(m_housekeeping);
+				}
+			}
+
+			void StreamingScheduler::Submit(const StreamingTask& task)
+			{
+				std::lock_guard<std::mutex> lock(m_heapLock);
+
+				StreamingTask t = task;
+				t.Sequence = m_sequence++;
+
+				m_heap.Add(t);
+				std::push_heap(m_heap.begin(), m_heap.end(), TaskHeapLess);
+				m_queuedCount++;
+
+				if (m_runnerCount < m_maxRunners)
+				{
+					m_runnerCount++;
+
+					for (int32 i = m_runners.getCount() - 1; i >= 0; i--)
+					{
+						if (m_runners[i].isDone())
+							m_runners.RemoveAtSwapping(i);
+					}
+					m_runners.Add(TaskScheduler::getSingleton().Submit([this]() { RunTasks(); }, TaskAffinity::Background));
+				}
+			}
+
+			void StreamingScheduler::Purge(AsyncProcessor* proc)
+			{
+				std::lock_guard<std::mutex> lock(m_heapLock);
+				PurgeLocked(proc);
+			}
+
+			void StreamingScheduler::PurgeLocked(AsyncProcessor* proc)
+			{
+				int32 removed = 0;
+				for (int32 i = m_heap.getCount() - 1; i >= 0; i--)
+				{
+					if (m_heap[i].Owner == proc)
+					{
+						m_heap.RemoveAtSwapping(i);
+						removed++;
+					}
+				}
+
+				if (removed)
+				{
+					std::make_heap(m_heap.begin(), m_heap.end(), TaskHeapLess);
+					m_queuedCount -= removed;
+				}
+			}
+
+			void StreamingScheduler::RunTasks()
+			{
+				std::unique_lock<std::mutex> lock(m_heapLock);
+
+				while (m_heap.getCount())
+				{
+					std::pop_heap(m_heap.begin(), m_heap.end(), TaskHeapLess);
+					StreamingTask task = m_heap.LastItem();
+					m_heap.RemoveAt(m_heap.getCount() - 1);
+					m_queuedCount--;
+
+					// recorded while still holding the lock so Detach can wait on it
+					m_running.Add(task.Owner);
+
+					lock.unlock();
+					task.Owner->Execute(task);
+					lock.lock();
+
+					m_running.Remove(task.Owner);
+					m_taskDone.notify_all();
+				}
+
+				m_runnerCount--;
+			}
+
+			void StreamingScheduler::Housekeep()
+			{
+				std::lock_guard<std::mutex> lock(m_ownerLock);
+				for (AsyncProcessor* proc : m_owners)
+				{
+					proc->Housekeep();
+				}
+			}
+		}
+	}
+}
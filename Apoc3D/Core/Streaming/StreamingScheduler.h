@@ -0,0 +1,132 @@
+#pragma once
+
+#ifndef APOC3D_STREAMINGSCHEDULER_H
+#define APOC3D_STREAMINGSCHEDULER_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2010-2017 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+#include "apoc3d/Collections/List.h"
+#include "apoc3d/Core/TaskScheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+using namespace Apoc3D::Collections;
+
+namespace Apoc3D
+{
+	namespace Core
+	{
+		namespace Streaming
+		{
+			/**
+			 *  A work item in the StreamingScheduler. It refers to the head operation of one resource's
+			 *  operation chain in the owning AsyncProcessor. The ticket is used to detect stale items
+			 *  after the chain is changed by cancellation or re-prioritization.
+			 */
+			struct StreamingTask
+			{
+				AsyncProcessor* Owner = nullptr;
+				Resource* Subject = nullptr;
+				uint32 Ticket = 0;
+				float Priority = 0;
+				uint64 Sequence = 0;
+
+				StreamingTask() { }
+				StreamingTask(AsyncProcessor* owner, Resource* subject, uint32 ticket, float priority)
+					: Owner(owner), Subject(subject), Ticket(ticket), Priority(priority) { }
+
+				/** Higher priority goes first; among equal ones, the earlier submitted goes first. */
+				bool isPriorTo(const StreamingTask& o) const
+				{
+					if (Priority != o.Priority)
+						return Priority > o.Priority;
+					return Sequence < o.Sequence;
+				}
+			};
+
+			/**
+			 *  Runs the StreamingTasks of all async ResourceManagers on the TaskScheduler.
+			 *
+			 *  The tasks are kept in one priority heap. A limited number of Background scheduler tasks
+			 *  take them off the heap, most urgent first, and leave when it is empty, so loading does not
+			 *  take over all the workers, nor a thread waiting in TaskScheduler::Wait. The periodic collection for the attached AsyncProcessors is
+			 *  submitted from Update.
+			 *
+			 *  The scheduler is created when the first AsyncProcessor attaches, and destroyed when the last detaches.
+			 */
+			class APAPI StreamingScheduler
+			{
+			public:
+				/** The number of tasks processed at the same time. 0 means deciding from the TaskScheduler's number of workers. */
+				static int32 WorkerCount;
+
+				static StreamingScheduler* Attach(AsyncProcessor* proc);
+				static void Detach(AsyncProcessor* proc);
+
+				/** Starts the periodic collection when it is due. Called by ResourceManager::PerformAllPostSync every frame. */
+				static void Update();
+
+				/** Queues a task, and starts a scheduler task to process the queue if there is room for one more. */
+				void Submit(const StreamingTask& task);
+
+				/** Removes all queued tasks owned by the given AsyncProcessor. */
+				void Purge(AsyncProcessor* proc);
+
+				int32 getWorkerCount() const { return m_maxRunners; }
+				int32 getQueuedTaskCount() const { return m_queuedCount; }
+
+			private:
+				StreamingScheduler(int32 maxRunners);
+				~StreamingScheduler();
+
+				/** The body of the scheduler tasks. Processes the queue until it is empty. */
+				void RunTasks();
+				void PurgeLocked(AsyncProcessor* proc);
+				void Housekeep();
+
+				std::mutex m_ownerLock;
+				List<AsyncProcessor*> m_owners;
+
+				/** Guards the heap, the runners and m_running */
+				std::mutex m_heapLock;
+				List<StreamingTask> m_heap;
+
+				/** The owners of the tasks being executed, once for each */
+				List<AsyncProcessor*> m_running;
+				std::condition_variable m_taskDone;
+
+				List<TaskHandle> m_runners;
+				int32 m_runnerCount = 0;
+				int32 m_maxRunners;
+
+				TaskHandle m_housekeeping;
+				std::chrono::steady_clock::time_point m_lastHousekeep;
+
+				std::atomic<int32> m_queuedCount;
+				uint64 m_sequence = 0;
+
+				static std::mutex s_instanceLock;
+				static StreamingScheduler* s_instance;
+			};
+		}
+	}
+}
+
+#endif
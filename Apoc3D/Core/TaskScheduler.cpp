@@ -0,0 +1,577 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "TaskScheduler.h"
+
+#include "apoc3d/Math/MathCommon.h"
+#include "apoc3d/Platform/Thread.h"
+#include "apoc3d/Utility/StringUtils.h"
+
+#include <memory>
+
+using namespace Apoc3D::Platform;
+using namespace Apoc3D::Utility;
+
+namespace Apoc3D
+{
+	namespace Core
+	{
+		struct TaskState
+		{
+			std::function<void()> Work;
+			TaskAffinity Affinity = TaskAffinity::Any;
+
+			/** One for the scheduler until the task has run, and one for each handle. */
+			std::atomic<int32> RefCount;
+			/** Dependencies not done yet, plus one held while the task is being submitted. */
+			std::atomic<int32> PendingCount;
+			std::atomic<bool> Done;
+
+			/** Guards Continuations, and Done turning true */
+			std::mutex Lock;
+			List<TaskState*> Continuations;
+
+			TaskState(std::function<void()>&& work, TaskAffinity affinity)
+				: Work(std::move(work)), Affinity(affinity), RefCount(2), PendingCount(1), Done(false) { }
+
+			void AddRef() { RefCount++; }
+			void Release()
+			{
+				if (--RefCount == 0)
+					delete this;
+			}
+		};
+
+		/************************************************************************/
+		/*  TaskHandle                                                          */
+		/************************************************************************/
+
+		TaskHandle::~TaskHandle()
+		{
+			if (m_task)
+				m_task->Release();
+		}
+
+		TaskHandle::TaskHandle(const TaskHandle& o)
+			: m_task(o.m_task)
+		{
+			if (m_task)
+				m_task->AddRef();
+		}
+		TaskHandle::TaskHandle(TaskHandle&& o)
+			: m_task(o.m_task)
+		{
+			o.m_task = nullptr;
+		}
+
+		TaskHandle& TaskHandle::operator=(const TaskHandle& o)
+		{
+			if (this != &o)
+			{
+				if (o.m_task)
+					o.m_task->AddRef();
+				if (m_task)
+					m_task->Release();
+				m_task = o.m_task;
+			}
+			return *this;
+		}
+		TaskHandle& TaskHandle::operator=(TaskHandle&& o)
+		{
+			if (this != &o)
+			{
+				if (m_task)
+					m_task->Release();
+				m_task = o.m_task;
+				o.m_task = nullptr;
+			}
+			return *this;
+		}
+
+		bool TaskHandle::isDone() const { return m_task == nullptr || m_task->Done; }
+
+		/** Shared by the calling thread and the helper tasks of a ParallelFor. Helpers starting late find no chunks left. */
+		struct ParallelForState
+		{
+			FunctorReference<void(int32, int32)> Body;
+			int32 Start;
+			int32 End;
+			int32 GrainSize;
+			int32 ChunkCount;
+
+			std::atomic<int32> NextChunk;
+			std::atomic<int32> DoneChunks;
+
+			ParallelForState(FunctorReference<void(int32, int32)> body, int32 start, int32 end, int32 grainSize, int32 chunkCount)
+				: Body(body), Start(start), End(end), GrainSize(grainSize), ChunkCount(chunkCount), NextChunk(0), DoneChunks(0) { }
+
+			void ProcessChunks()
+			{
+				for (;;)
+				{
+					int32 chunk = NextChunk++;
+					if (chunk >= ChunkCount)
+						break;
+
+					int32 chunkStart = Start + chunk * GrainSize;
+					Body(chunkStart, Math::Min(chunkStart + GrainSize, End));
+					DoneChunks++;
+				}
+			}
+		};
+
+		/************************************************************************/
+		/*  TaskScheduler                                                       */
+		/************************************************************************/
+
+		SINGLETON_IMPL(TaskScheduler);
+
+		int32 TaskScheduler::WorkerCount = -1;
+
+		/** The worker the current thread is, or -1 */
+		static thread_local int32 CurrentWorkerIndex = -1;
+
+		TaskScheduler::TaskScheduler()
+			: m_waitingCount(0), m_queuedCount(0), m_queuedBackgroundCount(0), m_mainThreadQueuedCount(0),
+			m_terminating(false), m_mainThreadID(std::this_thread::get_id())
+		{
+			int32 count = WorkerCount;
+			if (count < 0)
+			{
+				count = (int32)std::thread::hardware_concurrency() - 1;
+				if (count < 0) count = 0;
+			}
+
+			for (int32 i = 0; i < count; i++)
+			{
+				Worker* w = new Worker();
+				w->Scheduler = this;
+				w->Index = i;
+				m_workers.Add(w);
+			}
+
+			for (Worker* w : m_workers)
+			{
+				w->Thread = new std::thread(&TaskScheduler::ThreadEntry, w);
+				SetThreadName(w->Thread, L"Task Worker " + StringUtils::IntToString(w->Index));
+			}
+		}
+
+		TaskScheduler::~TaskScheduler()
+		{
+			m_terminating = true;
+			{
+				std::lock_guard<std::mutex> lock(m_sleepLock);
+				m_workAvailable.notify_all();
+			}
+
+			for (Worker* w : m_workers)
+			{
+				if (w->Thread->joinable())
+					w->Thread->join();
+				delete w->Thread;
+			}
+
+			// run what is left here, so continuations and waiting handles are not left hanging
+			for (;;)
+			{
+				TaskState* task = TryGetTask(-1, true);
+				if (task == nullptr)
+					task = TryGetMainThreadTask();
+				if (task == nullptr)
+					break;
+
+				Execute(task);
+			}
+
+			m_workers.DeleteAndClear();
+		}
+
+		TaskHandle TaskScheduler::Submit(std::function<void()> work, TaskAffinity affinity)
+		{
+			return Submit(std::move(work), nullptr, 0, affinity);
+		}
+
+		TaskHandle TaskScheduler::Submit(std::function<void()> work, std::initializer_list<TaskHandle> dependencies, TaskAffinity affinity)
+		{
+			return Submit(std::move(work), dependencies.begin(), (int32)dependencies.size(), affinity);
+		}
+
+		TaskHandle TaskScheduler::Submit(std::function<void()> work, const TaskHandle* dependencies, int32 dependencyCount, TaskAffinity affinity)
+		{
+			TaskState* task = new TaskState(std::move(work), affinity);
+
+			for (int32 i = 0; i < dependencyCount; i++)
+			{
+				TaskState* dep = dependencies[i].m_task;
+				if (dep == nullptr)
+					continue;
+
+				std::lock_guard<std::mutex> lock(dep->Lock);
+				if (!dep->Done)
+				{
+					task->PendingCount++;
+					dep->Continuations.Add(task);
+				}
+			}
+
+			// the last dependency may have finished already
+			if (--task->PendingCount == 0)
+				Schedule(task);
+
+			return TaskHandle(task);
+		}
+
+		void TaskScheduler::Wait(const TaskHandle& handle)
+		{
+			TaskState* target = handle.m_task;
+			if (target == nullptr)
+				return;
+
+			WaitUntil([target]()->bool { return target->Done; });
+		}
+
+		void TaskScheduler::WaitAll(const TaskHandle* tasks, int32 count)
+		{
+			for (int32 i = 0; i < count; i++)
+				Wait(tasks[i]);
+		}
+
+		void TaskScheduler::ParallelFor(int32 start, int32 end, FunctorReference<void(int32, int32)> body, int32 grainSize)
+		{
+			const int32 count = end - start;
+			if (count <= 0)
+				return;
+
+			const int32 threadCount = m_workers.getCount() + 1;
+			if (grainSize <= 0)
+			{
+				// a few chunks for each thread, so the ones that finish early can take more
+				const int32 chunksWanted = threadCount * 4;
+				grainSize = (count + chunksWanted - 1) / chunksWanted;
+			}
+
+			const int32 chunkCount = (count + grainSize - 1) / grainSize;
+			if (chunkCount == 1 || threadCount == 1)
+			{
+				body(start, end);
+				return;
+			}
+
+			// the calling thread and the helper tasks take chunks from the same counter
+			std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>(body, start, end, grainSize, chunkCount);
+
+			const int32 helperCount = Math::Min(chunkCount - 1, m_workers.getCount());
+			for (int32 i = 0; i < helperCount; i++)
+				Submit([state]() { state->ProcessChunks(); });
+
+			state->ProcessChunks();
+
+			// only the chunks others have taken are waited for, not helpers that have not started
+			WaitUntil([&state]()->bool { return state->DoneChunks == state->ChunkCount; });
+		}
+
+		void TaskScheduler::RunJobs(int32 jobCount, FunctorReference<void(int32)> job, bool parallel)
+		{
+			if (parallel && jobCount > 1 && isInitialized())
+			{
+				getSingleton().ParallelFor(0, jobCount, [job](int32 first, int32 last)
+				{
+					for (int32 i = first; i < last; i++)
+						job(i);
+				}, 1);
+				return;
+			}
+
+			for (int32 i = 0; i < jobCount; i++)
+				job(i);
+		}
+
+		int32 TaskScheduler::RunMainThreadTasks()
+		{
+			assert(isMainThread());
+
+			int32 count;
+			{
+				std::lock_guard<std::mutex> lock(m_mainThreadLock);
+				count = m_mainThreadTasks.getCount();
+			}
+
+			// nothing else would run them
+			const bool runAny = m_workers.getCount() == 0;
+			if (runAny)
+				count += m_queuedCount - m_queuedBackgroundCount;
+
+			// the ones queued while running wait for the next call
+			int32 done = 0;
+			for (; done < count; done++)
+			{
+				TaskState* task = TryGetMainThreadTask();
+				if (task == nullptr && runAny)
+					task = TryGetTask(-1, false);
+				if (task == nullptr)
+					break;
+
+				Execute(task);
+			}
+			return done;
+		}
+
+		void TaskScheduler::ThreadEntry(Worker* worker)
+		{
+			CurrentWorkerIndex = worker->Index;
+			worker->Scheduler->WorkerMain(worker);
+		}
+
+		void TaskScheduler::WorkerMain(Worker* worker)
+		{
+			while (!m_terminating)
+			{
+				TaskState* task = TryGetTask(worker->Index, true);
+				if (task)
+				{
+					Execute(task);
+				}
+				else
+				{
+					std::unique_lock<std::mutex> lock(m_sleepLock);
+					m_workAvailable.wait(lock, [this]() { return m_queuedCount > 0 || m_terminating; });
+				}
+			}
+		}
+
+		void TaskScheduler::Schedule(TaskState* task)
+		{
+			if (task->Affinity == TaskAffinity::MainThread)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mainThreadLock);
+					m_mainThreadTasks.Enqueue(task);
+					m_mainThreadQueuedCount++;
+				}
+				WakeWaiters();
+				return;
+			}
+
+			const bool background = task->Affinity == TaskAffinity::Background;
+
+			int32 workerIndex = getCurrentWorkerIndex();
+			if (workerIndex != -1)
+			{
+				m_workers[workerIndex]->Push(task);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(m_sharedLock);
+				m_sharedTasks.Enqueue(task);
+			}
+
+			if (background)
+				m_queuedBackgroundCount++;
+			m_queuedCount++;
+
+			{
+				std::lock_guard<std::mutex> lock(m_sleepLock);
+				m_workAvailable.notify_one();
+			}
+
+			if (!background)
+				WakeWaiters();
+		}
+
+		void TaskScheduler::Execute(TaskState* task)
+		{
+			task->Work();
+			task->Work = nullptr;
+
+			List<TaskState*> continuations;
+			{
+				std::lock_guard<std::mutex> lock(task->Lock);
+				task->Done = true;
+				continuations = std::move(task->Continuations);
+			}
+
+			for (TaskState* next : continuations)
+			{
+				if (--next->PendingCount == 0)
+					Schedule(next);
+			}
+
+			WakeWaiters();
+
+			task->Release();
+		}
+
+		void TaskScheduler::WaitUntil(FunctorReference<bool()> isDone)
+		{
+			const int32 workerIndex = getCurrentWorkerIndex();
+			const bool onMainThread = isMainThread();
+
+			while (!isDone())
+			{
+				TaskState* task = nullptr;
+				if (workerIndex != -1)
+					task = TryGetTask(workerIndex, false);
+				if (task == nullptr && onMainThread)
+					task = TryGetMainThreadTask();
+
+				if (task)
+				{
+					Execute(task);
+					continue;
+				}
+
+				// counted before checking again under the lock, so a task done in the mean time wakes this thread
+				m_waitingCount++;
+				{
+					std::unique_lock<std::mutex> lock(m_sleepLock);
+					m_waitersWake.wait(lock, [&]() { return isDone() || HasWorkForWaiter(workerIndex, onMainThread); });
+				}
+				m_waitingCount--;
+			}
+		}
+
+		bool TaskScheduler::HasWorkForWaiter(int32 workerIndex, bool onMainThread) const
+		{
+			if (onMainThread && m_mainThreadQueuedCount > 0)
+				return true;
+			return workerIndex != -1 && m_queuedCount - m_queuedBackgroundCount > 0;
+		}
+
+		void TaskScheduler::WakeWaiters()
+		{
+			if (m_waitingCount > 0)
+			{
+				std::lock_guard<std::mutex> lock(m_sleepLock);
+				m_waitersWake.notify_all();
+			}
+		}
+
+		TaskState* TaskScheduler::TryGetTask(int32 workerIndex, bool allowBackground)
+		{
+			if (m_queuedCount - (allowBackground ? 0 : m_queuedBackgroundCount.load()) <= 0)
+				return nullptr;
+
+			TaskState* task = nullptr;
+
+			if (workerIndex != -1)
+				task = m_workers[workerIndex]->Pop(allowBackground);
+
+			if (task == nullptr)
+			{
+				std::lock_guard<std::mutex> lock(m_sharedLock);
+				for (int32 i = 0; i < m_sharedTasks.getCount(); i++)
+				{
+					if (allowBackground || m_sharedTasks[i]->Affinity != TaskAffinity::Background)
+					{
+						task = m_sharedTasks[i];
+						m_sharedTasks.RemoveAt(i);
+						break;
+					}
+				}
+			}
+
+			if (task == nullptr)
+			{
+				// steal the oldest task of another worker, starting from the next one
+				const int32 count = m_workers.getCount();
+				for (int32 i = 1; i <= count && task == nullptr; i++)
+				{
+					int32 victim = (workerIndex + i) % count;
+					if (victim != workerIndex)
+						task = m_workers[victim]->Steal(allowBackground);
+				}
+			}
+
+			if (task)
+			{
+				if (task->Affinity == TaskAffinity::Background)
+					m_queuedBackgroundCount--;
+				m_queuedCount--;
+			}
+			return task;
+		}
+
+		TaskState* TaskScheduler::TryGetMainThreadTask()
+		{
+			std::lock_guard<std::mutex> lock(m_mainThreadLock);
+			if (m_mainThreadTasks.getCount() == 0)
+				return nullptr;
+
+			m_mainThreadQueuedCount--;
+			return m_mainThreadTasks.Dequeue();
+		}
+
+		int32 TaskScheduler::getCurrentWorkerIndex() const { return CurrentWorkerIndex; }
+
+		/************************************************************************/
+		/*  TaskScheduler::Worker                                               */
+		/************************************************************************/
+
+		void TaskScheduler::Worker::Push(TaskState* task)
+		{
+			std::lock_guard<std::mutex> lock(DequeLock);
+			Deque.Add(task);
+		}
+
+		TaskState* TaskScheduler::Worker::Pop(bool allowBackground)
+		{
+			std::lock_guard<std::mutex> lock(DequeLock);
+
+			for (int32 i = Deque.getCount() - 1; i >= Head; i--)
+			{
+				TaskState* task = Deque[i];
+				if (allowBackground || task->Affinity != TaskAffinity::Background)
+				{
+					Deque.RemoveAt(i);
+
+					if (Deque.getCount() == Head)
+					{
+						Deque.Clear();
+						Head = 0;
+					}
+					return task;
+				}
+			}
+			return nullptr;
+		}
+
+		TaskState* TaskScheduler::Worker::Steal(bool allowBackground)
+		{
+			std::lock_guard<std::mutex> lock(DequeLock);
+
+			for (int32 i = Head; i < Deque.getCount(); i++)
+			{
+				TaskState* task = Deque[i];
+				if (allowBackground || task->Affinity != TaskAffinity::Background)
+				{
+					if (i == Head)
+						Head++;
+					else
+						Deque.RemoveAt(i);
+
+					if (Deque.getCount() == Head)
+					{
+						Deque.Clear();
+						Head = 0;
+					}
+					return task;
+				}
+			}
+			return nullptr;
+		}
+	}
+}
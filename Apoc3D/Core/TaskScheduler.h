@@ -0,0 +1,217 @@
+#pragma once
+#ifndef APOC3D_TASKSCHEDULER_H
+#define APOC3D_TASKSCHEDULER_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+#include "apoc3d/Collections/List.h"
+#include "apoc3d/Collections/Queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace Apoc3D::Collections;
+
+namespace Apoc3D
+{
+	namespace Core
+	{
+		struct TaskState;
+
+		/** Where a task is allowed to run */
+		enum struct TaskAffinity
+		{
+			/** Any worker thread, or a worker waiting on tasks */
+			Any,
+			/** Only the main thread, in TaskScheduler::RunMainThreadTasks or while it waits on tasks. For render work. */
+			MainThread,
+			/**
+			 *  Only idle worker threads, never a thread waiting on other tasks. For long running work like
+			 *  streaming, which would hold up whoever is waiting. Not run at all when there are no workers.
+			 */
+			Background
+		};
+
+		/** A reference to a task submitted to the TaskScheduler. An empty handle counts as done. */
+		class APAPI TaskHandle
+		{
+			friend class TaskScheduler;
+		public:
+			TaskHandle() { }
+			~TaskHandle();
+
+			TaskHandle(const TaskHandle& o);
+			TaskHandle(TaskHandle&& o);
+			TaskHandle& operator=(const TaskHandle& o);
+			TaskHandle& operator=(TaskHandle&& o);
+
+			bool isDone() const;
+			bool isValid() const { return m_task != nullptr; }
+
+		private:
+			/** Takes over a reference already counted. */
+			explicit TaskHandle(TaskState* task) : m_task(task) { }
+
+			TaskState* m_task = nullptr;
+		};
+
+		/**
+		 *  The engine-wide pool of worker threads that subsystems submit work to, instead of
+		 *  running threads of their own.
+		 *
+		 *  Each worker has its own deque of tasks. Tasks submitted from a worker go to the back of
+		 *  its deque and are taken from the back again, so related work stays on the same thread.
+		 *  Idle workers steal from the front of other deques, and sleep on a condition variable
+		 *  when there is no work at all. Tasks submitted from other threads go to a shared queue.
+		 *
+		 *  A task can depend on other tasks; it is only queued once they are all done. A worker
+		 *  waiting on a task runs other tasks in the mean time, so tasks can wait on the tasks they
+		 *  submit. Other threads only take part in their own ParallelFor, and sleep on a condition
+		 *  variable while there is nothing for them to run.
+		 *
+		 *  The thread that initializes the scheduler is the main thread. MainThread tasks
+		 *  are only run there, when it calls RunMainThreadTasks or waits. Without workers,
+		 *  RunMainThreadTasks runs the Any tasks as well.
+		 */
+		class APAPI TaskScheduler
+		{
+			SINGLETON_DECL(TaskScheduler);
+
+		public:
+			/**
+			 *  The number of worker threads besides the main thread. -1 to decide from the number of hardware threads.
+			 *  With 0, all tasks run on the main thread, in RunMainThreadTasks or while it waits.
+			 */
+			static int32 WorkerCount;
+
+			TaskScheduler();
+			~TaskScheduler();
+
+			TaskHandle Submit(std::function<void()> work, TaskAffinity affinity = TaskAffinity::Any);
+
+			/** Submits a task that is queued once all the given tasks are done. */
+			TaskHandle Submit(std::function<void()> work, const TaskHandle* dependencies, int32 dependencyCount, TaskAffinity affinity = TaskAffinity::Any);
+			TaskHandle Submit(std::function<void()> work, std::initializer_list<TaskHandle> dependencies, TaskAffinity affinity = TaskAffinity::Any);
+
+			/** Submits a task that runs after the given one. */
+			TaskHandle ContinueWith(const TaskHandle& task, std::function<void()> work, TaskAffinity affinity = TaskAffinity::Any)
+			{
+				return Submit(std::move(work), &task, 1, affinity);
+			}
+
+			/** Blocks until the task is done. Workers run other tasks meanwhile, and the main thread MainThread tasks. */
+			void Wait(const TaskHandle& task);
+			void WaitAll(const TaskHandle* tasks, int32 count);
+
+			/**
+			 *  Calls body(chunkStart, chunkEnd) over consecutive chunks covering [start, end), on the
+			 *  calling thread and the workers. Returns when all chunks are done.
+			 *  @param grainSize The number of indices in a chunk. 0 to make a few chunks for each thread.
+			 */
+			void ParallelFor(int32 start, int32 end, FunctorReference<void(int32, int32)> body, int32 grainSize = 0);
+
+			/**
+			 *  Calls job(i) for every i in [0, jobCount), taking jobs one at a time with ParallelFor.
+			 *  All jobs run on the calling thread when parallel is false, or when the scheduler is not
+			 *  initialized, as in tools and tests.
+			 *  @param parallel False for small batches, where waking the workers costs more than it saves.
+			 */
+			static void RunJobs(int32 jobCount, FunctorReference<void(int32)> job, bool parallel = true);
+
+			/**
+			 *  Runs the MainThread tasks queued so far. To be called by the main loop every frame.
+			 *  When there are no workers, runs the Any tasks queued so far too.
+			 *  @return The number of tasks run.
+			 */
+			int32 RunMainThreadTasks();
+
+			bool isMainThread() const { return std::this_thread::get_id() == m_mainThreadID; }
+
+			int32 getWorkerCount() const { return m_workers.getCount(); }
+			int32 getQueuedTaskCount() const { return m_queuedCount; }
+
+		private:
+			struct Worker
+			{
+				TaskScheduler* Scheduler = nullptr;
+				int32 Index = 0;
+				std::thread* Thread = nullptr;
+
+				std::mutex DequeLock;
+				/** Tasks from Head to the end are queued. The owner works at the back and thieves at the front. */
+				List<TaskState*> Deque;
+				int32 Head = 0;
+
+				void Push(TaskState* task);
+				TaskState* Pop(bool allowBackground);
+				TaskState* Steal(bool allowBackground);
+			};
+
+			static void ThreadEntry(Worker* worker);
+			void WorkerMain(Worker* worker);
+
+			/** Queues a task whose dependencies are done. */
+			void Schedule(TaskState* task);
+			void Execute(TaskState* task);
+
+			/**
+			 *  @param workerIndex The index of the calling worker, or -1 for other threads.
+			 *  @param allowBackground False for threads waiting on tasks.
+			 */
+			TaskState* TryGetTask(int32 workerIndex, bool allowBackground);
+			TaskState* TryGetMainThreadTask();
+			int32 getCurrentWorkerIndex() const;
+
+			/** Runs what the calling thread may run while waiting, and sleeps when there is nothing, until isDone returns true. */
+			void WaitUntil(FunctorReference<bool()> isDone);
+			/** Whether there is something for a waiting thread to run. */
+			bool HasWorkForWaiter(int32 workerIndex, bool onMainThread) const;
+			/** Wakes the waiting threads, after a task is done or queued. */
+			void WakeWaiters();
+
+			List<Worker*> m_workers;
+
+			std::mutex m_sharedLock;
+			Queue<TaskState*> m_sharedTasks;
+
+			std::mutex m_mainThreadLock;
+			Queue<TaskState*> m_mainThreadTasks;
+
+			std::mutex m_sleepLock;
+			std::condition_variable m_workAvailable;
+			/** For threads waiting on tasks. Notified when a task is done or queued, while m_waitingCount is not 0. */
+			std::condition_variable m_waitersWake;
+			std::atomic<int32> m_waitingCount;
+
+			/** Tasks in the deques and the shared queue */
+			std::atomic<int32> m_queuedCount;
+			/** The Background tasks among them */
+			std::atomic<int32> m_queuedBackgroundCount;
+			/** Tasks in m_mainThreadTasks */
+			std::atomic<int32> m_mainThreadQueuedCount;
+			std::atomic<bool> m_terminating;
+
+			std::thread::id m_mainThreadID;
+		};
+	}
+}
+
+#endif
@@ -24,6 +24,8 @@
 #include "Core/PluginManager.h"
 #include "Core/Logging.h"
 #include "Core/CommandInterpreter.h"
+#include "Core/Streaming/StreamingScheduler.h"
+#include "Core/TaskScheduler.h"
 #include "Config/ConfigurationManager.h"
 #include "Graphics/Animation/AnimationManager.h"
 #include "Graphics/EffectSystem/EffectManager.h"
@@ -39,6 +41,7 @@
 #include "Vfs/ResourceLocation.h"
 
 using namespace Apoc3D::Core;
+using namespace Apoc3D::Core::Streaming;
 using namespace Apoc3D::VFS;
 using namespace Apoc3D::Config;
 using namespace Apoc3D::Graphics;
@@ -56,10 +59,24 @@ namespace Apoc3D
 		setlocale(LC_CTYPE, ".ACP");
 		
 
+		// the log drain runs on the task scheduler
+		if (mconf)
+		{
+			TaskScheduler::WorkerCount = mconf->TaskWorkerCount;
+		}
+		TaskScheduler::Initialize();
+
 		LogManager::Initialize();
 		if (mconf)
 		{
 			LogManager::getSingleton().WriteLogToStd = mconf->WriteLogToStd;
+
+			if (mconf->AsyncLogging)
+			{
+				AsyncLogOptions options;
+				options.FilePath = mconf->LogFile;
+				LogManager::getSingleton().StartAsync(options);
+			}
 		}
 		CommandInterpreter::Initialize();
 
@@ -115,6 +132,8 @@ namespace Apoc3D
 
 			ModelManager::CacheSize = mconf->ModelCacheSize;
 			ModelManager::UseCache = mconf->ModelAsync;
+
+			StreamingScheduler::WorkerCount = mconf->StreamingWorkerCount;
 		}
 		
 		TextureManager::Initialize();
@@ -142,8 +161,11 @@ namespace Apoc3D
 		GraphicsAPIManager::Finalize();
 		ConfigurationManager::Finalize();
 		FileSystem::Finalize();
-		
+
 		CommandInterpreter::Finalize();
+
+		LogManager::getSingleton().StopAsync();
+		TaskScheduler::Finalize();
 		LogManager::Finalize();
 	}
 }
\ No newline at end of file
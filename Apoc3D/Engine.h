@@ -59,6 +59,16 @@ namespace Apoc3D
 		 */
 		bool WriteLogToStd;
 
+		/**
+		 *  Specified whether log messages are processed on the TaskScheduler's workers, so writing them 
+		 *  does not hold up the calling thread. See LogManager::StartAsync.
+		 */
+		bool AsyncLogging;
+		/**
+		 *  If not empty, log messages are also written to this file. Only used with AsyncLogging.
+		 */
+		String LogFile;
+
 		/** 
 		 *  Specified whether the TextureManager will be actuated to use async processing
 		 */
@@ -77,9 +87,21 @@ namespace Apoc3D
 		 */
 		uint ModelCacheSize;
 
+		/**
+		 *  The number of resource operations the async resource managers process at the same time, 
+		 *  on the TaskScheduler's workers. 0 to decide automatically from the number of workers.
+		 */
+		int32 StreamingWorkerCount;
+
+		/**
+		 *  The number of worker threads of the TaskScheduler, besides the main thread.
+		 *  -1 to decide automatically from the number of hardware threads.
+		 */
+		int32 TaskWorkerCount;
+
 		ManualStartConfig()
-			: TextureCacheSize(1024*1024*100), ModelCacheSize(1024*1024*50), WriteLogToStd(false),
-			TextureAsync(true), ModelAsync(true)
+			: TextureCacheSize(1024*1024*100), ModelCacheSize(1024*1024*50), WriteLogToStd(false), AsyncLogging(false),
+			TextureAsync(true), ModelAsync(true), StreamingWorkerCount(0), TaskWorkerCount(-1)
 		{
 
 		}
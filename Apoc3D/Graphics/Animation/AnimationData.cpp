@@ -43,6 +43,12 @@ namespace Apoc3D
 			constexpr TaggedDataKey TAG_3_RigidAnimationClipTag = "RigidAnimationClip";
 			constexpr TaggedDataKey TAG_3_RigidAnimationClipCountTag = "RigidAnimationClipCount";
 
+			constexpr TaggedDataKey TAG_3_2_CompressedSkinnedClipTag = "CompressedSkinnedClip3.2";
+			constexpr TaggedDataKey TAG_3_2_CompressedSkinnedClipCountTag = "CompressedSkinnedClip3.2Count";
+
+			constexpr TaggedDataKey TAG_3_2_CompressedRigidClipTag = "CompressedRigidClip3.2";
+			constexpr TaggedDataKey TAG_3_2_CompressedRigidClipCountTag = "CompressedRigidClip3.2Count";
+
 			constexpr TaggedDataKey TAG_3_MaterialAnimationTag = "MaterialAnimation3.0";
 			constexpr TaggedDataKey TAG_3_1_MaterialAnimationTag = "MaterialAnimation3.1";
 			constexpr TaggedDataKey TAG_3_MaterialAnimationCountTag = "MaterialAnimation3.0Count";
@@ -199,6 +205,61 @@ namespace Apoc3D
 					});
 				}
 
+				// compressed clips are stored separately, and join the same tables
+				if (data->Contains(TAG_3_2_CompressedSkinnedClipCountTag))
+				{
+					m_hasSkinnedClip = true;
+
+					int32 count = data->GetInt32(TAG_3_2_CompressedSkinnedClipCountTag);
+					data->ProcessData(TAG_3_2_CompressedSkinnedClipTag, [count, this](BinaryReader* br)
+					{
+						ReadCompressedClips(br, count, m_skinnedAnimationClips);
+					});
+				}
+				if (data->Contains(TAG_3_2_CompressedRigidClipCountTag))
+				{
+					m_hasRigidClip = true;
+
+					int32 count = data->GetInt32(TAG_3_2_CompressedRigidClipCountTag);
+					data->ProcessData(TAG_3_2_CompressedRigidClipTag, [count, this](BinaryReader* br)
+					{
+						ReadCompressedClips(br, count, m_rigidAnimationClips);
+					});
+				}
+			}
+
+			void AnimationData::ReadCompressedClips(BinaryReader* br, int32 count, ClipTable& table)
+			{
+				for (int32 i = 0; i < count; i++)
+				{
+					String key = br->ReadString();
+
+					CompressedAnimationClip* clip = new CompressedAnimationClip();
+					clip->Read(br);
+
+					table.Add(key, new ModelAnimationClip(clip));
+				}
+			}
+			void AnimationData::WriteCompressedClips(BinaryWriter* bw, const ClipTable& table)
+			{
+				for (auto& e : table)
+				{
+					if (const CompressedAnimationClip* clip = e.Value->getCompressed())
+					{
+						bw->WriteString(e.Key);
+						clip->Write(bw);
+					}
+				}
+			}
+			int32 AnimationData::GetCompressedClipCount(const ClipTable& table)
+			{
+				int32 count = 0;
+				for (auto& e : table)
+				{
+					if (e.Value->getCompressed())
+						count++;
+				}
+				return count;
 			}
 
 			void AnimationData::ReadMaterialAnimationClips(BinaryReader* br, int32 count, bool readsFrameFlag)
@@ -289,9 +350,19 @@ namespace Apoc3D
 					data->AddInt32(TAG_3_RootBoneTag, m_rootBone);
 				}
 
-				if (m_hasSkinnedClip)
+				int32 compressedSkinnedCount = GetCompressedClipCount(m_skinnedAnimationClips);
+				if (compressedSkinnedCount > 0)
+				{
+					data->AddInt32(TAG_3_2_CompressedSkinnedClipCountTag, compressedSkinnedCount);
+					data->AddEntry(TAG_3_2_CompressedSkinnedClipTag, [this](BinaryWriter* bw)
+					{
+						WriteCompressedClips(bw, m_skinnedAnimationClips);
+					});
+				}
+
+				if (m_hasSkinnedClip && compressedSkinnedCount < m_skinnedAnimationClips.getCount())
 				{
-					data->AddInt32(TAG_3_SkinnedAnimationClipCountTag, m_skinnedAnimationClips.getCount());
+					data->AddInt32(TAG_3_SkinnedAnimationClipCountTag, m_skinnedAnimationClips.getCount() - compressedSkinnedCount);
 
 					data->AddEntry(TAG_3_SkinnedAnimationClipTag, [this](BinaryWriter* bw)
 					{
@@ -300,6 +371,9 @@ namespace Apoc3D
 							const String& name = e.Key;
 							const ModelAnimationClip* clip = e.Value;
 
+							if (clip->getCompressed())
+								continue;
+
 							bw->WriteString(name);
 							bw->WriteDouble(static_cast<double>(clip->getDuration()));
 
@@ -318,9 +392,19 @@ namespace Apoc3D
 					});
 				}
 
-				if (m_hasRigidClip)
+				int32 compressedRigidCount = GetCompressedClipCount(m_rigidAnimationClips);
+				if (compressedRigidCount > 0)
 				{
-					data->AddInt32(TAG_3_RigidAnimationClipCountTag, m_rigidAnimationClips.getCount());
+					data->AddInt32(TAG_3_2_CompressedRigidClipCountTag, compressedRigidCount);
+					data->AddEntry(TAG_3_2_CompressedRigidClipTag, [this](BinaryWriter* bw)
+					{
+						WriteCompressedClips(bw, m_rigidAnimationClips);
+					});
+				}
+
+				if (m_hasRigidClip && compressedRigidCount < m_rigidAnimationClips.getCount())
+				{
+					data->AddInt32(TAG_3_RigidAnimationClipCountTag, m_rigidAnimationClips.getCount() - compressedRigidCount);
 
 					data->AddEntry(TAG_3_RigidAnimationClipTag, [this](BinaryWriter* bw)
 					{
@@ -329,6 +413,9 @@ namespace Apoc3D
 							const String& name = e.Key;
 							const ModelAnimationClip* clip = e.Value;
 
+							if (clip->getCompressed())
+								continue;
+
 							bw->WriteString(name);
 							bw->WriteDouble(static_cast<double>(clip->getDuration()));
 
@@ -95,6 +95,10 @@ namespace Apoc3D
 			private:
 				void ReadMaterialAnimationClips(BinaryReader* br, int32 count, bool readsFrameFlag);
 
+				static void ReadCompressedClips(BinaryReader* br, int32 count, ClipTable& table);
+				static void WriteCompressedClips(BinaryWriter* bw, const ClipTable& table);
+				static int32 GetCompressedClipCount(const ClipTable& table);
+
 				ClipTable m_rigidAnimationClips;
 				ClipTable m_skinnedAnimationClips;
 				MtrlClipTable m_mtrlAnimationClips;
@@ -15,6 +15,7 @@
  */
 
 #include "AnimationPlayers.h"
+#include "SkinningBatch.h"
 #include "apoc3d/Core/AppTime.h"
 
 using namespace Apoc3D::Collections;
@@ -38,6 +39,19 @@ namespace Apoc3D
 
 				m_currentTimeValue = time;
 
+				if (const CompressedAnimationClip* compressed = m_currentClipValue->getCompressed())
+				{
+					// compressed clips are interpolated rather than stepped through key by key
+					const List<CompressedAnimationClip::Track>& tracks = compressed->getTracks();
+					for (int32 i = 0; i < tracks.getCount(); i++)
+					{
+						Matrix transform;
+						compressed->Sample(i, time, transform, &m_keyHints[i]);
+						SetSampledTransform(tracks[i].ObjectIndex, transform);
+					}
+					return;
+				}
+
 				const List<ModelKeyframe>& keyframes = m_currentClipValue->getKeyframes();
 
 				while (m_currentKeyframe < keyframes.getCount())
@@ -101,7 +115,11 @@ namespace Apoc3D
 				const ModelAnimationClip* clip = getCurrentClip();
 				const List<ModelKeyframe>& keyframes = clip->getKeyframes();
 
-				m_currentTransfrom = keyframes.getCount() > 0 ? keyframes[0].getTransform() : Matrix::Identity;
+				const CompressedAnimationClip* compressed = clip->getCompressed();
+				if (compressed && compressed->getTracks().getCount() > 0)
+					compressed->Sample(0, 0, m_currentTransfrom);
+				else
+					m_currentTransfrom = keyframes.getCount() > 0 ? keyframes[0].getTransform() : Matrix::Identity;
 			}
 			void RootAnimationPlayer::SetKeyframe(const ModelKeyframe& keyframe)
 			{
@@ -116,11 +134,12 @@ namespace Apoc3D
 			{
 				if (newClip)
 				{
+					const ModelAnimationClip* clip = getCurrentClip();
+
 					for (int i=0;i<m_meshTransformCount;i++)
 					{
 						m_initialTransforms[i].LoadIdentity();
 
-						const ModelAnimationClip* clip = getCurrentClip();
 						for (int j=0;j<clip->getKeyframes().getCount();j++)
 						{
 							if (clip->getKeyframes()[j].getObjectIndex() == i)
@@ -130,6 +149,16 @@ namespace Apoc3D
 							}
 						}
 					}
+
+					if (const CompressedAnimationClip* compressed = clip->getCompressed())
+					{
+						const List<CompressedAnimationClip::Track>& tracks = compressed->getTracks();
+						for (int32 i = 0; i < tracks.getCount(); i++)
+						{
+							if (tracks[i].ObjectIndex < m_meshTransformCount)
+								compressed->Sample(i, 0, m_initialTransforms[tracks[i].ObjectIndex]);
+						}
+					}
 				}
 				else
 				{
@@ -142,6 +171,16 @@ namespace Apoc3D
 			/************************************************************************/
 
 
+			SkinnedAnimationPlayer::~SkinnedAnimationPlayer()
+			{
+				if (m_batch)
+					m_batch->Remove(this);
+
+				delete[] m_boneTransforms;
+				delete[] m_worldTransforms;
+				delete[] m_skinTransforms;
+			}
+
 			void SkinnedAnimationPlayer::InitClip(bool newClip /* = false */)
 			{
 				if (newClip)
@@ -162,6 +201,13 @@ namespace Apoc3D
 			{
 				if (getCurrentClip())
 				{
+					if (m_batch)
+					{
+						// evaluated later with the other players in the batch
+						m_paletteDirty = true;
+						return;
+					}
+
 					//// Root bone.
 					//m_worldTransforms[0] = m_boneTransforms[0];
 
@@ -57,6 +57,9 @@ namespace Apoc3D
 					m_playbackRate = playbackRate;
 					m_duration = duration;
 
+					const CompressedAnimationClip* compressed = clip->getCompressed();
+					m_keyHints.ReserveDiscard(compressed ? compressed->getTracks().getCount() : 0);
+
 					InitClip(true);
 				}
 
@@ -82,12 +85,15 @@ namespace Apoc3D
 				
 				int getCurrentKeyframe() const { return m_currentKeyframe; }						/** Gets the current key frame index */
 
-				/** Sets the current key frame index */
+				/** Sets the current key frame index. Not applicable to compressed clips. */
 				void setCurrentKeyframe(int value)
 				{
 					const List<ModelKeyframe>& keyframes = m_currentClipValue->getKeyframes();
-					float time = keyframes[value].getTime();
-					setCurrentTimeValue( time );
+					if (value < keyframes.getCount())
+					{
+						float time = keyframes[value].getTime();
+						setCurrentTimeValue(time);
+					}
 				}
 
 				float getCurrentTimeValue() const { return m_currentTimeValue; }		/** Gets the current play position. */
@@ -104,6 +110,15 @@ namespace Apoc3D
 				/** Virtual method allowing subclasses to set any data associated with a particular keyframe. */
 				virtual void SetKeyframe(const ModelKeyframe& keyframe) { }
 
+				/** 
+				 *  Called with the interpolated transforms when playing a compressed clip.
+				 *  By default this is passed to SetKeyframe as a keyframe at the current time.
+				 */
+				virtual void SetSampledTransform(int32 objectIndex, const Matrix& transform)
+				{
+					SetKeyframe(ModelKeyframe(objectIndex, m_currentTimeValue, transform));
+				}
+
 				/**
 				 *  Virtual method allowing subclasses to perform data needed after the animation 
 				 *  has been updated for a new time index.
@@ -123,6 +138,8 @@ namespace Apoc3D
 				float m_elapsedPlaybackTime = 0;							/** Amount of time elapsed while playing */
 
 				bool m_paused = false;										/** Whether or not playback is paused */
+
+				List<int32> m_keyHints;										/** The last used key of each compressed track */
 				
 			};
 
@@ -246,9 +263,13 @@ namespace Apoc3D
 				}
 			};
 
-			/** The animation player manipulates a skinned model */
+			/** 
+			 *  The animation player manipulates a skinned model.
+			 *  When added to a SkinningBatch, the bone hierarchy is evaluated by the batch instead of in Update.
+			 */
 			class APAPI SkinnedAnimationPlayer : public ModelAnimationPlayerBase
 			{
+				friend class SkinningBatch;
 			public:
 				SkinnedAnimationPlayer(const List<Bone>* bones, bool useQuaternionSlerp = false)
 					: m_bones(bones), m_useQuaternionInterpolation(useQuaternionSlerp)
@@ -262,19 +283,16 @@ namespace Apoc3D
 					m_skinTransforms = new Matrix[bones->getCount()];
 					memset(m_worldTransforms, 0, sizeof(Matrix) * bones->getCount());
 				}
-				~SkinnedAnimationPlayer()
-				{
-					delete[] m_boneTransforms;
-					delete[] m_worldTransforms;
-					delete[] m_skinTransforms;
-				}
+				~SkinnedAnimationPlayer();
 
 				int32 getTransformCount() const { return m_bones->getCount(); }
 
 				
 				const Matrix* GetBoneTransform() const { return m_boneTransforms; }		/** Gets the current bone transform matrices, relative to their parent bones. */
 				const Matrix* GetWorldTransform() const { return m_worldTransforms; }	/** Gets the current bone transform matrices, in absolute format. */
-				const Matrix* GetSkinTransforms() const { return m_skinTransforms; }	/** Gets the current bone transform matrices, relative to the skinning bind pose. */
+				const Matrix* GetSkinTransforms() const { return m_palette ? m_palette : m_skinTransforms; }	/** Gets the current bone transform matrices, relative to the skinning bind pose. */
+
+				SkinningBatch* getSkinningBatch() const { return m_batch; }
 
 				virtual void GetTransform(int boneID, Matrix& result)
 				{
@@ -297,6 +315,10 @@ namespace Apoc3D
 				Matrix* m_worldTransforms;
 				Matrix* m_skinTransforms;
 
+				SkinningBatch* m_batch = nullptr;
+				Matrix* m_palette = nullptr;		/** The player's part of the batch's palette buffer */
+				bool m_paletteDirty = false;		/** Whether the batch needs to evaluate the palette */
+
 				bool m_useQuaternionInterpolation;
 				const List<Bone>* m_bones;
 				//const List<Matrix>* m_inverseBindPose;
@@ -1,13 +1,214 @@
 #include "AnimationTypes.h"
 
+#include "apoc3d/IOLib/BinaryReader.h"
+#include "apoc3d/IOLib/BinaryWriter.h"
+
 namespace Apoc3D
 {
 	namespace Graphics
 	{
 		namespace Animation
 		{
+			// the 3 smallest components of a unit quaternion are within +-1/sqrt(2); 15 bits are used for each
+			const float RotationRange = 0.70710678f;
+			const float RotationSteps = 32767.0f;
+
+			void CompressedAnimationClip::EncodeRotation(const Quaternion& q, uint16 (&result)[3])
+			{
+				float c[4] = { q.X, q.Y, q.Z, q.W };
+
+				int32 largest = 0;
+				for (int32 i = 1; i < 4; i++)
+				{
+					if (fabs(c[i]) > fabs(c[largest]))
+						largest = i;
+				}
+
+				// q and -q are the same rotation; make the dropped component positive
+				float sign = c[largest] < 0 ? -1.0f : 1.0f;
+
+				int32 j = 0;
+				for (int32 i = 0; i < 4; i++)
+				{
+					if (i != largest)
+					{
+						float v = Math::Clamp(c[i] * sign / RotationRange, -1.0f, 1.0f);
+						result[j++] = static_cast<uint16>(Math::Round((v * 0.5f + 0.5f) * RotationSteps));
+					}
+				}
+
+				result[0] |= static_cast<uint16>((largest >> 1) << 15);
+				result[1] |= static_cast<uint16>((largest & 1) << 15);
+			}
+			void CompressedAnimationClip::DecodeRotation(const uint16 (&data)[3], Quaternion& result)
+			{
+				int32 largest = ((data[0] >> 15) << 1) | (data[1] >> 15);
+
+				float c[4];
+				float sumSq = 0;
+
+				int32 j = 0;
+				for (int32 i = 0; i < 4; i++)
+				{
+					if (i != largest)
+					{
+						float v = (data[j++] & 0x7fff) / RotationSteps;
+						c[i] = (v * 2.0f - 1.0f) * RotationRange;
+						sumSq += c[i] * c[i];
+					}
+				}
+				c[largest] = sqrtf(Math::Max(0.0f, 1.0f - sumSq));
+
+				result = Quaternion(c[0], c[1], c[2], c[3]);
+			}
+
+			int32 CompressedAnimationClip::FindKey(const Track& track, float t, int32 hint) const
+			{
+				const Key* keys = m_keys.getElements() + track.FirstKey;
+				const int32 last = track.KeyCount - 1;
+
+				// playback usually stays on the same key or moves to the next
+				if (hint >= 0 && hint < last && keys[hint].Time <= t)
+				{
+					if (t < keys[hint + 1].Time)
+						return hint;
+					if (hint + 1 == last || t < keys[hint + 2].Time)
+						return hint + 1;
+				}
+
+				int32 lo = 0;
+				int32 hi = last;
+				while (lo < hi)
+				{
+					int32 mid = (lo + hi + 1) / 2;
+					if (keys[mid].Time <= t)
+						lo = mid;
+					else
+						hi = mid - 1;
+				}
+				return lo;
+			}
+
+			void CompressedAnimationClip::Sample(int32 trackIndex, float time, Quaternion& rotation, Vector3& translation, Vector3& scale, int32* keyHint) const
+			{
+				const Track& track = m_tracks[trackIndex];
+				const Key* keys = m_keys.getElements() + track.FirstKey;
+
+				float t = m_duration > 0 ? Math::Clamp(time / m_duration, 0.0f, 1.0f) * TimeSteps : 0;
+
+				int32 k = FindKey(track, t, keyHint ? *keyHint : -1);
+				if (keyHint)
+					*keyHint = k;
+
+				const Key& a = keys[k];
+				const Key& b = k + 1 < track.KeyCount ? keys[k + 1] : a;
+
+				float amount = 0;
+				if (b.Time > a.Time)
+					amount = Math::Clamp((t - a.Time) / (b.Time - a.Time), 0.0f, 1.0f);
+
+				Quaternion ra;
+				DecodeRotation(a.Rotation, ra);
+				if (&a != &b)
+				{
+					Quaternion rb;
+					DecodeRotation(b.Rotation, rb);
+					Quaternion::Lerp(rotation, ra, rb, amount);
+				}
+				else
+				{
+					rotation = ra;
+				}
+
+				float invAmount = 1.0f - amount;
+				translation = track.TranslationMin + Vector3(
+					a.Translation[0] * invAmount + b.Translation[0] * amount,
+					a.Translation[1] * invAmount + b.Translation[1] * amount,
+					a.Translation[2] * invAmount + b.Translation[2] * amount) * track.TranslationStep;
+
+				scale = track.ScaleMin + Vector3(
+					a.Scale[0] * invAmount + b.Scale[0] * amount,
+					a.Scale[1] * invAmount + b.Scale[1] * amount,
+					a.Scale[2] * invAmount + b.Scale[2] * amount) * track.ScaleStep;
+			}
+			void CompressedAnimationClip::Sample(int32 trackIndex, float time, Matrix& result, int32* keyHint) const
+			{
+				Quaternion rotation;
+				Vector3 translation;
+				Vector3 scale;
+				Sample(trackIndex, time, rotation, translation, scale, keyHint);
+
+				// scale * rotation * translation, written out directly
+				Matrix::CreateRotationQuaternion(result, rotation);
+				result.M11 *= scale.X; result.M12 *= scale.X; result.M13 *= scale.X;
+				result.M21 *= scale.Y; result.M22 *= scale.Y; result.M23 *= scale.Y;
+				result.M31 *= scale.Z; result.M32 *= scale.Z; result.M33 *= scale.Z;
+				result.M41 = translation.X;
+				result.M42 = translation.Y;
+				result.M43 = translation.Z;
+			}
+
+			void CompressedAnimationClip::Read(BinaryReader* br)
+			{
+				m_duration = br->ReadSingle();
+
+				int32 trackCount = br->ReadInt32();
+				m_tracks.ReserveDiscard(trackCount);
+				for (Track& t : m_tracks)
+				{
+					t.ObjectIndex = br->ReadInt32();
+					t.FirstKey = br->ReadInt32();
+					t.KeyCount = br->ReadInt32();
+					br->ReadVector3(t.TranslationMin);
+					br->ReadVector3(t.TranslationStep);
+					br->ReadVector3(t.ScaleMin);
+					br->ReadVector3(t.ScaleStep);
+				}
+
+				int32 keyCount = br->ReadInt32();
+				m_keys.ReserveDiscard(keyCount);
+				for (Key& k : m_keys)
+				{
+					k.Time = br->ReadUInt16();
+					for (uint16& v : k.Rotation) v = br->ReadUInt16();
+					for (uint16& v : k.Translation) v = br->ReadUInt16();
+					for (uint16& v : k.Scale) v = br->ReadUInt16();
+				}
+			}
+			void CompressedAnimationClip::Write(BinaryWriter* bw) const
+			{
+				bw->WriteSingle(m_duration);
+
+				bw->WriteInt32(m_tracks.getCount());
+				for (const Track& t : m_tracks)
+				{
+					bw->WriteInt32(t.ObjectIndex);
+					bw->WriteInt32(t.FirstKey);
+					bw->WriteInt32(t.KeyCount);
+					bw->WriteVector3(t.TranslationMin);
+					bw->WriteVector3(t.TranslationStep);
+					bw->WriteVector3(t.ScaleMin);
+					bw->WriteVector3(t.ScaleStep);
+				}
+
+				bw->WriteInt32(m_keys.getCount());
+				for (const Key& k : m_keys)
+				{
+					bw->WriteUInt16(k.Time);
+					for (uint16 v : k.Rotation) bw->WriteUInt16(v);
+					for (uint16 v : k.Translation) bw->WriteUInt16(v);
+					for (uint16 v : k.Scale) bw->WriteUInt16(v);
+				}
+			}
+
+			/************************************************************************/
+			/*  ModelAnimationClip                                                  */
+			/************************************************************************/
+
 			void ModelAnimationClip::Transform(const Matrix& t)
 			{
+				assert(m_compressed == nullptr);
+
 				for (int i=0;i<m_keyFrames.getCount();i++)
 				{
 					const ModelKeyframe& f = m_keyFrames[i];
@@ -19,10 +19,12 @@
  */
 
 #include "apoc3d/Math/Matrix.h"
+#include "apoc3d/Math/Quaternion.h"
 #include "apoc3d/Collections/List.h"
 
 using namespace Apoc3D::Collections;
 using namespace Apoc3D::Math;
+using namespace Apoc3D::IO;
 
 namespace Apoc3D
 {
@@ -180,8 +182,78 @@ namespace Apoc3D
 				uint32 m_flags;
 			};
 
+			/**
+			 *  A compact form of model animation clip.
+			 *
+			 *  Keys are grouped into one track per animated object. Each key stores a rotation, translation 
+			 *  and scale quantized to 16 bits per component, 20 bytes in total. Keys do not need to be evenly
+			 *  spaced, so the build engine can drop the ones that can be interpolated from their neighbors.
+			 *  The transform at any time is interpolated from the 2 keys around it.
+			 */
+			class APAPI CompressedAnimationClip
+			{
+			public:
+				static const int32 TimeSteps = 65535;
+
+				struct Track
+				{
+					int32 ObjectIndex;
+					int32 FirstKey;
+					int32 KeyCount;
+
+					/** Dequantized translation = TranslationMin + q * TranslationStep. Same for scale. */
+					Vector3 TranslationMin;
+					Vector3 TranslationStep;
+					Vector3 ScaleMin;
+					Vector3 ScaleStep;
+				};
+
+				struct Key
+				{
+					/** The time of the key, in units of duration/TimeSteps */
+					uint16 Time;
+					/** The 3 smallest components of the rotation. The index of the largest one is kept in the top bits. */
+					uint16 Rotation[3];
+					uint16 Translation[3];
+					uint16 Scale[3];
+				};
+
+				CompressedAnimationClip(float duration, const List<Track>& tracks, const List<Key>& keys)
+					: m_duration(duration), m_tracks(tracks), m_keys(keys) { }
+				CompressedAnimationClip() { }
+				~CompressedAnimationClip() { }
+
+				/**
+				 *  Interpolates the transform of a track at the given time.
+				 *  @param keyHint Optional. The key found last time for this track, which is reused when the
+				 *                 time moves forward gradually. Updated to the key used this time.
+				 */
+				void Sample(int32 trackIndex, float time, Matrix& result, int32* keyHint = nullptr) const;
+				void Sample(int32 trackIndex, float time, Quaternion& rotation, Vector3& translation, Vector3& scale, int32* keyHint = nullptr) const;
+
+				float getDuration() const { return m_duration; }
+				const List<Track>& getTracks() const { return m_tracks; }
+				const List<Key>& getKeys() const { return m_keys; }
+
+				void Read(BinaryReader* br);
+				void Write(BinaryWriter* bw) const;
+
+				static void EncodeRotation(const Quaternion& q, uint16 (&result)[3]);
+				static void DecodeRotation(const uint16 (&data)[3], Quaternion& result);
+
+			private:
+				int32 FindKey(const Track& track, float t, int32 hint) const;
+
+				float m_duration = 0;
+				List<Track> m_tracks;
+				List<Key> m_keys;
+			};
+
 			/**
 			 *  A model animation clip holds all the keyframes needed to describe a single model animation.
+			 *
+			 *  The keyframes can be replaced with a CompressedAnimationClip, in which case getKeyframes is empty 
+			 *  and the players sample the compressed clip instead.
 			 */
 			class APAPI ModelAnimationClip
 			{
@@ -191,8 +263,19 @@ namespace Apoc3D
 				{
 
 				}
-				~ModelAnimationClip() { }
 
+				/** Creates a clip from compressed data. The clip takes the ownership of it. */
+				ModelAnimationClip(CompressedAnimationClip* compressed)
+					: m_duration(compressed->getDuration()), m_compressed(compressed)
+				{
+
+				}
+				~ModelAnimationClip() { DELETE_AND_NULL(m_compressed); }
+
+				ModelAnimationClip(const ModelAnimationClip&) = delete;
+				ModelAnimationClip& operator=(const ModelAnimationClip&) = delete;
+
+				/** Applies a transform to all the keyframes. Compressed clips should be transformed before compressing. */
 				void Transform(const Matrix& t);
 				
 				/**
@@ -205,9 +288,13 @@ namespace Apoc3D
 				 */
 				const List<ModelKeyframe>& getKeyframes() const { return m_keyFrames; }
 
+				/** Gets the compressed data of the clip, or null if the clip uses regular keyframes. */
+				const CompressedAnimationClip* getCompressed() const { return m_compressed; }
+
 			private:
 				float m_duration;
 				List<ModelKeyframe> m_keyFrames;
+				CompressedAnimationClip* m_compressed = nullptr;
 
 			};
 
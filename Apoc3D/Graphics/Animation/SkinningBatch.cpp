@@ -0,0 +1,259 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "SkinningBatch.h"
+
+#include "AnimationPlayers.h"
+#include "AnimationTypes.h"
+#include "apoc3d/Core/TaskScheduler.h"
+#include "apoc3d/Graphics/Model.h"
+#include "apoc3d/Math/MathBatch.h"
+
+#include <algorithm>
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		namespace Animation
+		{
+			/** The most instances in a job. Keeps a job's bone major scratch data small. */
+			const int32 InstancesPerJob = 16;
+			/** Below this number of bones in total, all jobs run on the calling thread. */
+			const int32 ParallelThreshold = 1024;
+
+			SkinningBatch::SkinningBatch()
+			{
+			}
+
+			SkinningBatch::~SkinningBatch()
+			{
+				for (Model* mdl : m_models)
+					mdl->m_skinningBatch = nullptr;
+				m_models.Clear();
+
+				for (const Entry& e : m_entries)
+					Detach(e);
+				m_entries.Clear();
+
+				m_skeletons.DeleteAndClear();
+			}
+
+			void SkinningBatch::Add(SkinnedAnimationPlayer* player)
+			{
+				assert(player->m_batch == nullptr);
+
+				Entry e;
+				e.Player = player;
+				e.Skel = FindSkeleton(player->m_bones);
+				e.Skel->PlayerCount++;
+				m_entries.Add(e);
+
+				player->m_batch = this;
+				m_layoutDirty = true;
+			}
+
+			void SkinningBatch::Remove(SkinnedAnimationPlayer* player)
+			{
+				assert(player->m_batch == this);
+
+				int32 idx = -1;
+				for (int32 i = 0; i < m_entries.getCount(); i++)
+				{
+					if (m_entries[i].Player == player)
+					{
+						idx = i;
+						break;
+					}
+				}
+				assert(idx != -1);
+
+				Skeleton* skel = m_entries[idx].Skel;
+				Detach(m_entries[idx]);
+				m_entries.RemoveAtSwapping(idx);
+
+				if (--skel->PlayerCount == 0)
+				{
+					m_skeletons.Remove(skel);
+					delete skel;
+				}
+
+				// the other players keep using the old buffer until then
+				m_layoutDirty = true;
+			}
+
+			void SkinningBatch::Detach(const Entry& e)
+			{
+				// the player goes back to its own palette. One added since the last layout has no other
+				SkinnedAnimationPlayer* p = e.Player;
+				if (p->m_palette)
+					memcpy(p->m_skinTransforms, p->m_palette, sizeof(Matrix) * e.Skel->Parents.getCount());
+				p->m_palette = nullptr;
+				p->m_paletteDirty = false;
+				p->m_batch = nullptr;
+			}
+
+			SkinningBatch::Skeleton* SkinningBatch::FindSkeleton(const List<Bone>* bones)
+			{
+				for (Skeleton* s : m_skeletons)
+				{
+					if (s->Bones == bones)
+						return s;
+				}
+
+				Skeleton* skel = new Skeleton();
+				skel->Bones = bones;
+				skel->PlayerCount = 0;
+
+				for (int32 i = 0; i < bones->getCount(); i++)
+				{
+					const Bone& b = bones->operator[](i);
+
+					// parents are evaluated first, same as SkinnedAnimationPlayer::OnUpdate
+					assert(b.Parent < i);
+					skel->Parents.Add(b.Parent);
+
+					Matrix offset;
+					Matrix::Multiply(offset, b.getBoneReferenceTransform(), b.getInvBindPoseTransform());
+					skel->Offsets.Add(offset);
+				}
+
+				m_skeletons.Add(skel);
+				return skel;
+			}
+
+			void SkinningBatch::Relayout()
+			{
+				int32 total = 0;
+				for (const Entry& e : m_entries)
+					total += e.Skel->Parents.getCount();
+
+				List<Matrix> palettes(total);
+				palettes.Reserve(total);
+
+				int32 offset = 0;
+				for (const Entry& e : m_entries)
+				{
+					const SkinnedAnimationPlayer* p = e.Player;
+					const int32 boneCount = e.Skel->Parents.getCount();
+
+					memcpy(palettes.getElements() + offset, p->GetSkinTransforms(), sizeof(Matrix) * boneCount);
+					offset += boneCount;
+				}
+
+				m_palettes = std::move(palettes);
+
+				offset = 0;
+				for (const Entry& e : m_entries)
+				{
+					e.Player->m_palette = m_palettes.getElements() + offset;
+					offset += e.Skel->Parents.getCount();
+				}
+
+				m_layoutDirty = false;
+			}
+
+			void SkinningBatch::Evaluate()
+			{
+				if (m_layoutDirty)
+					Relayout();
+
+				m_pending.Clear();
+				for (const Entry& e : m_entries)
+				{
+					if (e.Player->m_paletteDirty)
+						m_pending.Add(e);
+				}
+
+				if (m_pending.getCount() == 0)
+					return;
+
+				std::stable_sort(m_pending.begin(), m_pending.end(), [](const Entry& a, const Entry& b) { return a.Skel < b.Skel; });
+
+				m_jobs.Clear();
+				int32 scratchSize = 0;
+				for (int32 i = 0; i < m_pending.getCount(); )
+				{
+					Job job;
+					job.Skel = m_pending[i].Skel;
+					job.First = i;
+					job.Count = 0;
+					job.ScratchOffset = scratchSize;
+
+					while (i < m_pending.getCount() && m_pending[i].Skel == job.Skel && job.Count < InstancesPerJob)
+					{
+						job.Count++;
+						i++;
+					}
+
+					scratchSize += job.Count * job.Skel->Parents.getCount();
+					m_jobs.Add(job);
+				}
+
+				m_locals.Reserve(scratchSize);
+				m_worlds.Reserve(scratchSize);
+
+				TaskScheduler::RunJobs(m_jobs.getCount(), FunctorReference<void(int32)>(this, &SkinningBatch::EvaluateJob), scratchSize >= ParallelThreshold);
+			}
+
+			void SkinningBatch::EvaluateJob(int32 index)
+			{
+				const Job& job = m_jobs[index];
+				const Skeleton* skel = job.Skel;
+				const Entry* entries = m_pending.getElements() + job.First;
+				const int32 n = job.Count;
+				const int32 boneCount = skel->Parents.getCount();
+
+				// bone major: the transform of bone b for instance i is at [b * n + i]
+				Matrix* locals = m_locals.getElements() + job.ScratchOffset;
+				Matrix* worlds = m_worlds.getElements() + job.ScratchOffset;
+
+				for (int32 i = 0; i < n; i++)
+				{
+					const Matrix* src = entries[i].Player->m_boneTransforms;
+					for (int32 b = 0; b < boneCount; b++)
+						locals[b * n + i] = src[b];
+				}
+
+				for (int32 b = 0; b < boneCount; b++)
+				{
+					Matrix* boneLocals = locals + b * n;
+					Matrix* boneWorlds = worlds + b * n;
+
+					int32 parent = skel->Parents[b];
+					if (parent < 0)
+						memcpy(boneWorlds, boneLocals, sizeof(Matrix) * n);
+					else
+						MultiplyMatrices(boneWorlds, boneLocals, worlds + parent * n, n);
+
+					// the local transforms are no longer needed, the skin transforms take their place
+					MultiplyMatrices(boneLocals, skel->Offsets[b], boneWorlds, n);
+				}
+
+				for (int32 i = 0; i < n; i++)
+				{
+					SkinnedAnimationPlayer* p = entries[i].Player;
+					for (int32 b = 0; b < boneCount; b++)
+					{
+						p->m_palette[b] = locals[b * n + i];
+						p->m_worldTransforms[b] = worlds[b * n + i];
+					}
+					p->m_paletteDirty = false;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef APOC3D_SKINNINGBATCH_H
+#define APOC3D_SKINNINGBATCH_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+#include "apoc3d/Collections/List.h"
+#include "apoc3d/Math/Matrix.h"
+
+using namespace Apoc3D::Collections;
+using namespace Apoc3D::Core;
+using namespace Apoc3D::Math;
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		namespace Animation
+		{
+			class Bone;
+
+			/**
+			 *  Computes the skinning palettes of many SkinnedAnimationPlayers together.
+			 *
+			 *  Once added, a player only samples its clip in Update and leaves the bone hierarchy to
+			 *  the batch. Evaluate then processes every player updated since the last call: players
+			 *  sharing a skeleton are grouped, and each group is evaluated bone by bone across all its
+			 *  instances, so the matrix products run on contiguous arrays with the batched math functions.
+			 *  Groups are spread over the TaskScheduler's threads.
+			 *
+			 *  The palettes of all players live in one buffer. GetSkinTransforms of an added player points
+			 *  into it, so render operations can use the palettes directly. Adding and removing players
+			 *  only marks the buffer to be laid out again in the next Evaluate, which is when the pointers
+			 *  change. Until then, a newly added player uses its own palette.
+			 */
+			class APAPI SkinningBatch
+			{
+			public:
+				SkinningBatch();
+				~SkinningBatch();
+
+				SkinningBatch(const SkinningBatch&) = delete;
+				SkinningBatch& operator=(const SkinningBatch&) = delete;
+
+				void Add(SkinnedAnimationPlayer* player);
+				void Remove(SkinnedAnimationPlayer* player);
+
+				/** 
+				 *  Computes the palettes of the players updated since the last call. 
+				 *  Call this after updating the models and before drawing them.
+				 */
+				void Evaluate();
+
+				/** Gets the buffer holding the palettes of all added players, as of the last Evaluate */
+				const Matrix* getPalettes() const { return m_palettes.getElements(); }
+				int32 getPaletteMatrixCount() const { return m_palettes.getCount(); }
+
+				int32 getPlayerCount() const { return m_entries.getCount(); }
+
+			private:
+				/** Per skeleton data shared by all players using it */
+				struct Skeleton
+				{
+					const List<Bone>* Bones;
+					List<int32> Parents;
+					/** Bone reference transform * inverse bind pose. Constant, so computed once here. */
+					List<Matrix> Offsets;
+					int32 PlayerCount;
+				};
+
+				struct Entry
+				{
+					SkinnedAnimationPlayer* Player;
+					Skeleton* Skel;
+				};
+
+				/** Players of the same skeleton evaluated together by one thread */
+				struct Job
+				{
+					Skeleton* Skel;
+					/** The range in m_pending */
+					int32 First;
+					int32 Count;
+					/** Where the job's bone major matrices go in m_locals and m_worlds */
+					int32 ScratchOffset;
+				};
+
+				friend class Apoc3D::Graphics::Model;
+
+				/** Called by Model::setSkinningBatch, so models do not keep pointing to a deleted batch. */
+				void RegisterModel(Model* mdl) { m_models.Add(mdl); }
+				void UnregisterModel(Model* mdl) { m_models.Remove(mdl); }
+
+				void Detach(const Entry& e);
+				Skeleton* FindSkeleton(const List<Bone>* bones);
+				void Relayout();
+				void EvaluateJob(int32 index);
+
+				List<Entry> m_entries;
+				List<Skeleton*> m_skeletons;
+				List<Matrix> m_palettes;
+
+				List<Entry> m_pending;
+				List<Job> m_jobs;
+				List<Matrix> m_locals;
+				List<Matrix> m_worlds;
+
+				/** The models set to use this batch */
+				List<Model*> m_models;
+
+				/** Set when players were added or removed since the last Relayout */
+				bool m_layoutDirty = false;
+			};
+		}
+	}
+}
+
+#endif
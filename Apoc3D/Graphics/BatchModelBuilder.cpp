@@ -62,6 +62,11 @@ namespace Apoc3D
 
 				for (int j=0;j<data->Entities.getCount();j++)
 				{
+					// meshes saved with split indices load without faces, which are merged below
+					MeshData* md = data->Entities[j];
+					if (md->Faces.getCount() == 0 && md->Parts.getCount() > 0)
+						md->BuildFaces();
+
 					targets.Add(data->Entities[j], index);
 					index++;
 				}
@@ -0,0 +1,324 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "PixelFormat.h"
+#include "ImageJobs.h"
+#include "LockData.h"
+
+#include "apoc3d/Library/squish.h"
+#include "apoc3d/Math/Math.h"
+#include "apoc3d/Math/ColorValue.h"
+
+#include <emmintrin.h>
+
+using namespace Apoc3D::Math;
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		/*
+		 *  Block compressed images are coded a band of block rows at a time. A band brings its pixel
+		 *  rows to A8R8G8B8 in a buffer of its own, then gathers each 4x4 block into the r,g,b,a byte
+		 *  order squish works with. Decoding goes the other way. Bands share nothing, so they run in
+		 *  parallel on the image workers.
+		 */
+
+		/** The number of blocks in a band. Each block takes tens of microseconds with cluster fit. */
+		const int32 BandBlocks = 1024;
+		/** Below this number of pixels, all bands run on the calling thread. */
+		const int32 ParallelThreshold = 64 * 64;
+
+		static int32 GetSquishFormat(PixelFormat format)
+		{
+			switch (format)
+			{
+				case FMT_DXT1: return squish::kDxt1;
+				case FMT_DXT3: return squish::kDxt3;
+				case FMT_DXT5: return squish::kDxt5;
+			}
+			return 0;
+		}
+
+		static int32 GetSquishFlags(PixelFormat format, const BlockCompressionOptions& options)
+		{
+			int32 flags = GetSquishFormat(format);
+
+			switch (options.Quality)
+			{
+				case BlockCompressionQuality::Fast: flags |= squish::kColourRangeFit; break;
+				case BlockCompressionQuality::Normal: flags |= squish::kColourClusterFit; break;
+				case BlockCompressionQuality::Best: flags |= squish::kColourIterativeClusterFit; break;
+			}
+
+			flags |= options.PerceptualMetric ? squish::kColourMetricPerceptual : squish::kColourMetricUniform;
+
+			if (options.WeightColorByAlpha)
+				flags |= squish::kWeightColourByAlpha;
+
+			return flags;
+		}
+
+		/** Copies A8R8G8B8 pixels to r,g,b,a bytes */
+		static void SwizzleToRGBA(const uint32* src, byte* dst, int32 count)
+		{
+			int32 i = 0;
+#ifndef BIG_ENDIAN
+			// the bytes of an A8R8G8B8 pixel are b,g,r,a in memory; swapping r and b is all there is to do
+			const __m128i agMask = _mm_set1_epi32(0xff00ff00);
+			const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i rb = _mm_and_si128(v, rbMask);
+				rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+				v = _mm_or_si128(_mm_and_si128(v, agMask), rb);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), v);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				uint32 c = src[i];
+				dst[i * 4 + 0] = (byte)CV_GetColorR(c);
+				dst[i * 4 + 1] = (byte)CV_GetColorG(c);
+				dst[i * 4 + 2] = (byte)CV_GetColorB(c);
+				dst[i * 4 + 3] = (byte)CV_GetColorA(c);
+			}
+		}
+
+		/** Copies r,g,b,a bytes to A8R8G8B8 pixels */
+		static void SwizzleFromRGBA(const byte* src, uint32* dst, int32 count)
+		{
+			int32 i = 0;
+#ifndef BIG_ENDIAN
+			// the same swap of r and b, which undoes itself
+			SwizzleToRGBA(reinterpret_cast<const uint32*>(src), reinterpret_cast<byte*>(dst), count & ~3);
+			i = count & ~3;
+#endif
+			for (; i < count; i++)
+			{
+				dst[i] = CV_PackColor(src[i * 4 + 0], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3]);
+			}
+		}
+
+		/** Splits a block compressed box into bands of block rows, slice by slice */
+		class BlockBands
+		{
+		public:
+			BlockBands(const DataBox& image)
+			{
+				m_width = image.getWidth();
+				m_height = image.getHeight();
+				m_blocksX = (m_width + 3) / 4;
+				m_blocksY = (m_height + 3) / 4;
+				m_bandBlockRows = Math::Max(1, BandBlocks / Math::Max(1, m_blocksX));
+				m_bandsPerSlice = (m_blocksY + m_bandBlockRows - 1) / m_bandBlockRows;
+				m_bandCount = m_bandsPerSlice * image.getDepth();
+			}
+
+			int32 getBandCount() const { return m_bandCount; }
+
+		protected:
+			/** Works out the slice and the range of pixel rows a band covers */
+			void GetBandExtent(int32 band, int32& z, int32& firstRow, int32& rowCount) const
+			{
+				z = band / m_bandsPerSlice;
+
+				const int32 firstBlockRow = (band % m_bandsPerSlice) * m_bandBlockRows;
+				const int32 endBlockRow = Math::Min(m_blocksY, firstBlockRow + m_bandBlockRows);
+
+				firstRow = firstBlockRow * 4;
+				rowCount = Math::Min(m_height, endBlockRow * 4) - firstRow;
+			}
+
+			int32 m_width;
+			int32 m_height;
+			int32 m_blocksX;
+			int32 m_blocksY;
+
+			int32 m_bandBlockRows;
+			int32 m_bandsPerSlice;
+			int32 m_bandCount;
+		};
+
+		class BlockEncoder : public BlockBands
+		{
+		public:
+			BlockEncoder(const DataBox& src, const DataBox& dst, int32 flags)
+				: BlockBands(src), m_src(src), m_dst(dst), m_flags(flags)
+			{
+				m_blockSize = (flags & squish::kDxt1) ? 8 : 16;
+			}
+
+			void ProcessBand(int32 band)
+			{
+				int32 z, firstRow, rowCount;
+				GetBandExtent(band, z, firstRow, rowCount);
+
+				const byte* srcRows = static_cast<const byte*>(m_src.getDataPointer()) +
+					(size_t)z * m_src.getSlicePitch() + (size_t)firstRow * m_src.getRowPitch();
+
+				// bring the rows to A8R8G8B8, unless they already are
+				List<uint32> buffer;
+				const uint32* pixels = reinterpret_cast<const uint32*>(srcRows);
+				int32 pitch = m_src.getRowPitch() / sizeof(uint32);
+
+				if (m_src.getFormat() != FMT_A8R8G8B8)
+				{
+					buffer.ReserveDiscard(m_width * rowCount);
+					pitch = m_width;
+
+					DataBox srcBox(m_width, rowCount, 1, m_src.getRowPitch(), m_src.getRowPitch() * rowCount, (void*)srcRows, m_src.getFormat());
+					DataBox bufferBox(m_width, rowCount, 1, m_width * sizeof(uint32), m_width * rowCount * sizeof(uint32), buffer.getElements(), FMT_A8R8G8B8);
+					PixelFormatUtils::ConvertPixels(srcBox, bufferBox, false);
+
+					pixels = buffer.getElements();
+				}
+
+				byte* dstBase = static_cast<byte*>(m_dst.getDataPointer()) + (size_t)z * m_dst.getSlicePitch();
+
+				for (int32 y = 0; y < rowCount; y += 4)
+				{
+					byte* dstBlock = dstBase + (size_t)((firstRow + y) / 4) * m_dst.getRowPitch();
+					const int32 blockHeight = Math::Min(4, rowCount - y);
+
+					for (int32 x = 0; x < m_width; x += 4)
+					{
+						const int32 blockWidth = Math::Min(4, m_width - x);
+
+						squish::u8 rgba[16 * 4] = { 0 };
+						int32 mask = 0;
+
+						for (int32 j = 0; j < blockHeight; j++)
+						{
+							SwizzleToRGBA(pixels + (size_t)(y + j) * pitch + x, rgba + j * 16, blockWidth);
+							mask |= ((1 << blockWidth) - 1) << (j * 4);
+						}
+
+						squish::CompressMasked(rgba, mask, dstBlock, m_flags);
+						dstBlock += m_blockSize;
+					}
+				}
+			}
+
+		private:
+			const DataBox& m_src;
+			const DataBox& m_dst;
+			int32 m_flags;
+			int32 m_blockSize;
+		};
+
+		class BlockDecoder : public BlockBands
+		{
+		public:
+			BlockDecoder(const DataBox& src, const DataBox& dst, int32 flags)
+				: BlockBands(src), m_src(src), m_dst(dst), m_flags(flags)
+			{
+				m_blockSize = (flags & squish::kDxt1) ? 8 : 16;
+			}
+
+			void ProcessBand(int32 band)
+			{
+				int32 z, firstRow, rowCount;
+				GetBandExtent(band, z, firstRow, rowCount);
+
+				// whole blocks are decoded, so the buffer is padded to them
+				const int32 pitch = m_blocksX * 4;
+				List<uint32> buffer;
+				buffer.ReserveDiscard(pitch * ((rowCount + 3) & ~3));
+
+				const byte* srcBase = static_cast<const byte*>(m_src.getDataPointer()) + (size_t)z * m_src.getSlicePitch();
+
+				for (int32 y = 0; y < rowCount; y += 4)
+				{
+					const byte* srcBlock = srcBase + (size_t)((firstRow + y) / 4) * m_src.getRowPitch();
+
+					for (int32 x = 0; x < pitch; x += 4)
+					{
+						squish::u8 rgba[16 * 4];
+						squish::Decompress(rgba, srcBlock, m_flags);
+
+						for (int32 j = 0; j < 4; j++)
+							SwizzleFromRGBA(rgba + j * 16, &buffer[(y + j) * pitch + x], 4);
+
+						srcBlock += m_blockSize;
+					}
+				}
+
+				byte* dstRows = static_cast<byte*>(m_dst.getDataPointer()) +
+					(size_t)z * m_dst.getSlicePitch() + (size_t)firstRow * m_dst.getRowPitch();
+
+				if (m_dst.getFormat() == FMT_A8R8G8B8)
+				{
+					for (int32 j = 0; j < rowCount; j++)
+						memcpy(dstRows + (size_t)j * m_dst.getRowPitch(), &buffer[j * pitch], m_width * sizeof(uint32));
+				}
+				else
+				{
+					DataBox bufferBox(m_width, rowCount, 1, pitch * sizeof(uint32), pitch * rowCount * sizeof(uint32), buffer.getElements(), FMT_A8R8G8B8);
+					DataBox dstBox(m_width, rowCount, 1, m_dst.getRowPitch(), m_dst.getRowPitch() * rowCount, dstRows, m_dst.getFormat());
+					PixelFormatUtils::ConvertPixels(bufferBox, dstBox, false);
+				}
+			}
+
+		private:
+			const DataBox& m_src;
+			const DataBox& m_dst;
+			int32 m_flags;
+			int32 m_blockSize;
+		};
+
+		bool PixelFormatUtils::CanCompress(PixelFormat srcFormat, PixelFormat dstFormat)
+		{
+			return GetSquishFormat(dstFormat) != 0 && !IsCompressed(srcFormat) &&
+				(srcFormat == FMT_A8R8G8B8 || CanConvert(srcFormat, FMT_A8R8G8B8));
+		}
+
+		bool PixelFormatUtils::CanDecompress(PixelFormat srcFormat, PixelFormat dstFormat)
+		{
+			return GetSquishFormat(srcFormat) != 0 && !IsCompressed(dstFormat) &&
+				(dstFormat == FMT_A8R8G8B8 || CanConvert(FMT_A8R8G8B8, dstFormat));
+		}
+
+		bool PixelFormatUtils::Compress(const DataBox& src, const DataBox& dst, const BlockCompressionOptions& options)
+		{
+			if (!CanCompress(src.getFormat(), dst.getFormat()))
+				return false;
+
+			BlockEncoder encoder(src, dst, GetSquishFlags(dst.getFormat(), options));
+
+			const int32 bandCount = encoder.getBandCount();
+			bool parallel = options.Parallel && bandCount > 1 && src.getWidth() * src.getHeight() * src.getDepth() >= ParallelThreshold;
+
+			RunImageJobs(bandCount, FunctorReference<void(int32)>(&encoder, &BlockEncoder::ProcessBand), parallel);
+			return true;
+		}
+
+		bool PixelFormatUtils::Decompress(const DataBox& src, const DataBox& dst, bool parallel)
+		{
+			if (!CanDecompress(src.getFormat(), dst.getFormat()))
+				return false;
+
+			BlockDecoder decoder(src, dst, GetSquishFormat(src.getFormat()));
+
+			const int32 bandCount = decoder.getBandCount();
+			parallel &= bandCount > 1 && src.getWidth() * src.getHeight() * src.getDepth() >= ParallelThreshold;
+
+			RunImageJobs(bandCount, FunctorReference<void(int32)>(&decoder, &BlockDecoder::ProcessBand), parallel);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,425 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "CPUParticleSystem.h"
+
+#include "apoc3d/Core/TaskScheduler.h"
+#include "apoc3d/Math/Math.h"
+#include "apoc3d/Math/MathBatch.h"
+#include "apoc3d/Math/Matrix.h"
+
+#include "RenderSystem/RenderDevice.h"
+#include "RenderSystem/VertexDeclaration.h"
+#include "RenderSystem/HardwareBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <emmintrin.h>
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		const VertexElement CPUParticleVertex::VtxElements[] =
+		{
+			VertexElement(0, VEF_Vector3, VEU_Position, 0),
+			VertexElement(12, VEF_Color, VEU_Color, 0),
+			VertexElement(16, VEF_Vector2, VEU_TextureCoordinate, 0)
+		};
+
+		static const int32 FloatStreamCount = 9;
+
+		CPUParticleSystem::CPUParticleSystem(RenderDevice* device, Material* mtrl)
+			: m_device(device), m_mtrl(mtrl)
+		{
+		}
+
+		CPUParticleSystem::~CPUParticleSystem()
+		{
+			ReleaseBuffers();
+		}
+
+		void CPUParticleSystem::ReleaseBuffers()
+		{
+			delete[] m_streams;
+			delete[] m_color;
+			delete[] m_sortKeys;
+			delete[] m_sortOrder;
+			m_streams = nullptr;
+			m_color = nullptr;
+			m_sortKeys = nullptr;
+			m_sortOrder = nullptr;
+
+			DELETE_AND_NULL(m_vertexBuffer);
+			DELETE_AND_NULL(m_vertexDeclaration);
+		}
+
+		void CPUParticleSystem::Setup(FunctorReference<void(ParticleSettings&)> settingsFunc)
+		{
+			settingsFunc(m_settings);
+
+			Load();
+		}
+
+		void CPUParticleSystem::Load()
+		{
+			InitializeSettings(m_settings);
+
+			// Setup can be called again to change the settings
+			ReleaseBuffers();
+			m_opBuffer.Clear();
+
+			m_capacity = m_settings.MaxParticles;
+			m_count = 0;
+			m_frameSegment = 0;
+			m_verticesDirty = true;
+
+			m_streams = new float[m_capacity * FloatStreamCount];
+			m_posX = m_streams;
+			m_posY = m_posX + m_capacity;
+			m_posZ = m_posY + m_capacity;
+			m_velX = m_posZ + m_capacity;
+			m_velY = m_velX + m_capacity;
+			m_velZ = m_velY + m_capacity;
+			m_age = m_velZ + m_capacity;
+			m_ageRate = m_age + m_capacity;
+			m_randomValue = m_ageRate + m_capacity;
+			m_color = new uint32[m_capacity];
+
+			m_sortKeys = new float[m_capacity];
+			m_sortOrder = new int32[m_capacity];
+
+			ObjectFactory* fac = m_device->getObjectFactory();
+			List<VertexElement> elems;
+			elems.Add(CPUParticleVertex::VtxElements[0]);
+			elems.Add(CPUParticleVertex::VtxElements[1]);
+			elems.Add(CPUParticleVertex::VtxElements[2]);
+
+			m_vertexDeclaration = fac->CreateVertexDeclaration(elems);
+
+			m_vertexBuffer = fac->CreateVertexBuffer(m_capacity * FrameSegmentCount, m_vertexDeclaration,
+				(BufferUsageFlags)(BU_Dynamic | BU_WriteOnly | BU_PointSpriteVertex));
+
+			m_geoData.VertexBuffer = m_vertexBuffer;
+			m_geoData.VertexDecl = m_vertexDeclaration;
+			m_geoData.PrimitiveType = PrimitiveType::PointList;
+			m_geoData.VertexSize = m_vertexDeclaration->GetVertexSize();
+			m_geoData.UserData = this;
+		}
+
+		void CPUParticleSystem::Reset()
+		{
+			m_count = 0;
+			m_verticesDirty = true;
+			for (CPUParticleEmitter& e : m_emitters)
+				e.Remainder = 0;
+		}
+
+		int32 CPUParticleSystem::AddEmitter(const Vector3& position, float rate)
+		{
+			CPUParticleEmitter e;
+			e.Position = position;
+			e.Rate = rate;
+			m_emitters.Add(e);
+			return m_emitters.getCount() - 1;
+		}
+
+		void CPUParticleSystem::SetCollisionPlane(const Plane& plane, float restitution)
+		{
+			m_collisionPlane = Plane::Normalize(plane);
+			m_restitution = restitution;
+			m_hasCollisionPlane = true;
+		}
+
+		int32 CPUParticleSystem::Spawn(const Vector3& position, const Vector3& velocity, int32 count)
+		{
+			count = Math::Min(count, m_capacity - m_count);
+			if (count <= 0)
+				return 0;
+
+			const ParticleSettings& s = m_settings;
+			Vector3 baseVelocity = velocity * s.EmitterVelocitySensitivity;
+			float baseAgeRate = s.Duration > 0 ? 1.0f / s.Duration : 1.0f;
+
+			// The new particles go to one consecutive range in each stream
+			int32 start = m_count;
+			int32 end = m_count + count;
+			for (int32 i = start; i < end; i++)
+			{
+				float horizontalVelocity = Math::Lerp(s.MinHorizontalVelocity, s.MaxHorizontalVelocity, m_random.NextFloat());
+				float horizontalAngle = m_random.NextFloat() * Math::PI * 2;
+				float verticalVelocity = Math::Lerp(s.MinVerticalVelocity, s.MaxVerticalVelocity, m_random.NextFloat());
+
+				m_posX[i] = position.X;
+				m_posY[i] = position.Y;
+				m_posZ[i] = position.Z;
+				m_velX[i] = baseVelocity.X + horizontalVelocity * cosf(horizontalAngle);
+				m_velY[i] = baseVelocity.Y + verticalVelocity;
+				m_velZ[i] = baseVelocity.Z + horizontalVelocity * sinf(horizontalAngle);
+				m_age[i] = 0;
+				m_ageRate[i] = baseAgeRate * (1 + m_random.NextFloat() * s.DurationRandomness);
+				m_randomValue[i] = m_random.NextFloat();
+				m_color[i] = Color4::Lerp(s.MinColor, s.MaxColor, m_random.NextFloat()).ToArgb();
+			}
+
+			m_count = end;
+			m_verticesDirty = true;
+			return count;
+		}
+
+		void CPUParticleSystem::Update(float dt)
+		{
+			for (CPUParticleEmitter& e : m_emitters)
+			{
+				if (!e.Enabled)
+					continue;
+
+				float total = e.Rate * dt + e.Remainder;
+				int32 n = static_cast<int32>(total);
+				e.Remainder = total - n;
+
+				if (n > 0)
+					Spawn(e.Position, e.Velocity, n);
+			}
+
+			Integrate(dt);
+			Compact();
+
+			m_verticesDirty = true;
+		}
+
+		void CPUParticleSystem::UpdateAll(CPUParticleSystem* const* systems, int32 count, float dt, bool parallel)
+		{
+			TaskScheduler::RunJobs(count, [systems, dt](int32 i) { systems[i]->Update(dt); }, parallel);
+		}
+
+		void CPUParticleSystem::Integrate(float dt)
+		{
+			const ParticleSettings& s = m_settings;
+
+			// EndVelocity is the fraction of the starting speed left at the end of the nominal
+			// Duration. Applied as a constant drag, ignoring the lifetime variation.
+			float drag = 1;
+			if (s.EndVelocity != 1 && s.Duration > 0)
+				drag = powf(Math::Max(s.EndVelocity, 0.01f), dt / s.Duration);
+
+			Vector3 dv = s.Gravity * dt;
+
+			float nx = m_collisionPlane.X, ny = m_collisionPlane.Y, nz = m_collisionPlane.Z, nd = m_collisionPlane.D;
+			float bounce = 1 + m_restitution;
+
+			Vector3 minv = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+			Vector3 maxv = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+			int32 i = 0;
+			if (GetMathSIMDLevel() != MathSIMDLevel::Scalar)
+			{
+				__m128 vdt = _mm_set1_ps(dt);
+				__m128 vdrag = _mm_set1_ps(drag);
+				__m128 dvx = _mm_set1_ps(dv.X), dvy = _mm_set1_ps(dv.Y), dvz = _mm_set1_ps(dv.Z);
+				__m128 pnx = _mm_set1_ps(nx), pny = _mm_set1_ps(ny), pnz = _mm_set1_ps(nz), pnd = _mm_set1_ps(nd);
+				__m128 vbounce = _mm_set1_ps(bounce);
+				__m128 zero = _mm_setzero_ps();
+
+				__m128 minX = _mm_set1_ps(FLT_MAX), minY = minX, minZ = minX;
+				__m128 maxX = _mm_set1_ps(-FLT_MAX), maxY = maxX, maxZ = maxX;
+
+				for (; i + 4 <= m_count; i += 4)
+				{
+					__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m_velX + i), vdrag), dvx);
+					__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m_velY + i), vdrag), dvy);
+					__m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m_velZ + i), vdrag), dvz);
+
+					__m128 px = _mm_add_ps(_mm_loadu_ps(m_posX + i), _mm_mul_ps(vx, vdt));
+					__m128 py = _mm_add_ps(_mm_loadu_ps(m_posY + i), _mm_mul_ps(vy, vdt));
+					__m128 pz = _mm_add_ps(_mm_loadu_ps(m_posZ + i), _mm_mul_ps(vz, vdt));
+
+					if (m_hasCollisionPlane)
+					{
+						__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, pnx), _mm_mul_ps(py, pny)), _mm_add_ps(_mm_mul_ps(pz, pnz), pnd));
+						__m128 vn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, pnx), _mm_mul_ps(vy, pny)), _mm_mul_ps(vz, pnz));
+
+						// push the ones behind the plane back onto it, and reflect the ones still moving into it
+						__m128 behind = _mm_cmplt_ps(d, zero);
+						__m128 push = _mm_and_ps(behind, d);
+						__m128 impulse = _mm_and_ps(_mm_and_ps(behind, _mm_cmplt_ps(vn, zero)), _mm_mul_ps(vn, vbounce));
+
+						px = _mm_sub_ps(px, _mm_mul_ps(push, pnx));
+						py = _mm_sub_ps(py, _mm_mul_ps(push, pny));
+						pz = _mm_sub_ps(pz, _mm_mul_ps(push, pnz));
+						vx = _mm_sub_ps(vx, _mm_mul_ps(impulse, pnx));
+						vy = _mm_sub_ps(vy, _mm_mul_ps(impulse, pny));
+						vz = _mm_sub_ps(vz, _mm_mul_ps(impulse, pnz));
+					}
+
+					_mm_storeu_ps(m_velX + i, vx);
+					_mm_storeu_ps(m_velY + i, vy);
+					_mm_storeu_ps(m_velZ + i, vz);
+					_mm_storeu_ps(m_posX + i, px);
+					_mm_storeu_ps(m_posY + i, py);
+					_mm_storeu_ps(m_posZ + i, pz);
+
+					_mm_storeu_ps(m_age + i, _mm_add_ps(_mm_loadu_ps(m_age + i), _mm_mul_ps(_mm_loadu_ps(m_ageRate + i), vdt)));
+
+					minX = _mm_min_ps(minX, px); maxX = _mm_max_ps(maxX, px);
+					minY = _mm_min_ps(minY, py); maxY = _mm_max_ps(maxY, py);
+					minZ = _mm_min_ps(minZ, pz); maxZ = _mm_max_ps(maxZ, pz);
+				}
+
+				float lanes[4];
+				_mm_storeu_ps(lanes, minX); minv.X = Math::Min(Math::Min(lanes[0], lanes[1]), Math::Min(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, minY); minv.Y = Math::Min(Math::Min(lanes[0], lanes[1]), Math::Min(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, minZ); minv.Z = Math::Min(Math::Min(lanes[0], lanes[1]), Math::Min(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, maxX); maxv.X = Math::Max(Math::Max(lanes[0], lanes[1]), Math::Max(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, maxY); maxv.Y = Math::Max(Math::Max(lanes[0], lanes[1]), Math::Max(lanes[2], lanes[3]));
+				_mm_storeu_ps(lanes, maxZ); maxv.Z = Math::Max(Math::Max(lanes[0], lanes[1]), Math::Max(lanes[2], lanes[3]));
+			}
+
+			for (; i < m_count; i++)
+			{
+				float vx = m_velX[i] * drag + dv.X;
+				float vy = m_velY[i] * drag + dv.Y;
+				float vz = m_velZ[i] * drag + dv.Z;
+
+				float px = m_posX[i] + vx * dt;
+				float py = m_posY[i] + vy * dt;
+				float pz = m_posZ[i] + vz * dt;
+
+				if (m_hasCollisionPlane)
+				{
+					float d = px * nx + py * ny + pz * nz + nd;
+					if (d < 0)
+					{
+						px -= d * nx; py -= d * ny; pz -= d * nz;
+
+						float vn = vx * nx + vy * ny + vz * nz;
+						if (vn < 0)
+						{
+							vx -= vn * bounce * nx; vy -= vn * bounce * ny; vz -= vn * bounce * nz;
+						}
+					}
+				}
+
+				m_velX[i] = vx; m_velY[i] = vy; m_velZ[i] = vz;
+				m_posX[i] = px; m_posY[i] = py; m_posZ[i] = pz;
+				m_age[i] += m_ageRate[i] * dt;
+
+				minv.X = Math::Min(minv.X, px); maxv.X = Math::Max(maxv.X, px);
+				minv.Y = Math::Min(minv.Y, py); maxv.Y = Math::Max(maxv.Y, py);
+				minv.Z = Math::Min(minv.Z, pz); maxv.Z = Math::Max(maxv.Z, pz);
+			}
+
+			if (m_count > 0)
+				m_bounds = BoundingBox(minv, maxv);
+		}
+
+		void CPUParticleSystem::Compact()
+		{
+			float* streams[FloatStreamCount] = { m_posX, m_posY, m_posZ, m_velX, m_velY, m_velZ, m_age, m_ageRate, m_randomValue };
+
+			int32 i = 0;
+			while (i < m_count)
+			{
+				if (m_age[i] < 1)
+				{
+					i++;
+					continue;
+				}
+
+				// fill the hole with the last one, which is checked next
+				int32 last = --m_count;
+				for (float* s : streams)
+					s[i] = s[last];
+				m_color[i] = m_color[last];
+			}
+		}
+
+		void CPUParticleSystem::WriteVertices(CPUParticleVertex* dst)
+		{
+			if (m_sorted)
+			{
+				for (int32 i = 0; i < m_count; i++)
+				{
+					float dx = m_posX[i] - m_sortOrigin.X;
+					float dy = m_posY[i] - m_sortOrigin.Y;
+					float dz = m_posZ[i] - m_sortOrigin.Z;
+					m_sortKeys[i] = dx * dx + dy * dy + dz * dz;
+					m_sortOrder[i] = i;
+				}
+
+				const float* keys = m_sortKeys;
+				std::sort(m_sortOrder, m_sortOrder + m_count, [keys](int32 a, int32 b) { return keys[a] > keys[b]; });
+
+				for (int32 j = 0; j < m_count; j++)
+				{
+					int32 i = m_sortOrder[j];
+					CPUParticleVertex& v = dst[j];
+					v.Position = Vector3(m_posX[i], m_posY[i], m_posZ[i]);
+					v.Color = m_color[i];
+					v.Age = m_age[i];
+					v.Random = m_randomValue[i];
+				}
+			}
+			else
+			{
+				for (int32 i = 0; i < m_count; i++)
+				{
+					CPUParticleVertex& v = dst[i];
+					v.Position = Vector3(m_posX[i], m_posY[i], m_posZ[i]);
+					v.Color = m_color[i];
+					v.Age = m_age[i];
+					v.Random = m_randomValue[i];
+				}
+			}
+		}
+
+		RenderOperationBuffer* CPUParticleSystem::GetRenderOperation(int lod)
+		{
+			// drawn again without changes, such as in another view of the same frame
+			if (!m_verticesDirty)
+				return &m_opBuffer;
+			m_verticesDirty = false;
+
+			m_opBuffer.Clear();
+
+			if (m_count > 0)
+			{
+				// Each frame goes to the next segment of the buffer. The GPU is never supposed to get more
+				// than 2 frames behind, so the segment being written is no longer in use.
+				const int32 stride = sizeof(CPUParticleVertex);
+				int32 baseVertex = m_frameSegment * m_capacity;
+
+				void* data = m_vertexBuffer->Lock(baseVertex * stride, m_count * stride, LOCK_NoOverwrite);
+				WriteVertices(reinterpret_cast<CPUParticleVertex*>(data));
+				m_vertexBuffer->Unlock();
+
+				m_frameSegment = (m_frameSegment + 1) % FrameSegmentCount;
+
+				m_geoData.BaseVertex = baseVertex;
+				m_geoData.VertexCount = m_count;
+				m_geoData.PrimitiveCount = m_count;
+
+				RenderOperation rop;
+				rop.GeometryData = &m_geoData;
+				rop.RootTransform = Matrix::Identity;
+				rop.Material = m_mtrl;
+				m_opBuffer.Add(rop);
+			}
+
+			return &m_opBuffer;
+		}
+	}
+}
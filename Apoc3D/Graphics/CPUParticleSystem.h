@@ -0,0 +1,209 @@
+#pragma once
+#ifndef APOC3D_CPUPARTICLESYSTEM_H
+#define APOC3D_CPUPARTICLESYSTEM_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "ParticleSettings.h"
+#include "GeometryData.h"
+#include "Renderable.h"
+#include "RenderOperationBuffer.h"
+#include "RenderSystem/VertexElement.h"
+
+#include "apoc3d/Collections/List.h"
+#include "apoc3d/Math/BoundingBox.h"
+#include "apoc3d/Math/Plane.h"
+#include "apoc3d/Math/RandomUtils.h"
+
+using namespace Apoc3D::Collections;
+using namespace Apoc3D::Core;
+using namespace Apoc3D::Graphics::RenderSystem;
+using namespace Apoc3D::Math;
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		/** Vertex written by CPUParticleSystem, one point sprite per particle. */
+		struct APAPI CPUParticleVertex
+		{
+			Vector3 Position;
+			uint32 Color;
+			float Age;			/** Age of the particle relative to its lifetime, 0 to 1. */
+			float Random;		/** A random value in [0, 1], used to make each particle look slightly different. */
+
+			/** Describe the layout of this vertex structure. */
+			static const VertexElement VtxElements[];
+		};
+
+		/** A source that spawns particles at a steady rate into a CPUParticleSystem. */
+		struct CPUParticleEmitter
+		{
+			Vector3 Position = Vector3::Zero;
+			/** Velocity of the object emitting, scaled by ParticleSettings::EmitterVelocitySensitivity. */
+			Vector3 Velocity = Vector3::Zero;
+			/** Particles per second. */
+			float Rate = 0;
+			bool Enabled = true;
+
+			/** Fraction of a particle carried over to the next update. */
+			float Remainder = 0;
+		};
+
+		/**
+		 *  A particle system simulated on the CPU.
+		 *
+		 *  Unlike ParticleSystem, which only extrapolates from the spawn time in the vertex shader,
+		 *  the particles here are integrated every update. This allows each particle to have its own
+		 *  lifetime, and the system to do collision, sorting and culling.
+		 *
+		 *  Particle state is kept in separate arrays for each component so updates can be done 4
+		 *  particles at a time. Dead particles are removed by moving the last ones into their place,
+		 *  so the live particles are always packed at the front.
+		 *
+		 *  The vertex buffer holds 3 frames worth of particles. Each frame is written to the next
+		 *  part with LOCK_NoOverwrite, so it never waits on the GPU drawing the previous ones.
+		 *  The particles are only written when they changed since the last GetRenderOperation, so
+		 *  a system drawn in several views in a frame is uploaded once.
+		 */
+		class APAPI CPUParticleSystem : public Renderable
+		{
+		public:
+			/** The number of frames the GPU is allowed to be behind before a part of the vertex buffer is written again. */
+			static const int32 FrameSegmentCount = 3;
+
+			CPUParticleSystem(RenderDevice* device, Material* mtrl);
+			virtual ~CPUParticleSystem();
+
+			CPUParticleSystem(const CPUParticleSystem&) = delete;
+			CPUParticleSystem& operator=(const CPUParticleSystem&) = delete;
+
+			void Setup(FunctorReference<void(ParticleSettings&)> settingsFunc);
+
+			/** Kills all particles. The emitters are kept. */
+			void Reset();
+
+			int32 AddEmitter(const Vector3& position, float rate);
+			void RemoveEmitter(int32 index) { m_emitters.RemoveAt(index); }
+			CPUParticleEmitter& getEmitter(int32 index) { return m_emitters[index]; }
+			int32 getEmitterCount() const { return m_emitters.getCount(); }
+
+			/**
+			 *  Adds a batch of particles at the same position.
+			 *  @return The number of particles added, which is less than count when the system is full.
+			 */
+			int32 Spawn(const Vector3& position, const Vector3& velocity, int32 count);
+
+			/** Makes particles bounce off the given plane. Restitution is the fraction of the normal speed kept. */
+			void SetCollisionPlane(const Plane& plane, float restitution);
+			void ClearCollisionPlane() { m_hasCollisionPlane = false; }
+
+			/** Makes particles drawn back to front as seen from the given position. */
+			void SetSortOrigin(const Vector3& eye) { m_sortOrigin = eye; m_sorted = true; m_verticesDirty = true; }
+			void ClearSortOrigin() { m_sorted = false; m_verticesDirty = true; }
+
+			/** Spawns from the emitters, then integrates and removes the dead particles. */
+			virtual void Update(float dt);
+
+			/**
+			 *  Updates a number of systems, spread over the TaskScheduler's workers.
+			 *  @param parallel False to update on the calling thread only.
+			 */
+			static void UpdateAll(CPUParticleSystem* const* systems, int32 count, float dt, bool parallel = true);
+
+			virtual RenderOperationBuffer* GetRenderOperation(int lod) override;
+
+			int32 getParticleCount() const { return m_count; }
+			int32 getCapacity() const { return m_capacity; }
+
+			/** The bounds of the particles as of the last update. Only valid when there are particles. */
+			const BoundingBox& getBounds() const { return m_bounds; }
+
+			const float* getPositionX() const { return m_posX; }
+			const float* getPositionY() const { return m_posY; }
+			const float* getPositionZ() const { return m_posZ; }
+			const float* getVelocityX() const { return m_velX; }
+			const float* getVelocityY() const { return m_velY; }
+			const float* getVelocityZ() const { return m_velZ; }
+			const float* getAge() const { return m_age; }
+			const uint32* getColor() const { return m_color; }
+
+			const ParticleSettings* getSettings() const { return &m_settings; }
+			ParticleSettings* getSettings() { return &m_settings; }
+
+		protected:
+			/* Derived particle system classes should override this method
+			   and use it to initialize their tweakable settings.
+			*/
+			virtual void InitializeSettings(ParticleSettings &settings) const { }
+
+			virtual void Load();
+
+		private:
+			void Integrate(float dt);
+			void Compact();
+			void WriteVertices(CPUParticleVertex* dst);
+			void ReleaseBuffers();
+
+			RenderDevice* m_device;
+			Material* m_mtrl;
+
+			ParticleSettings m_settings;
+			Random m_random;
+
+			List<CPUParticleEmitter> m_emitters;
+
+			/** One allocation holding all the float streams below. */
+			float* m_streams = nullptr;
+			float* m_posX = nullptr;
+			float* m_posY = nullptr;
+			float* m_posZ = nullptr;
+			float* m_velX = nullptr;
+			float* m_velY = nullptr;
+			float* m_velZ = nullptr;
+			float* m_age = nullptr;				/** 0 to 1 over the lifetime */
+			float* m_ageRate = nullptr;			/** 1 / lifetime */
+			float* m_randomValue = nullptr;
+			uint32* m_color = nullptr;
+
+			int32 m_count = 0;
+			int32 m_capacity = 0;
+
+			BoundingBox m_bounds;
+
+			bool m_hasCollisionPlane = false;
+			Plane m_collisionPlane;
+			float m_restitution = 0;
+
+			bool m_sorted = false;
+			Vector3 m_sortOrigin;
+			float* m_sortKeys = nullptr;
+			int32* m_sortOrder = nullptr;
+
+			VertexBuffer* m_vertexBuffer = nullptr;
+			VertexDeclaration* m_vertexDeclaration = nullptr;
+			int32 m_frameSegment = 0;
+			/** Set when the particles change, cleared once they are written to the vertex buffer. */
+			bool m_verticesDirty = true;
+
+			GeometryData m_geoData;
+			RenderOperationBuffer m_opBuffer;
+		};
+	}
+}
+
+#endif
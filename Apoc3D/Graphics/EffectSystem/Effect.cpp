@@ -30,6 +30,7 @@
 #include "apoc3d/IOLib/BinaryReader.h"
 #include "apoc3d/IOLib/EffectData.h"
 #include "apoc3d/IOLib/Streams.h"
+#include "apoc3d/Math/MathBatch.h"
 #include "apoc3d/Math/Matrix.h"
 #include "apoc3d/Vfs/FileSystem.h"
 #include "apoc3d/Vfs/ResourceLocation.h"
@@ -92,6 +93,9 @@ namespace Apoc3D
 			static float s_instancingFloatBuffer[InstancingData::MaxOneTimeInstances];
 			static float s_instancingVector2Buffer[InstancingData::MaxOneTimeInstances*2];
 			static Vector4 s_instancingVector4Buffer[InstancingData::MaxOneTimeInstances];
+
+			// plans of deleted materials are not removed one by one. The table is cleared once it gets this large.
+			static const int32 MaxMaterialPlans = 4096;
 			
 			
 			template void AutomaticEffect::SetParameterValue<bool>(int32 index, const bool* value, int32 count);
@@ -117,6 +121,8 @@ namespace Apoc3D
 					ep.Free();
 				}
 
+				ClearMaterialPlans();
+
 				DELETE_AND_NULL(m_vertexShader);
 				DELETE_AND_NULL(m_pixelShader);
 				DELETE_AND_NULL(m_whiteTexture);
@@ -133,7 +139,12 @@ namespace Apoc3D
 				DELETE_AND_NULL(m_pixelShader);
 
 				m_parameters.Clear();
+				m_materialParameters.Clear();
+				m_objectParameters.Clear();
+				ClearMaterialPlans();
 				m_supportsInstancing = false;
+				m_supportsStreamInstancing = false;
+				m_instanceStreamBlobValueCount = 0;
 				m_isUnsupported = false;
 
 				EffectData data;
@@ -187,6 +198,44 @@ namespace Apoc3D
 					ResolvedEffectParameter rep(m_device, m_name, &srcEp, shader, hasShaderIssues);
 					m_parameters.Add(rep);
 				}
+
+				// sort out what Setup needs to look at, so parameters done in begin() are not gone through again
+				for (int32 i = 0; i < m_parameters.getCount(); i++)
+				{
+					const ResolvedEffectParameter& ep = m_parameters[i];
+
+					if (ep.RS_SetupAtBegining && ep.RS_SetupAtBeginingOnly)
+						continue;
+
+					switch (ep.Usage)
+					{
+						case EPUSAGE_MtrlC4_Ambient:
+						case EPUSAGE_MtrlC4_Diffuse:
+						case EPUSAGE_MtrlC4_Emissive:
+						case EPUSAGE_MtrlC4_Specular:
+						case EPUSAGE_MtrlC_Power:
+						case EPUSAGE_CustomMaterialParam:
+							m_materialParameters.Add(i);
+							break;
+						default:
+							if (ep.Usage >= EPUSAGE_Tex0 && ep.Usage <= EPUSAGE_Tex15)
+								m_materialParameters.Add(i);
+							else
+								m_objectParameters.Add(i);
+							break;
+					}
+				}
+
+				// constants in consecutive registers can then be set together
+				auto registerOrder = [this](int32 a, int32 b)
+				{
+					const ResolvedEffectParameter& pa = m_parameters[a];
+					const ResolvedEffectParameter& pb = m_parameters[b];
+					if (pa.RS_TargetShader != pb.RS_TargetShader)
+						return pa.RS_TargetShader < pb.RS_TargetShader ? -1 : 1;
+					return pa.RegisterIndex - pb.RegisterIndex;
+				};
+				m_materialParameters.Sort(registerOrder);
 				
 				// instancing check
 				for (const EffectParameter& srcEp : m_parametersSrc)
@@ -194,8 +243,18 @@ namespace Apoc3D
 					if (srcEp.Usage == EPUSAGE_Trans_InstanceWorlds)
 					{
 						m_supportsInstancing = true;
-						break;
 					}
+					else if (srcEp.Usage == EPUSAGE_Trans_InstanceStream)
+					{
+						m_supportsStreamInstancing = true;
+						m_instanceStreamBlobValueCount = Math::Clamp(srcEp.InstanceStreamBlobCount, 0, InstancingData::MaxInstanceStreamBlobValues);
+					}
+				}
+
+				if (m_supportsInstancing && m_supportsStreamInstancing)
+				{
+					ApocLog(LOG_Graphics, L"[AutomaticEffect][" + m_name + L"] Both tr_instanceworld and tr_instancestream are used. Using the instance stream.", LOGLVL_Warning);
+					m_supportsInstancing = false;
 				}
 
 				if (hasShaderIssues)
@@ -228,58 +287,30 @@ namespace Apoc3D
 				bool materialChanged = m_previousMaterialPointer != mtrl;
 				m_previousMaterialPointer = mtrl;
 
-				for (int32 i = 0; i < m_parameters.getCount();i++)
+				if (materialChanged && mtrl && m_materialParameters.getCount())
 				{
-					const ResolvedEffectParameter& ep = m_parameters[i];
+					ApplyMaterialPlan(*GetMaterialPlan(mtrl), mtrl);
+				}
 
-					if (ep.RS_SetupAtBegining && ep.RS_SetupAtBeginingOnly)
-						continue;
+				// transforms already computed in Prepare
+				int32 preparedIndex = -1;
+				if (count == 1 && m_preparedOps && rop >= m_preparedOps && rop < m_preparedOps + m_preparedCount)
+				{
+					preparedIndex = static_cast<int32>(rop - m_preparedOps);
+				}
+
+				for (int32 idx : m_objectParameters)
+				{
+					const ResolvedEffectParameter& ep = m_parameters[idx];
 
 					switch (ep.Usage)
 					{
-						case EPUSAGE_MtrlC4_Ambient:
-							if (materialChanged)
-								ep.SetColor4(mtrl->Ambient);
-							break;
-						case EPUSAGE_MtrlC4_Diffuse:
-							if (materialChanged)
-								ep.SetColor4(mtrl->Diffuse);
-							break;
-						case EPUSAGE_MtrlC4_Emissive:
-							if (materialChanged)
-								ep.SetColor4(mtrl->Emissive);
-							break;
-						case EPUSAGE_MtrlC4_Specular:
-							if (materialChanged)
-								ep.SetColor4(mtrl->Specular);
-							break;
-						case EPUSAGE_MtrlC_Power:
-							if (materialChanged)
-								ep.SetFloat(mtrl->Power);
-							break;
-						case EPUSAGE_Tex0:
-						case EPUSAGE_Tex1:
-						case EPUSAGE_Tex2:
-						case EPUSAGE_Tex3:
-						case EPUSAGE_Tex4:
-						case EPUSAGE_Tex5:
-						case EPUSAGE_Tex6:
-						case EPUSAGE_Tex7:
-						case EPUSAGE_Tex8:
-						case EPUSAGE_Tex9:
-						case EPUSAGE_Tex10:
-						case EPUSAGE_Tex11:
-						case EPUSAGE_Tex12:
-						case EPUSAGE_Tex13:
-						case EPUSAGE_Tex14:
-						case EPUSAGE_Tex15:
-							if (materialChanged)
+						case EPUSAGE_Trans_WorldViewProj:
+							if (preparedIndex != -1 && m_preparedWorldViewProj.getCount())
 							{
-								SetTexture(ep, mtrl->getTexture(ep.Usage - EPUSAGE_Tex0));
+								ep.SetMatrix(m_preparedWorldViewProj[preparedIndex]);
 							}
-							break;
-						case EPUSAGE_Trans_WorldViewProj:
-							if (RendererEffectParams::CurrentCamera)
+							else if (RendererEffectParams::CurrentCamera)
 							{
 								Matrix mvp;
 								Matrix::Multiply(mvp, rop->RootTransform, RendererEffectParams::CurrentCamera->getViewProjMatrix());
@@ -288,7 +319,11 @@ namespace Apoc3D
 							}
 							break;
 						case EPUSAGE_Trans_WorldView:
-							if (RendererEffectParams::CurrentCamera)
+							if (preparedIndex != -1 && m_preparedWorldView.getCount())
+							{
+								ep.SetMatrix(m_preparedWorldView[preparedIndex]);
+							}
+							else if (RendererEffectParams::CurrentCamera)
 							{
 								Matrix mv;
 								Matrix::Multiply(mv, rop->RootTransform, RendererEffectParams::CurrentCamera->getViewMatrix());
@@ -300,7 +335,11 @@ namespace Apoc3D
 							ep.SetMatrix(rop->RootTransform);
 							break;
 						case EPUSAGE_Trans_WorldViewOriProj:
-							if (RendererEffectParams::CurrentCamera)
+							if (preparedIndex != -1 && m_preparedWorldViewOriProj.getCount())
+							{
+								ep.SetMatrix(m_preparedWorldViewOriProj[preparedIndex]);
+							}
+							else if (RendererEffectParams::CurrentCamera)
 							{
 								Matrix view = RendererEffectParams::CurrentCamera->getViewMatrix();
 								view.SetTranslation(Vector3::Zero);
@@ -327,6 +366,10 @@ namespace Apoc3D
 							break;
 						}
 
+						case EPUSAGE_Trans_InstanceStream:
+							ep.SetInt(count);
+							break;
+
 						case EPUSAGE_M4X3_BoneTrans:
 							ep.Set4X3Matrix(rop->PartTransform.Transfroms, rop->PartTransform.Count);
 							break;
@@ -425,18 +468,69 @@ namespace Apoc3D
 								LogManager::getSingleton().Write(LOG_Graphics, L"[" + m_name + L"] No InfoBlob Obtained.", LOGLVL_Error);
 							}
 							break;
+					}
+				}
+			}
 
-						case EPUSAGE_CustomMaterialParam:
-							if (materialChanged)
-							{
-								if (mtrl && ep.ReferenceSource->CustomMaterialParamName.size())
-								{
-									SetMaterialCustomParameter(ep, mtrl);
-								}
-							}
-							break;
+			void AutomaticEffect::Prepare(Material* mtrl, const RenderOperation* rop, int32 count)
+			{
+				m_preparedOps = nullptr;
+				m_preparedCount = 0;
+				m_preparedWorldViewProj.Clear();
+				m_preparedWorldView.Clear();
+				m_preparedWorldViewOriProj.Clear();
+
+				Camera* camera = RendererEffectParams::CurrentCamera;
+				if (m_isUnsupported || camera == nullptr || count < 2)
+					return;
+
+				bool needsWorldViewProj = false;
+				bool needsWorldView = false;
+				bool needsWorldViewOriProj = false;
+				for (int32 idx : m_objectParameters)
+				{
+					switch (m_parameters[idx].Usage)
+					{
+						case EPUSAGE_Trans_WorldViewProj: needsWorldViewProj = true; break;
+						case EPUSAGE_Trans_WorldView: needsWorldView = true; break;
+						case EPUSAGE_Trans_WorldViewOriProj: needsWorldViewOriProj = true; break;
 					}
 				}
+
+				if (!needsWorldViewProj && !needsWorldView && !needsWorldViewOriProj)
+					return;
+
+				m_preparedWorlds.ReserveDiscard(count);
+				Matrix* worlds = m_preparedWorlds.getElements();
+				for (int32 i = 0; i < count; i++)
+				{
+					worlds[i] = rop[i].RootTransform;
+				}
+
+				if (needsWorldViewProj)
+				{
+					m_preparedWorldViewProj.ReserveDiscard(count);
+					MultiplyMatrices(m_preparedWorldViewProj.getElements(), worlds, camera->getViewProjMatrix(), count);
+				}
+				if (needsWorldView)
+				{
+					m_preparedWorldView.ReserveDiscard(count);
+					MultiplyMatrices(m_preparedWorldView.getElements(), worlds, camera->getViewMatrix(), count);
+				}
+				if (needsWorldViewOriProj)
+				{
+					Matrix view = camera->getViewMatrix();
+					view.SetTranslation(Vector3::Zero);
+
+					Matrix oriViewProj;
+					Matrix::Multiply(oriViewProj, view, camera->getProjMatrix());
+
+					m_preparedWorldViewOriProj.ReserveDiscard(count);
+					MultiplyMatrices(m_preparedWorldViewOriProj.getElements(), worlds, oriViewProj, count);
+				}
+
+				m_preparedOps = rop;
+				m_preparedCount = count;
 			}
 			void AutomaticEffect::BeginPass(int32 passId)
 			{
@@ -611,7 +705,9 @@ namespace Apoc3D
 			}
 			void AutomaticEffect::end()
 			{
-
+				// the render operations may be gone after this
+				m_preparedOps = nullptr;
+				m_preparedCount = 0;
 			}
 
 
@@ -640,6 +736,160 @@ namespace Apoc3D
 				else
 					SetSingleCustomParameter(ep, v.Type, v.Value);
 			}
+			AutomaticEffect::MaterialPlan* AutomaticEffect::GetMaterialPlan(Material* mtrl)
+			{
+				MaterialPlan* plan = nullptr;
+				if (m_materialPlans.TryGetValue(mtrl, plan))
+				{
+					// the address may have been taken by a new material since
+					if (plan->BatchID != mtrl->getBatchID() || plan->ParameterVersion != mtrl->getParameterVersion())
+						BuildMaterialPlan(*plan, mtrl);
+					return plan;
+				}
+
+				if (m_materialPlans.getCount() >= MaxMaterialPlans)
+					ClearMaterialPlans();
+
+				plan = new MaterialPlan();
+				BuildMaterialPlan(*plan, mtrl);
+				m_materialPlans.Add(mtrl, plan);
+				return plan;
+			}
+
+			void AutomaticEffect::BuildMaterialPlan(MaterialPlan& plan, Material* mtrl)
+			{
+				plan.BatchID = mtrl->getBatchID();
+				plan.ParameterVersion = mtrl->getParameterVersion();
+				plan.Sources.Clear();
+				plan.Runs.Clear();
+				plan.OtherParameters.Clear();
+
+				int32 offset = 0;
+				for (int32 idx : m_materialParameters)
+				{
+					const ResolvedEffectParameter& ep = m_parameters[idx];
+
+					const void* data = nullptr;
+					int32 size = 0;
+					int32 registerCount = 1;
+					CustomEffectParameterType type = CEPT_Vector4;
+
+					switch (ep.Usage)
+					{
+						case EPUSAGE_MtrlC4_Ambient: data = &mtrl->Ambient; size = sizeof(Color4); break;
+						case EPUSAGE_MtrlC4_Diffuse: data = &mtrl->Diffuse; size = sizeof(Color4); break;
+						case EPUSAGE_MtrlC4_Emissive: data = &mtrl->Emissive; size = sizeof(Color4); break;
+						case EPUSAGE_MtrlC4_Specular: data = &mtrl->Specular; size = sizeof(Color4); break;
+						case EPUSAGE_MtrlC_Power: data = &mtrl->Power; size = sizeof(float); type = CEPT_Float; break;
+
+						case EPUSAGE_CustomMaterialParam:
+						{
+							if (ep.ReferenceSource->CustomMaterialParamName.empty())
+								continue;
+
+							const MaterialCustomParameter* mcp = mtrl->getCustomParameter(ep.ReferenceSource->CustomMaterialParamName);
+							if (mcp == nullptr)
+								continue;
+
+							type = mcp->Type;
+							switch (type)
+							{
+								case CEPT_Float: data = mcp->Value; size = sizeof(float); break;
+								case CEPT_Vector2: data = mcp->Value; size = sizeof(Vector2); break;
+								case CEPT_Vector4: data = mcp->Value; size = sizeof(Vector4); break;
+								case CEPT_Matrix: data = mcp->Value; size = sizeof(Matrix); registerCount = 4; break;
+								case CEPT_Ref_Vector2: data = mcp->RefValue; size = sizeof(Vector2); break;
+								case CEPT_Ref_Vector3: data = mcp->RefValue; size = sizeof(Vector3); break;
+								case CEPT_Ref_Vector4: data = mcp->RefValue; size = sizeof(Vector4); break;
+								case CEPT_Ref_Matrix: data = mcp->RefValue; size = sizeof(Matrix); registerCount = 4; break;
+							}
+							break;
+						}
+					}
+
+					// textures, booleans and integers are not float constants
+					if (data == nullptr)
+					{
+						plan.OtherParameters.Add(idx);
+						continue;
+					}
+
+					plan.Sources.Add({ data, size, offset });
+
+					MaterialConstantRun* last = plan.Runs.getCount() ? &plan.Runs.LastItem() : nullptr;
+					if (last && last->TargetShader == ep.RS_TargetShader && ep.RS_TargetShader->HasLinearRegisters() &&
+						last->RegisterIndex + last->RegisterCount == ep.RegisterIndex)
+					{
+						last->Type = CEPT_Vector4;
+						last->RegisterCount += registerCount;
+					}
+					else
+					{
+						plan.Runs.Add({ ep.RS_TargetShader, ep.RS_TargetShader->HasLinearRegisters() ? CEPT_Vector4 : type, ep.RegisterIndex, registerCount, offset });
+					}
+
+					offset += registerCount;
+				}
+
+				// the unused parts of registers stay zero, as when set one by one
+				plan.Constants.ReserveDiscard(offset);
+				memset(plan.Constants.getElements(), 0, sizeof(Vector4) * offset);
+			}
+
+			void AutomaticEffect::ApplyMaterialPlan(MaterialPlan& plan, Material* mtrl)
+			{
+				Vector4* constants = plan.Constants.getElements();
+				for (const MaterialConstantSource& src : plan.Sources)
+				{
+					memcpy(constants + src.Offset, src.Data, src.Size);
+				}
+
+				for (const MaterialConstantRun& run : plan.Runs)
+				{
+					const Vector4* data = constants + run.Offset;
+					switch (run.Type)
+					{
+						case CEPT_Float: run.TargetShader->SetValue(run.RegisterIndex, data->X); break;
+						case CEPT_Vector2: 
+						case CEPT_Ref_Vector2: 
+							run.TargetShader->SetVector2(run.RegisterIndex, *reinterpret_cast<const Vector2*>(data)); 
+							break;
+						case CEPT_Ref_Vector3: 
+							run.TargetShader->SetVector3(run.RegisterIndex, *reinterpret_cast<const Vector3*>(data)); 
+							break;
+						case CEPT_Matrix:
+						case CEPT_Ref_Matrix:
+							run.TargetShader->SetValue(run.RegisterIndex, *reinterpret_cast<const Matrix*>(data));
+							break;
+						default: 
+							run.TargetShader->SetVector4(run.RegisterIndex, data, run.RegisterCount); 
+							break;
+					}
+				}
+
+				for (int32 idx : plan.OtherParameters)
+				{
+					SetMaterialParameter(m_parameters[idx], mtrl);
+				}
+			}
+
+			void AutomaticEffect::SetMaterialParameter(const ResolvedEffectParameter& ep, Material* mtrl)
+			{
+				if (ep.Usage >= EPUSAGE_Tex0 && ep.Usage <= EPUSAGE_Tex15)
+				{
+					SetTexture(ep, mtrl->getTexture(ep.Usage - EPUSAGE_Tex0));
+				}
+				else if (ep.Usage == EPUSAGE_CustomMaterialParam)
+				{
+					SetMaterialCustomParameter(ep, mtrl);
+				}
+			}
+
+			void AutomaticEffect::ClearMaterialPlans()
+			{
+				m_materialPlans.DeleteValuesAndClear();
+			}
+
 			void AutomaticEffect::SetMaterialCustomParameter(const ResolvedEffectParameter& ep, Material* mtrl)
 			{
 				const MaterialCustomParameter* mcp = mtrl->getCustomParameter(ep.ReferenceSource->CustomMaterialParamName);
@@ -68,6 +68,13 @@ namespace Apoc3D
 				 */
 				virtual void Setup(Material* mtrl, const RenderOperation* rop, int count) = 0;
 
+				/**
+				 *  Called once by the RenderDevice with the whole group of render operations before Begin,
+				 *  when they will be set up one at a time. This allows values of each object to be
+				 *  computed for all of them at once.
+				 */
+				virtual void Prepare(Material* mtrl, const RenderOperation* rop, int32 count) { }
+
 				/**
 				 *  Some effects need to draw the mesh more than one time.
 				 *  So material-shape level multi-pass is supported here.
@@ -80,6 +87,12 @@ namespace Apoc3D
 				/** Check if the effect supports instancing. */
 				virtual bool SupportsInstancing() { return false; }
 
+				/** Check if the effect takes the instance transforms from the instance stream of InstancingData. */
+				virtual bool SupportsStreamInstancing() { return false; }
+
+				/** The number of instance blob values following the transform of each instance in the instance stream. */
+				virtual int32 getInstanceStreamBlobValueCount() { return 0; }
+
 				bool IsUnsupported() const { return m_isUnsupported; }
 				const String& getName() const { return m_name; }
 
@@ -113,6 +126,9 @@ namespace Apoc3D
 
 				virtual void Setup(Material* mtrl, const RenderOperation* rop, int32 count);
 
+				/** Computes the world-view-projection like transforms of all the render operations at once. */
+				virtual void Prepare(Material* mtrl, const RenderOperation* rop, int32 count);
+
 				virtual void BeginPass(int passId);
 				virtual void EndPass();
 
@@ -123,6 +139,13 @@ namespace Apoc3D
 				 */
 				virtual bool SupportsInstancing();
 
+				/**
+				 *  Check if the effect supports stream instancing, which is when a parameter with usage
+				 *  "tr_instancestream" is used.
+				 */
+				virtual bool SupportsStreamInstancing() { return m_supportsStreamInstancing; }
+				virtual int32 getInstanceStreamBlobValueCount() { return m_instanceStreamBlobValueCount; }
+
 				void Reload(const ResourceLocation& rl);
 
 				int32 FindParameterIndex(const String& name);
@@ -218,6 +241,48 @@ namespace Apoc3D
 				void SetTexture(const ResolvedEffectParameter& param, ResourceHandle<Texture>* value);
 				void SetTexture(const ResolvedEffectParameter& param, Texture* value);
 				
+				/** Where one material constant is read from, and where it goes in MaterialPlan::Constants. */
+				struct MaterialConstantSource
+				{
+					const void* Data;
+					int32 Size;			/** in bytes */
+					int32 Offset;		/** in float4s */
+				};
+
+				/** Constants in consecutive registers of a shader, set with one call. */
+				struct MaterialConstantRun
+				{
+					Shader* TargetShader;
+					CustomEffectParameterType Type;
+					int32 RegisterIndex;
+					int32 RegisterCount;
+					int32 Offset;		/** in float4s */
+				};
+
+				/**
+				 *  The material parameters of this effect resolved for one material, so no name lookups
+				 *  are done when the material is used again.
+				 *  Rebuilt when the material's custom parameters are changed.
+				 */
+				struct MaterialPlan
+				{
+					uint32 BatchID = 0;
+					uint32 ParameterVersion = 0;
+
+					List<MaterialConstantSource> Sources;
+					List<MaterialConstantRun> Runs;
+					List<Vector4> Constants;
+
+					/** Indices of parameters which are not float constants, like textures. Set one by one. */
+					List<int32> OtherParameters;
+				};
+
+				MaterialPlan* GetMaterialPlan(Material* mtrl);
+				void BuildMaterialPlan(MaterialPlan& plan, Material* mtrl);
+				void ApplyMaterialPlan(MaterialPlan& plan, Material* mtrl);
+				void SetMaterialParameter(const ResolvedEffectParameter& param, Material* mtrl);
+				void ClearMaterialPlans();
+
 				void SetInstanceBlobParameter(const ResolvedEffectParameter& param, const InstanceInfoBlobValue& v);
 				void SetMaterialCustomParameter(const ResolvedEffectParameter& param, Material* mtrl);
 				void SetSingleCustomParameter(const ResolvedEffectParameter& param, CustomEffectParameterType type, const void* data);
@@ -228,10 +293,25 @@ namespace Apoc3D
 				List<EffectParameter> m_parametersSrc;
 				List<ResolvedEffectParameter> m_parameters;
 
+				List<int32> m_materialParameters;		/** indices of parameters set once for each material */
+				List<int32> m_objectParameters;			/** indices of parameters set for each render operation */
+
+				HashMap<Material*, MaterialPlan*> m_materialPlans;
+
+				/** Transforms computed in Prepare, for the render operations from m_preparedOps. */
+				const RenderOperation* m_preparedOps = nullptr;
+				int32 m_preparedCount = 0;
+				List<Matrix> m_preparedWorlds;
+				List<Matrix> m_preparedWorldViewProj;
+				List<Matrix> m_preparedWorldView;
+				List<Matrix> m_preparedWorldViewOriProj;
+
 				RenderDevice* m_device;
 				Texture* m_whiteTexture;
 
 				bool m_supportsInstancing = false;
+				bool m_supportsStreamInstancing = false;
+				int32 m_instanceStreamBlobValueCount = 0;
 
 				float m_unifiedTime = 0;
 				float m_lastTime = 0;
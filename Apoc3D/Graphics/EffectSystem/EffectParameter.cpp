@@ -54,6 +54,7 @@ namespace Apoc3D
 				{ L"tr_invviewproj", EPUSAGE_Trans_InvViewProj },
 
 				{ L"tr_instanceworld", EPUSAGE_Trans_InstanceWorlds },
+				{ L"tr_instancestream", EPUSAGE_Trans_InstanceStream },
 
 				{ L"m4x3_bonestransform", EPUSAGE_M4X3_BoneTrans },
 				{ L"m4x4_bonestransform", EPUSAGE_M4X4_BoneTrans },
@@ -138,10 +139,13 @@ namespace Apoc3D
 					SamplerStateOverridenGroupName = br->ReadString();
 
 				DefaultTextureName = br->ReadString();
+
+				if (version >= 4)
+					InstanceStreamBlobCount = br->ReadInt32();
 			}
 			void EffectParameter::Write(BinaryWriter* bw)
 			{
-				bw->WriteInt32(3);
+				bw->WriteInt32(4);
 
 				bw->WriteString(Name);
 				bw->WriteString(EffectParameter::ToString(Usage));
@@ -163,6 +167,8 @@ namespace Apoc3D
 				bw->WriteString(SamplerStateOverridenGroupName);
 
 				bw->WriteString(DefaultTextureName);
+
+				bw->WriteInt32(InstanceStreamBlobCount);
 			}
 
 
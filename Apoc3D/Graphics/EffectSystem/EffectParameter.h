@@ -84,6 +84,15 @@ namespace Apoc3D
 				 *  InstancingData::MaxOneTimeInstances
 				 */
 				EPUSAGE_Trans_InstanceWorlds,
+
+				/**
+				 * tr_instancestream
+				 *  Marks an effect that reads the world transform of each instance from the per-instance
+				 *  vertex stream described in InstancingData, so any number of instances can be drawn at once.
+				 *  The InstanceStreamBlobCount of this parameter is the number of InstanceInfoBlob values following
+				 *  the transform in the stream. The parameter is set to the number of instances drawn.
+				 */
+				EPUSAGE_Trans_InstanceStream,
 				
 
 				EPUSAGE_M4X3_BoneTrans,			/** m4x3_bonestransform */
@@ -214,6 +223,8 @@ namespace Apoc3D
 
 				String CustomMaterialParamName;
 				int32 InstanceBlobIndex = -1;
+				/** For EPUSAGE_Trans_InstanceStream, the number of instance blob values in the stream after each transform. */
+				int32 InstanceStreamBlobCount = 0;
 
 				ShaderType ProgramType = ShaderType::Vertex;
 
@@ -2,10 +2,18 @@
 #include "RenderSystem/VertexDeclaration.h"
 #include "RenderSystem/HardwareBuffer.h"
 
+#include <atomic>
+
 namespace Apoc3D
 {
 	namespace Graphics
 	{
+		uint32 GeometryData::NewBatchID()
+		{
+			static std::atomic<uint32> counter(0);
+			return counter++;
+		}
+
 		void GeometryData::Setup(RenderSystem::VertexBuffer* vb, RenderSystem::IndexBuffer* ib, 
 			RenderSystem::VertexDeclaration* decl,
 			RenderSystem::PrimitiveType pt)
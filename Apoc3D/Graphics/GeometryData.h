@@ -53,14 +53,21 @@ namespace Apoc3D
 
 			bool Discard = false;
 
+			/** A number used to group render operations with the same geometry when batching. Copies share the same number. */
+			uint32 BatchID;
+
 			bool usesIndex() const { return IndexBuffer != nullptr; }
 
 			GeometryData()
+				: BatchID(NewBatchID())
 			{ }
 			~GeometryData() { }
 
 			void Setup(RenderSystem::VertexBuffer* vb, RenderSystem::IndexBuffer* ib, RenderSystem::VertexDeclaration* decl,
 				RenderSystem::PrimitiveType pt);
+
+		private:
+			static uint32 NewBatchID();
 			
 		};
 	};
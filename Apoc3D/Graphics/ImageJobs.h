@@ -0,0 +1,35 @@
+#pragma once
+#ifndef APOC3D_IMAGEJOBS_H
+#define APOC3D_IMAGEJOBS_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		/**
+		 *  Runs job(0) to job(jobCount - 1) for the image conversions, resizes and block compression,
+		 *  on the TaskScheduler's workers. Returns when all jobs are done. Implemented in PixelFormat.cpp.
+		 */
+		void RunImageJobs(int32 jobCount, FunctorReference<void(int32)> job, bool parallel);
+	}
+}
+
+#endif
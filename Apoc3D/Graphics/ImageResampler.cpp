@@ -0,0 +1,603 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "PixelFormat.h"
+#include "ImageJobs.h"
+
+#include "apoc3d/Math/Math.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <emmintrin.h>
+
+using namespace Apoc3D::Math;
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		/*
+		 *  The resampler filters rows first, then columns. Pixels are decoded into 4 floats, one for
+		 *  each channel in memory order, so both passes can work on whole pixels with SSE.
+		 *
+		 *  The output rows are cut into bands. Each band filters just the source rows it covers
+		 *  horizontally into its own buffer, so bands run in parallel without sharing anything and
+		 *  the memory used stays small even for big images. Rows near band borders are filtered
+		 *  by both bands; bands are tall enough to keep this cheap.
+		 */
+
+		/** The number of destination rows in a band */
+		const int32 BandHeight = 32;
+		/** Below this number of destination pixels, all bands run on the calling thread. */
+		const int32 ParallelThreshold = 256 * 256;
+
+		enum struct ChannelType
+		{
+			UNorm8,
+			UNorm16,
+			Float16,
+			Float32
+		};
+
+		struct PixelLayout
+		{
+			ChannelType Type;
+			int32 ChannelCount;
+			/** The channel holding alpha, -1 if none */
+			int32 AlphaIndex;
+		};
+
+		static bool GetPixelLayout(PixelFormat fmt, PixelLayout& layout)
+		{
+			// the alpha positions follow the converters in PixelFormat.cpp
+			switch (fmt)
+			{
+				case FMT_Luminance8:		layout = { ChannelType::UNorm8, 1, -1 }; return true;
+				case FMT_Alpha8:			layout = { ChannelType::UNorm8, 1, 0 }; return true;
+				case FMT_A8L8:				layout = { ChannelType::UNorm8, 2, 1 }; return true;
+				case FMT_R8G8B8:
+				case FMT_B8G8R8:			layout = { ChannelType::UNorm8, 3, -1 }; return true;
+				case FMT_A8R8G8B8:
+				case FMT_A8B8G8R8:			layout = { ChannelType::UNorm8, 4, 3 }; return true;
+				case FMT_B8G8R8A8:
+				case FMT_R8G8B8A8:			layout = { ChannelType::UNorm8, 4, 0 }; return true;
+				case FMT_X8R8G8B8:
+				case FMT_X8B8G8R8:			layout = { ChannelType::UNorm8, 4, -1 }; return true;
+
+				case FMT_Luminance16:		layout = { ChannelType::UNorm16, 1, -1 }; return true;
+				case FMT_G16R16:			layout = { ChannelType::UNorm16, 2, -1 }; return true;
+				case FMT_R16G16B16:			layout = { ChannelType::UNorm16, 3, -1 }; return true;
+				case FMT_A16B16G16R16:		layout = { ChannelType::UNorm16, 4, 0 }; return true;
+
+				case FMT_R16F:				layout = { ChannelType::Float16, 1, -1 }; return true;
+				case FMT_G16R16F:			layout = { ChannelType::Float16, 2, -1 }; return true;
+				case FMT_A16B16G16R16F:		layout = { ChannelType::Float16, 4, 0 }; return true;
+
+				case FMT_R32F:				layout = { ChannelType::Float32, 1, -1 }; return true;
+				case FMT_G32R32F:			layout = { ChannelType::Float32, 2, -1 }; return true;
+				case FMT_A32B32G32R32F:		layout = { ChannelType::Float32, 4, 0 }; return true;
+			}
+			return false;
+		}
+
+		/************************************************************************/
+		/*  Filters                                                             */
+		/************************************************************************/
+
+		static float Sinc(float x)
+		{
+			if (fabs(x) < 1e-5f)
+				return 1.0f;
+			x *= Math::PI;
+			return sinf(x) / x;
+		}
+
+		/** Zeroth order modified Bessel function of the first kind, for the Kaiser window */
+		static float BesselI0(float x)
+		{
+			float sum = 1.0f;
+			float term = 1.0f;
+			float halfX = x * 0.5f;
+			for (int32 k = 1; k < 32; k++)
+			{
+				term *= halfX / k;
+				float t2 = term * term;
+				sum += t2;
+				if (t2 < sum * 1e-8f)
+					break;
+			}
+			return sum;
+		}
+
+		struct FilterFunction
+		{
+			ResizeFilter Type;
+			float Support;
+
+			static const int32 WindowSize = 3;
+			static constexpr float KaiserAlpha = 4.0f;
+
+			FilterFunction(ResizeFilter type)
+				: Type(type)
+			{
+				switch (type)
+				{
+					case ResizeFilter::Box: Support = 0.5f; break;
+					case ResizeFilter::Triangle: Support = 1.0f; break;
+					default: Support = (float)WindowSize; break;
+				}
+			}
+
+			float Evaluate(float x) const
+			{
+				x = fabs(x);
+				switch (Type)
+				{
+					case ResizeFilter::Box:
+						return x <= 0.5f ? 1.0f : 0.0f;
+					case ResizeFilter::Triangle:
+						return x < 1.0f ? 1.0f - x : 0.0f;
+					case ResizeFilter::Lanczos:
+						return x < WindowSize ? Sinc(x) * Sinc(x / WindowSize) : 0.0f;
+					case ResizeFilter::Kaiser:
+					{
+						if (x >= WindowSize)
+							return 0.0f;
+						float t = x / WindowSize;
+						return Sinc(x) * BesselI0(KaiserAlpha * sqrtf(1.0f - t * t)) / BesselI0(KaiserAlpha);
+					}
+				}
+				return 0.0f;
+			}
+		};
+
+		/**
+		 *  The weights of the source pixels for every destination pixel along one axis.
+		 *  Each destination pixel reads a continuous range of source pixels; taps outside the image are
+		 *  folded onto the edge pixels.
+		 */
+		struct FilterKernel
+		{
+			List<int32> First;
+			List<int32> Count;
+			/** Weights of each destination pixel, Stride apart */
+			List<float> Weights;
+			int32 Stride = 0;
+
+			void Build(const FilterFunction& filter, int32 srcSize, int32 dstSize)
+			{
+				const float scale = (float)dstSize / srcSize;
+				// when reducing, the filter is stretched to cover all the source pixels
+				const float filterScale = Math::Min(scale, 1.0f);
+				const float radius = filter.Support / filterScale;
+
+				Stride = (int32)ceilf(radius * 2) + 2;
+
+				First.ReserveDiscard(dstSize);
+				Count.ReserveDiscard(dstSize);
+				Weights.ReserveDiscard(dstSize * Stride);
+
+				for (int32 i = 0; i < dstSize; i++)
+				{
+					float center = (i + 0.5f) / scale;
+					int32 left = (int32)floorf(center - radius);
+					int32 right = (int32)ceilf(center + radius);
+
+					int32 first = Math::Clamp(left, 0, srcSize - 1);
+					int32 last = Math::Clamp(right, 0, srcSize - 1);
+					if (last - first + 1 > Stride)
+						last = first + Stride - 1;
+
+					float* w = &Weights[i * Stride];
+					float sum = 0;
+					for (int32 j = left; j <= right; j++)
+					{
+						float v = filter.Evaluate((j + 0.5f - center) * filterScale);
+						if (v == 0)
+							continue;
+
+						int32 k = Math::Clamp(j, first, last) - first;
+						w[k] += v;
+						sum += v;
+					}
+
+					if (sum != 0)
+					{
+						for (int32 k = 0; k <= last - first; k++)
+							w[k] /= sum;
+
+						// drop the taps at the ends that got no weight
+						int32 lead = 0;
+						while (lead < last - first && w[lead] == 0)
+							lead++;
+						if (lead > 0)
+						{
+							memmove(w, w + lead, sizeof(float) * (last - first + 1 - lead));
+							memset(w + last - first + 1 - lead, 0, sizeof(float) * lead);
+							first += lead;
+						}
+						while (last > first && w[last - first] == 0)
+							last--;
+					}
+					else
+					{
+						// can happen with the box filter when enlarging; take the nearest pixel
+						first = last = Math::Clamp((int32)center, 0, srcSize - 1);
+						w[0] = 1;
+					}
+
+					First[i] = first;
+					Count[i] = last - first + 1;
+				}
+			}
+		};
+
+		/************************************************************************/
+		/*  Channel conversion                                                  */
+		/************************************************************************/
+
+		static float SRGBToLinear(float v)
+		{
+			return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+		}
+		static float LinearToSRGB(float v)
+		{
+			return v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+		}
+
+		/** Tables for 8-bit channels, so the gamma curve is not evaluated per pixel */
+		struct ByteTables
+		{
+			static const int32 SRGBStartSize = 4096;
+
+			float ToFloat[256];
+			float SRGBToLinear[256];
+			/** Linear values half way between two sRGB codes. The code of a value is the number of these below it. */
+			float SRGBThresholds[256];
+			/** The code of each of the evenly spaced linear values, where the search for codes starts */
+			byte SRGBStart[SRGBStartSize];
+
+			ByteTables()
+			{
+				for (int32 i = 0; i < 256; i++)
+				{
+					ToFloat[i] = i / 255.0f;
+					SRGBToLinear[i] = Graphics::SRGBToLinear(i / 255.0f);
+				}
+				for (int32 i = 0; i < 255; i++)
+				{
+					SRGBThresholds[i] = Graphics::SRGBToLinear((i + 0.5f) / 255.0f);
+				}
+				// a sentinel, so the search always stops at 255
+				SRGBThresholds[255] = FLT_MAX;
+
+				for (int32 i = 0; i < SRGBStartSize; i++)
+				{
+					float v = (float)i / (SRGBStartSize - 1);
+					SRGBStart[i] = (byte)(std::upper_bound(SRGBThresholds, SRGBThresholds + 255, v) - SRGBThresholds);
+				}
+			}
+
+			byte EncodeSRGB(float v) const
+			{
+				v = Math::Saturate(v);
+
+				// the start is exact or a few codes low in the dark range, where the curve is steep
+				int32 code = SRGBStart[(int32)(v * (SRGBStartSize - 1))];
+				while (SRGBThresholds[code] <= v)
+					code++;
+				return (byte)code;
+			}
+		};
+
+		static const ByteTables& GetByteTables()
+		{
+			static ByteTables tables;
+			return tables;
+		}
+
+		static byte EncodeUNorm8(float v)
+		{
+			return (byte)(Math::Saturate(v) * 255.0f + 0.5f);
+		}
+		static uint16 EncodeUNorm16(float v)
+		{
+			return (uint16)(Math::Saturate(v) * 65535.0f + 0.5f);
+		}
+
+		/************************************************************************/
+		/*  Resampler                                                           */
+		/************************************************************************/
+
+		class ImageResampler
+		{
+		public:
+			ImageResampler(const void* src, int32 srcWidth, int32 srcHeight, void* dst, int32 dstWidth, int32 dstHeight,
+				const PixelLayout& layout, const ResizeOptions& options)
+				: m_src(reinterpret_cast<const byte*>(src)), m_srcWidth(srcWidth), m_srcHeight(srcHeight)
+				, m_dst(reinterpret_cast<byte*>(dst)), m_dstWidth(dstWidth), m_dstHeight(dstHeight)
+				, m_layout(layout), m_tables(GetByteTables())
+			{
+				FilterFunction filter(options.Filter);
+				m_horizontal.Build(filter, srcWidth, dstWidth);
+				m_vertical.Build(filter, srcHeight, dstHeight);
+
+				m_premultiply = options.PremultipliedAlpha && layout.AlphaIndex != -1 && layout.ChannelCount > 1;
+				m_gamma = options.GammaCorrect && (layout.Type == ChannelType::UNorm8 || layout.Type == ChannelType::UNorm16);
+
+				int32 channelSize = layout.Type == ChannelType::UNorm8 ? 1 : (layout.Type == ChannelType::Float32 ? 4 : 2);
+				m_pixelSize = channelSize * layout.ChannelCount;
+			}
+
+			int32 getBandCount() const { return (m_dstHeight + BandHeight - 1) / BandHeight; }
+
+			void ProcessBand(int32 band)
+			{
+				const int32 dstStart = band * BandHeight;
+				const int32 dstEnd = Math::Min(dstStart + BandHeight, m_dstHeight);
+
+				// the source rows this band reads
+				int32 srcFirst = m_srcHeight;
+				int32 srcEnd = 0;
+				for (int32 y = dstStart; y < dstEnd; y++)
+				{
+					srcFirst = Math::Min(srcFirst, m_vertical.First[y]);
+					srcEnd = Math::Max(srcEnd, m_vertical.First[y] + m_vertical.Count[y]);
+				}
+
+				const int32 rowFloats = m_dstWidth * 4;
+				List<float> rows;
+				rows.ReserveDiscard(rowFloats * (srcEnd - srcFirst));
+
+				List<float> line;
+				line.ReserveDiscard(Math::Max(m_srcWidth, m_dstWidth) * 4);
+
+				for (int32 y = srcFirst; y < srcEnd; y++)
+				{
+					DecodeRow(m_src + (size_t)y * m_srcWidth * m_pixelSize, line.getElements());
+					FilterRow(line.getElements(), &rows[(y - srcFirst) * rowFloats]);
+				}
+
+				for (int32 y = dstStart; y < dstEnd; y++)
+				{
+					FilterColumns(y, rows.getElements() + (m_vertical.First[y] - srcFirst) * rowFloats, line.getElements());
+					EncodeRow(line.getElements(), m_dst + (size_t)y * m_dstWidth * m_pixelSize);
+				}
+			}
+
+		private:
+			void FilterRow(const float* src, float* dst) const
+			{
+				const FilterKernel& k = m_horizontal;
+				for (int32 x = 0; x < m_dstWidth; x++)
+				{
+					const float* s = src + k.First[x] * 4;
+					const float* w = &k.Weights[x * k.Stride];
+
+					__m128 acc = _mm_setzero_ps();
+					for (int32 i = 0; i < k.Count[x]; i++)
+					{
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + i * 4), _mm_set1_ps(w[i])));
+					}
+					_mm_storeu_ps(dst + x * 4, acc);
+				}
+			}
+
+			void FilterColumns(int32 y, const float* rows, float* dst) const
+			{
+				const int32 rowFloats = m_dstWidth * 4;
+				const int32 count = m_vertical.Count[y];
+				const float* w = &m_vertical.Weights[y * m_vertical.Stride];
+
+				// every pixel is a group of 4, so the row length is a multiple of 4 floats
+				for (int32 i = 0; i < rowFloats; i += 4)
+				{
+					const float* s = rows + i;
+
+					__m128 acc = _mm_setzero_ps();
+					for (int32 j = 0; j < count; j++)
+					{
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + j * rowFloats), _mm_set1_ps(w[j])));
+					}
+					_mm_storeu_ps(dst + i, acc);
+				}
+			}
+
+			void DecodeRow(const byte* src, float* dst) const
+			{
+				const int32 channels = m_layout.ChannelCount;
+				const int32 count = m_srcWidth * channels;
+
+				// channels are decoded into the first lanes of each pixel, the rest stay 0
+				if (channels < 4)
+					memset(dst, 0, sizeof(float) * 4 * m_srcWidth);
+
+				switch (m_layout.Type)
+				{
+					case ChannelType::UNorm8:
+					{
+						const float* tables[4];
+						for (int32 c = 0; c < 4; c++)
+							tables[c] = m_gamma && c != m_layout.AlphaIndex ? m_tables.SRGBToLinear : m_tables.ToFloat;
+
+						if (channels == 4)
+						{
+							for (int32 x = 0; x < m_srcWidth; x++, src += 4, dst += 4)
+							{
+								dst[0] = tables[0][src[0]];
+								dst[1] = tables[1][src[1]];
+								dst[2] = tables[2][src[2]];
+								dst[3] = tables[3][src[3]];
+							}
+							dst -= m_srcWidth * 4;
+						}
+						else
+						{
+							for (int32 i = 0; i < count; i++)
+							{
+								int32 c = i % channels;
+								dst[(i / channels) * 4 + c] = tables[c][src[i]];
+							}
+						}
+						break;
+					}
+					case ChannelType::UNorm16:
+					{
+						const uint16* s = reinterpret_cast<const uint16*>(src);
+						for (int32 i = 0; i < count; i++)
+						{
+							int32 c = i % channels;
+							float v = s[i] / 65535.0f;
+							dst[(i / channels) * 4 + c] = m_gamma && c != m_layout.AlphaIndex ? SRGBToLinear(v) : v;
+						}
+						break;
+					}
+					case ChannelType::Float16:
+					{
+						const uint16* s = reinterpret_cast<const uint16*>(src);
+						for (int32 i = 0; i < count; i++)
+							dst[(i / channels) * 4 + i % channels] = R16ToR32(s[i]);
+						break;
+					}
+					case ChannelType::Float32:
+					{
+						const float* s = reinterpret_cast<const float*>(src);
+						for (int32 i = 0; i < count; i++)
+							dst[(i / channels) * 4 + i % channels] = s[i];
+						break;
+					}
+				}
+
+				if (m_premultiply)
+				{
+					const int32 alpha = m_layout.AlphaIndex;
+					for (int32 x = 0; x < m_srcWidth; x++)
+					{
+						float* p = dst + x * 4;
+						float a = p[alpha];
+						for (int32 c = 0; c < channels; c++)
+						{
+							if (c != alpha)
+								p[c] *= a;
+						}
+					}
+				}
+			}
+
+			void EncodeRow(float* src, byte* dst) const
+			{
+				const int32 channels = m_layout.ChannelCount;
+				const int32 alpha = m_layout.AlphaIndex;
+				const int32 count = m_dstWidth * channels;
+
+				if (m_premultiply)
+				{
+					for (int32 x = 0; x < m_dstWidth; x++)
+					{
+						float* p = src + x * 4;
+						float a = p[alpha];
+						float invA = a > 0 ? 1.0f / a : 0.0f;
+						for (int32 c = 0; c < channels; c++)
+						{
+							if (c != alpha)
+								p[c] *= invA;
+						}
+					}
+				}
+
+				switch (m_layout.Type)
+				{
+					case ChannelType::UNorm8:
+						for (int32 i = 0; i < count; i++)
+						{
+							int32 c = i % channels;
+							float v = src[(i / channels) * 4 + c];
+							dst[i] = m_gamma && c != alpha ? m_tables.EncodeSRGB(v) : EncodeUNorm8(v);
+						}
+						break;
+					case ChannelType::UNorm16:
+					{
+						uint16* d = reinterpret_cast<uint16*>(dst);
+						for (int32 i = 0; i < count; i++)
+						{
+							int32 c = i % channels;
+							float v = src[(i / channels) * 4 + c];
+							d[i] = EncodeUNorm16(m_gamma && c != alpha ? LinearToSRGB(Math::Saturate(v)) : v);
+						}
+						break;
+					}
+					case ChannelType::Float16:
+					{
+						uint16* d = reinterpret_cast<uint16*>(dst);
+						for (int32 i = 0; i < count; i++)
+							d[i] = R32ToR16(src[(i / channels) * 4 + i % channels]);
+						break;
+					}
+					case ChannelType::Float32:
+					{
+						float* d = reinterpret_cast<float*>(dst);
+						for (int32 i = 0; i < count; i++)
+							d[i] = src[(i / channels) * 4 + i % channels];
+						break;
+					}
+				}
+			}
+
+			const byte* m_src;
+			int32 m_srcWidth;
+			int32 m_srcHeight;
+			byte* m_dst;
+			int32 m_dstWidth;
+			int32 m_dstHeight;
+
+			PixelLayout m_layout;
+			int32 m_pixelSize;
+			bool m_premultiply;
+			bool m_gamma;
+
+			FilterKernel m_horizontal;
+			FilterKernel m_vertical;
+
+			const ByteTables& m_tables;
+		};
+
+		bool PixelFormatUtils::CanResize(PixelFormat format)
+		{
+			PixelLayout layout;
+			return GetPixelLayout(format, layout);
+		}
+
+		bool PixelFormatUtils::Resize(const void* src, int srcWidth, int srcHeight,
+			void* dst, int dstWidth, int dstHeight, PixelFormat format, const ResizeOptions& options)
+		{
+			PixelLayout layout;
+			if (!GetPixelLayout(format, layout))
+				return false;
+
+			if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0)
+				return true;
+
+			ImageResampler resampler(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, layout, options);
+			FunctorReference<void(int32)> job(&resampler, &ImageResampler::ProcessBand);
+
+			const int32 bandCount = resampler.getBandCount();
+			bool parallel = options.Parallel && bandCount > 1 && dstWidth * dstHeight >= ParallelThreshold;
+
+			RunImageJobs(bandCount, job, parallel);
+			return true;
+		}
+	}
+}
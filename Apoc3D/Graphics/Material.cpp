@@ -29,6 +29,8 @@
 #include "apoc3d/Vfs/FileLocateRule.h"
 #include "apoc3d/Vfs/ResourceLocation.h"
 
+#include <atomic>
+
 using namespace Apoc3D::VFS;
 using namespace Apoc3D::Utility;
 
@@ -36,8 +38,10 @@ namespace Apoc3D
 {
 	namespace Graphics
 	{
+		static std::atomic<uint32> s_materialBatchIDCounter(0);
+
 		Material::Material(RenderDevice* device)
-			: m_device(device)
+			: m_device(device), m_batchID(s_materialBatchIDCounter++)
 		{
 			ZeroArray(m_tex);
 			ZeroArray(m_effects);
@@ -55,7 +59,8 @@ namespace Apoc3D
 			Ambient(m.Ambient), Diffuse(m.Diffuse), Specular(m.Specular), Emissive(m.Emissive), Power(m.Power),
 			Cull(m.Cull),
 			ExternalReferenceName(m.ExternalReferenceName),
-			m_customParametrs(m.m_customParametrs), m_effectName(m.m_effectName), m_texName(m.m_texName)
+			m_customParametrs(m.m_customParametrs), m_effectName(m.m_effectName), m_texName(m.m_texName),
+			m_batchID(s_materialBatchIDCounter++)
 		{
 			CopyArray(m_texDirty, m.m_texDirty);
 			ZeroArray(m_tex);
@@ -95,6 +100,7 @@ namespace Apoc3D
 			else
 			{
 				m_customParametrs.Add(value.Usage, value);
+				m_parameterVersion++;
 			}
 		}
 
@@ -174,6 +180,7 @@ namespace Apoc3D
 			ExternalReferenceName = mdata.ExternalRefName;
 
 			m_customParametrs = mdata.CustomParametrs;
+			m_parameterVersion++;
 			m_passFlags = mdata.PassFlags;
 			m_colorWriteMasks = mdata.ColorWriteMasks;
 			m_priority = mdata.Priority;
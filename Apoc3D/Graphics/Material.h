@@ -77,6 +77,9 @@ namespace Apoc3D
 			const MaterialCustomParameter* getCustomParameter(const String& usage) const;
 			void AddCustomParameter(const MaterialCustomParameter& value);
 
+			/** Changes every time custom parameters are added or replaced. Effects use this to know their cached lookups are out of date. */
+			uint32 getParameterVersion() const { return m_parameterVersion; }
+
 			const String& GetPassEffectName(int32 index);
 			void SetPassEffectName(int32 index, const String& en);
 			/** 
@@ -126,6 +129,9 @@ namespace Apoc3D
 			uint64 getPassFlags() const { return m_passFlags; }
 			void setPassFlags(uint64 val) { m_passFlags = val; }
 
+			/** A number unique to each material instance, used to group render operations when batching. */
+			uint32 getBatchID() const { return m_batchID; }
+
 			ColorWriteMasks GetTargetWriteMask(uint32 rtIndex) const;
 			void SetTargetWriteMask(uint32 rtIndex, ColorWriteMasks masks);
 
@@ -174,6 +180,9 @@ namespace Apoc3D
 
 			uint32 m_priority = DefaultMaterialPriority;
 
+			uint32 m_batchID;
+			uint32 m_parameterVersion = 0;
+
 			void LoadTexture(int32 index);
 			void LoadEffect(int32 index);
 		};
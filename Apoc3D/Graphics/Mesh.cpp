@@ -74,6 +74,38 @@ namespace Apoc3D
 			m_vertexBuffer->Unlock();
 			
 			// index data
+			if (data->Parts.getCount() > 0)
+			{
+				// the indices were split per sub part when the mesh was built, copy them straight in
+				assert(data->Parts.getCount() == matCount);
+
+				IndexBufferFormat format = data->PartIndices16 ? IndexBufferFormat::Bit16 : IndexBufferFormat::Bit32;
+				int32 indexSize = data->PartIndices16 ? sizeof(ushort) : sizeof(uint32);
+
+				m_primitiveCount = 0;
+				for (int32 i = 0; i < matCount; i++)
+				{
+					const MeshPart& part = data->Parts[i];
+					SubPart& sp = m_subParts[i];
+
+					sp.PrimitiveCount = part.IndexCount / 3;
+					sp.VertexCount = part.VertexCount;
+					sp.VertexRangeUsedStart = part.VertexRangeStart;
+					sp.VertexRangeUsedCount = part.VertexRangeCount;
+
+					sp.Indices = m_factory->CreateIndexBuffer(format, part.IndexCount, BU_Static);
+					if (part.IndexCount > 0)
+					{
+						void* idst = sp.Indices->Lock(0, 0, LOCK_None);
+						memcpy(idst, data->PartIndexData + part.IndexStart * indexSize, part.IndexCount * indexSize);
+						sp.Indices->Unlock();
+					}
+
+					m_primitiveCount += sp.PrimitiveCount;
+				}
+				return;
+			}
+
 			bool useIndex16 = vertexCount <= MaxUInt16;
 			List<uint>* partIndices = new List<uint>[matCount];
 
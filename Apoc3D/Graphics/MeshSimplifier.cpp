@@ -1,459 +1,546 @@
 #include "MeshSimplifier.h"
 #include "apoc3d/Math/Math.h"
 
+#include <algorithm>
+
 namespace Apoc3D
 {
 	namespace Graphics
 	{
-		struct Triangle;
-		struct Vertex;
-		
-		struct Vertex
+		namespace MeshSimplifier
 		{
-			/**
-			 *  location of point in euclidean space
-			 */
-			Vector3 m_position;
-			/**
-			 *  place of vertex in original list
-			 */
-			int m_id;
-			/**
-			 *  adjacent vertices
-			 */
-			List<Vertex*> m_neighbour;
-			/**
-			 *  adjacent triangles
-			 */
-			List<Triangle*> m_face;
-			/**
-			 *  cached cost of collapsing edge
-			 */
-			float m_objdist;
-			/**
-			 *  candidate vertex for collapse
-			 */
-			Vertex* m_collapse;
-
-			Vertex(Vector3 v, int _id)
-				: m_position(v), m_id(_id) { }
+			/** The weight of the planes keeping open borders in place, relative to the faces' */
+			const double BorderWeight = 10.0;
+			/** Added to the cost of collapses that would flip a face, so they are done last */
+			const float FlipPenalty = 1e10f;
 
-			~Vertex();
+			/** Symmetric 4x4 matrix of plane equations, the sum of p * p^T for each plane p */
+			struct Quadric
+			{
+				double A2, AB, AC, AD;
+				double B2, BC, BD;
+				double C2, CD;
+				double D2;
 
-			void RemoveIfNonNeighbour(Vertex* n);
-		};
+				void Clear() { A2 = AB = AC = AD = B2 = BC = BD = C2 = CD = D2 = 0; }
 
-		struct Triangle
-		{
-			/**
-			 *  the 3 points that make this triangle
-			 */
-			Vertex* m_vertex[3]; 
-			/**
-			 *  unit vector orthogonal to this face
-			 */
-			Vector3 m_normal;
+				void AddPlane(double a, double b, double c, double d, double weight)
+				{
+					A2 += weight * a * a; AB += weight * a * b; AC += weight * a * c; AD += weight * a * d;
+					B2 += weight * b * b; BC += weight * b * c; BD += weight * b * d;
+					C2 += weight * c * c; CD += weight * c * d;
+					D2 += weight * d * d;
+				}
 
-			Triangle(Vertex *v0, Vertex *v1, Vertex *v2);
-			~Triangle();
+				/** The weighted sum of squared distances from the point to the planes */
+				double Evaluate(const Vector3& p) const
+				{
+					double x = p.X, y = p.Y, z = p.Z;
+					return A2 * x * x + 2 * AB * x * y + 2 * AC * x * z + 2 * AD * x
+						+ B2 * y * y + 2 * BC * y * z + 2 * BD * y
+						+ C2 * z * z + 2 * CD * z
+						+ D2;
+				}
 
-			void ComputeNormal();
-			void ReplaceVertex(Vertex *vold, Vertex *vnew);
+				void Add(const Quadric& o)
+				{
+					A2 += o.A2; AB += o.AB; AC += o.AC; AD += o.AD;
+					B2 += o.B2; BC += o.BC; BD += o.BD;
+					C2 += o.C2; CD += o.CD;
+					D2 += o.D2;
+				}
+			};
 
-			int HasVertex(Vertex *v) const
+			/**
+			 *  Vertices are collapsed one at a time, always taking the cheapest one from a heap. Costs
+			 *  are updated lazily: a changed cost is pushed again with a new version, and stale entries
+			 *  are skipped when they come up.
+			 *
+			 *  Adjacency is kept in flat arrays. The faces of each original vertex are stored once, and
+			 *  collapsed vertices are tracked with union find, so the faces of a vertex are the ones of
+			 *  all the vertices merged into it. Those are linked in a circular list which two collapsing
+			 *  vertices join in constant time.
+			 */
+			class QuadricCollapse
 			{
-				return v == m_vertex[0] || v == m_vertex[1] || v == m_vertex[2];
-			}
-		};
-		
-		struct WorkingData
-		{
-			List<Triangle*> m_triangles;
-			List<Vertex*> m_vertices;
-
-			WorkingData(const List<Vector3>& vert, const List<MeshFace>& tri);
-			~WorkingData();
+			public:
+				QuadricCollapse(const List<Vector3>& vert, const List<MeshFace>& tri);
 
-			void AddVertices(const List<Vector3>& vert);
-			void AddFaces(const List<MeshFace>& tri);
+				void Run(List<int>& map, List<int>& permutation, List<int32>& faceCounts);
 
-			Vertex* MinimumCostEdge();
-			void ComputeAllEdgeCollapseCosts();
-			void Collapse(Vertex* u, Vertex* v);
+			private:
+				struct HeapEntry
+				{
+					float Cost;
+					int32 Vertex;
+					int32 Version;
 
-			void ProgressiveMesh(List<int>& map, List<int>& permutation);
-		};
+					bool operator<(const HeapEntry& o) const { return Cost > o.Cost; }
+				};
 
-		void MeshSimplifier::ProgressiveMesh(const List<Vector3>& vert, const List<MeshFace>& tri, 
-			List<int>& map, List<int>& permutation)
-		{
-			WorkingData wd(vert, tri);
+				void BuildAdjacency();
+				void BuildQuadrics();
 
-			wd.ProgressiveMesh(map, permutation);
+				int32 Find(int32 v);
 
-			// rearrange the vertex list 
-			//for(int i=0;i<vert.num;i++)
-			//{
-			//	new_vert[permutation[i]]=vert[i];
-			//}
-		}
+				template <typename Func>
+				void ForEachFace(int32 v, Func f)
+				{
+					int32 w = v;
+					do
+					{
+						for (int32 i = m_faceStart[w]; i < m_faceStart[w + 1]; i++)
+						{
+							int32 face = m_vertexFaces[i];
+							if (m_faceAlive[face])
+								f(face);
+						}
+						w = m_groupNext[w];
+					} while (w != v);
+				}
 
+				struct RingFace
+				{
+					int32 Corners[3];
+				};
+
+				void GetCorners(int32 face, int32 c[3]);
+				void GatherNeighbors(int32 v, List<int32>& result);
+				bool FlipsFace(int32 u, int32 v) const;
+				void UpdateCost(int32 v);
+				void Collapse(int32 u, int32 v);
+
+				const List<Vector3>& m_positions;
+				const List<MeshFace>& m_faces;
+				int32 m_vertexCount;
+				int32 m_aliveFaceCount = 0;
+
+				// faces of each original vertex, m_vertexFaces[m_faceStart[v]] to m_vertexFaces[m_faceStart[v + 1]]
+				List<int32> m_faceStart;
+				List<int32> m_vertexFaces;
+				List<byte> m_faceAlive;
+
+				List<int32> m_parent;
+				List<int32> m_groupNext;
+				List<byte> m_vertexAlive;
+
+				List<Quadric> m_quadrics;
+				List<int32> m_target;
+				List<int32> m_version;
+				List<HeapEntry> m_heap;
+
+				List<int32> m_visitMark;
+				int32 m_visitStamp = 0;
+				List<int32> m_neighbors;
+				List<int32> m_affected;
+				/** The faces around the vertex whose cost is being updated */
+				List<RingFace> m_ring;
+			};
+
+			QuadricCollapse::QuadricCollapse(const List<Vector3>& vert, const List<MeshFace>& tri)
+				: m_positions(vert), m_faces(tri), m_vertexCount(vert.getCount())
+			{
+				m_parent.ReserveDiscard(m_vertexCount);
+				m_groupNext.ReserveDiscard(m_vertexCount);
+				m_vertexAlive.ReserveDiscard(m_vertexCount);
+				m_target.ReserveDiscard(m_vertexCount);
+				m_version.ReserveDiscard(m_vertexCount);
+				m_visitMark.ReserveDiscard(m_vertexCount);
+
+				for (int32 i = 0; i < m_vertexCount; i++)
+				{
+					m_parent[i] = i;
+					m_groupNext[i] = i;
+					m_vertexAlive[i] = 1;
+					m_target[i] = -1;
+					m_version[i] = 0;
+					m_visitMark[i] = 0;
+				}
 
-		//////////////////////////////////////////////////////////////////////////
+				BuildAdjacency();
+				BuildQuadrics();
+			}
 
-		Vertex::~Vertex()
-		{
-			assert(m_face.getCount()==0);
-			while (m_neighbour.getCount())
+			void QuadricCollapse::BuildAdjacency()
 			{
-				m_neighbour[0]->m_neighbour.Remove(this);
-				m_neighbour.Remove(m_neighbour[0]);
-			}
-		}
+				const int32 faceCount = m_faces.getCount();
 
-		void Vertex::RemoveIfNonNeighbour(Vertex* n)
-		{
-			// removes n from neighbor list if n isn't a neighbor.
-			if (!m_neighbour.Contains(n))
-				return;
+				m_faceAlive.ReserveDiscard(faceCount);
+				m_faceStart.ReserveDiscard(m_vertexCount + 1);
+				for (int32 i = 0; i <= m_vertexCount; i++)
+					m_faceStart[i] = 0;
 
-			for (int i=0;i<m_face.getCount();i++)
-			{
-				if (m_face[i]->HasVertex(n))
-					return;
-			}
-			m_neighbour.Remove(n);
-		}
+				for (int32 i = 0; i < faceCount; i++)
+				{
+					const MeshFace& f = m_faces[i];
+					bool valid = f.IndexA != f.IndexB && f.IndexB != f.IndexC && f.IndexC != f.IndexA;
+					m_faceAlive[i] = valid ? 1 : 0;
+
+					if (valid)
+					{
+						m_faceStart[f.IndexA + 1]++;
+						m_faceStart[f.IndexB + 1]++;
+						m_faceStart[f.IndexC + 1]++;
+						m_aliveFaceCount++;
+					}
+				}
 
-		//////////////////////////////////////////////////////////////////////////
+				for (int32 i = 0; i < m_vertexCount; i++)
+					m_faceStart[i + 1] += m_faceStart[i];
 
-		Triangle::Triangle(Vertex* v0, Vertex* v1, Vertex* v2)
-		{
-			assert(v0!=v1 && v1!=v2 && v2!=v0);
-			m_vertex[0]=v0;
-			m_vertex[1]=v1;
-			m_vertex[2]=v2;
-			ComputeNormal();
-			for(int i=0;i<3;i++) 
-			{
-				m_vertex[i]->m_face.Add(this);
-				for(int j=0;j<3;j++) if(i!=j) 
+				List<int32> fill(m_faceStart);
+				m_vertexFaces.ReserveDiscard(m_faceStart[m_vertexCount]);
+				for (int32 i = 0; i < faceCount; i++)
 				{
-					if (!m_vertex[i]->m_neighbour.Contains(m_vertex[j]))
-						m_vertex[i]->m_neighbour.Add(m_vertex[j]);
+					if (m_faceAlive[i])
+					{
+						const MeshFace& f = m_faces[i];
+						m_vertexFaces[fill[f.IndexA]++] = i;
+						m_vertexFaces[fill[f.IndexB]++] = i;
+						m_vertexFaces[fill[f.IndexC]++] = i;
+					}
 				}
 			}
-		}
-		Triangle::~Triangle()
-		{
-			int i;
-			for(i=0;i<3;i++)
+
+			static uint64 EdgeKey(int32 a, int32 b)
 			{
-				if(m_vertex[i]) 
-					m_vertex[i]->m_face.Remove(this);
+				if (a > b) std::swap(a, b);
+				return ((uint64)(uint32)a << 32) | (uint32)b;
 			}
-			for(i=0;i<3;i++)
+
+			void QuadricCollapse::BuildQuadrics()
 			{
-				int i2 = (i+1)%3;
-				if(!m_vertex[i] || !m_vertex[i2]) continue;
-				m_vertex[i ]->RemoveIfNonNeighbour(m_vertex[i2]);
-				m_vertex[i2]->RemoveIfNonNeighbour(m_vertex[i ]);
-			}
-		}
+				const int32 faceCount = m_faces.getCount();
 
-		void Triangle::ComputeNormal()
-		{
-			Vector3 v0=m_vertex[0]->m_position;
-			Vector3 v1=m_vertex[1]->m_position;
-			Vector3 v2=m_vertex[2]->m_position;
-
-			v0 = v1 - v0;
-			v1 = v2 - v1;
-			m_normal = Vector3::Cross(v0, v1);
-			m_normal.NormalizeInPlace();
-		}
+				m_quadrics.ReserveDiscard(m_vertexCount);
+				for (Quadric& q : m_quadrics)
+					q.Clear();
 
-		void Triangle::ReplaceVertex(Vertex *vold, Vertex *vnew)
-		{
-			assert(vold && vnew);
-			assert(vold==m_vertex[0] || vold==m_vertex[1] || vold==m_vertex[2]);
-			assert(vnew!=m_vertex[0] && vnew!=m_vertex[1] && vnew!=m_vertex[2]);
+				// edges used by only one face are on an open border
+				List<uint64> edges(m_aliveFaceCount * 3);
+				for (int32 i = 0; i < faceCount; i++)
+				{
+					if (m_faceAlive[i])
+					{
+						const MeshFace& f = m_faces[i];
+						edges.Add(EdgeKey(f.IndexA, f.IndexB));
+						edges.Add(EdgeKey(f.IndexB, f.IndexC));
+						edges.Add(EdgeKey(f.IndexC, f.IndexA));
+					}
+				}
+				std::sort(edges.begin(), edges.end());
 
-			if(vold==m_vertex[0])
-			{
-				m_vertex[0]=vnew;
-			}
-			else if(vold==m_vertex[1])
-			{
-				m_vertex[1]=vnew;
+				for (int32 i = 0; i < faceCount; i++)
+				{
+					if (!m_faceAlive[i])
+						continue;
+
+					const MeshFace& f = m_faces[i];
+					const int32 idx[3] = { f.IndexA, f.IndexB, f.IndexC };
+					const Vector3& p0 = m_positions[idx[0]];
+
+					Vector3 n = Vector3::Cross(m_positions[idx[1]] - p0, m_positions[idx[2]] - p0);
+					float len = n.Length();
+					if (len <= 0)
+						continue;
+					n /= len;
+
+					// weighted by area so small faces do not count as much as big ones
+					double d = -Vector3::Dot(n, p0);
+					double area = len * 0.5;
+					for (int32 j = 0; j < 3; j++)
+						m_quadrics[idx[j]].AddPlane(n.X, n.Y, n.Z, d, area);
+
+					for (int32 j = 0; j < 3; j++)
+					{
+						int32 a = idx[j];
+						int32 b = idx[(j + 1) % 3];
+
+						uint64 key = EdgeKey(a, b);
+						auto range = std::equal_range(edges.begin(), edges.end(), key);
+						if (range.second - range.first != 1)
+							continue;
+
+						// a plane through the border edge, perpendicular to the face
+						Vector3 edge = m_positions[b] - m_positions[a];
+						Vector3 bn = Vector3::Cross(edge, n);
+						float bnLen = bn.Length();
+						if (bnLen <= 0)
+							continue;
+						bn /= bnLen;
+
+						double bd = -Vector3::Dot(bn, m_positions[a]);
+						double weight = BorderWeight * edge.LengthSquared();
+						m_quadrics[a].AddPlane(bn.X, bn.Y, bn.Z, bd, weight);
+						m_quadrics[b].AddPlane(bn.X, bn.Y, bn.Z, bd, weight);
+					}
+				}
 			}
-			else
+
+			int32 QuadricCollapse::Find(int32 v)
 			{
-				assert(vold==m_vertex[2]);
-				m_vertex[2]=vnew;
+				int32 root = v;
+				while (m_parent[root] != root)
+					root = m_parent[root];
+
+				while (m_parent[v] != root)
+				{
+					int32 next = m_parent[v];
+					m_parent[v] = root;
+					v = next;
+				}
+				return root;
 			}
 
-			int i;
-			vold->m_face.Remove(this);
-			assert(!vnew->m_face.Contains(this));
-			vnew->m_face.Add(this);
-			for(i=0;i<3;i++)
+			void QuadricCollapse::GetCorners(int32 face, int32 c[3])
 			{
-				vold->RemoveIfNonNeighbour(m_vertex[i]);
-				m_vertex[i]->RemoveIfNonNeighbour(vold);
+				const MeshFace& f = m_faces[face];
+				c[0] = Find(f.IndexA);
+				c[1] = Find(f.IndexB);
+				c[2] = Find(f.IndexC);
 			}
-			for (i=0;i<3;i++)
+
+			void QuadricCollapse::GatherNeighbors(int32 v, List<int32>& result)
 			{
-				assert(m_vertex[i]->m_face.Contains(this)==1);
-				for (int j=0;j<3;j++)
+				result.Clear();
+				m_ring.Clear();
+				m_visitStamp++;
+				m_visitMark[v] = m_visitStamp;
+
+				ForEachFace(v, [&](int32 face)
 				{
-					if (i!=j)
+					RingFace rf;
+					GetCorners(face, rf.Corners);
+					m_ring.Add(rf);
+
+					for (int32 c : rf.Corners)
 					{
-						if (m_vertex[i]->m_neighbour.Contains(m_vertex[j]))
+						if (m_visitMark[c] != m_visitStamp)
 						{
-							m_vertex[i]->m_neighbour.Add(m_vertex[j]);
+							m_visitMark[c] = m_visitStamp;
+							result.Add(c);
 						}
 					}
-				}
-
+				});
 			}
-			ComputeNormal();
-		}
-
-		//////////////////////////////////////////////////////////////////////////
-		float ComputeEdgeCollapseCost(Vertex* u, Vertex* v);
-		void ComputeEdgeCostAtVertex(Vertex* v);
 
-		WorkingData::WorkingData(const List<Vector3>& vert, const List<MeshFace>& tri)
-		{
-			m_vertices.ReserveDiscard(vert.getCount());
-			m_triangles.ReserveDiscard(tri.getCount());
-
-			AddVertices(vert);
-			AddFaces(tri);
-		}
-		WorkingData::~WorkingData()
-		{
-			for (int i=0;i<m_triangles.getCount();i++)
+			bool QuadricCollapse::FlipsFace(int32 u, int32 v) const
 			{
-				delete m_triangles[i];
+				// the faces around u are in m_ring
+				for (const RingFace& rf : m_ring)
+				{
+					const int32* c = rf.Corners;
+					if (c[0] == v || c[1] == v || c[2] == v)
+						continue;
+
+					const Vector3& p0 = m_positions[c[0]];
+					const Vector3& p1 = m_positions[c[1]];
+					const Vector3& p2 = m_positions[c[2]];
+					Vector3 before = Vector3::Cross(p1 - p0, p2 - p0);
+
+					const Vector3& q0 = m_positions[c[0] == u ? v : c[0]];
+					const Vector3& q1 = m_positions[c[1] == u ? v : c[1]];
+					const Vector3& q2 = m_positions[c[2] == u ? v : c[2]];
+					Vector3 after = Vector3::Cross(q1 - q0, q2 - q0);
+
+					if (Vector3::Dot(before, after) <= 0)
+						return true;
+				}
+				return false;
 			}
-			m_triangles.Clear();
 
-			for (int i=0;i<m_vertices.getCount();i++)
+			void QuadricCollapse::UpdateCost(int32 v)
 			{
-				delete m_vertices[i];
-			}
-			m_vertices.Clear();
-		}
+				// also fills m_ring for FlipsFace
+				GatherNeighbors(v, m_neighbors);
 
-		void WorkingData::AddVertices(const List<Vector3>& vert)
-		{
-			for (int i=0;i<vert.getCount();i++)
-			{
-				m_vertices.Add(new Vertex(vert[i], i));
-			}
-		}
-		void WorkingData::AddFaces(const List<MeshFace>& tri)
-		{
-			for (int i = 0; i < tri.getCount(); i++)
-			{
-				MeshFace td = tri[i];
-				Triangle* tri = new Triangle(
-					m_vertices[td.IndexA],
-					m_vertices[td.IndexB],
-					m_vertices[td.IndexC]);
+				float bestCost;
+				int32 best = -1;
 
-				m_triangles.Add(tri);
-			}
-		}
+				if (m_neighbors.getCount() == 0)
+				{
+					// v has no neighbors so it costs nothing to collapse
+					bestCost = -0.01f;
+				}
+				else
+				{
+					bestCost = FLT_MAX;
+					for (int32 n : m_neighbors)
+					{
+						Quadric q = m_quadrics[v];
+						q.Add(m_quadrics[n]);
 
+						float cost = (float)Math::Max(q.Evaluate(m_positions[n]), 0.0);
+						if (FlipsFace(v, n))
+							cost += FlipPenalty;
 
-		Vertex* WorkingData::MinimumCostEdge()
-		{
-			// Find the edge that when collapsed will affect model the least.
-			// This function actually returns a Vertex, the second vertex
-			// of the edge (collapse candidate) is stored in the vertex sounds.
-			// Serious optimization opportunity here: this function currently
-			// does a sequential search through an unsorted list :-(
-			// Our algorithm could be O(n*lg(n)) instead of O(n*n)
-			Vertex* mn = m_vertices[0];
-			for (int i = 0; i < m_vertices.getCount(); i++)
-			{
-				if (m_vertices[i]->m_objdist < mn->m_objdist)
-				{
-					mn = m_vertices[i];
+						if (best == -1 || cost < bestCost)
+						{
+							bestCost = cost;
+							best = n;
+						}
+					}
 				}
-			}
-			return mn;
-		}
 
-		void WorkingData::ComputeAllEdgeCollapseCosts()
-		{
-			// For all the edges, compute the difference it would make
-			// to the model if it was collapsed.  The least of these
-			// per vertex is cached in each vertex object.
-			for (int i = 0; i < m_vertices.getCount(); i++)
-			{
-				ComputeEdgeCostAtVertex(m_vertices[i]);
-			}
-		}
+				m_target[v] = best;
 
-		void WorkingData::Collapse(Vertex* u, Vertex* v)
-		{
-			// Collapse the edge uv by moving vertex u onto v
-			// Actually remove triangles on uv, then update triangles that
-			// have u to have v, and then remove u.
-			if (!v)
-			{
-				// u is a vertex all by itself so just delete it
-				m_vertices.Remove(u);
-				delete u;
-				return;
+				HeapEntry e;
+				e.Cost = bestCost;
+				e.Vertex = v;
+				e.Version = ++m_version[v];
+				m_heap.Add(e);
+				std::push_heap(m_heap.begin(), m_heap.end());
 			}
 
-			int i;
-			List<Vertex*> tmp;
-			// make tmp a list of all the neighbors of u
-			for (i = 0; i < u->m_neighbour.getCount(); i++)
+			void QuadricCollapse::Collapse(int32 u, int32 v)
 			{
-				tmp.Add(u->m_neighbour[i]);
-			}
-			// delete triangles on edge uv:
-			for (i = u->m_face.getCount() - 1; i >= 0; i--)
-			{
-				if (u->m_face[i]->HasVertex(v))
+				// faces on the edge uv degenerate
+				ForEachFace(u, [&](int32 face)
 				{
-					m_triangles.Remove(u->m_face[i]);
-					delete (u->m_face[i]);
-					u->m_face[i] = 0;
-				}
-			}
-			// update remaining triangles to have v instead of u
-			for (i = u->m_face.getCount() - 1; i >= 0; i--)
-			{
-				u->m_face[i]->ReplaceVertex(u, v);
-			}
-			m_vertices.Remove(u);
-			delete u;
-			// recompute the edge collapse costs for neighboring vertices
-			for (i = 0; i < tmp.getCount(); i++)
-			{
-				ComputeEdgeCostAtVertex(tmp[i]);
-			}
-		}
-
-		void WorkingData::ProgressiveMesh(List<int>& map, List<int>& permutation)
-		{
-			ComputeAllEdgeCollapseCosts(); // cache all edge collapse costs
+					const MeshFace& f = m_faces[face];
+					if (Find(f.IndexA) == v || Find(f.IndexB) == v || Find(f.IndexC) == v)
+					{
+						m_faceAlive[face] = 0;
+						m_aliveFaceCount--;
+					}
+				});
 
-			permutation.ResizeDiscard(m_vertices.getCount());
-			map.ResizeDiscard(m_vertices.getCount());
+				m_parent[u] = v;
+				m_vertexAlive[u] = 0;
+				std::swap(m_groupNext[u], m_groupNext[v]);
+				m_quadrics[v].Add(m_quadrics[u]);
 
+				// v's quadric changed, so every edge on it is affected. Its neighbors now include u's old
+				// ones, and the vertices that were going to collapse onto u
+				GatherNeighbors(v, m_affected);
 
-			// reduce the object down to nothing:
-			while (m_vertices.getCount() > 0)
-			{
-				// get the next vertex to collapse
-				Vertex* mn = MinimumCostEdge();
-				// keep track of this vertex, i.e. the collapse ordering
-				permutation[mn->m_id] = m_vertices.getCount() - 1;
-				// keep track of vertex to which we collapse to
-				map[m_vertices.getCount() - 1] = (mn->m_collapse) ? mn->m_collapse->m_id : -1;
-				// Collapse this edge
-				Collapse(mn, mn->m_collapse);
+				UpdateCost(v);
+				for (int32 n : m_affected)
+					UpdateCost(n);
 			}
-			// reorder the map list based on the collapse ordering
-			for (int i = 0; i < map.getCount(); i++)
+
+			void QuadricCollapse::Run(List<int>& map, List<int>& permutation, List<int32>& faceCounts)
 			{
-				map[i] = (map[i] == -1) ? 0 : permutation[map[i]];
-			}
+				permutation.ReserveDiscard(m_vertexCount);
+				map.ReserveDiscard(m_vertexCount);
+				faceCounts.ReserveDiscard(m_vertexCount + 1);
+				faceCounts[m_vertexCount] = m_aliveFaceCount;
 
-			// The caller of this function should reorder their vertices
-			// according to the returned "permutation".
+				m_heap.ResizeDiscard(m_vertexCount * 4);
+				for (int32 i = 0; i < m_vertexCount; i++)
+					UpdateCost(i);
 
-		}
+				for (int32 remaining = m_vertexCount; remaining > 0; )
+				{
+					std::pop_heap(m_heap.begin(), m_heap.end());
+					HeapEntry e = m_heap.LastItem();
+					m_heap.RemoveAt(m_heap.getCount() - 1);
 
+					int32 u = e.Vertex;
+					if (!m_vertexAlive[u] || e.Version != m_version[u])
+						continue;
 
-		//////////////////////////////////////////////////////////////////////////
+					int32 v = m_target[u];
+					remaining--;
 
-	
-		float ComputeEdgeCollapseCost(Vertex* u, Vertex* v)
-		{
-			// if we collapse edge uv by moving u to v then how 
-			// much different will the model change, i.e. how much "error".
-			// Texture, vertex normal, and border vertex code was removed
-			// to keep this demo as simple as possible.
-			// The method of determining cost was designed in order 
-			// to exploit small and coplanar regions for
-			// effective polygon reduction.
-			// Is is possible to add some checks here to see if "folds"
-			// would be generated.  i.e. normal of a remaining face gets
-			// flipped.  I never seemed to run into this problem and
-			// therefore never added code to detect this case.
-			int i;
-			float edgelength = Vector3::Distance(u->m_position, v->m_position);
-			float curvature = 0;
-
-			// find the "sides" triangles that are on the edge uv
-			List<Triangle*> sides;
-			for (i = 0; i < u->m_face.getCount(); i++)
-			{
-				if (u->m_face[i]->HasVertex(v))
+					// keep track of this vertex, i.e. the collapse ordering,
+					// and the vertex to which we collapse to
+					permutation[u] = remaining;
+					map[remaining] = v;
+
+					if (v != -1)
+					{
+						Collapse(u, v);
+					}
+					else
+					{
+						m_vertexAlive[u] = 0;
+					}
+
+					faceCounts[remaining] = m_aliveFaceCount;
+				}
+
+				// reorder the map list based on the collapse ordering
+				for (int32 i = 0; i < map.getCount(); i++)
 				{
-					sides.Add(u->m_face[i]);
+					map[i] = (map[i] == -1) ? 0 : permutation[map[i]];
 				}
 			}
 
-			// use the triangle facing most away from the sides 
-			// to determine our curvature term
+			//////////////////////////////////////////////////////////////////////////
 
-			for (i = 0; i < u->m_face.getCount(); i++)
+			void ProgressiveMesh(const List<Vector3>& vert, const List<MeshFace>& tri, List<int>& map, List<int>& permutation)
 			{
-				float mincurv = 1; // curve for face i and closer side to it
-				for (int j = 0; j < sides.getCount(); j++)
-				{
-					// use dot product of face normals. '^' defined in vector
-					float dotprod = Vector3::Dot(u->m_face[i]->m_normal, sides[j]->m_normal);
-					mincurv = Math::Min(mincurv, (1 - dotprod) / 2.0f);
-				}
-				curvature = Math::Max(curvature, mincurv);
+				List<int32> faceCounts;
+				ProgressiveMesh(vert, tri, map, permutation, faceCounts);
 			}
-			// the more coplanar the lower the curvature term   
-			return edgelength * curvature; 
-		}
 
-		void ComputeEdgeCostAtVertex(Vertex* v)
-		{
-			// compute the edge collapse cost for all edges that start
-			// from vertex v.  Since we are only interested in reducing
-			// the object by selecting the min cost edge at each step, we
-			// only cache the cost of the least cost edge at this vertex
-			// (in member variable collapse) as well as the value of the 
-			// cost (in member variable objdist).
-			if(v->m_neighbour.getCount()==0) 
+			void ProgressiveMesh(const List<Vector3>& vert, const List<MeshFace>& tri, List<int>& map, List<int>& permutation, List<int32>& faceCounts)
 			{
-				// v doesn't have neighbors so it costs nothing to collapse
-				v->m_collapse = 0;
-				v->m_objdist = -0.01f;
-				return;
+				QuadricCollapse qc(vert, tri);
+				qc.Run(map, permutation, faceCounts);
+
+				// The caller of this function should reorder their vertices
+				// according to the returned "permutation".
 			}
-			v->m_objdist = FLT_MAX;
-			v->m_collapse = 0;
-			// search all neighboring edges for "least cost" edge
-			for (int i=0;i<v->m_neighbour.getCount();i++)
+
+			static int32 MapIndex(int32 index, const List<int>& map, int32 vertexCount)
 			{
-				float dist = ComputeEdgeCollapseCost(v, v->m_neighbour[i]);
-				if (dist < v->m_objdist)
+				while (index >= vertexCount)
+					index = map[index];
+				return index;
+			}
+
+			void CollapseFaces(const List<MeshFace>& tri, const List<int>& map, const List<int>& permutation, int32 vertexCount, List<MeshFace>& result)
+			{
+				result.Clear();
+				if (vertexCount <= 0)
+					return;
+
+				for (const MeshFace& f : tri)
 				{
-					v->m_collapse = v->m_neighbour[i];  // candidate for edge collapse
-					v->m_objdist = dist; // cost of the collapse
+					int32 a = MapIndex(permutation[f.IndexA], map, vertexCount);
+					int32 b = MapIndex(permutation[f.IndexB], map, vertexCount);
+					int32 c = MapIndex(permutation[f.IndexC], map, vertexCount);
+
+					if (a != b && b != c && c != a)
+						result.Add(MeshFace(a, b, c, f.MaterialID));
 				}
 			}
-		}
 
+			void GenerateLODChain(const List<Vector3>& vert, const List<MeshFace>& tri, const List<int32>& targetFaceCounts, List<List<MeshFace>>& lods)
+			{
+				List<int> map;
+				List<int> permutation;
+				List<int32> faceCounts;
+				ProgressiveMesh(vert, tri, map, permutation, faceCounts);
+
+				// from new places back to the original indices
+				List<int32> original;
+				original.ReserveDiscard(permutation.getCount());
+				for (int32 i = 0; i < permutation.getCount(); i++)
+					original[permutation[i]] = i;
+
+				lods.Clear();
+				for (int32 target : targetFaceCounts)
+				{
+					// face counts only go down as vertices are removed
+					int32 keep = vert.getCount();
+					while (keep > 0 && faceCounts[keep] > target)
+						keep--;
 
-		
+					lods.Add(List<MeshFace>());
+					List<MeshFace>& faces = lods.LastItem();
+					CollapseFaces(tri, map, permutation, keep, faces);
 
+					for (MeshFace& f : faces)
+					{
+						f.IndexA = original[f.IndexA];
+						f.IndexB = original[f.IndexB];
+						f.IndexC = original[f.IndexC];
+					}
+				}
+			}
+		}
 	}
-}
\ No newline at end of file
+}
@@ -11,9 +11,33 @@ namespace Apoc3D
 {
 	namespace Graphics
 	{
+		/**
+		 *  Mesh simplification by edge collapses ordered with quadric error metrics.
+		 *
+		 *  Every vertex is collapsed onto one of its neighbors, which keeps its position,
+		 *  so the result can be expressed as a vertex order plus a collapse map:
+		 *   - permutation[i] is the new place of vertex i. After reordering, the vertices at the end
+		 *     are the first to be collapsed.
+		 *   - map[j] is the new place of the vertex the one at new place j collapses to. It is always 
+		 *     less than j.
+		 *  To keep n vertices, an index j >= n is replaced by map[j] until it is below n; faces
+		 *  that end up with repeated indices are dropped.
+		 */
 		namespace MeshSimplifier
 		{
 			APAPI void ProgressiveMesh(const List<Vector3>& vert, const List<MeshFace>& tri, List<int>& map, List<int>& permutation);
+
+			/** Also gives faceCounts[n], the number of faces left when n vertices are kept, for n in [0, vertex count]. */
+			APAPI void ProgressiveMesh(const List<Vector3>& vert, const List<MeshFace>& tri, List<int>& map, List<int>& permutation, List<int32>& faceCounts);
+
+			/** Gets the faces left when vertexCount vertices are kept. Indices in result are new places of vertices. */
+			APAPI void CollapseFaces(const List<MeshFace>& tri, const List<int>& map, const List<int>& permutation, int32 vertexCount, List<MeshFace>& result);
+
+			/**
+			 *  Simplifies the mesh once for each of the given face counts, keeping as many vertices as
+			 *  possible without going over each count. Faces in lods use the original vertex indices.
+			 */
+			APAPI void GenerateLODChain(const List<Vector3>& vert, const List<MeshFace>& tri, const List<int32>& targetFaceCounts, List<List<MeshFace>>& lods);
 		}
 	}
 }
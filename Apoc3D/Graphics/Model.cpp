@@ -19,6 +19,7 @@
 #include "Mesh.h"
 #include "Animation/AnimationData.h"
 #include "Animation/AnimationPlayers.h"
+#include "Animation/SkinningBatch.h"
 #include "apoc3d/Core/ResourceHandle.h"
 #include "apoc3d/IOLib/ModelData.h"
 #include "apoc3d/Vfs/ResourceLocation.h"
@@ -120,6 +121,9 @@ namespace Apoc3D
 
 		Model::~Model()
 		{
+			if (m_skinningBatch)
+				m_skinningBatch->UnregisterModel(this);
+
 			m_animInstance.DeleteAndClear();
 			DELETE_AND_NULL(m_mtrlPlayer);
 
@@ -600,6 +604,7 @@ namespace Apoc3D
 			if (m_skinPlayer)
 			{
 				m_skinPlayer->eventCompleted.clear();
+				m_animInstance.Remove(m_skinPlayer);
 				delete m_skinPlayer;
 				m_skinPlayer = nullptr;
 			}
@@ -617,11 +622,34 @@ namespace Apoc3D
 
 					m_animInstance.Add(m_skinPlayer);
 					m_skinPlayer->eventCompleted.bind(this, &Model::SkinAnim_Completed);
+
+					if (m_skinningBatch)
+						m_skinningBatch->Add(m_skinPlayer);
 				}
 			}
 
 			m_skinState = APS_Stopped;
 		}
+		void Model::setSkinningBatch(SkinningBatch* batch)
+		{
+			if (m_skinningBatch == batch)
+				return;
+
+			if (m_skinPlayer)
+			{
+				if (m_skinningBatch)
+					m_skinningBatch->Remove(m_skinPlayer);
+				if (batch)
+					batch->Add(m_skinPlayer);
+			}
+
+			if (m_skinningBatch)
+				m_skinningBatch->UnregisterModel(this);
+			if (batch)
+				batch->RegisterModel(this);
+
+			m_skinningBatch = batch;
+		}
 		void Model::ReloadRigidAnimation()
 		{
 			if (m_rigidPlayer)				
@@ -90,6 +90,7 @@ namespace Apoc3D
 		 */
 		class APAPI Model : public Renderable
 		{
+			friend class Animation::SkinningBatch;
 		public:
 			enum AnimationPlaybackState
 			{
@@ -150,6 +151,14 @@ namespace Apoc3D
 
 			List<ModelAnimationPlayerBase*>& getCustomAnimation() { return m_animInstance; }
 
+			/**
+			 *  Lets a SkinningBatch evaluate the skinned animation of this model together with others.
+			 *  SkinningBatch::Evaluate should then be called after updating the models each frame. 
+			 *  Pass nullptr to evaluate it in Update again.
+			 */
+			void setSkinningBatch(SkinningBatch* batch);
+			SkinningBatch* getSkinningBatch() const { return m_skinningBatch; }
+
 			AnimationPlaybackState getMaterialAnimationState() const { return m_mtrlState; }
 			AnimationPlaybackState getSkinAnimationState() const { return m_skinState; }
 			AnimationPlaybackState getRigidAnimationState() const { return m_rigidState; }
@@ -196,6 +205,7 @@ namespace Apoc3D
 			const AnimationData* m_animData;
 
 			SkinnedAnimationPlayer* m_skinPlayer;
+			SkinningBatch* m_skinningBatch = nullptr;
 			RigidAnimationPlayer* m_rigidPlayer;
 			MaterialAnimationPlayer* m_mtrlPlayer;
 
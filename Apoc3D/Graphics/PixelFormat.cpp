@@ -1,11 +1,16 @@
 
 #include "PixelFormat.h"
+#include "ImageJobs.h"
 #include "LockData.h"
+#include "PixelKernels.h"
+#include "apoc3d/Core/TaskScheduler.h"
 #include "apoc3d/Math/Math.h"
+#include "apoc3d/Math/MathBatch.h"
 #include "apoc3d/Math/Color.h"
 #include "apoc3d/Collections/HashMap.h"
 #include "apoc3d/Utility/TypeConverter.h"
 
+using namespace Apoc3D::Core;
 using namespace Apoc3D::Math;
 using namespace Apoc3D::Utility;
 
@@ -141,7 +146,7 @@ namespace Apoc3D
 		{
 			if (format == FMT_DXT1)				
 			{
-				return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+				return ((width + 3) / 4) * ((height + 3) / 4) * depth * 8;
 			}
 
 			if (format == FMT_DXT2 ||
@@ -149,7 +154,7 @@ namespace Apoc3D
 				format == FMT_DXT4 ||
 				format == FMT_DXT5)
 			{
-				return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+				return ((width + 3) / 4) * ((height + 3) / 4) * depth * 16;
 			}
 			int bytepp = FormatSizeTable.pfSizeTable[(int)format];
 			if (bytepp == -1)
@@ -708,27 +713,15 @@ namespace Apoc3D
 		};
 		
 		template <class U>
-		static void BoxConversion(const DataBox& src, const DataBox& dst)
+		static void ConvertRow(const void* src, void* dst, int32 count)
 		{
-			typename U::SrcType *srcptr = static_cast<typename U::SrcType*>(src.getDataPointer());
-			typename U::DstType *dstptr = static_cast<typename U::DstType*>(dst.getDataPointer());
-			const int srcSliceSkip = src.getSlicePitch();
-			const int dstSliceSkip = dst.getSlicePitch();
+			const typename U::SrcType* srcptr = static_cast<const typename U::SrcType*>(src);
+			typename U::DstType* dstptr = static_cast<typename U::DstType*>(dst);
 
-			for (int z=0;z<src.getDepth();z++)
+			for (int32 x = 0; x < count; x++)
 			{
-				for (int y=0;y<src.getHeight();y++)
-				{
-					for (int x=0;x<src.getWidth();x++)
-					{
-						dstptr[x] = U::ConvertPixel(srcptr[x]);
-					}
-					srcptr = reinterpret_cast<typename U::SrcType*>((byte*)srcptr + src.getRowPitch());
-					dstptr = reinterpret_cast<typename U::DstType*>((byte*)dstptr + dst.getRowPitch());
-				}
-				srcptr = reinterpret_cast<typename U::SrcType*>((byte*)srcptr + srcSliceSkip);
-				dstptr = reinterpret_cast<typename U::DstType*>((byte*)dstptr + dstSliceSkip);
-			} 
+				dstptr[x] = U::ConvertPixel(srcptr[x]);
+			}
 		}
 
 		// END Pixel Converters
@@ -852,96 +845,292 @@ namespace Apoc3D
 		};
 
 
+		void RunImageJobs(int32 jobCount, FunctorReference<void(int32)> job, bool parallel)
+		{
+			TaskScheduler::RunJobs(jobCount, job, parallel);
+		}
+
+		/**
+		 *  Works out the KernelParams of a converter that only moves bytes, by converting a pixel
+		 *  whose bytes are numbered, and one with all bytes zero.
+		 */
+		template <class U>
+		static PixelKernels::KernelParams GetShuffleParams()
+		{
+			typedef typename U::SrcType SrcType;
+			typedef typename U::DstType DstType;
+			static_assert(sizeof(DstType) <= 4, "");
+
+			byte numbered[sizeof(SrcType)];
+			byte zero[sizeof(SrcType)] = { 0 };
+			for (int32 i = 0; i < (int32)sizeof(SrcType); i++)
+				numbered[i] = (byte)(i + 1);
+
+			DstType a = U::ConvertPixel(*reinterpret_cast<const SrcType*>(numbered));
+			DstType b = U::ConvertPixel(*reinterpret_cast<const SrcType*>(zero));
+			const byte* numberedOut = reinterpret_cast<const byte*>(&a);
+			const byte* zeroOut = reinterpret_cast<const byte*>(&b);
+
+			PixelKernels::KernelParams params;
+			memset(&params, 0, sizeof(params));
+			for (int32 k = 0; k < (int32)sizeof(DstType); k++)
+			{
+				if (numberedOut[k] == zeroOut[k])
+				{
+					params.Shuffle[k] = 0x80;
+					params.Fill |= (uint32)zeroOut[k] << (k * 8);
+				}
+				else
+				{
+					params.Shuffle[k] = numberedOut[k] - 1;
+				}
+			}
+			return params;
+		}
+
+		/** Converts rows of pixels with the best kernel for the SIMD level, then finishes them with the scalar converter */
+		struct RowConverter
+		{
+			typedef void (*ScalarRoutine)(const void* src, void* dst, int32 count);
+
+			ScalarRoutine Scalar = nullptr;
+			PixelKernels::Kernel SSE2 = nullptr;
+			PixelKernels::Kernel AVX2 = nullptr;
+			PixelKernels::KernelParams Params;
+
+			int32 SrcPixelSize = 0;
+			int32 DstPixelSize = 0;
+
+			RowConverter() { memset(&Params, 0, sizeof(Params)); }
+
+			void Convert(const byte* src, byte* dst, int32 count, MathSIMDLevel level) const
+			{
+				int32 done = 0;
+
+#ifndef BIG_ENDIAN
+#if APOC3D_MATH_AVX2
+				if (level == MathSIMDLevel::AVX2 && AVX2)
+					done = AVX2(src, dst, count, Params);
+#endif
+				if (level >= MathSIMDLevel::SSE2 && SSE2 && done < count)
+					done += SSE2(src + done * SrcPixelSize, dst + done * DstPixelSize, count - done, Params);
+#endif
+
+				if (done < count)
+					Scalar(src + done * SrcPixelSize, dst + done * DstPixelSize, count - done);
+			}
+		};
+
+		/** The number of pixels in a band of rows. Small enough to stay in cache, big enough to be worth a thread. */
+		const int32 ConversionBandPixels = 65536;
+		/** Below this number of pixels, the conversion runs on the calling thread. */
+		const int32 ConversionParallelThreshold = 256 * 256;
+
+		/** Converts a DataBox in bands of rows, each of which can be done by a different thread. */
+		class BoxConversion
+		{
+		public:
+			BoxConversion(const RowConverter& conv, const DataBox& src, const DataBox& dst)
+				: m_conv(conv), m_src(src), m_dst(dst), m_level(GetMathSIMDLevel())
+			{
+				m_rowCount = src.getHeight() * src.getDepth();
+				m_bandRows = Math::Max(1, ConversionBandPixels / Math::Max(1, src.getWidth()));
+			}
+
+			int32 getBandCount() const { return (m_rowCount + m_bandRows - 1) / m_bandRows; }
+
+			void ProcessBand(int32 band)
+			{
+				const int32 height = m_src.getHeight();
+				const int32 width = m_src.getWidth();
+
+				const byte* srcBase = static_cast<const byte*>(m_src.getDataPointer());
+				byte* dstBase = static_cast<byte*>(m_dst.getDataPointer());
+
+				const int32 end = Math::Min(m_rowCount, (band + 1) * m_bandRows);
+				for (int32 r = band * m_bandRows; r < end; r++)
+				{
+					const int32 z = r / height;
+					const int32 y = r % height;
+
+					const byte* srcRow = srcBase + (size_t)z * m_src.getSlicePitch() + (size_t)y * m_src.getRowPitch();
+					byte* dstRow = dstBase + (size_t)z * m_dst.getSlicePitch() + (size_t)y * m_dst.getRowPitch();
+					m_conv.Convert(srcRow, dstRow, width, m_level);
+				}
+			}
+
+		private:
+			const RowConverter& m_conv;
+			const DataBox& m_src;
+			const DataBox& m_dst;
+			MathSIMDLevel m_level;
+
+			int32 m_rowCount;
+			int32 m_bandRows;
+		};
+
 		struct ConveterHelper
 		{
-			typedef void (*ConversionRoutine)(const DataBox& src, const DataBox& dst);
-			Apoc3D::Collections::HashMap<uint, ConversionRoutine> Converters;
+			Apoc3D::Collections::HashMap<uint, RowConverter> Converters;
 
 			ConveterHelper()
-				: Converters(25)
-			{
-				Register<A8R8G8B8toA8B8G8R8>();
-				Register<A8R8G8B8toB8G8R8A8>();
-				Register<A8R8G8B8toR8G8B8A8>();
-				Register<A8B8G8R8toA8R8G8B8>();
-				Register<A8B8G8R8toB8G8R8A8>();
-				Register<A8B8G8R8toR8G8B8A8>();
-				Register<B8G8R8A8toA8R8G8B8>();
-				Register<B8G8R8A8toA8B8G8R8>();
-				Register<B8G8R8A8toR8G8B8A8>();
-				Register<R8G8B8A8toA8R8G8B8>();
-				Register<R8G8B8A8toA8B8G8R8>();
-				Register<R8G8B8A8toB8G8R8A8>();
-				Register<A8B8G8R8toL8>();
-				Register<L8toA8B8G8R8>();
-				Register<A8R8G8B8toL8>();
-				Register<L8toA8R8G8B8>();
-				Register<B8G8R8A8toL8>();
-				Register<L8toB8G8R8A8>();
-				Register<L8toL16>();
-				Register<L16toL8>();
-				Register<B8G8R8toR8G8B8>();
-				Register<R8G8B8toB8G8R8>();
-				Register<R8G8B8toX8R8G8B8>();
-				Register<R8G8B8toA8R8G8B8>();
-				Register<B8G8R8toA8R8G8B8>();
-				Register<R8G8B8toA8B8G8R8>();
-				Register<B8G8R8toA8B8G8R8>();
-				Register<R8G8B8toB8G8R8A8>();
-				Register<B8G8R8toB8G8R8A8>();
-				Register<A8R8G8B8toR8G8B8>();
-				Register<A8R8G8B8toB8G8R8>();
-				Register<X8R8G8B8toA8R8G8B8>();
-				Register<X8R8G8B8toA8B8G8R8>();
-				Register<X8R8G8B8toB8G8R8A8>();
-				Register<X8R8G8B8toR8G8B8A8>();
-				Register<X8B8G8R8toA8R8G8B8>();
-				Register<X8B8G8R8toA8B8G8R8>();
-				Register<X8B8G8R8toB8G8R8A8>();
-				Register<X8B8G8R8toR8G8B8A8>();
-
-				Register<A8R8G8B8toA32B32G32R32F>();
-				Register<A32B32G32R32FtoA8R8G8B8>();
-
-				Register<A16B16G16R16FtoA32B32G32R32F>();
-				Register<A32B32G32R32FtoA16B16G16R16F>();
-
-				Register<A8R8G8B8toA16B16G16R16F>();
-				Register<A16B16G16R16FtoA8R8G8B8>();	
+				: Converters(64)
+			{
+				using namespace PixelKernels;
+
+#if APOC3D_MATH_AVX2
+				const Kernel Shuffle32AVX2 = AVX2::Shuffle32;
+				const Kernel Shuffle24AVX2 = AVX2::Shuffle24;
+				const Kernel Shuffle24To32AVX2 = AVX2::Shuffle24To32;
+				const Kernel Shuffle32To24AVX2 = AVX2::Shuffle32To24;
+				const Kernel Expand8To32AVX2 = AVX2::Expand8To32;
+#else
+				const Kernel Shuffle32AVX2 = nullptr;
+				const Kernel Shuffle24AVX2 = nullptr;
+				const Kernel Shuffle24To32AVX2 = nullptr;
+				const Kernel Shuffle32To24AVX2 = nullptr;
+				const Kernel Expand8To32AVX2 = nullptr;
+#endif
+
+				RegisterShuffle<A8R8G8B8toA8B8G8R8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<A8R8G8B8toB8G8R8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<A8R8G8B8toR8G8B8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<A8B8G8R8toA8R8G8B8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<A8B8G8R8toB8G8R8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<A8B8G8R8toR8G8B8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<B8G8R8A8toA8R8G8B8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<B8G8R8A8toA8B8G8R8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<B8G8R8A8toR8G8B8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<R8G8B8A8toA8R8G8B8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<R8G8B8A8toA8B8G8R8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<R8G8B8A8toB8G8R8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<A8B8G8R8toL8>(SSE2::Extract32To8, nullptr);
+				RegisterShuffle<L8toA8B8G8R8>(SSE2::Expand8To32, Expand8To32AVX2);
+				RegisterShuffle<A8R8G8B8toL8>(SSE2::Extract32To8, nullptr);
+				RegisterShuffle<L8toA8R8G8B8>(SSE2::Expand8To32, Expand8To32AVX2);
+				RegisterShuffle<B8G8R8A8toL8>(SSE2::Extract32To8, nullptr);
+				RegisterShuffle<L8toB8G8R8A8>(SSE2::Expand8To32, Expand8To32AVX2);
+				Register<L8toL16>(SSE2::L8ToL16, nullptr);
+				Register<L16toL8>(SSE2::L16ToL8, nullptr);
+				RegisterShuffle<B8G8R8toR8G8B8>(nullptr, Shuffle24AVX2);
+				RegisterShuffle<R8G8B8toB8G8R8>(nullptr, Shuffle24AVX2);
+				RegisterShuffle<R8G8B8toX8R8G8B8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<R8G8B8toA8R8G8B8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<B8G8R8toA8R8G8B8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<R8G8B8toA8B8G8R8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<B8G8R8toA8B8G8R8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<R8G8B8toB8G8R8A8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<B8G8R8toB8G8R8A8>(nullptr, Shuffle24To32AVX2);
+				RegisterShuffle<A8R8G8B8toR8G8B8>(nullptr, Shuffle32To24AVX2);
+				RegisterShuffle<A8R8G8B8toB8G8R8>(nullptr, Shuffle32To24AVX2);
+				RegisterShuffle<X8R8G8B8toA8R8G8B8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8R8G8B8toA8B8G8R8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8R8G8B8toB8G8R8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8R8G8B8toR8G8B8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8B8G8R8toA8R8G8B8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8B8G8R8toA8B8G8R8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8B8G8R8toB8G8R8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+				RegisterShuffle<X8B8G8R8toR8G8B8A8>(SSE2::Shuffle32, Shuffle32AVX2);
+
+#if APOC3D_MATH_AVX2
+				Register<A8R8G8B8toA32B32G32R32F>(SSE2::A8R8G8B8ToF32, AVX2::A8R8G8B8ToF32);
+				Register<A32B32G32R32FtoA8R8G8B8>(SSE2::F32ToA8R8G8B8, AVX2::F32ToA8R8G8B8);
+
+				Register<A16B16G16R16FtoA32B32G32R32F>(SSE2::F16ToF32, AVX2::F16ToF32);
+				Register<A32B32G32R32FtoA16B16G16R16F>(SSE2::F32ToF16, AVX2::F32ToF16);
+
+				Register<A8R8G8B8toA16B16G16R16F>(SSE2::A8R8G8B8ToF16, AVX2::A8R8G8B8ToF16);
+				Register<A16B16G16R16FtoA8R8G8B8>(SSE2::F16ToA8R8G8B8, AVX2::F16ToA8R8G8B8);
+#else
+				Register<A8R8G8B8toA32B32G32R32F>(SSE2::A8R8G8B8ToF32, nullptr);
+				Register<A32B32G32R32FtoA8R8G8B8>(SSE2::F32ToA8R8G8B8, nullptr);
+
+				Register<A16B16G16R16FtoA32B32G32R32F>(SSE2::F16ToF32, nullptr);
+				Register<A32B32G32R32FtoA16B16G16R16F>(SSE2::F32ToF16, nullptr);
+
+				Register<A8R8G8B8toA16B16G16R16F>(SSE2::A8R8G8B8ToF16, nullptr);
+				Register<A16B16G16R16FtoA8R8G8B8>(SSE2::F16ToA8R8G8B8, nullptr);
+#endif
 			}
 
 			template <typename type>
-			void Register()
+			static RowConverter MakeConverter(PixelKernels::Kernel sse2, PixelKernels::Kernel avx2)
 			{
-				Converters.Add(type::ID, &BoxConversion<type>);
+				RowConverter conv;
+				conv.Scalar = &ConvertRow<type>;
+				conv.SSE2 = sse2;
+				conv.AVX2 = avx2;
+				conv.SrcPixelSize = sizeof(typename type::SrcType);
+				conv.DstPixelSize = sizeof(typename type::DstType);
+				return conv;
 			}
 
-			bool Convert(const DataBox& src, const DataBox& dst)
+			template <typename type>
+			void Register(PixelKernels::Kernel sse2, PixelKernels::Kernel avx2)
 			{
-				ConversionRoutine func;
-				if (Converters.TryGetValue(PACKCONVERTERID(src.getFormat(), dst.getFormat()), func))
-				{
-					func(src, dst);
-					return true;
-				}
-				return false;
+				Converters.Add(type::ID, MakeConverter<type>(sse2, avx2));
+			}
+
+			/** For converters that only move bytes around and fill in constant ones */
+			template <typename type>
+			void RegisterShuffle(PixelKernels::Kernel sse2, PixelKernels::Kernel avx2)
+			{
+				RowConverter conv = MakeConverter<type>(sse2, avx2);
+				conv.Params = GetShuffleParams<type>();
+				Converters.Add(type::ID, conv);
+			}
+
+			bool Convert(const DataBox& src, const DataBox& dst, bool parallel)
+			{
+				const RowConverter* conv = Converters.TryGetValue(PACKCONVERTERID(src.getFormat(), dst.getFormat()));
+				if (conv == nullptr)
+					return false;
+
+				BoxConversion box(*conv, src, dst);
+				const int32 bandCount = box.getBandCount();
+				parallel &= bandCount > 1 && src.getWidth() * src.getHeight() * src.getDepth() >= ConversionParallelThreshold;
+
+				RunImageJobs(bandCount, FunctorReference<void(int32)>(&box, &BoxConversion::ProcessBand), parallel);
+				return true;
 			}
 
 		} static converterHelper;
 
 
-		bool PixelFormatUtils::ConvertPixels(const DataBox& src, const DataBox& dst)
+		bool PixelFormatUtils::CanConvert(PixelFormat srcFormat, PixelFormat dstFormat)
 		{
-			return converterHelper.Convert(src, dst);
+			if (IsCompressed(dstFormat))
+				return CanCompress(srcFormat, dstFormat);
+			if (IsCompressed(srcFormat))
+				return CanDecompress(srcFormat, dstFormat);
+
+			return converterHelper.Converters.TryGetValue(PACKCONVERTERID(srcFormat, dstFormat)) != nullptr;
+		}
+
+		bool PixelFormatUtils::ConvertPixels(const DataBox& src, const DataBox& dst, bool parallel)
+		{
+			if (IsCompressed(dst.getFormat()))
+			{
+				BlockCompressionOptions options;
+				options.Parallel = parallel;
+				return Compress(src, dst, options);
+			}
+			if (IsCompressed(src.getFormat()))
+				return Decompress(src, dst, parallel);
+
+			return converterHelper.Convert(src, dst, parallel);
 		}
 
 		void PixelFormatUtils::Resize(const void* src, int srcWidth, int srcHeight,
 			void* dst, int dstWidth, int dstHeight, PixelFormat format)
 		{
-			int lvlSize = PixelFormatUtils::GetMemorySize(
-				dstWidth, dstHeight, 1, format);
+			if (!Resize(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, format, ResizeOptions()))
+			{
+				int lvlSize = PixelFormatUtils::GetMemorySize(
+					dstWidth, dstHeight, 1, format);
 
-			memset(dst, 0, lvlSize);
+				memset(dst, 0, lvlSize);
+			}
 		}
 
 
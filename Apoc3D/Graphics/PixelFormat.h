@@ -93,6 +93,73 @@ namespace Apoc3D
 			FMT_Palette8Alpha8 = 40,
 			FMT_Count = 41
 		};
+
+		/** The filters PixelFormatUtils::Resize can sample with */
+		enum struct ResizeFilter
+		{
+			/** Averages the covered pixels. Cheapest, but blocky when enlarging. */
+			Box,
+			/** Bilinear when enlarging, a tent over the covered pixels when reducing. */
+			Triangle,
+			/** 3-lobed Lanczos windowed sinc. Sharp, but may ring around hard edges. */
+			Lanczos,
+			/** Kaiser windowed sinc. Keeps detail with little ringing; a good choice for mip maps. */
+			Kaiser
+		};
+
+		struct ResizeOptions
+		{
+			ResizeFilter Filter = ResizeFilter::Kaiser;
+
+			/**
+			 *  Filters in linear space, treating integer color channels as sRGB encoded.
+			 *  Alpha and floating point channels are always taken as linear.
+			 */
+			bool GammaCorrect = false;
+
+			/**
+			 *  Weights colors by alpha while filtering, so the colors of transparent pixels
+			 *  do not bleed into visible ones. Has no effect on formats without alpha.
+			 */
+			bool PremultipliedAlpha = false;
+
+			/** Lets big images be processed by several threads */
+			bool Parallel = true;
+
+			ResizeOptions() { }
+			ResizeOptions(ResizeFilter filter) : Filter(filter) { }
+		};
+
+		/** Speed and quality trade offs of PixelFormatUtils::Compress */
+		enum struct BlockCompressionQuality
+		{
+			/** Range fit. Takes the end points along the principal axis of each block's colors. Several times faster than Normal. */
+			Fast,
+			/** Cluster fit. Tries every way of splitting the block's colors among the palette entries. */
+			Normal,
+			/** Iterative cluster fit. Repeats the cluster fit along a refined axis. The slowest. */
+			Best
+		};
+
+		struct BlockCompressionOptions
+		{
+			BlockCompressionQuality Quality = BlockCompressionQuality::Normal;
+
+			/**
+			 *  Weights the color error of each channel by how sensitive the eye is to it.
+			 *  Turn off for data that is not color, like normal maps.
+			 */
+			bool PerceptualMetric = true;
+
+			/** Lets the colors of transparent pixels count less when fitting a block. */
+			bool WeightColorByAlpha = false;
+
+			/** Lets big images be processed by several threads */
+			bool Parallel = true;
+
+			BlockCompressionOptions() { }
+			BlockCompressionOptions(BlockCompressionQuality quality) : Quality(quality) { }
+		};
 	
 
 		/** Some functions for PixelFormat */
@@ -124,10 +191,51 @@ namespace Apoc3D
 
 			APAPI void DumpPixelFormatName(Apoc3D::Collections::List<String>& names);
 
-			/** Converts some pixels from a source format to a destination format */
-			APAPI bool ConvertPixels(const DataBox& src, const DataBox& dst);
-
-
+			/** Checks if ConvertPixels supports converting from one format to another. */
+			APAPI bool CanConvert(PixelFormat srcFormat, PixelFormat dstFormat);
+
+			/**
+			 *  Converts some pixels from a source format to a destination format.
+			 *  Common pairs use SIMD kernels, and large boxes are split into bands of rows converted in parallel.
+			 *  Block compressed formats go through Compress, with the default options, or Decompress.
+			 *  @param parallel Set to false to keep the work on the calling thread.
+			 *  @return false if the pair of formats is not supported.
+			 */
+			APAPI bool ConvertPixels(const DataBox& src, const DataBox& dst, bool parallel = true);
+
+
+			/** Checks if Compress can encode a format to a block compressed one. */
+			APAPI bool CanCompress(PixelFormat srcFormat, PixelFormat dstFormat);
+			/** Checks if Decompress can decode a block compressed format to another format. */
+			APAPI bool CanDecompress(PixelFormat srcFormat, PixelFormat dstFormat);
+
+			/**
+			 *  Encodes an image to DXT1, DXT3 or DXT5 on the CPU. Bands of 4x4 blocks are encoded in parallel.
+			 *  The source can be in any format ConvertPixels can convert to A8R8G8B8.
+			 *  The row pitch of a block compressed box is the size of a row of blocks.
+			 *  @return false if the pair of formats is not supported.
+			 */
+			APAPI bool Compress(const DataBox& src, const DataBox& dst, const BlockCompressionOptions& options);
+
+			/**
+			 *  Decodes a DXT1, DXT3 or DXT5 image to any format ConvertPixels can convert A8R8G8B8 to.
+			 *  @return false if the pair of formats is not supported.
+			 */
+			APAPI bool Decompress(const DataBox& src, const DataBox& dst, bool parallel = true);
+
+
+			/** Checks if a PixelFormat can be resampled by Resize. Packed and compressed formats can not. */
+			APAPI bool CanResize(PixelFormat format);
+
+			/**
+			 *  Resamples a tightly packed 2D image to a new size with a separable filter.
+			 *  8 and 16-bit integer, 16-bit float and 32-bit float channel formats are supported.
+			 *  @return false if the format is not supported, in which case dst is left untouched.
+			 */
+			APAPI bool Resize(const void* src, int srcWidth, int srcHeight,
+				void* dst, int dstWidth, int dstHeight, PixelFormat format, const ResizeOptions& options);
+
+			/** Resamples with the default options. Unsupported formats result in a zero filled image. */
 			APAPI void Resize(const void* src, int srcWidth, int srcHeight, 
 				void* dst, int dstWidth, int dstHeight, PixelFormat format);
 		};
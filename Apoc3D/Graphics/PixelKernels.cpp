@@ -0,0 +1,341 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "PixelKernels.h"
+
+#include <emmintrin.h>
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		namespace PixelKernels
+		{
+			namespace SSE2
+			{
+				static inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+				{
+					return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+				}
+
+				// Same as Math::R16ToR32I on 4 halves in the low 16 bits of each lane
+				static inline __m128 HalfToFloat(__m128i h)
+				{
+					const __m128i em = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+					const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+
+					// rebias the exponent, inf and nan get it rebiased twice to reach 255
+					__m128i normal = _mm_add_epi32(_mm_slli_epi32(em, 13), _mm_set1_epi32(0x38000000));
+					__m128i infNan = _mm_add_epi32(normal, _mm_set1_epi32(0x38000000));
+					// denormals are small integers times 2^-24, which converts exactly
+					__m128i denorm = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(em), _mm_set1_ps(1.0f / 16777216.0f)));
+
+					__m128i r = Select(_mm_cmpgt_epi32(em, _mm_set1_epi32(0x7bff)), infNan, normal);
+					r = Select(_mm_cmplt_epi32(em, _mm_set1_epi32(0x400)), denorm, r);
+					return _mm_castsi128_ps(_mm_or_si128(r, sign));
+				}
+
+				// Same as Math::R32ToR16I, which truncates. The results are in the low 16 bits of each lane.
+				static inline __m128i FloatToHalf(__m128 v)
+				{
+					const __m128i bits = _mm_castps_si128(v);
+					const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+					const __m128i abs = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+					const __m128i e = _mm_srli_epi32(abs, 23);
+
+					__m128i normal = _mm_sub_epi32(_mm_srli_epi32(abs, 13), _mm_set1_epi32(112 << 10));
+					__m128i denorm = _mm_cvttps_epi32(_mm_mul_ps(_mm_castsi128_ps(abs), _mm_set1_ps(16777216.0f)));
+					__m128i infNan = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_srli_epi32(_mm_and_si128(abs, _mm_set1_epi32(0x7fffff)), 13));
+
+					__m128i r = Select(_mm_cmpgt_epi32(e, _mm_set1_epi32(112)), normal, denorm);
+					r = Select(_mm_cmpgt_epi32(e, _mm_set1_epi32(142)), _mm_set1_epi32(0x7c00), r);
+					r = Select(_mm_cmpeq_epi32(e, _mm_set1_epi32(255)), infNan, r);
+					return _mm_or_si128(r, sign);
+				}
+
+				// Packs the low 16 bits of each lane, as _mm_packs_epi32 saturates
+				static inline __m128i Pack16(__m128i a, __m128i b)
+				{
+					a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+					b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+					return _mm_packs_epi32(a, b);
+				}
+
+				// A8R8G8B8 pixel in the low 4 bytes of the lanes to a,r,g,b floats
+				static inline __m128 UnpackColor(__m128i bgra)
+				{
+					__m128 v = _mm_div_ps(_mm_cvtepi32_ps(bgra), _mm_set1_ps(255.0f));
+					return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+				}
+				// a,r,g,b floats to the b,g,r,a bytes of a A8R8G8B8 pixel, as int32s
+				static inline __m128i PackColor(__m128 argb)
+				{
+					__m128 v = _mm_shuffle_ps(argb, argb, _MM_SHUFFLE(0, 1, 2, 3));
+					v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+					return _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.0f)));
+				}
+
+				int32 Shuffle32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					// bytes moving by the same distance are done together
+					uint32 masks[7] = { 0 };
+					for (int32 k = 0; k < 4; k++)
+					{
+						if (params.Shuffle[k] != 0x80)
+							masks[k - params.Shuffle[k] + 3] |= 0xFFu << (params.Shuffle[k] * 8);
+					}
+
+					// at most 4 distances are used, unused terms have an empty mask
+					__m128i termMasks[4];
+					__m128i termLeft[4];
+					__m128i termRight[4];
+					int32 termCount = 0;
+					for (int32 i = 0; i < 4; i++)
+						termMasks[i] = termLeft[i] = termRight[i] = _mm_setzero_si128();
+
+					for (int32 i = 0; i < 7; i++)
+					{
+						if (masks[i])
+						{
+							int32 distance = (i - 3) * 8;
+							termMasks[termCount] = _mm_set1_epi32((int32)masks[i]);
+							termLeft[termCount] = _mm_cvtsi32_si128(distance > 0 ? distance : 0);
+							termRight[termCount] = _mm_cvtsi32_si128(distance < 0 ? -distance : 0);
+							termCount++;
+						}
+					}
+					const __m128i fill = _mm_set1_epi32((int32)params.Fill);
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4)
+					{
+						__m128i v = _mm_loadu_si128(s++);
+						__m128i t0 = _mm_srl_epi32(_mm_sll_epi32(_mm_and_si128(v, termMasks[0]), termLeft[0]), termRight[0]);
+						__m128i t1 = _mm_srl_epi32(_mm_sll_epi32(_mm_and_si128(v, termMasks[1]), termLeft[1]), termRight[1]);
+						__m128i t2 = _mm_srl_epi32(_mm_sll_epi32(_mm_and_si128(v, termMasks[2]), termLeft[2]), termRight[2]);
+						__m128i t3 = _mm_srl_epi32(_mm_sll_epi32(_mm_and_si128(v, termMasks[3]), termLeft[3]), termRight[3]);
+
+						_mm_storeu_si128(d++, _mm_or_si128(_mm_or_si128(t0, t1), _mm_or_si128(_mm_or_si128(t2, t3), fill)));
+					}
+					return i;
+				}
+
+				int32 Expand8To32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					uint32 lumMask = 0;
+					for (int32 k = 0; k < 4; k++)
+					{
+						if (params.Shuffle[k] != 0x80)
+							lumMask |= 0xFFu << (k * 8);
+					}
+					const __m128i lum = _mm_set1_epi32((int32)lumMask);
+					const __m128i fill = _mm_set1_epi32((int32)params.Fill);
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 16 <= count; i += 16)
+					{
+						__m128i v = _mm_loadu_si128(s++);
+						__m128i lo = _mm_unpacklo_epi8(v, v);
+						__m128i hi = _mm_unpackhi_epi8(v, v);
+
+						_mm_storeu_si128(d++, _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi16(lo, lo), lum), fill));
+						_mm_storeu_si128(d++, _mm_or_si128(_mm_and_si128(_mm_unpackhi_epi16(lo, lo), lum), fill));
+						_mm_storeu_si128(d++, _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi16(hi, hi), lum), fill));
+						_mm_storeu_si128(d++, _mm_or_si128(_mm_and_si128(_mm_unpackhi_epi16(hi, hi), lum), fill));
+					}
+					return i;
+				}
+
+				int32 Extract32To8(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i shift = _mm_cvtsi32_si128(params.Shuffle[0] * 8);
+					const __m128i mask = _mm_set1_epi32(0xFF);
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 16 <= count; i += 16, s += 4)
+					{
+						__m128i a = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s), shift), mask);
+						__m128i b = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 1), shift), mask);
+						__m128i c = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 2), shift), mask);
+						__m128i e = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 3), shift), mask);
+
+						_mm_storeu_si128(d++, _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e)));
+					}
+					return i;
+				}
+
+				int32 L8ToL16(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 16 <= count; i += 16)
+					{
+						__m128i v = _mm_loadu_si128(s++);
+						_mm_storeu_si128(d++, _mm_unpacklo_epi8(v, v));
+						_mm_storeu_si128(d++, _mm_unpackhi_epi8(v, v));
+					}
+					return i;
+				}
+
+				int32 L16ToL8(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 16 <= count; i += 16, s += 2)
+					{
+						__m128i a = _mm_srli_epi16(_mm_loadu_si128(s), 8);
+						__m128i b = _mm_srli_epi16(_mm_loadu_si128(s + 1), 8);
+						_mm_storeu_si128(d++, _mm_packus_epi16(a, b));
+					}
+					return i;
+				}
+
+				int32 A8R8G8B8ToF32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i zero = _mm_setzero_si128();
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					float* d = static_cast<float*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4, d += 16)
+					{
+						__m128i v = _mm_loadu_si128(s++);
+						__m128i lo = _mm_unpacklo_epi8(v, zero);
+						__m128i hi = _mm_unpackhi_epi8(v, zero);
+
+						_mm_storeu_ps(d, UnpackColor(_mm_unpacklo_epi16(lo, zero)));
+						_mm_storeu_ps(d + 4, UnpackColor(_mm_unpackhi_epi16(lo, zero)));
+						_mm_storeu_ps(d + 8, UnpackColor(_mm_unpacklo_epi16(hi, zero)));
+						_mm_storeu_ps(d + 12, UnpackColor(_mm_unpackhi_epi16(hi, zero)));
+					}
+					return i;
+				}
+
+				int32 F32ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const float* s = static_cast<const float*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4, s += 16)
+					{
+						__m128i a = PackColor(_mm_loadu_ps(s));
+						__m128i b = PackColor(_mm_loadu_ps(s + 4));
+						__m128i c = PackColor(_mm_loadu_ps(s + 8));
+						__m128i e = PackColor(_mm_loadu_ps(s + 12));
+
+						_mm_storeu_si128(d++, _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e)));
+					}
+					return i;
+				}
+
+				int32 A8R8G8B8ToF16(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i zero = _mm_setzero_si128();
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4)
+					{
+						__m128i v = _mm_loadu_si128(s++);
+						__m128i lo = _mm_unpacklo_epi8(v, zero);
+						__m128i hi = _mm_unpackhi_epi8(v, zero);
+
+						__m128i h0 = FloatToHalf(UnpackColor(_mm_unpacklo_epi16(lo, zero)));
+						__m128i h1 = FloatToHalf(UnpackColor(_mm_unpackhi_epi16(lo, zero)));
+						__m128i h2 = FloatToHalf(UnpackColor(_mm_unpacklo_epi16(hi, zero)));
+						__m128i h3 = FloatToHalf(UnpackColor(_mm_unpackhi_epi16(hi, zero)));
+
+						_mm_storeu_si128(d++, Pack16(h0, h1));
+						_mm_storeu_si128(d++, Pack16(h2, h3));
+					}
+					return i;
+				}
+
+				int32 F16ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i zero = _mm_setzero_si128();
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4, s += 2)
+					{
+						__m128i v0 = _mm_loadu_si128(s);
+						__m128i v1 = _mm_loadu_si128(s + 1);
+
+						__m128i a = PackColor(HalfToFloat(_mm_unpacklo_epi16(v0, zero)));
+						__m128i b = PackColor(HalfToFloat(_mm_unpackhi_epi16(v0, zero)));
+						__m128i c = PackColor(HalfToFloat(_mm_unpacklo_epi16(v1, zero)));
+						__m128i e = PackColor(HalfToFloat(_mm_unpackhi_epi16(v1, zero)));
+
+						_mm_storeu_si128(d++, _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e)));
+					}
+					return i;
+				}
+
+				int32 F32ToF16(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const float* s = static_cast<const float*>(src);
+					__m128i* d = static_cast<__m128i*>(dst);
+
+					int32 i = 0;
+					for (; i + 2 <= count; i += 2, s += 8)
+					{
+						__m128i a = FloatToHalf(_mm_loadu_ps(s));
+						__m128i b = FloatToHalf(_mm_loadu_ps(s + 4));
+						_mm_storeu_si128(d++, Pack16(a, b));
+					}
+					return i;
+				}
+
+				int32 F16ToF32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i zero = _mm_setzero_si128();
+
+					const __m128i* s = static_cast<const __m128i*>(src);
+					float* d = static_cast<float*>(dst);
+
+					int32 i = 0;
+					for (; i + 2 <= count; i += 2, d += 8)
+					{
+						__m128i v = _mm_loadu_si128(s++);
+						_mm_storeu_ps(d, HalfToFloat(_mm_unpacklo_epi16(v, zero)));
+						_mm_storeu_ps(d + 4, HalfToFloat(_mm_unpackhi_epi16(v, zero)));
+					}
+					return i;
+				}
+			}
+		}
+	}
+}
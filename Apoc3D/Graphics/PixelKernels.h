@@ -0,0 +1,89 @@
+#pragma once
+#ifndef APOC3D_PIXELKERNELS_H
+#define APOC3D_PIXELKERNELS_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		/**
+		 *  SIMD row kernels behind PixelFormatUtils::ConvertPixels.
+		 *
+		 *  Each kernel converts a row of pixels, but only whole groups of them, and returns the
+		 *  number of pixels done. The rest of the row is left to the next lower level, ending
+		 *  with the scalar converter. Results are bit exact with the scalar converters.
+		 */
+		namespace PixelKernels
+		{
+			/** Per format pair constants for the byte moving kernels. */
+			struct KernelParams
+			{
+				/** For each output byte, the input byte it is copied from, or 0x80 to take it from Fill. */
+				byte Shuffle[4];
+				/** The bytes of every output pixel that do not come from the input. */
+				uint32 Fill;
+			};
+
+			typedef int32 (*Kernel)(const void* src, void* dst, int32 count, const KernelParams& params);
+
+			namespace SSE2
+			{
+				/** 32-bit pixels to 32-bit pixels, any byte order. */
+				int32 Shuffle32(const void* src, void* dst, int32 count, const KernelParams& params);
+				/** 8-bit luminance to 32-bit pixels. */
+				int32 Expand8To32(const void* src, void* dst, int32 count, const KernelParams& params);
+				/** One byte of 32-bit pixels to 8-bit luminance. */
+				int32 Extract32To8(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 L8ToL16(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 L16ToL8(const void* src, void* dst, int32 count, const KernelParams& params);
+
+				int32 A8R8G8B8ToF32(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F32ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 A8R8G8B8ToF16(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F16ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F32ToF16(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F16ToF32(const void* src, void* dst, int32 count, const KernelParams& params);
+			}
+
+#if APOC3D_MATH_AVX2
+			/** Implemented in PixelKernelsAVX2.cpp, which is compiled with AVX2 code generation. */
+			namespace AVX2
+			{
+				int32 Shuffle32(const void* src, void* dst, int32 count, const KernelParams& params);
+				/** 24-bit pixels to 24-bit pixels */
+				int32 Shuffle24(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 Shuffle24To32(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 Shuffle32To24(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 Expand8To32(const void* src, void* dst, int32 count, const KernelParams& params);
+
+				int32 A8R8G8B8ToF32(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F32ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 A8R8G8B8ToF16(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F16ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F32ToF16(const void* src, void* dst, int32 count, const KernelParams& params);
+				int32 F16ToF32(const void* src, void* dst, int32 count, const KernelParams& params);
+			}
+#endif
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,326 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+// This file is compiled with AVX2 code generation(/arch:AVX2), and is only entered when
+// GetMathSIMDLevel reports AVX2. Do not call inline functions from other headers here.
+
+#include "PixelKernels.h"
+
+#if APOC3D_MATH_AVX2
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+#include <cstring>
+
+namespace Apoc3D
+{
+	namespace Graphics
+	{
+		namespace PixelKernels
+		{
+			namespace AVX2
+			{
+				// The same as the SSE2 versions, 8 lanes at a time
+				static inline __m256 HalfToFloat(__m256i h)
+				{
+					const __m256i em = _mm256_and_si256(h, _mm256_set1_epi32(0x7fff));
+					const __m256i sign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16);
+
+					__m256i normal = _mm256_add_epi32(_mm256_slli_epi32(em, 13), _mm256_set1_epi32(0x38000000));
+					__m256i infNan = _mm256_add_epi32(normal, _mm256_set1_epi32(0x38000000));
+					__m256i denorm = _mm256_castps_si256(_mm256_mul_ps(_mm256_cvtepi32_ps(em), _mm256_set1_ps(1.0f / 16777216.0f)));
+
+					__m256i r = _mm256_blendv_epi8(normal, infNan, _mm256_cmpgt_epi32(em, _mm256_set1_epi32(0x7bff)));
+					r = _mm256_blendv_epi8(r, denorm, _mm256_cmpgt_epi32(_mm256_set1_epi32(0x400), em));
+					return _mm256_castsi256_ps(_mm256_or_si256(r, sign));
+				}
+
+				static inline __m256i FloatToHalf(__m256 v)
+				{
+					const __m256i bits = _mm256_castps_si256(v);
+					const __m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+					const __m256i abs = _mm256_and_si256(bits, _mm256_set1_epi32(0x7fffffff));
+					const __m256i e = _mm256_srli_epi32(abs, 23);
+
+					__m256i normal = _mm256_sub_epi32(_mm256_srli_epi32(abs, 13), _mm256_set1_epi32(112 << 10));
+					__m256i denorm = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_castsi256_ps(abs), _mm256_set1_ps(16777216.0f)));
+					__m256i infNan = _mm256_or_si256(_mm256_set1_epi32(0x7c00), _mm256_srli_epi32(_mm256_and_si256(abs, _mm256_set1_epi32(0x7fffff)), 13));
+
+					__m256i r = _mm256_blendv_epi8(denorm, normal, _mm256_cmpgt_epi32(e, _mm256_set1_epi32(112)));
+					r = _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7c00), _mm256_cmpgt_epi32(e, _mm256_set1_epi32(142)));
+					r = _mm256_blendv_epi8(r, infNan, _mm256_cmpeq_epi32(e, _mm256_set1_epi32(255)));
+					return _mm256_or_si256(r, sign);
+				}
+
+				// Packs the low 16 bits of each lane of a and b, in order
+				static inline __m256i Pack16(__m256i a, __m256i b)
+				{
+					__m256i r = _mm256_packus_epi32(_mm256_and_si256(a, _mm256_set1_epi32(0xffff)), _mm256_and_si256(b, _mm256_set1_epi32(0xffff)));
+					return _mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0));
+				}
+
+				// 2 A8R8G8B8 pixels to a,r,g,b floats
+				static inline __m256 UnpackColor(const void* src)
+				{
+					__m256i bgra = _mm256_cvtepu8_epi32(_mm_loadl_epi64(static_cast<const __m128i*>(src)));
+					__m256 v = _mm256_div_ps(_mm256_cvtepi32_ps(bgra), _mm256_set1_ps(255.0f));
+					return _mm256_permute_ps(v, _MM_SHUFFLE(0, 1, 2, 3));
+				}
+				// 2 pixels of a,r,g,b floats to the b,g,r,a bytes of A8R8G8B8 pixels, as int32s
+				static inline __m256i PackColor(__m256 argb)
+				{
+					__m256 v = _mm256_permute_ps(argb, _MM_SHUFFLE(0, 1, 2, 3));
+					v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+					return _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)));
+				}
+				// Pixels 0,1 in a, 2,3 in b and so on, to 8 A8R8G8B8 pixels
+				static inline __m256i PackColors(__m256i a, __m256i b, __m256i c, __m256i d)
+				{
+					// packing works within each 128-bit half, leaving pixels in the order 0,2,4,6,1,3,5,7
+					__m256i r = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+					return _mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+				}
+
+				// Makes a _mm256_shuffle_epi8 mask moving 4 pixels in each 128-bit half
+				static __m256i MakeShuffle(const KernelParams& params, int32 srcSize, int32 dstSize)
+				{
+					byte mask[16];
+					memset(mask, 0x80, sizeof(mask));
+
+					for (int32 p = 0; p < 4; p++)
+					{
+						for (int32 k = 0; k < dstSize; k++)
+						{
+							byte from = params.Shuffle[k];
+							mask[p * dstSize + k] = from == 0x80 ? 0x80 : (byte)(p * srcSize + from);
+						}
+					}
+					return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask)));
+				}
+
+				// 12 bytes from the low part of each 128-bit half
+				static inline void Store24(byte* d, __m256i v)
+				{
+					__m128i lo = _mm256_castsi256_si128(v);
+					__m128i hi = _mm256_extracti128_si256(v, 1);
+
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(d), lo);
+					int32 t = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+					memcpy(d + 8, &t, sizeof(t));
+
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(d + 12), hi);
+					t = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+					memcpy(d + 20, &t, sizeof(t));
+				}
+				// 4 pixels into each 128-bit half. Reads 4 bytes past the 8 pixels.
+				static inline __m256i Load24(const byte* s)
+				{
+					__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+					__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12));
+					return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+				}
+
+				int32 Shuffle32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m256i shuffle = MakeShuffle(params, 4, 4);
+					const __m256i fill = _mm256_set1_epi32((int32)params.Fill);
+
+					const __m256i* s = static_cast<const __m256i*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 8 <= count; i += 8)
+					{
+						__m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256(s++), shuffle);
+						_mm256_storeu_si256(d++, _mm256_or_si256(v, fill));
+					}
+					return i;
+				}
+
+				int32 Shuffle24(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m256i shuffle = MakeShuffle(params, 3, 3);
+
+					const byte* s = static_cast<const byte*>(src);
+					byte* d = static_cast<byte*>(dst);
+
+					// stops early so the loads past the 8 pixels stay in the row
+					int32 i = 0;
+					for (; i + 10 <= count; i += 8, s += 24, d += 24)
+					{
+						Store24(d, _mm256_shuffle_epi8(Load24(s), shuffle));
+					}
+					return i;
+				}
+
+				int32 Shuffle24To32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m256i shuffle = MakeShuffle(params, 3, 4);
+					const __m256i fill = _mm256_set1_epi32((int32)params.Fill);
+
+					const byte* s = static_cast<const byte*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 10 <= count; i += 8, s += 24)
+					{
+						__m256i v = _mm256_shuffle_epi8(Load24(s), shuffle);
+						_mm256_storeu_si256(d++, _mm256_or_si256(v, fill));
+					}
+					return i;
+				}
+
+				int32 Shuffle32To24(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m256i shuffle = MakeShuffle(params, 4, 3);
+
+					const __m256i* s = static_cast<const __m256i*>(src);
+					byte* d = static_cast<byte*>(dst);
+
+					int32 i = 0;
+					for (; i + 8 <= count; i += 8, d += 24)
+					{
+						Store24(d, _mm256_shuffle_epi8(_mm256_loadu_si256(s++), shuffle));
+					}
+					return i;
+				}
+
+				int32 Expand8To32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					uint32 lumMask = 0;
+					for (int32 k = 0; k < 4; k++)
+					{
+						if (params.Shuffle[k] != 0x80)
+							lumMask |= 0xFFu << (k * 8);
+					}
+					const __m256i lum = _mm256_set1_epi32((int32)lumMask);
+					const __m256i fill = _mm256_set1_epi32((int32)params.Fill);
+					const __m256i spread = _mm256_set1_epi32(0x01010101);
+
+					const byte* s = static_cast<const byte*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 8 <= count; i += 8, s += 8)
+					{
+						__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(s)));
+						v = _mm256_mullo_epi32(v, spread);
+						_mm256_storeu_si256(d++, _mm256_or_si256(_mm256_and_si256(v, lum), fill));
+					}
+					return i;
+				}
+
+				int32 A8R8G8B8ToF32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const uint32* s = static_cast<const uint32*>(src);
+					float* d = static_cast<float*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4, s += 4, d += 16)
+					{
+						_mm256_storeu_ps(d, UnpackColor(s));
+						_mm256_storeu_ps(d + 8, UnpackColor(s + 2));
+					}
+					return i;
+				}
+
+				int32 F32ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const float* s = static_cast<const float*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 8 <= count; i += 8, s += 32)
+					{
+						__m256i a = PackColor(_mm256_loadu_ps(s));
+						__m256i b = PackColor(_mm256_loadu_ps(s + 8));
+						__m256i c = PackColor(_mm256_loadu_ps(s + 16));
+						__m256i e = PackColor(_mm256_loadu_ps(s + 24));
+
+						_mm256_storeu_si256(d++, PackColors(a, b, c, e));
+					}
+					return i;
+				}
+
+				int32 A8R8G8B8ToF16(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const uint32* s = static_cast<const uint32*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4, s += 4)
+					{
+						__m256i a = FloatToHalf(UnpackColor(s));
+						__m256i b = FloatToHalf(UnpackColor(s + 2));
+						_mm256_storeu_si256(d++, Pack16(a, b));
+					}
+					return i;
+				}
+
+				int32 F16ToA8R8G8B8(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i* s = static_cast<const __m128i*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 8 <= count; i += 8, s += 4)
+					{
+						__m256i a = PackColor(HalfToFloat(_mm256_cvtepu16_epi32(_mm_loadu_si128(s))));
+						__m256i b = PackColor(HalfToFloat(_mm256_cvtepu16_epi32(_mm_loadu_si128(s + 1))));
+						__m256i c = PackColor(HalfToFloat(_mm256_cvtepu16_epi32(_mm_loadu_si128(s + 2))));
+						__m256i e = PackColor(HalfToFloat(_mm256_cvtepu16_epi32(_mm_loadu_si128(s + 3))));
+
+						_mm256_storeu_si256(d++, PackColors(a, b, c, e));
+					}
+					return i;
+				}
+
+				int32 F32ToF16(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const float* s = static_cast<const float*>(src);
+					__m256i* d = static_cast<__m256i*>(dst);
+
+					int32 i = 0;
+					for (; i + 4 <= count; i += 4, s += 16)
+					{
+						__m256i a = FloatToHalf(_mm256_loadu_ps(s));
+						__m256i b = FloatToHalf(_mm256_loadu_ps(s + 8));
+						_mm256_storeu_si256(d++, Pack16(a, b));
+					}
+					return i;
+				}
+
+				int32 F16ToF32(const void* src, void* dst, int32 count, const KernelParams& params)
+				{
+					const __m128i* s = static_cast<const __m128i*>(src);
+					float* d = static_cast<float*>(dst);
+
+					int32 i = 0;
+					for (; i + 2 <= count; i += 2, d += 8)
+					{
+						_mm256_storeu_ps(d, HalfToFloat(_mm256_cvtepu16_epi32(_mm_loadu_si128(s++))));
+					}
+					return i;
+				}
+			}
+		}
+	}
+}
+
+#endif
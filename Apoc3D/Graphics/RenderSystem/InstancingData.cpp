@@ -1,5 +1,17 @@
 #include "InstancingData.h"
 
+#include "RenderDevice.h"
+#include "HardwareBuffer.h"
+#include "VertexDeclaration.h"
+#include "VertexElement.h"
+
+#include "apoc3d/Graphics/RenderOperation.h"
+#include "apoc3d/Graphics/EffectSystem/EffectParameter.h"
+#include "apoc3d/Math/MathCommon.h"
+#include "apoc3d/Math/Matrix.h"
+
+using namespace Apoc3D::Graphics::EffectSystem;
+
 
 namespace Apoc3D
 {
@@ -7,17 +19,109 @@ namespace Apoc3D
 	{
 		namespace RenderSystem
 		{
+			static Vector4 ConvertBlobValue(const InstanceInfoBlobValue& v)
+			{
+				switch (v.Type)
+				{
+					case CEPT_Float: return Vector4(v.AsSingle(), 0, 0, 0);
+					case CEPT_Vector2: return Vector4(v.AsVector2().X, v.AsVector2().Y, 0, 0);
+					case CEPT_Vector4: return v.AsVector4();
+					case CEPT_Ref_Vector2:
+					{
+						const Vector2* val = reinterpret_cast<const Vector2*>(v.RefValue);
+						return Vector4(val->X, val->Y, 0, 0);
+					}
+					case CEPT_Ref_Vector3:
+					{
+						const Vector3* val = reinterpret_cast<const Vector3*>(v.RefValue);
+						return Vector4(val->X, val->Y, val->Z, 0);
+					}
+					case CEPT_Ref_Vector4:
+						return *reinterpret_cast<const Vector4*>(v.RefValue);
+					default:
+						// not representable in a float4
+						return Vector4::Zero;
+				}
+			}
+
 			InstancingData::InstancingData(RenderDevice* device)
 				: m_device(device)
 			{
-				//ObjectFactory* objFac = device->getObjectFactory();
-
-				//objFac->CreateVertexBuffer();
 			}
 
 			InstancingData::~InstancingData()
 			{
+				DELETE_AND_NULL(m_instanceStream);
+				DELETE_AND_NULL(m_instanceStreamDecl);
+			}
+
+			InstanceStreamRange InstancingData::FillInstanceStream(const RenderOperation* op, int32 count, int32 blobValueCount)
+			{
+				InstanceStreamRange range;
+				if (count <= 0)
+					return range;
+
+				blobValueCount = Math::Clamp(blobValueCount, 0, MaxInstanceStreamBlobValues);
+
+				int32 instanceSize = InstanceStreamTransformSize + blobValueCount;
+				int32 required = instanceSize * count;
+
+				ObjectFactory* fac = m_device->getObjectFactory();
+				if (m_instanceStreamDecl == nullptr)
+				{
+					List<VertexElement> elems;
+					elems.Add(VertexElement(0, VEF_Vector4, VEU_TextureCoordinate, InstanceStreamTexCoordIndex));
+					m_instanceStreamDecl = fac->CreateVertexDeclaration(elems);
+				}
+
+				LockMode lockMode = LOCK_NoOverwrite;
+				if (required > m_instanceStreamCapacity)
+				{
+					DELETE_AND_NULL(m_instanceStream);
+
+					m_instanceStreamCapacity = Math::Max(required, Math::Max(m_instanceStreamCapacity * 2, 4096));
+					m_instanceStream = fac->CreateVertexBuffer(m_instanceStreamCapacity, m_instanceStreamDecl, (BufferUsageFlags)(BU_Dynamic | BU_WriteOnly));
+					m_instanceStreamPosition = 0;
+					lockMode = LOCK_Discard;
+				}
+				else if (m_instanceStreamPosition + required > m_instanceStreamCapacity)
+				{
+					// wrap around. The GPU may still be reading the rest, so start with a new buffer
+					m_instanceStreamPosition = 0;
+					lockMode = LOCK_Discard;
+				}
+
+				const int32 float4Size = sizeof(Vector4);
+				Vector4* dst = reinterpret_cast<Vector4*>(m_instanceStream->Lock(m_instanceStreamPosition * float4Size, required * float4Size, lockMode));
+
+				for (int32 i = 0; i < count; i++)
+				{
+					const Matrix& m = op[i].RootTransform;
+					dst[0] = Vector4(m.M11, m.M21, m.M31, m.M41);
+					dst[1] = Vector4(m.M12, m.M22, m.M32, m.M42);
+					dst[2] = Vector4(m.M13, m.M23, m.M33, m.M43);
+					dst += InstanceStreamTransformSize;
+
+					if (blobValueCount > 0)
+					{
+						const InstanceInfoBlob* blob = reinterpret_cast<const InstanceInfoBlob*>(op[i].UserData);
+						for (int32 j = 0; j < blobValueCount; j++)
+						{
+							dst[j] = blob && j < blob->getCount() ? ConvertBlobValue((*blob)[j]) : Vector4::Zero;
+						}
+						dst += blobValueCount;
+					}
+				}
+
+				m_instanceStream->Unlock();
+
+				range.Offset = m_instanceStreamPosition * float4Size;
+				range.Stride = instanceSize * float4Size;
+				range.BlobValueCount = blobValueCount;
+				range.InstanceCount = count;
 
+				m_instanceStreamPosition += required;
+				return range;
 			}
 		}
 	}
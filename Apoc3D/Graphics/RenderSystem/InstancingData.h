@@ -31,15 +31,56 @@ namespace Apoc3D
 	{
 		namespace RenderSystem
 		{
-			/** An interface for instancing */
+			/** Where the per-instance data of one draw is in the instance stream. */
+			struct InstanceStreamRange
+			{
+				/** Offset of the first instance in the stream, in bytes. */
+				int32 Offset = 0;
+				/** Size of each instance, in bytes. */
+				int32 Stride = 0;
+				/** The number of instance blob values after the transform of each instance. */
+				int32 BlobValueCount = 0;
+				int32 InstanceCount = 0;
+			};
+
+			/**
+			 *  An interface for instancing.
+			 *
+			 *  There are two ways of instancing. Effects using EPUSAGE_Trans_InstanceWorlds take the transforms from
+			 *  a constant array, up to MaxOneTimeInstances a draw. Effects using EPUSAGE_Trans_InstanceStream take them
+			 *  from a per-instance vertex stream filled by FillInstanceStream, with no limit on the number of instances.
+			 *
+			 *  Each instance in the stream is a number of float4s. The first InstanceStreamTransformSize of them are the
+			 *  columns of the world transform, mapped to TEXCOORD InstanceStreamTexCoordIndex and up, so that
+			 *  the world position is (dot(p, c0), dot(p, c1), dot(p, c2)). They are followed by the values of the
+			 *  render operation's InstanceInfoBlob the effect asks for, converted to float4.
+			 *  Indexed geometry is drawn in one call for all instances. Non-indexed geometry is drawn one
+			 *  instance a call, reading the same stream.
+			 */
 			class APAPI InstancingData
 			{
 			public:
 				static const int32 MaxOneTimeInstances = 50;
 
+				static const int32 InstanceStreamTransformSize = 3;
+				static const int32 MaxInstanceStreamBlobValues = 4;
+				static const int32 InstanceStreamTexCoordIndex = 8;
+
 				InstancingData(RenderDevice* device);
 				virtual ~InstancingData();
 
+				/**
+				 *  Writes the transforms and instance blob values of the render operations into the instance stream.
+				 *  The stream grows as needed and is written with LOCK_NoOverwrite until it wraps around.
+				 *
+				 *  @param blobValueCount The number of values to take from the InstanceInfoBlob pointed by each
+				 *		render operation's UserData. 0 when the effect uses none.
+				 */
+				InstanceStreamRange FillInstanceStream(const RenderOperation* op, int32 count, int32 blobValueCount);
+
+				/** The vertex buffer behind the instance stream. Null before the first FillInstanceStream. */
+				VertexBuffer* getInstanceStream() const { return m_instanceStream; }
+
 				/** Prepares the instancing data for a set of render operation began at beginIndex in op.
 				 *  This is called each time of drawing up to MaxOneTimeInstances instances.
 				 *
@@ -49,7 +90,12 @@ namespace Apoc3D
 
 			private:
 				RenderDevice* m_device;
-				
+
+				/** One float4 per vertex, so any stride that is a multiple of it can be used. */
+				VertexDeclaration* m_instanceStreamDecl = nullptr;
+				VertexBuffer* m_instanceStream = nullptr;
+				int32 m_instanceStreamCapacity = 0;			/** in float4s */
+				int32 m_instanceStreamPosition = 0;			/** in float4s */
 			};
 		}
 	}
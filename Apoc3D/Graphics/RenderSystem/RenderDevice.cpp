@@ -56,7 +56,7 @@ namespace Apoc3D
 
 					Effect* fx = mtrl->GetPassEffect(passSelID);
 
-					if (fx->SupportsInstancing())
+					if (fx->SupportsInstancing() || fx->SupportsStreamInstancing())
 					{
 						const RenderOperation& rop = op[0];
 						const GeometryData* gm = rop.GeometryData;
@@ -67,9 +67,17 @@ namespace Apoc3D
 						entry->PrimitiveInstanced += gm->PrimitiveCount*count;
 						entry->VertexInstanced += gm->VertexCount*count;
 						entry->DPInstanced += count;
-						entry->InstancingBatch += count / InstancingData::MaxOneTimeInstances;
-						if ((count % InstancingData::MaxOneTimeInstances) != 0)
+
+						if (fx->SupportsStreamInstancing())
+						{
 							entry->InstancingBatch++;
+						}
+						else
+						{
+							entry->InstancingBatch += count / InstancingData::MaxOneTimeInstances;
+							if ((count % InstancingData::MaxOneTimeInstances) != 0)
+								entry->InstancingBatch++;
+						}
 					}
 					else
 					{
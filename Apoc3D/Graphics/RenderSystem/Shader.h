@@ -64,6 +64,12 @@ namespace Apoc3D
 				virtual bool TryGetParamIndex(const String& paramName, int& result) = 0;
 				virtual bool TryGetSamplerIndex(const String& paramName, int& result) = 0;
 
+				/**
+				 *  True if parameter indices are float4 constant registers, so values in consecutive
+				 *  registers can be set together with one SetVector4 call.
+				 */
+				virtual bool HasLinearRegisters() const { return false; }
+
 				virtual void SetVector2(int idx, const Vector2& value) = 0;
 				virtual void SetVector3(int idx, const Vector3& value) = 0;
 				virtual void SetVector4(int idx, const Vector4& value) = 0;
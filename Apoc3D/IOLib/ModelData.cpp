@@ -23,6 +23,7 @@
 #include "apoc3d/Vfs/ResourceLocation.h"
 #include "apoc3d/Graphics/Animation/AnimationData.h"
 #include "apoc3d/Core/Logging.h"
+#include "apoc3d/Math/Math.h"
 #include "apoc3d/Utility/StringUtils.h"
 
 using namespace Apoc3D::Utility;
@@ -54,6 +55,257 @@ namespace Apoc3D
 		//const String TAG_3_ParentBoneTag = L"ParentBone";
 		constexpr TaggedDataKey TAG_3_BoundingSphereTag = "BoundingSphere";
 
+		// part split layout, written instead of the faces when MeshStorageOptions::SplitIndices is set
+		constexpr TaggedDataKey TAG_3_PartIndexBitsTag = "PartIndexBits";
+		constexpr TaggedDataKey TAG_3_PartIndexCountTag = "PartIndexCount";
+		constexpr TaggedDataKey TAG_3_PartRangesTag = "PartRanges";
+		constexpr TaggedDataKey TAG_3_PartIndicesTag = "PartIndices";
+
+		// quantized vertex data, written instead of VertexData when any vertex element is encoded
+		constexpr TaggedDataKey TAG_3_VertexEncodingTag = "VertexEncoding";
+		constexpr TaggedDataKey TAG_3_PackedVertexDataTag = "PackedVertexData";
+
+		enum VertexEncoding : uint32
+		{
+			VENC_Raw = 0,
+			VENC_Half2 = 1,
+			VENC_Octahedral = 2
+		};
+
+		static_assert(sizeof(MeshPart) == sizeof(int32) * 5, "MeshPart is expected to be 5 int32s");
+
+		static int32 GetEncodedSize(const VertexElement& ve, VertexEncoding enc)
+		{
+			return enc == VENC_Raw ? ve.getSize() : 4;
+		}
+
+		static void SplitFaces(const List<MeshFace>& faces, int32 partCount, uint32 vertexCount, List<MeshPart>& parts, char*& indexData, bool& index16)
+		{
+			index16 = vertexCount <= MaxUInt16;
+			parts.ReserveDiscard(partCount);
+
+			for (const MeshFace& face : faces)
+			{
+				assert(face.MaterialID < partCount);
+				parts[face.MaterialID].IndexCount += 3;
+			}
+
+			int32 indexCount = 0;
+			for (MeshPart& part : parts)
+			{
+				part.IndexStart = indexCount;
+				indexCount += part.IndexCount;
+				part.IndexCount = 0;
+			}
+
+			uint16* indices16 = nullptr;
+			uint32* indices32 = nullptr;
+			if (index16)
+				indexData = reinterpret_cast<char*>(indices16 = new uint16[indexCount]);
+			else
+				indexData = reinterpret_cast<char*>(indices32 = new uint32[indexCount]);
+
+			for (const MeshFace& face : faces)
+			{
+				MeshPart& part = parts[face.MaterialID];
+				int32 pos = part.IndexStart + part.IndexCount;
+
+				if (index16)
+				{
+					indices16[pos] = (uint16)face.IndexA;
+					indices16[pos + 1] = (uint16)face.IndexB;
+					indices16[pos + 2] = (uint16)face.IndexC;
+				}
+				else
+				{
+					indices32[pos] = (uint32)face.IndexA;
+					indices32[pos + 1] = (uint32)face.IndexB;
+					indices32[pos + 2] = (uint32)face.IndexC;
+				}
+				part.IndexCount += 3;
+			}
+
+			// find out how many vertex that each part is pointing to
+			bool* used = new bool[vertexCount];
+			for (MeshPart& part : parts)
+			{
+				memset(used, 0, vertexCount * sizeof(bool));
+
+				int32 vertexUsedMin = (int32)vertexCount - 1;
+				int32 vertexUsedMax = 0;
+
+				for (int32 j = part.IndexStart; j < part.IndexStart + part.IndexCount; j++)
+				{
+					int32 idx = index16 ? indices16[j] : (int32)indices32[j];
+
+					if (!used[idx])
+					{
+						used[idx] = true;
+						part.VertexCount++;
+					}
+
+					if (idx < vertexUsedMin)
+						vertexUsedMin = idx;
+					if (idx > vertexUsedMax)
+						vertexUsedMax = idx;
+				}
+
+				part.VertexRangeStart = vertexUsedMin;
+				part.VertexRangeCount = Math::Max(0, vertexUsedMax - vertexUsedMin + 1);
+			}
+			delete[] used;
+		}
+
+		static void ExpandParts(const List<MeshPart>& parts, const char* indexData, bool index16, List<MeshFace>& faces)
+		{
+			const uint16* indices16 = reinterpret_cast<const uint16*>(indexData);
+			const uint32* indices32 = reinterpret_cast<const uint32*>(indexData);
+
+			for (int32 i = 0; i < parts.getCount(); i++)
+			{
+				const MeshPart& part = parts[i];
+
+				for (int32 j = part.IndexStart; j < part.IndexStart + part.IndexCount; j += 3)
+				{
+					if (index16)
+						faces.Add(MeshFace(indices16[j], indices16[j + 1], indices16[j + 2], i));
+					else
+						faces.Add(MeshFace(indices32[j], indices32[j + 1], indices32[j + 2], i));
+				}
+			}
+		}
+
+		// Octahedral mapping of unit vectors. The upper hemisphere is projected onto the inner
+		// diamond of the square and the lower one is folded over the corners.
+		static void EncodeOctahedral(const float* n, int16* result)
+		{
+			float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+			float x = l1 > 0 ? n[0] / l1 : 0;
+			float y = l1 > 0 ? n[1] / l1 : 0;
+
+			if (n[2] < 0)
+			{
+				float fx = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+				float fy = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+				x = fx;
+				y = fy;
+			}
+
+			result[0] = (int16)Math::Round(Math::Clamp(x, -1.0f, 1.0f) * 32767.0f);
+			result[1] = (int16)Math::Round(Math::Clamp(y, -1.0f, 1.0f) * 32767.0f);
+		}
+
+		static void DecodeOctahedral(const int16* e, float* n)
+		{
+			float x = e[0] / 32767.0f;
+			float y = e[1] / 32767.0f;
+			float z = 1 - fabsf(x) - fabsf(y);
+
+			if (z < 0)
+			{
+				float t = -z;
+				x += x >= 0 ? -t : t;
+				y += y >= 0 ? -t : t;
+			}
+
+			float len = sqrtf(x * x + y * y + z * z);
+			if (len > 0)
+				len = 1.0f / len;
+
+			n[0] = x * len;
+			n[1] = y * len;
+			n[2] = z * len;
+		}
+
+		static void EncodeVertices(const char* src, uint32 vertexSize, uint32 vertexCount, const List<VertexElement>& elements, 
+			const List<VertexEncoding>& encodings, int32 packedSize, char* dst)
+		{
+			for (uint32 i = 0; i < vertexCount; i++)
+			{
+				const char* vtx = src + i * vertexSize;
+
+				for (int32 k = 0; k < elements.getCount(); k++)
+				{
+					const VertexElement& ve = elements[k];
+					const float* v = reinterpret_cast<const float*>(vtx + ve.getOffset());
+
+					switch (encodings[k])
+					{
+						case VENC_Half2:
+						{
+							uint16 h[2] = { Math::R32ToR16(v[0]), Math::R32ToR16(v[1]) };
+							memcpy(dst, h, sizeof(h));
+							break;
+						}
+						case VENC_Octahedral:
+						{
+							int16 e[2];
+							EncodeOctahedral(v, e);
+							memcpy(dst, e, sizeof(e));
+							break;
+						}
+						default:
+							memcpy(dst, v, ve.getSize());
+							break;
+					}
+					dst += GetEncodedSize(ve, encodings[k]);
+				}
+			}
+		}
+
+		static void DecodeVertices(const char* src, uint32 vertexSize, uint32 vertexCount, const List<VertexElement>& elements,
+			const List<VertexEncoding>& encodings, char* dst)
+		{
+			for (uint32 i = 0; i < vertexCount; i++)
+			{
+				char* vtx = dst + i * vertexSize;
+
+				for (int32 k = 0; k < elements.getCount(); k++)
+				{
+					const VertexElement& ve = elements[k];
+					float* v = reinterpret_cast<float*>(vtx + ve.getOffset());
+
+					switch (encodings[k])
+					{
+						case VENC_Half2:
+						{
+							uint16 h[2];
+							memcpy(h, src, sizeof(h));
+							v[0] = Math::R16ToR32(h[0]);
+							v[1] = Math::R16ToR32(h[1]);
+							break;
+						}
+						case VENC_Octahedral:
+						{
+							int16 e[2];
+							memcpy(e, src, sizeof(e));
+							DecodeOctahedral(e, v);
+							break;
+						}
+						default:
+							memcpy(v, src, ve.getSize());
+							break;
+					}
+					src += GetEncodedSize(ve, encodings[k]);
+				}
+			}
+		}
+
+		static void ReadBlock(TaggedDataReader* data, const TaggedDataKey& name, char* dst, int64 size)
+		{
+			if (const char* src = data->TryGetDataPointer(name))
+			{
+				memcpy(dst, src, (size_t)size);
+			}
+			else
+			{
+				data->ProcessData(name, [dst, size](BinaryReader* br)
+				{
+					br->ReadBytes(dst, size);
+				});
+			}
+		}
+
 		uint32 MeshData::ComputeVertexSize(const List<VertexElement>& elements)
 		{
 			uint32 vertexSize = 0;
@@ -107,21 +359,36 @@ namespace Apoc3D
 			// read name
 			data->GetString(TAG_3_NameTag, Name);
 
-			// read faces
+			// read the indices already split per sub mesh, or the faces
+			uint32 partIndexBits;
+			if (data->TryGetUInt32(TAG_3_PartIndexBitsTag, partIndexBits))
+			{
+				PartIndices16 = partIndexBits == 16;
+
+				Parts.ReserveDiscard(materialCount);
+				if (materialCount > 0)
+					data->GetInt32(TAG_3_PartRangesTag, &Parts[0].IndexStart, materialCount * 5);
+
+				uint32 indexCount = data->GetUInt32(TAG_3_PartIndexCountTag);
+				for (const MeshPart& part : Parts)
+				{
+					if (part.IndexStart < 0 || part.IndexCount < 0 || (uint32)(part.IndexStart + part.IndexCount) > indexCount)
+						AP_EXCEPTION(ErrorID::InvalidData, L"MeshData part index range");
+				}
+
+				int64 indexDataSize = (int64)indexCount * (PartIndices16 ? sizeof(uint16) : sizeof(uint32));
+				PartIndexData = new char[indexDataSize];
+				ReadBlock(data, TAG_3_PartIndicesTag, PartIndexData, indexDataSize);
+			}
+			else
 			{
 				uint32 faceCount = data->GetInt32(TAG_3_FaceCountTag);
 				Faces.ReserveDiscard(faceCount);
 
-				data->ProcessData(TAG_3_FacesTag, [this](BinaryReader* br)
-				{
-					for (MeshFace & face : Faces)
-					{
-						face.IndexA = br->ReadInt32();
-						face.IndexB = br->ReadInt32();
-						face.IndexC = br->ReadInt32();
-						face.MaterialID = br->ReadInt32();
-					}
-				});
+				// faces are stored as 4 int32s each, same as MeshFace; read them as one array
+				static_assert(sizeof(MeshFace) == sizeof(int32) * 4, "MeshFace is expected to be 4 int32s");
+				if (faceCount > 0)
+					data->GetInt32(TAG_3_FacesTag, &Faces[0].IndexA, faceCount * 4);
 			}
 
 			// vertex element
@@ -148,14 +415,41 @@ namespace Apoc3D
 			VertexCount = data->GetUInt32(TAG_3_VertexCountTag);
 
 			// vertex data
-			data->ProcessData(TAG_3_VertexDataTag, [this](BinaryReader* br)
+			VertexData = new char[VertexCount*VertexSize];
+
+			List<VertexEncoding> encodings;
+			encodings.ReserveDiscard(VertexElements.getCount());
+
+			if (encodings.getCount() > 0 &&
+				data->TryGetUInt32(TAG_3_VertexEncodingTag, reinterpret_cast<uint32*>(&encodings[0]), encodings.getCount()))
 			{
-				VertexData = new char[VertexCount*VertexSize];
-				br->ReadBytes(reinterpret_cast<char*>(VertexData), VertexCount*VertexSize);
-			});
+				int32 packedSize = 0;
+				for (int32 i = 0; i < VertexElements.getCount(); i++)
+					packedSize += GetEncodedSize(VertexElements[i], encodings[i]);
+
+				int64 packedDataSize = (int64)packedSize * VertexCount;
+
+				char* buffer = nullptr;
+				const char* src = data->TryGetDataPointer(TAG_3_PackedVertexDataTag);
+				if (src == nullptr)
+				{
+					buffer = new char[packedDataSize];
+					ReadBlock(data, TAG_3_PackedVertexDataTag, buffer, packedDataSize);
+					src = buffer;
+				}
+
+				memset(VertexData, 0, VertexCount*VertexSize);
+				DecodeVertices(src, VertexSize, VertexCount, VertexElements, encodings, VertexData);
+
+				delete[] buffer;
+			}
+			else
+			{
+				ReadBlock(data, TAG_3_VertexDataTag, VertexData, VertexCount*VertexSize);
+			}
 		}
 
-		void MeshData::SaveData(TaggedDataWriter* data) const
+		void MeshData::SaveData(TaggedDataWriter* data, const MeshStorageOptions& options) const
 		{
 			uint32 materialCount = Materials.getMaterialCount();
 			data->AddUInt32(TAG_3_MaterialCountTag, materialCount);
@@ -187,19 +481,62 @@ namespace Apoc3D
 			// write name
 			data->AddString(TAG_3_NameTag, Name);
 			
-			data->AddUInt32(TAG_3_FaceCountTag, static_cast<uint32>(Faces.getCount()));
+			if (options.SplitIndices)
+			{
+				const List<MeshPart>* parts = &Parts;
+				const char* indexData = PartIndexData;
+				bool index16 = PartIndices16;
+
+				List<MeshPart> splitParts;
+				char* splitIndexData = nullptr;
+				if (Parts.getCount() == 0)
+				{
+					SplitFaces(Faces, materialCount, VertexCount, splitParts, splitIndexData, index16);
+					parts = &splitParts;
+					indexData = splitIndexData;
+				}
+
+				int32 indexCount = 0;
+				for (const MeshPart& part : *parts)
+					indexCount = Math::Max(indexCount, part.IndexStart + part.IndexCount);
+
+				data->AddUInt32(TAG_3_PartIndexBitsTag, index16 ? 16 : 32);
+				data->AddUInt32(TAG_3_PartIndexCountTag, static_cast<uint32>(indexCount));
+				if (parts->getCount() > 0)
+					data->AddInt32(TAG_3_PartRangesTag, &(*parts)[0].IndexStart, parts->getCount() * 5);
+
+				data->AddEntry(TAG_3_PartIndicesTag, [=](BinaryWriter* bw)
+				{
+					bw->WriteBytes(indexData, (int64)indexCount * (index16 ? sizeof(uint16) : sizeof(uint32)));
+				});
 
-			// write faces
-			data->AddEntry(TAG_3_FacesTag, [this](BinaryWriter* bw)
+				delete[] splitIndexData;
+			}
+			else
 			{
-				for (const MeshFace& mf : Faces)
+				const List<MeshFace>* faces = &Faces;
+
+				List<MeshFace> expandedFaces;
+				if (Faces.getCount() == 0 && Parts.getCount() > 0)
 				{
-					bw->WriteInt32(mf.IndexA);
-					bw->WriteInt32(mf.IndexB);
-					bw->WriteInt32(mf.IndexC);
-					bw->WriteInt32(mf.MaterialID);
+					ExpandParts(Parts, PartIndexData, PartIndices16, expandedFaces);
+					faces = &expandedFaces;
 				}
-			});
+
+				data->AddUInt32(TAG_3_FaceCountTag, static_cast<uint32>(faces->getCount()));
+
+				// write faces
+				data->AddEntry(TAG_3_FacesTag, [faces](BinaryWriter* bw)
+				{
+					for (const MeshFace& mf : *faces)
+					{
+						bw->WriteInt32(mf.IndexA);
+						bw->WriteInt32(mf.IndexB);
+						bw->WriteInt32(mf.IndexC);
+						bw->WriteInt32(mf.MaterialID);
+					}
+				});
+			}
 
 			// write vertex elements
 			data->AddEntry(TAG_3_VertexDeclTag, [this](BinaryWriter* bw)
@@ -218,10 +555,48 @@ namespace Apoc3D
 			data->AddUInt32(TAG_3_VertexCountTag, VertexCount);
 
 			// save vertex data
-			data->AddEntry(TAG_3_VertexDataTag, [this](BinaryWriter* bw)
+			List<VertexEncoding> encodings;
+			bool anyEncoded = false;
+			int32 packedSize = 0;
+
+			for (const VertexElement& ve : VertexElements)
 			{
-				bw->WriteBytes(VertexData, VertexSize*VertexCount);
-			});
+				VertexEncoding enc = VENC_Raw;
+
+				if (options.HalfTexCoords && ve.getUsage() == VEU_TextureCoordinate && ve.getType() == VEF_Vector2)
+				{
+					enc = VENC_Half2;
+				}
+				else if (options.OctahedralNormals && ve.getType() == VEF_Vector3 &&
+					(ve.getUsage() == VEU_Normal || ve.getUsage() == VEU_Tangent || ve.getUsage() == VEU_Binormal))
+				{
+					enc = VENC_Octahedral;
+				}
+
+				encodings.Add(enc);
+				anyEncoded |= enc != VENC_Raw;
+				packedSize += GetEncodedSize(ve, enc);
+			}
+
+			if (anyEncoded)
+			{
+				data->AddUInt32(TAG_3_VertexEncodingTag, reinterpret_cast<const uint32*>(&encodings[0]), encodings.getCount());
+
+				data->AddEntry(TAG_3_PackedVertexDataTag, [&](BinaryWriter* bw)
+				{
+					char* packed = new char[(int64)packedSize * VertexCount];
+					EncodeVertices(VertexData, VertexSize, VertexCount, VertexElements, encodings, packedSize, packed);
+					bw->WriteBytes(packed, (int64)packedSize * VertexCount);
+					delete[] packed;
+				});
+			}
+			else
+			{
+				data->AddEntry(TAG_3_VertexDataTag, [this](BinaryWriter* bw)
+				{
+					bw->WriteBytes(VertexData, VertexSize*VertexCount);
+				});
+			}
 		}
 
 		void MeshData::SaveLite(BinaryWriter& bw) const
@@ -240,8 +615,17 @@ namespace Apoc3D
 				else
 					bw.WriteString(PathUtils::GetFileNameNoExt(L""));
 			}
-			bw.WriteInt32(Faces.getCount());
-			for (const MeshFace& mf : Faces)
+			const List<MeshFace>* faces = &Faces;
+
+			List<MeshFace> expandedFaces;
+			if (Faces.getCount() == 0 && Parts.getCount() > 0)
+			{
+				ExpandParts(Parts, PartIndexData, PartIndices16, expandedFaces);
+				faces = &expandedFaces;
+			}
+
+			bw.WriteInt32(faces->getCount());
+			for (const MeshFace& mf : *faces)
 			{
 				bw.WriteInt32(mf.IndexA);
 				bw.WriteInt32(mf.IndexB);
@@ -253,6 +637,25 @@ namespace Apoc3D
 			bw.WriteBytes(VertexData, VertexSize*VertexCount);
 		}
 
+		void MeshData::BuildParts()
+		{
+			ClearParts();
+			SplitFaces(Faces, Materials.getMaterialCount(), VertexCount, Parts, PartIndexData, PartIndices16);
+		}
+
+		void MeshData::BuildFaces()
+		{
+			Faces.Clear();
+			ExpandParts(Parts, PartIndexData, PartIndices16, Faces);
+		}
+
+		void MeshData::ClearParts()
+		{
+			Parts.Clear();
+			delete[] PartIndexData;
+			PartIndexData = nullptr;
+		}
+
 		MeshData::MeshData()
 		{
 
@@ -262,6 +665,9 @@ namespace Apoc3D
 			delete[] VertexData;
 			VertexData = nullptr;
 
+			delete[] PartIndexData;
+			PartIndexData = nullptr;
+
 			for (MaterialData* md : Materials)
 			{
 				delete md;
@@ -305,7 +711,7 @@ namespace Apoc3D
 				});
 			}
 		}
-		void ModelData::WriteData(TaggedDataWriter* data) const
+		void ModelData::WriteData(TaggedDataWriter* data, const MeshStorageOptions& options) const
 		{
 			data->AddInt32(TAG_3_EntityCountTag, static_cast<int32>(Entities.getCount()));
 
@@ -314,9 +720,9 @@ namespace Apoc3D
 				MeshData* mesh = Entities[i];
 				TaggedDataKey tag = TAG_3_EntityPrefix + (uint32)i;
 
-				data->AddEntryDataSection(tag, [mesh](TaggedDataWriter* meshData)
+				data->AddEntryDataSection(tag, [mesh, &options](TaggedDataWriter* meshData)
 				{
-					mesh->SaveData(meshData);
+					mesh->SaveData(meshData, options);
 				});
 			}
 		}
@@ -355,14 +761,14 @@ namespace Apoc3D
 			}
 
 		}
-		void ModelData::Save(Stream& strm) const
+		void ModelData::Save(Stream& strm, const MeshStorageOptions& options) const
 		{
 			BinaryWriter bw(&strm, false);
 
 			bw.WriteUInt32(MdlId_V3);
-			bw.WriteTaggedDataBlock([this](TaggedDataWriter* mdlData)
+			bw.WriteTaggedDataBlock([this, &options](TaggedDataWriter* mdlData)
 			{
-				WriteData(mdlData);
+				WriteData(mdlData, options);
 			});
 		}
 		void ModelData::SaveLite(Stream& strm) const
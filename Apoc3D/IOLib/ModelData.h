@@ -42,6 +42,29 @@ namespace Apoc3D
 {
 	namespace IO
 	{
+		/** Choices for how SaveData lays out a mesh. The defaults write the original layout. */
+		struct MeshStorageOptions
+		{
+			/** Store the indices already split per sub mesh instead of as faces. */
+			bool SplitIndices = false;
+			/** Store 2-component float texture coordinates as half floats. */
+			bool HalfTexCoords = false;
+			/** Store 3-component float normals, tangents and binormals as 2 16-bit octahedral coordinates. */
+			bool OctahedralNormals = false;
+		};
+
+		/** The range of indices of one sub mesh in MeshData::PartIndexData. */
+		struct MeshPart
+		{
+			int32 IndexStart = 0;
+			int32 IndexCount = 0;
+
+			/** The number of distinct vertices used. */
+			int32 VertexCount = 0;
+			int32 VertexRangeStart = 0;
+			int32 VertexRangeCount = 0;
+		};
+
 		/**
 		 *  Defines one entire mesh's data stored in binary form and procedures to load/save them.
 		 */
@@ -74,12 +97,28 @@ namespace Apoc3D
 			/** A list of triangle faces. Only triangle list is supported as primitive at this stage. */
 			List<MeshFace> Faces;
 
+			/**
+			 *  The indices grouped by sub mesh, in the same order as Materials, as 16-bit or 32-bit 
+			 *  values ready for index buffers.
+			 *  These are only filled when loading a mesh saved with MeshStorageOptions::SplitIndices,
+			 *  in which case Faces is left empty. Use BuildFaces when faces are needed.
+			 */
+			List<MeshPart> Parts;
+			char* PartIndexData = nullptr;
+			bool PartIndices16 = false;
+
 			static uint32 ComputeVertexSize(const List<VertexElement>& elements);
 
 			void LoadData(TaggedDataReader* data);
-			void SaveData(TaggedDataWriter* data) const;
+			void SaveData(TaggedDataWriter* data, const MeshStorageOptions& options = MeshStorageOptions()) const;
 			void SaveLite(BinaryWriter& bw) const;
 
+			/** Fills Parts and PartIndexData from Faces. */
+			void BuildParts();
+			/** Fills Faces from Parts and PartIndexData. */
+			void BuildFaces();
+			void ClearParts();
+
 			MeshData();
 			~MeshData();
 
@@ -104,11 +143,11 @@ namespace Apoc3D
 			ModelData& operator=(const ModelData&) = delete;
 
 			void Load(const ResourceLocation& rl);
-			void Save(Stream& strm) const;
+			void Save(Stream& strm, const MeshStorageOptions& options = MeshStorageOptions()) const;
 			void SaveLite(Stream& strm) const;
 		private:
 			void ReadData(TaggedDataReader* data);
-			void WriteData(TaggedDataWriter*) const;
+			void WriteData(TaggedDataWriter*, const MeshStorageOptions& options) const;
 		};
 	}
 }
@@ -16,12 +16,20 @@
 
 #include "Streams.h"
 #include "apoc3d/Math/Math.h"
+#include "apoc3d/Utility/StringUtils.h"
+#include "apoc3d/Core/Logging.h"
 
-#ifdef USE_WIN32_FILE
+#if defined(USE_WIN32_FILE) || APOC3D_PLATFORM == APOC3D_PLATFORM_WINDOWS
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 using namespace std;
+using namespace Apoc3D::Core;
 
 namespace Apoc3D
 {
@@ -385,6 +393,112 @@ namespace Apoc3D
 			AP_EXCEPTION(ErrorID::EndOfStream, L"MemoryStream");
 		}
 
+		/************************************************************************/
+		/*  MappedFileStream                                                    */
+		/************************************************************************/
+
+		MappedFileStream::MappedFileStream(const String& filename)
+		{
+			// the view keeps the file and the mapping open, so the handles are closed right away
+#if APOC3D_PLATFORM == APOC3D_PLATFORM_WINDOWS
+			HANDLE file = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				AP_EXCEPTION(ErrorID::FileNotFound, filename);
+				return;
+			}
+
+			LARGE_INTEGER size = { 0 };
+			GetFileSizeEx(file, &size);
+			m_length = size.QuadPart;
+
+			// empty files can not be mapped
+			if (m_length > 0)
+			{
+				HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (mapping)
+				{
+					m_data = reinterpret_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+					CloseHandle(mapping);
+				}
+			}
+			CloseHandle(file);
+#else
+			std::string path = StringUtils::toPlatformNarrowString(filename);
+			int file = open(path.c_str(), O_RDONLY);
+			if (file == -1)
+			{
+				AP_EXCEPTION(ErrorID::FileNotFound, filename);
+				return;
+			}
+
+			struct stat st;
+			if (fstat(file, &st) == 0)
+				m_length = st.st_size;
+
+			if (m_length > 0)
+			{
+				void* view = mmap(nullptr, (size_t)m_length, PROT_READ, MAP_PRIVATE, file, 0);
+				if (view != MAP_FAILED)
+					m_data = reinterpret_cast<const char*>(view);
+			}
+			close(file);
+#endif
+			// not fatal, the caller sees no mapped data and reads the file some other way
+			if (m_length > 0 && !m_data)
+			{
+				LogManager::getSingleton().Write(LOG_System, L"Can not map file " + filename, LOGLVL_Warning);
+				m_length = 0;
+			}
+		}
+
+		MappedFileStream::~MappedFileStream()
+		{
+			if (m_data)
+			{
+#if APOC3D_PLATFORM == APOC3D_PLATFORM_WINDOWS
+				UnmapViewOfFile(m_data);
+#else
+				munmap(const_cast<char*>(m_data), (size_t)m_length);
+#endif
+				m_data = nullptr;
+			}
+		}
+
+		int64 MappedFileStream::Read(char* dest, int64 count)
+		{
+			if (m_position + count > m_length)
+			{
+				count = m_length - m_position;
+			}
+			if (count <= 0)
+				return 0;
+
+			memcpy(dest, m_data + m_position, static_cast<size_t>(count));
+
+			m_position += count;
+			return count;
+		}
+
+		void MappedFileStream::Write(const char* src, int64 count)
+		{
+			AP_EXCEPTION(ErrorID::NotSupported, L"Can't write");
+		}
+
+		void MappedFileStream::Seek(int64 offset, SeekMode mode)
+		{
+			switch (mode)
+			{
+				case SeekMode::Begin:   m_position = offset; break;
+				case SeekMode::Current: m_position += offset; break;
+				case SeekMode::End:     m_position = m_length + offset; break;
+			}
+			if (m_position < 0)
+				m_position = 0;
+			if (m_position > m_length)
+				m_position = m_length;
+		}
+
 		/************************************************************************/
 		/*  VirtualStream                                                       */
 		/************************************************************************/
@@ -438,6 +552,12 @@ namespace Apoc3D
 			return m_isOutput ? m_baseStream->getLength() : m_length;
 		}
 
+		const char* VirtualStream::getMappedData() const
+		{
+			const char* base = m_baseStream->getMappedData();
+			return base ? base + m_baseOffset : nullptr;
+		}
+
 
 		void VirtualStream::setPosition(int64 offset)
 		{
@@ -64,6 +64,13 @@ namespace Apoc3D
 
 			virtual void Flush() = 0;
 
+			/**
+			 *  Gets the whole content of the stream when it is held in memory, such as a mapped file.
+			 *  Bytes can then be used in place instead of being copied out by Read.
+			 *  @return nullptr if the content is not addressable.
+			 */
+			virtual const char* getMappedData() const { return nullptr; }
+
 			int ReadByte();
 			void WriteByte(byte value);
 
@@ -170,10 +177,20 @@ namespace Apoc3D
 			MemoryStream(char* data, int64 length)
 				: m_data(data), m_length(length) { }
 
+			/**
+			 *  Creates a read-only stream over data laid out as in a file, such as a part of a mapped file.
+			 *  @param endianIndependent True if the data is in the file byte order rather than the native one.
+			 */
+			MemoryStream(const char* data, int64 length, bool endianIndependent)
+				: m_data(const_cast<char*>(data))
+				, m_length(length)
+				, m_readonly(true)
+				, m_endianIndependent(endianIndependent) { }
+
 			virtual ~MemoryStream()
 			{ }
 
-			virtual bool IsReadEndianIndependent() const override { return false; }
+			virtual bool IsReadEndianIndependent() const override { return m_endianIndependent; }
 			virtual bool IsWriteEndianIndependent() const override { return false; }
 
 			virtual bool CanRead() const override { return true; }
@@ -190,6 +207,8 @@ namespace Apoc3D
 			
 			virtual void Flush() override { }
 
+			virtual const char* getMappedData() const override { return m_data; }
+
 		private:
 			NO_INLINE static void EndofStreamError();
 
@@ -197,6 +216,52 @@ namespace Apoc3D
 			char* m_data = nullptr;
 			int64 m_position = 0;
 			bool m_readonly = false;
+			bool m_endianIndependent = false;
+		};
+
+		/**
+		 *  Provides read-only access to a file mapped into memory.
+		 *  
+		 *  The file is mapped as a whole when the stream is created. Reading is a plain copy out of
+		 *  the mapping, and getMappedData gives the content without copying at all. Streams over
+		 *  parts of the file can be created as MemoryStream on the mapped data; they each have their
+		 *  own position, so unlike VirtualStream they can be read from different threads.
+		 *  When the file can not be mapped, a warning is logged and the stream is left empty with
+		 *  getMappedData returning null; callers then open the file with FileStream instead.
+		 */
+		class APAPI MappedFileStream : public Stream
+		{
+			RTTI_DERIVED(MappedFileStream, Stream);
+		public:
+			MappedFileStream(const String& filename);
+			virtual ~MappedFileStream();
+
+			MappedFileStream(const MappedFileStream&) = delete;
+			MappedFileStream& operator=(const MappedFileStream&) = delete;
+
+			virtual bool IsReadEndianIndependent() const override { return true; }
+			virtual bool IsWriteEndianIndependent() const override { return true; }
+
+			virtual bool CanRead() const override { return true; }
+			virtual bool CanWrite() const override { return false; }
+
+			virtual int64 getLength() const override { return m_length; }
+			virtual void setPosition(int64 offset) override { m_position = offset; }
+			virtual int64 getPosition() override { return m_position; }
+
+			virtual int64 Read(char* dest, int64 count) override;
+			virtual void Write(const char* src, int64 count) override;
+
+			virtual void Seek(int64 offset, SeekMode mode) override;
+
+			virtual void Flush() override { }
+
+			virtual const char* getMappedData() const override { return m_data; }
+
+		private:
+			const char* m_data = nullptr;
+			int64 m_length = 0;
+			int64 m_position = 0;
 		};
 
 		/** 
@@ -236,6 +301,8 @@ namespace Apoc3D
 
 			virtual void Flush() override { m_baseStream->Flush(); }
 
+			virtual const char* getMappedData() const override;
+
 			Stream* getBaseStream() const { return m_baseStream; }
 			bool isOutput() const { return m_isOutput; }
 
@@ -175,6 +175,7 @@ namespace Apoc3D
 			m_endBlockPosition = strm->getPosition() + strm->getLength();
 
 			m_endianIndependent = strm->IsReadEndianIndependent();
+			m_mappedData = strm->getMappedData();
 
 			BinaryReader br(strm, false);
 
@@ -294,13 +295,17 @@ namespace Apoc3D
 			assert(len <= sizeof(m_buffer));
 
 			const Entry* ent = FindEntry(name);
-			m_stream->setPosition(ent->Offset);
-			m_stream->Read(m_buffer, len);
+			FillBuffer(*ent, len);
 		}
 		void TaggedDataReader::FillBuffer(const Entry& ent, uint32 len)
 		{
 			assert(len <= sizeof(m_buffer));
 
+			if (m_mappedData)
+			{
+				memcpy(m_buffer, m_mappedData + ent.Offset, len);
+				return;
+			}
 			m_stream->setPosition(ent.Offset);
 			m_stream->Read(m_buffer, len);
 		}
@@ -314,24 +319,42 @@ namespace Apoc3D
 			const Entry* ent = FindEntry(name);
 			if (!ent) return false;
 
-			assert(len <= sizeof(m_buffer));
-			m_stream->setPosition(ent->Offset);
-			m_stream->Read(m_buffer, len);
+			FillBuffer(*ent, len);
+			return true;
+		}
+		bool TaggedDataReader::CopyMapped(const Entry* ent, void* dst, int64 size) const
+		{
+			// values are stored in little endian, which is what the arrays are expecting here
+#ifdef BIG_ENDIAN
+			return false;
+#else
+			if (!m_mappedData)
+				return false;
+
+			memcpy(dst, m_mappedData + ent->Offset, static_cast<size_t>(size));
 			return true;
+#endif
+		}
+		Stream* TaggedDataReader::CreateEntryStream(const Entry* ent) const
+		{
+			// streams on the mapped data keep their own position, leaving m_stream untouched
+			if (m_mappedData)
+				return new MemoryStream(m_mappedData + ent->Offset, ent->Size, m_endianIndependent);
+			return new VirtualStream(m_stream, ent->Offset, ent->Size);
 		}
 
 		BinaryReader* TaggedDataReader::TryGetData(const KeyType& name) const
 		{
 			const Entry* ent = FindEntry(name);
 			if (ent)
-				return new BinaryReader(new VirtualStream(m_stream, ent->Offset, ent->Size), true);
+				return new BinaryReader(CreateEntryStream(ent), true);
 			return nullptr;
 		}
 		BinaryReader* TaggedDataReader::GetData(const KeyType& name) const
 		{
 			const Entry* ent = FindEntry(name);
 			if (ent)
-				return new BinaryReader(new VirtualStream(m_stream, ent->Offset, ent->Size), true);
+				return new BinaryReader(CreateEntryStream(ent), true);
 			KeynotFoundError(name);
 			return nullptr;
 		}
@@ -343,9 +366,18 @@ namespace Apoc3D
 
 			if (ent)
 			{
-				VirtualStream vs(m_stream, ent->Offset, ent->Size);
-				BinaryReader br(&vs, false);
-				func(&br);
+				if (m_mappedData)
+				{
+					MemoryStream ms(m_mappedData + ent->Offset, ent->Size, m_endianIndependent);
+					BinaryReader br(&ms, false);
+					func(&br);
+				}
+				else
+				{
+					VirtualStream vs(m_stream, ent->Offset, ent->Size);
+					BinaryReader br(&vs, false);
+					func(&br);
+				}
 				return true;
 			}
 			return false;
@@ -354,8 +386,15 @@ namespace Apoc3D
 		void TaggedDataReader::ProcessData(const KeyType& name, FunctorReference<void(BinaryReader*)> func) const
 		{
 			const Entry* ent = FindEntry(name);
-			VirtualStream vs(m_stream, ent->Offset, ent->Size);
+			if (m_mappedData)
 			{
+				MemoryStream ms(m_mappedData + ent->Offset, ent->Size, m_endianIndependent);
+				BinaryReader br(&ms, false);
+				func(&br);
+			}
+			else
+			{
+				VirtualStream vs(m_stream, ent->Offset, ent->Size);
 				BinaryReader br(&vs, false);
 				func(&br);
 			}
@@ -381,11 +420,22 @@ namespace Apoc3D
 		{
 			const Entry* ent = FindEntry(name);
 			if (ent)
-				return new VirtualStream(m_stream, ent->Offset, ent->Size);
+				return CreateEntryStream(ent);
 			KeynotFoundError(name);
 			return nullptr;
 		}
 
+		const char* TaggedDataReader::TryGetDataPointer(const KeyType& name, int64* size) const
+		{
+			const Entry* ent = FindEntry(name);
+			if (!ent || !m_mappedData)
+				return nullptr;
+
+			if (size)
+				*size = ent->Size;
+			return m_mappedData + ent->Offset;
+		}
+
 
 		void TaggedDataReader::GetAuto(const KeyType& name, int64& value)	{ value = GetInt64(name); }
 		void TaggedDataReader::GetAuto(const KeyType& name, int32& value)	{ value = GetInt32(name); }
@@ -659,6 +709,9 @@ namespace Apoc3D
 		}
 		void TaggedDataReader::_GetEntryInt64(const Entry* ent, int64* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(int64) * len))
+				return;
+
 			const int32 Chunk = 4;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -696,6 +749,9 @@ namespace Apoc3D
 		}
 		void TaggedDataReader::_GetEntryInt32(const Entry* ent, int32* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(int32) * len))
+				return;
+
 			const int32 Chunk = 8;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -735,6 +791,9 @@ namespace Apoc3D
 		}
 		void TaggedDataReader::_GetEntryInt16(const Entry* ent, int16* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(int16) * len))
+				return;
+
 			const int32 Chunk = 16;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -773,6 +832,9 @@ namespace Apoc3D
 		
 		void TaggedDataReader::_GetEntryUInt64(const Entry* ent, uint64* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(uint64) * len))
+				return;
+
 			const int32 Chunk = 4;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -810,6 +872,9 @@ namespace Apoc3D
 		}
 		void TaggedDataReader::_GetEntryUInt32(const Entry* ent, uint32* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(uint32) * len))
+				return;
+
 			const int32 Chunk = 8;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -847,6 +912,9 @@ namespace Apoc3D
 		}
 		void TaggedDataReader::_GetEntryUInt16(const Entry* ent, uint16* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(uint16) * len))
+				return;
+
 			const int32 Chunk = 16;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -885,6 +953,9 @@ namespace Apoc3D
 
 		void TaggedDataReader::_GetEntrySingle(const Entry* ent, float* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(float) * len))
+				return;
+
 			const int32 Chunk = 8;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -924,6 +995,9 @@ namespace Apoc3D
 		}
 		void TaggedDataReader::_GetEntryDouble(const Entry* ent, double* val, int32 len)
 		{
+			if (CopyMapped(ent, val, sizeof(double) * len))
+				return;
+
 			const int32 Chunk = 4;
 			m_stream->setPosition(ent->Offset);
 #ifdef BIG_ENDIAN
@@ -130,6 +130,14 @@ namespace Apoc3D
 
 			Stream* GetDataStream(const KeyType& name) const;
 
+			/**
+			 *  Gets the bytes of a value in place when the stream is in memory (see Stream::getMappedData),
+			 *  so bulk data such as vertices or texture levels can be used without copying.
+			 *  The bytes are in the stream's byte order and stay valid as long as the underlying memory does.
+			 *  @return nullptr if the key is not found or the stream is not in memory.
+			 */
+			const char* TryGetDataPointer(const KeyType& name, int64* size = nullptr) const;
+
 			void GetAuto(const KeyType& name, int64& value);
 			void GetAuto(const KeyType& name, int32& value);
 			void GetAuto(const KeyType& name, int16& value);
@@ -375,6 +383,8 @@ namespace Apoc3D
 			void FillTagList(List<const char*>& nameTags) const;
 
 			bool isEndianIndependent() const { return !m_endianIndependent; }
+			/** True if values are read straight from memory, with TryGetDataPointer available. */
+			bool isMapped() const { return m_mappedData != nullptr; }
 			Stream* getBaseStream() const { return m_stream; }
 		private:
 			
@@ -395,6 +405,8 @@ namespace Apoc3D
 			inline void FillBuffer(const Entry& ent, uint32 len);
 			inline void FillBufferCurrent(uint32 len);
 			inline bool TryFillBuffer(const KeyType& name, uint32 len);
+			inline bool CopyMapped(const Entry* ent, void* dst, int64 size) const;
+			Stream* CreateEntryStream(const Entry* ent) const;
 
 
 			void _GetEntryInt64(const Entry* e, int64& val);
@@ -463,6 +475,7 @@ namespace Apoc3D
 			int32 m_sectCount;
 			SectionTable m_positions;
 			Stream* m_stream;
+			const char* m_mappedData = nullptr;
 
 			char m_buffer[32];
 			int64 m_endBlockPosition;
@@ -22,6 +22,7 @@
 #include "Streams.h"
 #include "apoc3d/Core/Logging.h"
 #include "apoc3d/Graphics/LockData.h"
+#include "apoc3d/Math/Math.h"
 #include "apoc3d/Utility/StringUtils.h"
 #include "apoc3d/Utility/Compression.h"
 #include "apoc3d/Vfs/ResourceLocation.h"
@@ -55,13 +56,16 @@ namespace Apoc3D
 
 		TextureLevelData::TextureLevelData(TextureLevelData&& rhs)
 			: Width(rhs.Width), Height(rhs.Height), Depth(rhs.Depth),
-			LevelSize(rhs.LevelSize), ContentData(rhs.ContentData) { }
+			LevelSize(rhs.LevelSize), ContentData(rhs.ContentData) 
+		{
+			rhs.ContentData = nullptr;
+		}
 
 		TextureLevelData& TextureLevelData::operator=(TextureLevelData&& rhs)
 		{
 			if (this != &rhs)
 			{
-				delete[] rhs.ContentData;
+				delete[] ContentData;
 
 				Width = rhs.Width;
 				Height = rhs.Height;
@@ -84,11 +88,21 @@ namespace Apoc3D
 
 			if (!doNotLoadContent)
 			{
-				Stream* strm = data->GetDataStream(Tag_Content);
-
 				ContentData = new char[LevelSize];
 
-				if ((flags & TextureData::TDF_RLECompressed) == TextureData::TDF_RLECompressed)
+				const bool rle = (flags & TextureData::TDF_RLECompressed) == TextureData::TDF_RLECompressed;
+				if (!rle)
+				{
+					if (const char* src = data->TryGetDataPointer(Tag_Content))
+					{
+						memcpy(ContentData, src, LevelSize);
+						return;
+					}
+				}
+
+				Stream* strm = data->GetDataStream(Tag_Content);
+
+				if (rle)
 				{
 					BufferedStreamReader bsr(strm);
 					int32 ret = rleDecompress(ContentData, LevelSize, &bsr);
@@ -148,11 +162,22 @@ namespace Apoc3D
 				else if ((flags & TextureData::TDF_LZ4Compressed) == TextureData::TDF_LZ4Compressed)
 				{
 					int32 comprsesedSize = br.ReadInt32();
-					char* compressedData = new char[comprsesedSize];
-					strm->Read(compressedData, comprsesedSize);
-					int32 ret = LZ4_decompress_safe(compressedData, ContentData, comprsesedSize, LevelSize);
-					assert(ret == LevelSize);
-					delete[] compressedData;
+
+					// decompress straight from memory if the file is mapped
+					if (const char* mapped = strm->getMappedData())
+					{
+						int32 ret = LZ4_decompress_safe(mapped + strm->getPosition(), ContentData, comprsesedSize, LevelSize);
+						assert(ret == LevelSize);
+						strm->Seek(comprsesedSize, SeekMode::Current);
+					}
+					else
+					{
+						char* compressedData = new char[comprsesedSize];
+						strm->Read(compressedData, comprsesedSize);
+						int32 ret = LZ4_decompress_safe(compressedData, ContentData, comprsesedSize, LevelSize);
+						assert(ret == LevelSize);
+						delete[] compressedData;
+					}
 				}
 				else
 				{
@@ -344,7 +369,7 @@ namespace Apoc3D
 		}
 
 		void ConvertFormat(const TextureLevelData& srcLvl, const TextureLevelData& dstLvl,
-			PixelFormat srcFormat, PixelFormat dstFormat,
+			PixelFormat srcFormat, PixelFormat dstFormat, const BlockCompressionOptions& compression,
 			int32 srcOffset = 0, int32 dstOffset = 0)
 		{
 			DataBox src = DataBox(
@@ -365,11 +390,12 @@ namespace Apoc3D
 				dstLvl.ContentData + dstOffset,
 				dstFormat);
 
-			bool r = PixelFormatUtils::ConvertPixels(src, dst);
+			bool r = PixelFormatUtils::IsCompressed(dstFormat) ?
+				PixelFormatUtils::Compress(src, dst, compression) : PixelFormatUtils::ConvertPixels(src, dst);
 			assert(r);
 		}
 
-		void TextureData::ConvertInPlace(PixelFormat newFmt)
+		void TextureData::ConvertInPlace(PixelFormat newFmt, const BlockCompressionOptions& compression)
 		{
 			TextureData newdata;
 			newdata.Format = newFmt;
@@ -408,19 +434,19 @@ namespace Apoc3D
 					int32 dstFaceSize = dstLvlSize / 6;
 					for (int32 j = 0; j < 6; j++)
 					{
-						ConvertFormat(srcLvl, dstLvl, Format, newdata.Format, i*srcFaceSize, i*dstFaceSize);
+						ConvertFormat(srcLvl, dstLvl, Format, newdata.Format, compression, j*srcFaceSize, j*dstFaceSize);
 					}
 				}
 				else
 				{
-					ConvertFormat(srcLvl, dstLvl, Format, newdata.Format);
+					ConvertFormat(srcLvl, dstLvl, Format, newdata.Format, compression);
 				}
 			}
 
 			*this = std::move(newdata);
 		}
 
-		void TextureData::ResizeInPlace(int32 newWidth, int32 newHeight)
+		void TextureData::ResizeInPlace(int32 newWidth, int32 newHeight, const ResizeOptions& options)
 		{
 			TextureData newData;
 			newData.Format = Format;
@@ -437,8 +463,8 @@ namespace Apoc3D
 				TextureLevelData& dstLvl = newData.Levels[i];
 
 				dstLvl.Depth = srcLvl.Depth;
-				dstLvl.Width = newWidth / (1 << i);
-				dstLvl.Height = newHeight / (1 << i);
+				dstLvl.Width = Math::Max(1, newWidth >> i);
+				dstLvl.Height = Math::Max(1, newHeight >> i);
 
 				int dstLvlSize = PixelFormatUtils::GetMemorySize(
 					dstLvl.Width, dstLvl.Height, dstLvl.Depth, newData.Format);
@@ -458,17 +484,65 @@ namespace Apoc3D
 					int32 dstFaceSize = dstLvlSize / 6;
 					for (int32 j = 0; j < 6; j++)
 					{
-						PixelFormatUtils::Resize(srcLvl.ContentData + i * srcFaceSize, srcLvl.Width, srcLvl.Height,
-							dstLvl.ContentData + i*dstFaceSize, dstLvl.Width, dstLvl.Height, newData.Format);
+						PixelFormatUtils::Resize(srcLvl.ContentData + j * srcFaceSize, srcLvl.Width, srcLvl.Height,
+							dstLvl.ContentData + j*dstFaceSize, dstLvl.Width, dstLvl.Height, newData.Format, options);
 					}
 				}
 				else
 				{
-					PixelFormatUtils::Resize(srcLvl.ContentData, srcLvl.Width, srcLvl.Height, dstLvl.ContentData, dstLvl.Width, dstLvl.Height, newData.Format);
+					PixelFormatUtils::Resize(srcLvl.ContentData, srcLvl.Width, srcLvl.Height, dstLvl.ContentData, dstLvl.Width, dstLvl.Height, newData.Format, options);
 				}
 			}
 
 			*this = std::move(newData);
 		}
+
+		bool TextureData::GenerateMipmaps(const ResizeOptions& options, int32 levelCount)
+		{
+			if (Levels.getCount() == 0 || Type == TextureType::Texture3D || !PixelFormatUtils::CanResize(Format))
+				return false;
+
+			const int32 faceCount = Type == TextureType::CubeTexture ? 6 : 1;
+
+			int32 fullCount = 1;
+			for (int32 size = Math::Max(Levels[0].Width, Levels[0].Height); size > 1; size >>= 1)
+				fullCount++;
+
+			if (levelCount <= 0 || levelCount > fullCount)
+				levelCount = fullCount;
+
+			if (Levels.getCount() > 1)
+				Levels.RemoveRange(1, Levels.getCount() - 1);
+
+			ContentSize = Levels[0].LevelSize;
+
+			for (int32 i = 1; i < levelCount; i++)
+			{
+				const TextureLevelData& srcLvl = Levels[i - 1];
+
+				TextureLevelData dstLvl;
+				dstLvl.Width = Math::Max(1, srcLvl.Width >> 1);
+				dstLvl.Height = Math::Max(1, srcLvl.Height >> 1);
+				dstLvl.Depth = 1;
+
+				int32 faceSize = PixelFormatUtils::GetMemorySize(dstLvl.Width, dstLvl.Height, 1, Format);
+				int32 srcFaceSize = srcLvl.LevelSize / faceCount;
+
+				dstLvl.LevelSize = faceSize * faceCount;
+				dstLvl.ContentData = new char[dstLvl.LevelSize];
+
+				for (int32 j = 0; j < faceCount; j++)
+				{
+					PixelFormatUtils::Resize(srcLvl.ContentData + j * srcFaceSize, srcLvl.Width, srcLvl.Height,
+						dstLvl.ContentData + j * faceSize, dstLvl.Width, dstLvl.Height, Format, options);
+				}
+
+				ContentSize += dstLvl.LevelSize;
+				Levels.Add(std::move(dstLvl));
+			}
+
+			LevelCount = levelCount;
+			return true;
+		}
 	}
 }
@@ -99,8 +99,21 @@ namespace Apoc3D
 			void Save(Stream& strm) const;
 			void SaveAsTagged(Stream& strm) const;
 
-			void ConvertInPlace(PixelFormat fmt);
-			void ResizeInPlace(int32 newWidth, int32 newHeight);
+			/**
+			 *  Converts all levels to another format. DXT1, DXT3 and DXT5 can be encoded to and
+			 *  decoded from on the CPU; see PixelFormatUtils::Compress.
+			 */
+			void ConvertInPlace(PixelFormat fmt, const BlockCompressionOptions& compression = BlockCompressionOptions());
+			void ResizeInPlace(int32 newWidth, int32 newHeight, const ResizeOptions& options = ResizeOptions());
+
+			/**
+			 *  Replaces the levels after the first one with a mip chain filtered down from it.
+			 *  Each level is resampled from the one above it.
+			 *  @param levelCount The total number of levels wanted. 0 for a full chain down to 1x1.
+			 *  @return false if the format can not be resized (see PixelFormatUtils::CanResize) or the 
+			 *		texture is a volume texture. The data is left unchanged in that case.
+			 */
+			bool GenerateMipmaps(const ResizeOptions& options = ResizeOptions(), int32 levelCount = 0);
 
 		};
 	}
@@ -35,6 +35,7 @@
 #include <cmath>
 #include <algorithm>
 #include <cfloat>
+#include <climits>
 
 // config.h
 // Set to 1 when building squish to use Altivec instructions.
@@ -3220,7 +3221,7 @@ namespace squish
 		// set defaults
 		if (method != kDxt3 && method != kDxt5)
 			method = kDxt1;
-		if (fit != kColourRangeFit)
+		if (fit != kColourRangeFit && fit != kColourIterativeClusterFit)
 			fit = kColourClusterFit;
 		if (metric != kColourMetricUniform)
 			metric = kColourMetricPerceptual;
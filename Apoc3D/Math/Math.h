@@ -34,7 +34,7 @@ namespace Apoc3D
 		// once a floating point value is formed, bits maybe altered implicitly due to floating point behavior
 		inline float R16ToR32(uint16 value)
 		{
-			uint32 iv = R32ToR16I(value);
+			uint32 iv = R16ToR32I(value);
 			return reinterpret_cast<const float&>(iv);
 		}
 
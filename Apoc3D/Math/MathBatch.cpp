@@ -0,0 +1,514 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "MathBatch.h"
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "Frustum.h"
+
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace Apoc3D
+{
+	namespace Math
+	{
+		static_assert(sizeof(Vector3) == sizeof(float) * 3, "Vector3 is expected to be tightly packed");
+		static_assert(sizeof(Vector4) == sizeof(float) * 4, "Vector4 is expected to be tightly packed");
+		static_assert(sizeof(Matrix) == sizeof(float) * 16, "Matrix is expected to be tightly packed");
+
+#if APOC3D_MATH_AVX2
+		// Implemented in MathBatchAVX2.cpp, which is compiled with AVX2 code generation.
+		// The vector ones only process whole groups and return the number of elements done.
+		namespace AVX2Kernels
+		{
+			int32 TransformCoordinates(Vector3* result, const Vector3* src, int32 count, const Matrix& transform);
+			int32 TransformNormals(Vector3* result, const Vector3* src, int32 count, const Matrix& transform);
+			int32 TransformVectors(Vector4* result, const Vector4* src, int32 count, const Matrix& transform);
+			void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix* mb, int32 count);
+			void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix& mb, int32 count);
+			void MultiplyMatrices(Matrix* result, const Matrix& ma, const Matrix* mb, int32 count);
+			int32 IntersectSpheres(const float* planes, const float* centerX, const float* centerY, const float* centerZ,
+				const float* radius, int32 count, byte* result);
+		}
+#endif
+
+		/************************************************************************/
+		/*  CPU detection                                                       */
+		/************************************************************************/
+
+		static void ReadCPUID(int32 info[4], int32 leaf)
+		{
+#if defined(_MSC_VER)
+			__cpuidex(info, leaf, 0);
+#else
+			uint32 a, b, c, d;
+			__cpuid_count(leaf, 0, a, b, c, d);
+			info[0] = (int32)a; info[1] = (int32)b; info[2] = (int32)c; info[3] = (int32)d;
+#endif
+		}
+
+		static uint64 ReadXCR0()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32 eax, edx;
+			__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return ((uint64)edx << 32) | eax;
+#endif
+		}
+
+		static MathSIMDLevel DetectSIMDLevel()
+		{
+			int32 info[4];
+			ReadCPUID(info, 0);
+			int32 maxLeaf = info[0];
+
+			ReadCPUID(info, 1);
+			bool sse2 = (info[3] & (1 << 26)) != 0;
+			bool fma = (info[2] & (1 << 12)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+
+			bool avx2 = false;
+			if (maxLeaf >= 7)
+			{
+				ReadCPUID(info, 7);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+
+			// the OS also has to preserve the YMM registers
+			if (avx && avx2 && fma && osxsave && (ReadXCR0() & 6) == 6)
+				return MathSIMDLevel::AVX2;
+			if (sse2)
+				return MathSIMDLevel::SSE2;
+			return MathSIMDLevel::Scalar;
+		}
+
+		static MathSIMDLevel s_simdLevelLimit = MathSIMDLevel::AVX2;
+
+		MathSIMDLevel GetMathSIMDLevel()
+		{
+			static const MathSIMDLevel detected = DetectSIMDLevel();
+
+			MathSIMDLevel level = detected < s_simdLevelLimit ? detected : s_simdLevelLimit;
+#if !APOC3D_MATH_AVX2
+			if (level == MathSIMDLevel::AVX2)
+				level = MathSIMDLevel::SSE2;
+#endif
+			return level;
+		}
+
+		void SetMathSIMDLevelLimit(MathSIMDLevel level) { s_simdLevelLimit = level; }
+
+
+		/************************************************************************/
+		/*  SSE2 kernels                                                        */
+		/************************************************************************/
+
+		// Matrix rows are passed by reference, 32-bit MSVC can only pass 3 vector parameters by value.
+
+		// Converts 4 packed Vector3s in a, b, c into separate x, y, z registers
+		static inline void Deinterleave3(__m128 a, __m128 b, __m128 c, __m128& x, __m128& y, __m128& z)
+		{
+			__m128 x2y2x3y3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+			__m128 y0z0y1z1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+
+			x = _mm_shuffle_ps(a, x2y2x3y3, _MM_SHUFFLE(2, 0, 3, 0));
+			y = _mm_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+			z = _mm_shuffle_ps(y0z0y1z1, c, _MM_SHUFFLE(3, 0, 3, 1));
+		}
+
+		// The reverse of Deinterleave3
+		static inline void Interleave3(__m128 x, __m128 y, __m128 z, __m128& a, __m128& b, __m128& c)
+		{
+			__m128 x0x2y0y2 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 y1y3z1z3 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+			__m128 z0z2x1x3 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+
+			a = _mm_shuffle_ps(x0x2y0y2, z0z2x1x3, _MM_SHUFFLE(2, 0, 2, 0));
+			b = _mm_shuffle_ps(y1y3z1z3, x0x2y0y2, _MM_SHUFFLE(3, 1, 2, 0));
+			c = _mm_shuffle_ps(z0z2x1x3, y1y3z1z3, _MM_SHUFFLE(3, 1, 3, 1));
+		}
+
+		static inline __m128 Dot3(__m128 x, __m128 y, __m128 z, const __m128& m1, const __m128& m2, const __m128& m3)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m1), _mm_mul_ps(y, m2)), _mm_mul_ps(z, m3));
+		}
+
+		static int32 TransformCoordinatesSSE(Vector3* result, const Vector3* src, int32 count, const Matrix& m)
+		{
+			const __m128 m11 = _mm_set1_ps(m.M11), m12 = _mm_set1_ps(m.M12), m13 = _mm_set1_ps(m.M13), m14 = _mm_set1_ps(m.M14);
+			const __m128 m21 = _mm_set1_ps(m.M21), m22 = _mm_set1_ps(m.M22), m23 = _mm_set1_ps(m.M23), m24 = _mm_set1_ps(m.M24);
+			const __m128 m31 = _mm_set1_ps(m.M31), m32 = _mm_set1_ps(m.M32), m33 = _mm_set1_ps(m.M33), m34 = _mm_set1_ps(m.M34);
+			const __m128 m41 = _mm_set1_ps(m.M41), m42 = _mm_set1_ps(m.M42), m43 = _mm_set1_ps(m.M43), m44 = _mm_set1_ps(m.M44);
+			const __m128 one = _mm_set1_ps(1.0f);
+
+			const float* s = &src->X;
+			float* d = &result->X;
+
+			int32 i = 0;
+			for (; i + 4 <= count; i += 4, s += 12, d += 12)
+			{
+				__m128 x, y, z;
+				Deinterleave3(_mm_loadu_ps(s), _mm_loadu_ps(s + 4), _mm_loadu_ps(s + 8), x, y, z);
+
+				__m128 rx = _mm_add_ps(Dot3(x, y, z, m11, m21, m31), m41);
+				__m128 ry = _mm_add_ps(Dot3(x, y, z, m12, m22, m32), m42);
+				__m128 rz = _mm_add_ps(Dot3(x, y, z, m13, m23, m33), m43);
+				__m128 rw = _mm_div_ps(one, _mm_add_ps(Dot3(x, y, z, m14, m24, m34), m44));
+
+				__m128 a, b, c;
+				Interleave3(_mm_mul_ps(rx, rw), _mm_mul_ps(ry, rw), _mm_mul_ps(rz, rw), a, b, c);
+
+				_mm_storeu_ps(d, a);
+				_mm_storeu_ps(d + 4, b);
+				_mm_storeu_ps(d + 8, c);
+			}
+			return i;
+		}
+
+		static int32 TransformNormalsSSE(Vector3* result, const Vector3* src, int32 count, const Matrix& m)
+		{
+			const __m128 m11 = _mm_set1_ps(m.M11), m12 = _mm_set1_ps(m.M12), m13 = _mm_set1_ps(m.M13);
+			const __m128 m21 = _mm_set1_ps(m.M21), m22 = _mm_set1_ps(m.M22), m23 = _mm_set1_ps(m.M23);
+			const __m128 m31 = _mm_set1_ps(m.M31), m32 = _mm_set1_ps(m.M32), m33 = _mm_set1_ps(m.M33);
+
+			const float* s = &src->X;
+			float* d = &result->X;
+
+			int32 i = 0;
+			for (; i + 4 <= count; i += 4, s += 12, d += 12)
+			{
+				__m128 x, y, z;
+				Deinterleave3(_mm_loadu_ps(s), _mm_loadu_ps(s + 4), _mm_loadu_ps(s + 8), x, y, z);
+
+				__m128 a, b, c;
+				Interleave3(Dot3(x, y, z, m11, m21, m31), Dot3(x, y, z, m12, m22, m32), Dot3(x, y, z, m13, m23, m33), a, b, c);
+
+				_mm_storeu_ps(d, a);
+				_mm_storeu_ps(d + 4, b);
+				_mm_storeu_ps(d + 8, c);
+			}
+			return i;
+		}
+
+		// r = v.x * row1 + v.y * row2 + v.z * row3 + v.w * row4
+		static inline __m128 TransformRow(__m128 v, const __m128& r1, const __m128& r2, const __m128& r3, const __m128& r4)
+		{
+			__m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), r1);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), r2));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), r3));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), r4));
+			return r;
+		}
+
+		static void TransformVectorsSSE(Vector4* result, const Vector4* src, int32 count, const Matrix& m)
+		{
+			const __m128 r1 = _mm_loadu_ps(&m.M11);
+			const __m128 r2 = _mm_loadu_ps(&m.M21);
+			const __m128 r3 = _mm_loadu_ps(&m.M31);
+			const __m128 r4 = _mm_loadu_ps(&m.M41);
+
+			for (int32 i = 0; i < count; i++)
+			{
+				_mm_storeu_ps(&result[i].X, TransformRow(_mm_loadu_ps(&src[i].X), r1, r2, r3, r4));
+			}
+		}
+
+		static inline void MultiplySSE(float* res, const float* a, const __m128& b1, const __m128& b2, const __m128& b3, const __m128& b4)
+		{
+			// each row is loaded right before its result is stored, so res can be a
+			__m128 a1 = _mm_loadu_ps(a);
+			_mm_storeu_ps(res, TransformRow(a1, b1, b2, b3, b4));
+			__m128 a2 = _mm_loadu_ps(a + 4);
+			_mm_storeu_ps(res + 4, TransformRow(a2, b1, b2, b3, b4));
+			__m128 a3 = _mm_loadu_ps(a + 8);
+			_mm_storeu_ps(res + 8, TransformRow(a3, b1, b2, b3, b4));
+			__m128 a4 = _mm_loadu_ps(a + 12);
+			_mm_storeu_ps(res + 12, TransformRow(a4, b1, b2, b3, b4));
+		}
+
+		static void MultiplyMatricesSSE(Matrix* result, const Matrix* ma, const Matrix* mb, int32 count)
+		{
+			for (int32 i = 0; i < count; i++)
+			{
+				const float* b = &mb[i].M11;
+				__m128 b1 = _mm_loadu_ps(b);
+				__m128 b2 = _mm_loadu_ps(b + 4);
+				__m128 b3 = _mm_loadu_ps(b + 8);
+				__m128 b4 = _mm_loadu_ps(b + 12);
+				MultiplySSE(&result[i].M11, &ma[i].M11, b1, b2, b3, b4);
+			}
+		}
+
+		static void MultiplyMatricesSSE(Matrix* result, const Matrix* ma, const Matrix& mb, int32 count)
+		{
+			const __m128 b1 = _mm_loadu_ps(&mb.M11);
+			const __m128 b2 = _mm_loadu_ps(&mb.M21);
+			const __m128 b3 = _mm_loadu_ps(&mb.M31);
+			const __m128 b4 = _mm_loadu_ps(&mb.M41);
+
+			for (int32 i = 0; i < count; i++)
+			{
+				MultiplySSE(&result[i].M11, &ma[i].M11, b1, b2, b3, b4);
+			}
+		}
+
+		static void MultiplyMatricesSSE(Matrix* result, const Matrix& ma, const Matrix* mb, int32 count)
+		{
+			const __m128 a1 = _mm_loadu_ps(&ma.M11);
+			const __m128 a2 = _mm_loadu_ps(&ma.M21);
+			const __m128 a3 = _mm_loadu_ps(&ma.M31);
+			const __m128 a4 = _mm_loadu_ps(&ma.M41);
+
+			for (int32 i = 0; i < count; i++)
+			{
+				// all rows of mb[i] are loaded before storing, so result can be mb
+				const float* b = &mb[i].M11;
+				__m128 b1 = _mm_loadu_ps(b);
+				__m128 b2 = _mm_loadu_ps(b + 4);
+				__m128 b3 = _mm_loadu_ps(b + 8);
+				__m128 b4 = _mm_loadu_ps(b + 12);
+
+				float* res = &result[i].M11;
+				_mm_storeu_ps(res, TransformRow(a1, b1, b2, b3, b4));
+				_mm_storeu_ps(res + 4, TransformRow(a2, b1, b2, b3, b4));
+				_mm_storeu_ps(res + 8, TransformRow(a3, b1, b2, b3, b4));
+				_mm_storeu_ps(res + 12, TransformRow(a4, b1, b2, b3, b4));
+			}
+		}
+
+
+		static const int32 FrustumPlaneCount = 6;
+
+		// planes holds X, Y, Z, D of each frustum plane
+		static int32 IntersectSpheresSSE(const float* planes, const float* centerX, const float* centerY, const float* centerZ,
+			const float* radius, int32 count, byte* result)
+		{
+			int32 i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(centerX + i);
+				__m128 y = _mm_loadu_ps(centerY + i);
+				__m128 z = _mm_loadu_ps(centerZ + i);
+				__m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (int32 j = 0; j < FrustumPlaneCount; j++)
+				{
+					const float* p = planes + j * 4;
+					__m128 d = _mm_add_ps(Dot3(x, y, z, _mm_set1_ps(p[0]), _mm_set1_ps(p[1]), _mm_set1_ps(p[2])), _mm_set1_ps(p[3]));
+					inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, negR));
+				}
+
+				int32 mask = _mm_movemask_ps(inside);
+				result[i] = mask & 1;
+				result[i + 1] = (mask >> 1) & 1;
+				result[i + 2] = (mask >> 2) & 1;
+				result[i + 3] = (mask >> 3) & 1;
+			}
+			return i;
+		}
+
+
+		/************************************************************************/
+		/*  Dispatch                                                            */
+		/************************************************************************/
+
+		void TransformCoordinates(Vector3* result, const Vector3* src, int32 count, const Matrix& transform)
+		{
+			int32 done = 0;
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+					done = AVX2Kernels::TransformCoordinates(result, src, count, transform);
+					done += TransformCoordinatesSSE(result + done, src + done, count - done, transform);
+					break;
+#endif
+				case MathSIMDLevel::SSE2:
+					done = TransformCoordinatesSSE(result, src, count, transform);
+					break;
+				default:
+					break;
+			}
+
+			for (int32 i = done; i < count; i++)
+			{
+				result[i] = Vector3::TransformCoordinate(src[i], transform);
+			}
+		}
+
+		void TransformNormals(Vector3* result, const Vector3* src, int32 count, const Matrix& transform)
+		{
+			int32 done = 0;
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+					done = AVX2Kernels::TransformNormals(result, src, count, transform);
+					done += TransformNormalsSSE(result + done, src + done, count - done, transform);
+					break;
+#endif
+				case MathSIMDLevel::SSE2:
+					done = TransformNormalsSSE(result, src, count, transform);
+					break;
+				default:
+					break;
+			}
+
+			for (int32 i = done; i < count; i++)
+			{
+				result[i] = Vector3::TransformNormal(src[i], transform);
+			}
+		}
+
+		void TransformVectors(Vector4* result, const Vector4* src, int32 count, const Matrix& transform)
+		{
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+				{
+					int32 done = AVX2Kernels::TransformVectors(result, src, count, transform);
+					TransformVectorsSSE(result + done, src + done, count - done, transform);
+					break;
+				}
+#endif
+				case MathSIMDLevel::SSE2:
+					TransformVectorsSSE(result, src, count, transform);
+					break;
+				default:
+					for (int32 i = 0; i < count; i++)
+						result[i] = Vector4::Transform(src[i], transform);
+					break;
+			}
+		}
+
+		void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix* mb, int32 count)
+		{
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+					AVX2Kernels::MultiplyMatrices(result, ma, mb, count);
+					break;
+#endif
+				case MathSIMDLevel::SSE2:
+					MultiplyMatricesSSE(result, ma, mb, count);
+					break;
+				default:
+					for (int32 i = 0; i < count; i++)
+					{
+						Matrix temp;
+						Matrix::Multiply(temp, ma[i], mb[i]);
+						result[i] = temp;
+					}
+					break;
+			}
+		}
+
+		void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix& mb, int32 count)
+		{
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+					AVX2Kernels::MultiplyMatrices(result, ma, mb, count);
+					break;
+#endif
+				case MathSIMDLevel::SSE2:
+					MultiplyMatricesSSE(result, ma, mb, count);
+					break;
+				default:
+					for (int32 i = 0; i < count; i++)
+					{
+						Matrix temp;
+						Matrix::Multiply(temp, ma[i], mb);
+						result[i] = temp;
+					}
+					break;
+			}
+		}
+
+		void MultiplyMatrices(Matrix* result, const Matrix& ma, const Matrix* mb, int32 count)
+		{
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+					AVX2Kernels::MultiplyMatrices(result, ma, mb, count);
+					break;
+#endif
+				case MathSIMDLevel::SSE2:
+					MultiplyMatricesSSE(result, ma, mb, count);
+					break;
+				default:
+					for (int32 i = 0; i < count; i++)
+					{
+						Matrix temp;
+						Matrix::Multiply(temp, ma, mb[i]);
+						result[i] = temp;
+					}
+					break;
+			}
+		}
+
+		void IntersectSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+			const float* radius, int32 count, byte* result)
+		{
+			float planes[FrustumPlaneCount * 4];
+			for (int32 j = 0; j < FrustumPlaneCount; j++)
+			{
+				const Plane& p = frustum.getPlane(static_cast<FrustumPlane>(j));
+				planes[j * 4] = p.X;
+				planes[j * 4 + 1] = p.Y;
+				planes[j * 4 + 2] = p.Z;
+				planes[j * 4 + 3] = p.D;
+			}
+
+			int32 done = 0;
+			switch (GetMathSIMDLevel())
+			{
+#if APOC3D_MATH_AVX2
+				case MathSIMDLevel::AVX2:
+					done = AVX2Kernels::IntersectSpheres(planes, centerX, centerY, centerZ, radius, count, result);
+					done += IntersectSpheresSSE(planes, centerX + done, centerY + done, centerZ + done, radius + done, count - done, result + done);
+					break;
+#endif
+				case MathSIMDLevel::SSE2:
+					done = IntersectSpheresSSE(planes, centerX, centerY, centerZ, radius, count, result);
+					break;
+				default:
+					break;
+			}
+
+			for (int32 i = done; i < count; i++)
+			{
+				result[i] = frustum.Intersects(BoundingSphere(Vector3(centerX[i], centerY[i], centerZ[i]), radius[i])) ? 1 : 0;
+			}
+		}
+	}
+}
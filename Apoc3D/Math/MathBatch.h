@@ -0,0 +1,94 @@
+#pragma once
+#ifndef APOC3D_MATHBATCH_H
+#define APOC3D_MATHBATCH_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "MathCommon.h"
+
+namespace Apoc3D
+{
+	namespace Math
+	{
+		/**
+		 *  The instruction sets the batched math functions can run on.
+		 *  The best one supported by both the build and the CPU is picked on first use.
+		 */
+		enum struct MathSIMDLevel
+		{
+			Scalar,
+			SSE2,
+			/** AVX2 with FMA3. Only available when built with APOC3D_MATH_AVX2. */
+			AVX2
+		};
+
+		/** Gets the instruction set the batched functions are currently using. */
+		APAPI MathSIMDLevel GetMathSIMDLevel();
+
+		/**
+		 *  Restricts the batched functions to the given instruction set or lower.
+		 *  Mainly for testing and comparing the kernels.
+		 */
+		APAPI void SetMathSIMDLevelLimit(MathSIMDLevel level);
+
+
+		/**
+		 *  Batched version of Vector3::TransformCoordinate.
+		 *  result and src can be the same array, but should not partially overlap.
+		 */
+		APAPI void TransformCoordinates(Vector3* result, const Vector3* src, int32 count, const Matrix& transform);
+
+		/**
+		 *  Batched version of Vector3::TransformNormal.
+		 *  result and src can be the same array, but should not partially overlap.
+		 */
+		APAPI void TransformNormals(Vector3* result, const Vector3* src, int32 count, const Matrix& transform);
+
+		/**
+		 *  Batched version of Vector4::Transform.
+		 *  result and src can be the same array, but should not partially overlap.
+		 */
+		APAPI void TransformVectors(Vector4* result, const Vector4* src, int32 count, const Matrix& transform);
+
+		/**
+		 *  Computes result[i] = ma[i] * mb[i].
+		 *  Unlike Matrix::Multiply, result can be the same array as ma or mb.
+		 */
+		APAPI void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix* mb, int32 count);
+
+		/**
+		 *  Computes result[i] = ma[i] * mb.
+		 *  result can be the same array as ma; mb should not be one of the results.
+		 */
+		APAPI void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix& mb, int32 count);
+
+		/**
+		 *  Computes result[i] = ma * mb[i].
+		 *  result can be the same array as mb; ma should not be one of the results.
+		 */
+		APAPI void MultiplyMatrices(Matrix* result, const Matrix& ma, const Matrix* mb, int32 count);
+
+		/**
+		 *  Batched version of Frustum::Intersects, on spheres stored in separate arrays for each component.
+		 *  result[i] is set to 1 if the i-th sphere intersects the frustum, otherwise 0.
+		 */
+		APAPI void IntersectSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+			const float* radius, int32 count, byte* result);
+	}
+}
+
+#endif
@@ -0,0 +1,240 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+// This file is compiled with AVX2 code generation(/arch:AVX2), and is only entered after
+// MathBatch.cpp has checked the CPU. Do not call inline functions from other headers here:
+// the linker may pick this file's AVX copy of them for the whole module.
+
+#include "MathBatch.h"
+
+#include "Matrix.h"
+#include "Vector.h"
+
+#if APOC3D_MATH_AVX2
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+
+namespace Apoc3D
+{
+	namespace Math
+	{
+		namespace AVX2Kernels
+		{
+			// Loads 2 unaligned 128-bit values into the low and high lane
+			static inline __m256 Load2(const float* lo, const float* hi)
+			{
+				return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+			}
+			static inline void Store2(float* lo, float* hi, __m256 v)
+			{
+				_mm_storeu_ps(lo, _mm256_castps256_ps128(v));
+				_mm_storeu_ps(hi, _mm256_extractf128_ps(v, 1));
+			}
+
+			// Same as the SSE version, on 4 Vector3s per lane
+			static inline void Deinterleave3(__m256 a, __m256 b, __m256 c, __m256& x, __m256& y, __m256& z)
+			{
+				__m256 x2y2x3y3 = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+				__m256 y0z0y1z1 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+
+				x = _mm256_shuffle_ps(a, x2y2x3y3, _MM_SHUFFLE(2, 0, 3, 0));
+				y = _mm256_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+				z = _mm256_shuffle_ps(y0z0y1z1, c, _MM_SHUFFLE(3, 0, 3, 1));
+			}
+			static inline void Interleave3(__m256 x, __m256 y, __m256 z, __m256& a, __m256& b, __m256& c)
+			{
+				__m256 x0x2y0y2 = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+				__m256 y1y3z1z3 = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+				__m256 z0z2x1x3 = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+
+				a = _mm256_shuffle_ps(x0x2y0y2, z0z2x1x3, _MM_SHUFFLE(2, 0, 2, 0));
+				b = _mm256_shuffle_ps(y1y3z1z3, x0x2y0y2, _MM_SHUFFLE(3, 1, 2, 0));
+				c = _mm256_shuffle_ps(z0z2x1x3, y1y3z1z3, _MM_SHUFFLE(3, 1, 3, 1));
+			}
+
+			static inline __m256 Dot3(__m256 x, __m256 y, __m256 z, float m1, float m2, float m3, const __m256& add)
+			{
+				__m256 r = _mm256_fmadd_ps(x, _mm256_set1_ps(m1), add);
+				r = _mm256_fmadd_ps(y, _mm256_set1_ps(m2), r);
+				return _mm256_fmadd_ps(z, _mm256_set1_ps(m3), r);
+			}
+
+			// Vectors 0-3 go to the low lanes and 4-7 to the high lanes
+			int32 TransformCoordinates(Vector3* result, const Vector3* src, int32 count, const Matrix& m)
+			{
+				const __m256 m41 = _mm256_set1_ps(m.M41), m42 = _mm256_set1_ps(m.M42), m43 = _mm256_set1_ps(m.M43), m44 = _mm256_set1_ps(m.M44);
+				const __m256 one = _mm256_set1_ps(1.0f);
+
+				const float* s = &src->X;
+				float* d = &result->X;
+
+				int32 i = 0;
+				for (; i + 8 <= count; i += 8, s += 24, d += 24)
+				{
+					__m256 x, y, z;
+					Deinterleave3(Load2(s, s + 12), Load2(s + 4, s + 16), Load2(s + 8, s + 20), x, y, z);
+
+					__m256 rx = Dot3(x, y, z, m.M11, m.M21, m.M31, m41);
+					__m256 ry = Dot3(x, y, z, m.M12, m.M22, m.M32, m42);
+					__m256 rz = Dot3(x, y, z, m.M13, m.M23, m.M33, m43);
+					__m256 rw = _mm256_div_ps(one, Dot3(x, y, z, m.M14, m.M24, m.M34, m44));
+
+					__m256 a, b, c;
+					Interleave3(_mm256_mul_ps(rx, rw), _mm256_mul_ps(ry, rw), _mm256_mul_ps(rz, rw), a, b, c);
+
+					Store2(d, d + 12, a);
+					Store2(d + 4, d + 16, b);
+					Store2(d + 8, d + 20, c);
+				}
+				return i;
+			}
+
+			int32 TransformNormals(Vector3* result, const Vector3* src, int32 count, const Matrix& m)
+			{
+				const __m256 zero = _mm256_setzero_ps();
+
+				const float* s = &src->X;
+				float* d = &result->X;
+
+				int32 i = 0;
+				for (; i + 8 <= count; i += 8, s += 24, d += 24)
+				{
+					__m256 x, y, z;
+					Deinterleave3(Load2(s, s + 12), Load2(s + 4, s + 16), Load2(s + 8, s + 20), x, y, z);
+
+					__m256 a, b, c;
+					Interleave3(
+						Dot3(x, y, z, m.M11, m.M21, m.M31, zero),
+						Dot3(x, y, z, m.M12, m.M22, m.M32, zero),
+						Dot3(x, y, z, m.M13, m.M23, m.M33, zero), a, b, c);
+
+					Store2(d, d + 12, a);
+					Store2(d + 4, d + 16, b);
+					Store2(d + 8, d + 20, c);
+				}
+				return i;
+			}
+
+			// r = v.x * row1 + v.y * row2 + v.z * row3 + v.w * row4, for the 2 vectors in the lanes
+			static inline __m256 TransformRow2(__m256 v, const __m256& r1, const __m256& r2, const __m256& r3, const __m256& r4)
+			{
+				__m256 r = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), r1);
+				r = _mm256_fmadd_ps(_mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), r2, r);
+				r = _mm256_fmadd_ps(_mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), r3, r);
+				return _mm256_fmadd_ps(_mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3)), r4, r);
+			}
+
+			int32 TransformVectors(Vector4* result, const Vector4* src, int32 count, const Matrix& m)
+			{
+				const __m256 r1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m.M11));
+				const __m256 r2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m.M21));
+				const __m256 r3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m.M31));
+				const __m256 r4 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m.M41));
+
+				int32 i = 0;
+				for (; i + 2 <= count; i += 2)
+				{
+					_mm256_storeu_ps(&result[i].X, TransformRow2(_mm256_loadu_ps(&src[i].X), r1, r2, r3, r4));
+				}
+				return i;
+			}
+
+			// Two rows of ma are processed at once. All rows are loaded before storing, so res can be ma or mb.
+			static inline void Multiply(float* res, const float* a, const __m256& b1, const __m256& b2, const __m256& b3, const __m256& b4)
+			{
+				__m256 a12 = _mm256_loadu_ps(a);
+				__m256 a34 = _mm256_loadu_ps(a + 8);
+
+				_mm256_storeu_ps(res, TransformRow2(a12, b1, b2, b3, b4));
+				_mm256_storeu_ps(res + 8, TransformRow2(a34, b1, b2, b3, b4));
+			}
+
+			void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix* mb, int32 count)
+			{
+				for (int32 i = 0; i < count; i++)
+				{
+					const __m128* b = reinterpret_cast<const __m128*>(&mb[i].M11);
+					__m256 b1 = _mm256_broadcast_ps(b);
+					__m256 b2 = _mm256_broadcast_ps(b + 1);
+					__m256 b3 = _mm256_broadcast_ps(b + 2);
+					__m256 b4 = _mm256_broadcast_ps(b + 3);
+					Multiply(&result[i].M11, &ma[i].M11, b1, b2, b3, b4);
+				}
+			}
+
+			void MultiplyMatrices(Matrix* result, const Matrix* ma, const Matrix& mb, int32 count)
+			{
+				const __m128* b = reinterpret_cast<const __m128*>(&mb.M11);
+				const __m256 b1 = _mm256_broadcast_ps(b);
+				const __m256 b2 = _mm256_broadcast_ps(b + 1);
+				const __m256 b3 = _mm256_broadcast_ps(b + 2);
+				const __m256 b4 = _mm256_broadcast_ps(b + 3);
+
+				for (int32 i = 0; i < count; i++)
+				{
+					Multiply(&result[i].M11, &ma[i].M11, b1, b2, b3, b4);
+				}
+			}
+
+			void MultiplyMatrices(Matrix* result, const Matrix& ma, const Matrix* mb, int32 count)
+			{
+				for (int32 i = 0; i < count; i++)
+				{
+					const __m128* b = reinterpret_cast<const __m128*>(&mb[i].M11);
+					__m256 b1 = _mm256_broadcast_ps(b);
+					__m256 b2 = _mm256_broadcast_ps(b + 1);
+					__m256 b3 = _mm256_broadcast_ps(b + 2);
+					__m256 b4 = _mm256_broadcast_ps(b + 3);
+					Multiply(&result[i].M11, &ma.M11, b1, b2, b3, b4);
+				}
+			}
+
+			int32 IntersectSpheres(const float* planes, const float* centerX, const float* centerY, const float* centerZ,
+				const float* radius, int32 count, byte* result)
+			{
+				const int32 PlaneCount = 6;
+
+				int32 i = 0;
+				for (; i + 8 <= count; i += 8)
+				{
+					__m256 x = _mm256_loadu_ps(centerX + i);
+					__m256 y = _mm256_loadu_ps(centerY + i);
+					__m256 z = _mm256_loadu_ps(centerZ + i);
+					__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+					__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+					for (int32 j = 0; j < PlaneCount; j++)
+					{
+						const float* p = planes + j * 4;
+						__m256 d = Dot3(x, y, z, p[0], p[1], p[2], _mm256_set1_ps(p[3]));
+						inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GT_OQ));
+					}
+
+					int32 mask = _mm256_movemask_ps(inside);
+					for (int32 k = 0; k < 8; k++)
+						result[i + k] = (mask >> k) & 1;
+				}
+				return i;
+			}
+		}
+	}
+}
+
+#endif
@@ -225,6 +225,12 @@ namespace Apoc3D
 			NewFormat = PixelFormatUtils::ConvertFormat(tmp);
 		}
 
+		BlockCompression = BlockCompressionQuality::Normal;
+		if (sect->tryGetAttribute(L"BlockCompression", tmp))
+		{
+			BlockCompression = ProjectUtils::BlockCompressionQualityConv.Parse(tmp);
+		}
+
 		CompressionType = TextureCompressionType::None;
 		if (sect->tryGetAttribute(L"Compression", tmp))
 		{
@@ -320,6 +326,9 @@ namespace Apoc3D
 		if (NewFormat != FMT_Unknown)
 		{
 			sect->AddAttributeString(L"PixelFormat", PixelFormatUtils::ToString(NewFormat));
+
+			if (PixelFormatUtils::IsCompressed(NewFormat) && BlockCompression != BlockCompressionQuality::Normal)
+				sect->AddAttributeString(L"BlockCompression", ProjectUtils::BlockCompressionQualityConv.ToString(BlockCompression));
 		}
 
 		if (CompressionType != TextureCompressionType::None)
@@ -1157,6 +1166,26 @@ namespace Apoc3D
 		CollapseAll = false;
 		sect->TryGetAttributeBool(L"CollapseAll", CollapseAll);
 
+		OptimizeVertexCache = false;
+		sect->TryGetAttributeBool(L"OptimizeVertexCache", OptimizeVertexCache);
+
+		OverdrawThreshold = 1.05f;
+		sect->TryGetAttributeSingle(L"OverdrawThreshold", OverdrawThreshold);
+
+		SimplifyRatio = 1;
+		sect->TryGetAttributeSingle(L"SimplifyRatio", SimplifyRatio);
+
+		SplitIndices = false;
+		sect->TryGetAttributeBool(L"SplitIndices", SplitIndices);
+
+		HalfTexCoords = false;
+		sect->TryGetAttributeBool(L"HalfTexCoords", HalfTexCoords);
+
+		OctahedralNormals = false;
+		sect->TryGetAttributeBool(L"OctahedralNormals", OctahedralNormals);
+
+		AnimationCompression.Parse(sect);
+
 	}
 	void ProjectResModel::Save(ConfigurationSection* sect, bool savingBuild)
 	{
@@ -1202,6 +1231,27 @@ namespace Apoc3D
 		if (CollapseAll)
 			sect->AddAttributeBool(L"CollapseAll", CollapseAll);
 
+		if (OptimizeVertexCache)
+		{
+			sect->AddAttributeBool(L"OptimizeVertexCache", OptimizeVertexCache);
+
+			if (OverdrawThreshold != 1.05f)
+				sect->AddAttributeSingle(L"OverdrawThreshold", OverdrawThreshold);
+		}
+
+		if (SimplifyRatio < 1)
+			sect->AddAttributeSingle(L"SimplifyRatio", SimplifyRatio);
+
+		if (SplitIndices)
+			sect->AddAttributeBool(L"SplitIndices", SplitIndices);
+
+		if (HalfTexCoords)
+			sect->AddAttributeBool(L"HalfTexCoords", HalfTexCoords);
+
+		if (OctahedralNormals)
+			sect->AddAttributeBool(L"OctahedralNormals", OctahedralNormals);
+
+		AnimationCompression.Save(sect);
 	}
 
 	/************************************************************************/
@@ -1230,6 +1280,8 @@ namespace Apoc3D
 		Reverse = false;
 		sect->TryGetAttributeBool(L"Reverse", Reverse);
 
+		AnimationCompression.Parse(sect);
+
 		for (const ConfigurationSection* ss : sect->getSubSections())
 		{
 			String name = ss->getName();
@@ -1243,6 +1295,7 @@ namespace Apoc3D
 		sect->AddAttributeString(L"SourceFile", WrapSourcePath(SourceFile, true));
 		sect->AddAttributeString(L"DestinationFile", WrapDestinationPath(DestinationFile, true));
 		sect->AddAttributeString(L"Reverse", StringUtils::BoolToString(Reverse));
+		AnimationCompression.Save(sect);
 
 		for (auto e : ObjectIndexMapping)
 		{
@@ -2178,7 +2231,10 @@ namespace Apoc3D
 	{
 		{ L"Nearest", TextureFilterType::Nearest },
 		{ L"BSpline", TextureFilterType::BSpline },
-		{ L"Box", TextureFilterType::Box }
+		{ L"Box", TextureFilterType::Box },
+		{ L"Triangle", TextureFilterType::Triangle },
+		{ L"Lanczos", TextureFilterType::Lanczos },
+		{ L"Kaiser", TextureFilterType::Kaiser }
 	};
 
 	const TypeDualConverter<TextureBuildMethod> ProjectUtils::TextureBuildMethodConv =
@@ -2195,6 +2251,13 @@ namespace Apoc3D
 		{ L"RLE", TextureCompressionType::RLE }
 	};
 
+	const TypeDualConverter<BlockCompressionQuality> ProjectUtils::BlockCompressionQualityConv =
+	{
+		{ L"Fast", BlockCompressionQuality::Fast },
+		{ L"Normal", BlockCompressionQuality::Normal },
+		{ L"Best", BlockCompressionQuality::Best }
+	};
+
 	const TypeDualConverter<MeshBuildMethod> ProjectUtils::MeshBuildMethodConv =
 	{
 		{ L"Ass", MeshBuildMethod::ASS },
@@ -64,7 +64,10 @@ namespace Apoc3D
 	{
 		Nearest,
 		Box,
-		BSpline
+		BSpline,
+		Triangle,
+		Lanczos,
+		Kaiser
 	};
 	enum struct TextureBuildMethod
 	{
@@ -260,6 +263,8 @@ namespace Apoc3D
 		TextureBuildMethod Method = TextureBuildMethod::D3D;
 		TextureFilterType ResizeFilterType = TextureFilterType::BSpline;
 		Apoc3D::Graphics::PixelFormat NewFormat = FMT_Unknown;
+		/** The quality DXT formats are encoded with when NewFormat is one */
+		Apoc3D::Graphics::BlockCompressionQuality BlockCompression = Apoc3D::Graphics::BlockCompressionQuality::Normal;
 		TextureCompressionType CompressionType = TextureCompressionType::None;
 
 
@@ -369,9 +374,26 @@ namespace Apoc3D
 		bool CollapseMeshs = false;
 		bool CollapseAll = false;
 
+		/** Reorder faces and vertices for the post-transform cache, overdraw and vertex fetch. */
+		bool OptimizeVertexCache = false;
+		/** How much worse the ACMR can get for reducing overdraw. 0 turns the overdraw pass off. */
+		float OverdrawThreshold = 1.05f;
+
+		/** The fraction of faces each mesh is simplified to with quadric edge collapse. 1 keeps all faces. */
+		float SimplifyRatio = 1;
+
+		/** Store the indices split per sub mesh, so loading skips splitting the faces. */
+		bool SplitIndices = false;
+		/** Store texture coordinates as half floats. */
+		bool HalfTexCoords = false;
+		/** Store normals, tangents and binormals as octahedral coordinates. */
+		bool OctahedralNormals = false;
+
 		bool UseVertexFormatConversion = false;
 		List<VertexElement> ConversionVertexElements;
 
+		ProjectAnimationCompressionOptions AnimationCompression;
+
 		virtual ProjectItemType getType() const override { return ProjectItemType::Model; }
 		virtual void Parse(const ConfigurationSection* sect) override;
 		virtual void Save(ConfigurationSection* sect, bool savingBuild) override;
@@ -536,6 +558,8 @@ namespace Apoc3D
 		String DestinationFile;
 		bool Reverse = false;
 
+		ProjectAnimationCompressionOptions AnimationCompression;
+
 		HashMap<String, int> ObjectIndexMapping;
 
 		virtual ProjectItemType getType() const override { return ProjectItemType::TransformAnimation; }
@@ -767,6 +791,7 @@ namespace Apoc3D
 		APAPI extern const TypeDualConverter<TextureFilterType> TextureFilterTypeConv;
 		APAPI extern const TypeDualConverter<TextureBuildMethod> TextureBuildMethodConv;
 		APAPI extern const TypeDualConverter<TextureCompressionType> TextureCompressionTypeConv;
+		APAPI extern const TypeDualConverter<Apoc3D::Graphics::BlockCompressionQuality> BlockCompressionQualityConv;
 		APAPI extern const TypeDualConverter<MeshBuildMethod> MeshBuildMethodConv;
 
 		APAPI extern const String BuildAttachmentSectionGUID;
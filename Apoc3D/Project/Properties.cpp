@@ -1,6 +1,7 @@
 #include "Properties.h"
 
 #include "apoc3d/Collections/List.h"
+#include "apoc3d/Config/ConfigurationSection.h"
 #include "apoc3d/Utility/StringUtils.h"
 
 using namespace Apoc3D::Collections;
@@ -102,4 +103,29 @@ namespace Apoc3D
 		return m_newWidth != 0 || m_newHeight != 0 || m_newDepth != 0 ||
 			m_newWidthRatio != 0 || m_newHeightRatio != 0 || m_newDepthRatio != 0;
 	}
+
+	void ProjectAnimationCompressionOptions::Parse(const ConfigurationSection* sect)
+	{
+		Enabled = false;
+		sect->TryGetAttributeBool(L"CompressAnimation", Enabled);
+
+		ReduceKeys = true;
+		sect->TryGetAttributeBool(L"AnimationKeyReduction", ReduceKeys);
+
+		Tolerance = 0.001f;
+		sect->TryGetAttributeSingle(L"AnimationTolerance", Tolerance);
+
+		AngleTolerance = 0.1f;
+		sect->TryGetAttributeSingle(L"AnimationAngleTolerance", AngleTolerance);
+	}
+	void ProjectAnimationCompressionOptions::Save(ConfigurationSection* sect) const
+	{
+		if (!Enabled)
+			return;
+
+		sect->AddAttributeBool(L"CompressAnimation", Enabled);
+		sect->AddAttributeBool(L"AnimationKeyReduction", ReduceKeys);
+		sect->AddAttributeSingle(L"AnimationTolerance", Tolerance);
+		sect->AddAttributeSingle(L"AnimationAngleTolerance", AngleTolerance);
+	}
 }
\ No newline at end of file
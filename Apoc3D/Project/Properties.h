@@ -37,5 +37,23 @@ namespace Apoc3D
 		float m_newDepthRatio = 0;
 
 	};
+
+	/** Options for building compressed model animation clips. */
+	class APAPI ProjectAnimationCompressionOptions
+	{
+	public:
+		bool Enabled = false;
+
+		/** Whether to remove the keys that can be interpolated from their neighbors within the tolerances */
+		bool ReduceKeys = true;
+
+		/** The max error of translation and scale allowed when removing keys */
+		float Tolerance = 0.001f;
+		/** The max error of rotation allowed when removing keys, in degrees */
+		float AngleTolerance = 0.1f;
+
+		void Parse(const ConfigurationSection* sect);
+		void Save(ConfigurationSection* sect) const;
+	};
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,242 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "FlatOctreeCuller.h"
+
+#include "OctreeSceneManager.h"
+#include "SceneObject.h"
+#include "apoc3d/Core/TaskScheduler.h"
+#include "apoc3d/Math/MathBatch.h"
+
+namespace Apoc3D
+{
+	namespace Scene
+	{
+		/** The number of objects in a chunk. Big enough to keep the cost of taking a chunk small. */
+		const int32 ChunkSize = 1024;
+		/** Below this number of objects to test, all chunks run on the calling thread. */
+		const int32 ParallelThreshold = 4096;
+
+		void FlatOctreeCuller::Cull(OctreeSceneNode* root, const LinkedList<SceneObject*>& farObjs, const LinkedList<SceneObject*>& dynObjs, const Frustum& frustum)
+		{
+			const Frustum* frustums[1] = { &frustum };
+			Cull(root, farObjs, dynObjs, frustums, 1);
+		}
+
+		void FlatOctreeCuller::Cull(OctreeSceneNode* root, const LinkedList<SceneObject*>& farObjs, const LinkedList<SceneObject*>& dynObjs,
+			const Frustum* const* frustums, int32 frustumCount)
+		{
+			assert(frustumCount > 0 && frustumCount <= 32);
+
+			if (m_dirty)
+			{
+				Rebuild(root, farObjs);
+				m_dirty = false;
+			}
+			UpdateDynamicObjects(dynObjs);
+
+			// nodes are few compared to objects, test them all here
+			const int32 nodeCount = m_nodeX.getCount();
+			m_nodeVisible.Reserve(nodeCount);
+			m_nodeMasks.ReserveDiscard(nodeCount);
+			for (int32 v = 0; v < frustumCount; v++)
+			{
+				IntersectSpheres(*frustums[v], m_nodeX.getElements(), m_nodeY.getElements(), m_nodeZ.getElements(), m_nodeRadius.getElements(),
+					nodeCount, m_nodeVisible.getElements());
+
+				for (int32 i = 0; i < nodeCount; i++)
+					m_nodeMasks[i] |= (uint32)m_nodeVisible[i] << v;
+			}
+
+			// a subtree is kept when any of the views sees it
+			m_ranges.Clear();
+			for (int32 i = 0; i < nodeCount; )
+			{
+				if (m_nodeMasks[i])
+				{
+					AddRange(m_nodeObjStart[i], m_nodeObjEnd[i]);
+					i++;
+				}
+				else
+				{
+					// skip the whole subtree
+					i = m_nodeSubtreeEnd[i];
+				}
+			}
+			AddRange(m_treeObjectCount, m_objects.getCount());
+
+			// cut the ranges into chunks, each with its own output slice
+			m_chunks.Clear();
+			int32 offset = 0;
+			for (int32 i = 0; i < m_ranges.getCount(); i += 2)
+			{
+				for (int32 start = m_ranges[i]; start < m_ranges[i + 1]; start += ChunkSize)
+				{
+					Chunk c;
+					c.Start = start;
+					c.Count = Math::Min(ChunkSize, m_ranges[i + 1] - start);
+					c.Offset = offset;
+					c.VisibleCount = 0;
+					m_chunks.Add(c);
+
+					offset += c.Count;
+				}
+			}
+			m_visible.Reserve(offset);
+			m_visibleMasks.Reserve(offset);
+			m_objVisible.Reserve(m_objects.getCount());
+			m_objMasks.Reserve(m_objects.getCount());
+
+			m_frustums = frustums;
+			m_frustumCount = frustumCount;
+			TaskScheduler::RunJobs(m_chunks.getCount(), FunctorReference<void(int32)>(this, &FlatOctreeCuller::ProcessChunk), offset * frustumCount >= ParallelThreshold);
+			m_frustums = nullptr;
+			m_frustumCount = 0;
+		}
+
+		void FlatOctreeCuller::Rebuild(OctreeSceneNode* root, const LinkedList<SceneObject*>& farObjs)
+		{
+			m_nodeX.Clear();
+			m_nodeY.Clear();
+			m_nodeZ.Clear();
+			m_nodeRadius.Clear();
+			m_nodeSubtreeEnd.Clear();
+			m_nodeObjStart.Clear();
+			m_nodeObjEnd.Clear();
+
+			m_objX.Clear();
+			m_objY.Clear();
+			m_objZ.Clear();
+			m_objRadius.Clear();
+			m_objects.Clear();
+
+			FlattenNode(root);
+			m_treeObjectCount = m_objects.getCount();
+
+			for (SceneObject* obj : farObjs)
+				AddObject(obj);
+			m_staticObjectCount = m_objects.getCount();
+		}
+
+		void FlatOctreeCuller::FlattenNode(OctreeSceneNode* node)
+		{
+			const int32 index = m_nodeX.getCount();
+
+			const BoundingSphere& bs = node->getBoundingSphere();
+			m_nodeX.Add(bs.Center.X);
+			m_nodeY.Add(bs.Center.Y);
+			m_nodeZ.Add(bs.Center.Z);
+			m_nodeRadius.Add(bs.Radius);
+			m_nodeSubtreeEnd.Add(0);
+
+			m_nodeObjStart.Add(m_objects.getCount());
+			const SceneObjectList& objs = node->getAttachedObjects();
+			for (SceneObject* obj : objs)
+				AddObject(obj);
+			m_nodeObjEnd.Add(m_objects.getCount());
+
+			for (int32 i = 0; i < OctreeSceneNode::OCTE_Count; i++)
+			{
+				OctreeSceneNode* subNode = node->getNode(static_cast<OctreeSceneNode::Extend>(i));
+				if (subNode)
+					FlattenNode(subNode);
+			}
+
+			m_nodeSubtreeEnd[index] = m_nodeX.getCount();
+		}
+
+		void FlatOctreeCuller::AddObject(SceneObject* obj)
+		{
+			const BoundingSphere& bs = obj->getBoundingSphere();
+			m_objX.Add(bs.Center.X);
+			m_objY.Add(bs.Center.Y);
+			m_objZ.Add(bs.Center.Z);
+			m_objRadius.Add(bs.Radius);
+			m_objects.Add(obj);
+		}
+
+		void FlatOctreeCuller::UpdateDynamicObjects(const LinkedList<SceneObject*>& dynObjs)
+		{
+			// drop the dynamic objects from last time, keeping the static ones
+			m_objX.Reserve(m_staticObjectCount);
+			m_objY.Reserve(m_staticObjectCount);
+			m_objZ.Reserve(m_staticObjectCount);
+			m_objRadius.Reserve(m_staticObjectCount);
+			m_objects.Reserve(m_staticObjectCount);
+
+			for (SceneObject* obj : dynObjs)
+				AddObject(obj);
+		}
+
+		void FlatOctreeCuller::AddRange(int32 start, int32 end)
+		{
+			if (start >= end)
+				return;
+
+			// objects of a visible node and its first child are usually next to each other
+			int32 count = m_ranges.getCount();
+			if (count && m_ranges[count - 1] == start)
+			{
+				m_ranges[count - 1] = end;
+			}
+			else
+			{
+				m_ranges.Add(start);
+				m_ranges.Add(end);
+			}
+		}
+
+		void FlatOctreeCuller::ProcessChunk(int32 index)
+		{
+			Chunk& c = m_chunks[index];
+
+			byte* flags = m_objVisible.getElements() + c.Start;
+			uint32* masks = m_objMasks.getElements() + c.Start;
+
+			// the chunk stays in cache while it is tested against each view
+			for (int32 v = 0; v < m_frustumCount; v++)
+			{
+				IntersectSpheres(*m_frustums[v], m_objX.getElements() + c.Start, m_objY.getElements() + c.Start, m_objZ.getElements() + c.Start,
+					m_objRadius.getElements() + c.Start, c.Count, flags);
+
+				if (v == 0)
+				{
+					for (int32 i = 0; i < c.Count; i++)
+						masks[i] = flags[i];
+				}
+				else
+				{
+					for (int32 i = 0; i < c.Count; i++)
+						masks[i] |= (uint32)flags[i] << v;
+				}
+			}
+
+			int32* dst = m_visible.getElements() + c.Offset;
+			uint32* dstMasks = m_visibleMasks.getElements() + c.Offset;
+			int32 visibleCount = 0;
+			for (int32 i = 0; i < c.Count; i++)
+			{
+				if (masks[i])
+				{
+					dst[visibleCount] = c.Start + i;
+					dstMasks[visibleCount] = masks[i];
+					visibleCount++;
+				}
+			}
+			c.VisibleCount = visibleCount;
+		}
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+#ifndef APOC3D_FLATOCTREECULLER_H
+#define APOC3D_FLATOCTREECULLER_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "apoc3d/ApocCommon.h"
+#include "apoc3d/Collections/List.h"
+#include "apoc3d/Collections/LinkedList.h"
+
+using namespace Apoc3D::Collections;
+using namespace Apoc3D::Core;
+using namespace Apoc3D::Math;
+
+namespace Apoc3D
+{
+	namespace Scene
+	{
+		/**
+		 *  Frustum culling over a flattened copy of an octree.
+		 *
+		 *  Bounding spheres of nodes and objects are kept in separate arrays for each component. Nodes are
+		 *  stored in depth first order, so the objects in a subtree always take a continuous range.
+		 *  Spheres are tested several at a time with the batched math functions. The object ranges left
+		 *  after node culling are cut into chunks which worker threads take in turn; each chunk writes its
+		 *  visible objects into its own slice, so results are merged without locks and in a fixed order.
+		 *
+		 *  Several frustums can be tested in one go. Each visible object then comes with a mask of the
+		 *  views it is visible in, and the arrays are only walked once for all of them.
+		 */
+		class APAPI FlatOctreeCuller
+		{
+		public:
+			FlatOctreeCuller() { }
+
+			FlatOctreeCuller(const FlatOctreeCuller&) = delete;
+			FlatOctreeCuller& operator=(const FlatOctreeCuller&) = delete;
+
+			/** Marks the flattened copy as out of date. It will be rebuilt at the next Cull. */
+			void Invalidate() { m_dirty = true; }
+
+			/**
+			 *  Finds the visible objects in the octree and the far/dynamic object lists.
+			 *  Bounds of the dynamic objects are read again on every call.
+			 */
+			void Cull(OctreeSceneNode* root, const LinkedList<SceneObject*>& farObjs, const LinkedList<SceneObject*>& dynObjs, const Frustum& frustum);
+
+			/**
+			 *  Finds the objects visible in any of the given frustums.
+			 *  @param frustumCount No more than 32, the bits in a view mask.
+			 */
+			void Cull(OctreeSceneNode* root, const LinkedList<SceneObject*>& farObjs, const LinkedList<SceneObject*>& dynObjs, 
+				const Frustum* const* frustums, int32 frustumCount);
+
+			/** Calls f(SceneObject* obj, bool inOctree) for every visible object found by the last Cull. */
+			template <typename Func>
+			void ForEachVisible(Func f) const
+			{
+				ForEachVisibleInViews([&f](SceneObject* obj, bool inOctree, uint32 viewMask) { f(obj, inOctree); });
+			}
+
+			/**
+			 *  Calls f(SceneObject* obj, bool inOctree, uint32 viewMask) for every visible object found by the last Cull.
+			 *  Bit i of viewMask is set if the object is visible in the i-th frustum.
+			 */
+			template <typename Func>
+			void ForEachVisibleInViews(Func f) const
+			{
+				for (const Chunk& c : m_chunks)
+				{
+					const int32* vis = m_visible.getElements() + c.Offset;
+					const uint32* masks = m_visibleMasks.getElements() + c.Offset;
+					for (int32 i = 0; i < c.VisibleCount; i++)
+					{
+						int32 idx = vis[i];
+						f(m_objects[idx], idx < m_treeObjectCount, masks[i]);
+					}
+				}
+			}
+
+		private:
+			/** A part of an object range tested by one thread */
+			struct Chunk
+			{
+				int32 Start;
+				int32 Count;
+				/** Where the visible object indices go in m_visible */
+				int32 Offset;
+				int32 VisibleCount;
+			};
+
+			void Rebuild(OctreeSceneNode* root, const LinkedList<SceneObject*>& farObjs);
+			void FlattenNode(OctreeSceneNode* node);
+			void AddObject(SceneObject* obj);
+			void UpdateDynamicObjects(const LinkedList<SceneObject*>& dynObjs);
+
+			void AddRange(int32 start, int32 end);
+			void ProcessChunk(int32 index);
+
+			bool m_dirty = true;
+
+			// nodes in depth first order
+			List<float> m_nodeX;
+			List<float> m_nodeY;
+			List<float> m_nodeZ;
+			List<float> m_nodeRadius;
+			/** The index after the last node of each node's subtree */
+			List<int32> m_nodeSubtreeEnd;
+			/** The range of objects attached to each node itself */
+			List<int32> m_nodeObjStart;
+			List<int32> m_nodeObjEnd;
+			List<byte> m_nodeVisible;
+			List<uint32> m_nodeMasks;
+
+			// octree objects, followed by far objects, then dynamic objects
+			List<float> m_objX;
+			List<float> m_objY;
+			List<float> m_objZ;
+			List<float> m_objRadius;
+			List<SceneObject*> m_objects;
+			List<byte> m_objVisible;
+			List<uint32> m_objMasks;
+
+			int32 m_treeObjectCount = 0;
+			int32 m_staticObjectCount = 0;
+
+			/** Object ranges to test, as pairs of start and end */
+			List<int32> m_ranges;
+			List<Chunk> m_chunks;
+			List<int32> m_visible;
+			List<uint32> m_visibleMasks;
+
+			const Frustum* const* m_frustums = nullptr;
+			int32 m_frustumCount = 0;
+
+		};
+	}
+}
+
+#endif
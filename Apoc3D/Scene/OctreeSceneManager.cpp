@@ -16,6 +16,7 @@
 
 #include "OctreeSceneManager.h"
 
+#include "FlatOctreeCuller.h"
 #include "SceneObject.h"
 #include "apoc3d/Graphics/RenderOperationBuffer.h"
 #include "apoc3d/Graphics/RenderOperation.h"
@@ -164,9 +165,26 @@ namespace Apoc3D
 
 		OctreeSceneManager::~OctreeSceneManager()
 		{
+			DELETE_AND_NULL(m_flatCuller);
 			delete m_octRootNode;	
 		}
 
+		void OctreeSceneManager::setCullingMode(OctreeCullingMode mode)
+		{
+			m_cullingMode = mode;
+
+			DELETE_AND_NULL(m_flatCuller);
+			if (mode == OctreeCullingMode::FlattenedParallel)
+			{
+				m_flatCuller = new FlatOctreeCuller();
+			}
+		}
+		void OctreeSceneManager::InvalidateFlatCopy()
+		{
+			if (m_flatCuller)
+				m_flatCuller->Invalidate();
+		}
+
 		void OctreeSceneManager::AddObject(SceneObject* const sceObj)
 		{
 			SceneManager::AddObject(sceObj);
@@ -178,6 +196,7 @@ namespace Apoc3D
 			else
 			{
 				AddStaticObject(sceObj);
+				InvalidateFlatCopy();
 			}
 
 			sceObj->OnAddedToScene(this);
@@ -214,6 +233,7 @@ namespace Apoc3D
 				m_octRootNode->RemoveObject(sceObj);
 				
 				m_farObjs.Remove(sceObj);
+				InvalidateFlatCopy();
 				//list<SceneObject*>::iterator iter = find(m_farObjs.begin(), m_farObjs.end(), sceObj);
 				//if (iter != m_farObjs.end())
 				//{
@@ -235,64 +255,106 @@ namespace Apoc3D
 		}
 		void OctreeSceneManager::PrepareVisibleObjects(Camera* camera, BatchData* batchData)
 		{
-			const Frustum& frus = camera->getFrustum();
+			PrepareVisibleObjects(&camera, &batchData, 1);
+		}
 
-			m_bfsQueue.Enqueue(m_octRootNode);
+		void OctreeSceneManager::PrepareVisibleObjects(Camera* const* cameras, BatchData* const* batchData, int32 viewCount)
+		{
+			assert(viewCount > 0 && viewCount <= MaxViews);
 
-			Vector3 camPos = camera->getInvViewMatrix().GetTranslation();
+			const Frustum* frustums[MaxViews];
+			Vector3 camPos[MaxViews];
+			for (int32 v = 0; v < viewCount; v++)
+			{
+				frustums[v] = &cameras[v]->getFrustum();
+				camPos[v] = cameras[v]->getInvViewMatrix().GetTranslation();
+			}
+
+			// hands an object to the batch data of every view in the mask
+			auto addVisible = [&](SceneObject* obj, bool inOctree, uint32 viewMask)
+			{
+				for (int32 v = 0; v < viewCount; v++)
+				{
+					if (viewMask & (1u << v))
+					{
+						if (inOctree && obj->hasSubObjects())
+						{
+							obj->PrepareVisibleObjects(cameras[v], 0, batchData[v]);
+						}
+						int level = GetLevel(obj->getBoundingSphere(), camPos[v]);
+
+						batchData[v]->AddVisisbleObject(obj, level);
+					}
+				}
+			};
+			auto testViews = [&](const BoundingSphere& sphere, uint32 viewMask)
+			{
+				uint32 result = 0;
+				for (int32 v = 0; v < viewCount; v++)
+				{
+					if ((viewMask & (1u << v)) && frustums[v]->Intersects(sphere))
+						result |= 1u << v;
+				}
+				return result;
+			};
+
+			if (m_flatCuller)
+			{
+				m_flatCuller->Cull(m_octRootNode, m_farObjs, m_dynObjs, frustums, viewCount);
+				m_flatCuller->ForEachVisibleInViews(addVisible);
+				return;
+			}
+
+			const uint32 allViews = viewCount == MaxViews ? 0xffffffffu : (1u << viewCount) - 1;
+
+			NodeViews root = { m_octRootNode, allViews };
+			m_cullQueue.Enqueue(root);
 
 			// do board first pass a the octree
-			while (m_bfsQueue.getCount())
+			while (m_cullQueue.getCount())
 			{
-				OctreeSceneNode* node = m_bfsQueue.Dequeue();
-				//Vector3 center = node->getBoundingSphere().Center;
-				
-				if (frus.Intersects(node->getBoundingSphere()))
+				NodeViews nv = m_cullQueue.Dequeue();
+				OctreeSceneNode* node = nv.Node;
+
+				uint32 nodeMask = testViews(node->getBoundingSphere(), nv.ViewMask);
+				if (nodeMask)
 				{
 					for (int i=0;i<OctreeSceneNode::OCTE_Count;i++)
 					{
 						OctreeSceneNode* subNode = node->getNode(static_cast<OctreeSceneNode::Extend>(i));
 						if (subNode)
 						{
-							m_bfsQueue.Enqueue(subNode);
+							NodeViews sub = { subNode, nodeMask };
+							m_cullQueue.Enqueue(sub);
 						}
 					}
 					const SceneObjectList& objs = node->getAttachedObjects();
 					for (int i=0;i<objs.getCount();i++)
 					{
-						if (frus.Intersects(objs[i]->getBoundingSphere()))
+						uint32 objMask = testViews(objs[i]->getBoundingSphere(), nodeMask);
+						if (objMask)
 						{
-							if (objs[i]->hasSubObjects())
-							{
-								objs[i]->PrepareVisibleObjects(camera, 0, batchData);
-							} 
-							int level = GetLevel(objs[i]->getBoundingSphere(), camPos);
-
-							batchData->AddVisisbleObject(objs[i], level);
+							addVisible(objs[i], true, objMask);
 						}
-						
 					}
 				}
 			}
 			for (SceneObject* obj : m_farObjs)
 			{
-				if (frus.Intersects(obj->getBoundingSphere()))
+				uint32 objMask = testViews(obj->getBoundingSphere(), allViews);
+				if (objMask)
 				{
-					int level = GetLevel(obj->getBoundingSphere(), camPos);
-
-					batchData->AddVisisbleObject(obj, level);
+					addVisible(obj, false, objMask);
 				}
 			}
 			for (SceneObject* obj : m_dynObjs)
 			{
-				if (frus.Intersects(obj->getBoundingSphere()))
+				uint32 objMask = testViews(obj->getBoundingSphere(), allViews);
+				if (objMask)
 				{
-					int level = GetLevel(obj->getBoundingSphere(), camPos);
-
-					batchData->AddVisisbleObject(obj, level);
+					addVisible(obj, false, objMask);
 				}
 			}
-
 		}
 
 		SceneObject* OctreeSceneManager::FindObject(const Ray& ray, IObjectFilter* filter)
@@ -374,6 +436,7 @@ namespace Apoc3D
 					m_octRootNode->RemoveObject(objects[i]);
 					AddStaticObject(objects[i]);
 					objects[i]->RequiresNodeUpdate = false;
+					InvalidateFlatCopy();
 				}
 			}
 		}
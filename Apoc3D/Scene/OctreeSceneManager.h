@@ -101,6 +101,15 @@ namespace Apoc3D
 			static Vector3 OffsetVectorTable[8];
 		};
 
+		/** How OctreeSceneManager finds the visible objects */
+		enum struct OctreeCullingMode
+		{
+			/** Walks the octree node by node, testing one sphere at a time. */
+			Hierarchical,
+			/** Uses FlatOctreeCuller: a flattened copy of the tree tested with SIMD on the TaskScheduler's threads. */
+			FlattenedParallel
+		};
+
 		class APAPI OctreeSceneManager : public SceneManager
 		{
 		public:
@@ -111,6 +120,11 @@ namespace Apoc3D
 			virtual bool RemoveObject(SceneObject* const obj);
 
 			virtual void PrepareVisibleObjects(Camera* camera, BatchData* batchData);
+			/**
+			 *  Culls all the views in one walk of the octree. Each node and object is only tested against
+			 *  the views its parent node is visible in, and the result is kept as a bit mask of views.
+			 */
+			virtual void PrepareVisibleObjects(Camera* const* cameras, BatchData* const* batchData, int32 viewCount);
 
 			virtual void Update(const AppTime* time);
 
@@ -121,11 +135,23 @@ namespace Apoc3D
 
 			bool QualifiesFarObject(const SceneObject* obj) const;
 
+			/** Changes the culling method. */
+			void setCullingMode(OctreeCullingMode mode);
+			OctreeCullingMode getCullingMode() const { return m_cullingMode; }
+
 		private:
+			/** An octree node to visit, with the views its parent is visible in. */
+			struct NodeViews
+			{
+				OctreeSceneNode* Node;
+				uint32 ViewMask;
+			};
+
 			LinkedList<SceneObject*> m_dynObjs;
 			LinkedList<SceneObject*> m_farObjs;
 
 			Queue<OctreeSceneNode*> m_bfsQueue;
+			Queue<NodeViews> m_cullQueue;
 
 			OctreeBox m_range;
 			Vector3 m_min;
@@ -135,7 +161,11 @@ namespace Apoc3D
 
 			OctreeSceneNode* m_octRootNode;
 
+			OctreeCullingMode m_cullingMode = OctreeCullingMode::Hierarchical;
+			FlatOctreeCuller* m_flatCuller = nullptr;
+
 			void AddStaticObject(SceneObject* obj);
+			void InvalidateFlatCopy();
 
 		};
 	}
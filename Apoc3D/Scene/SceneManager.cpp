@@ -42,6 +42,15 @@ namespace Apoc3D
 			return m_objects.Remove(obj);
 		}
 
+		void SceneManager::PrepareVisibleObjects(Camera* const* cameras, BatchData* const* batchData, int32 viewCount)
+		{
+			assert(viewCount <= MaxViews);
+			for (int32 i = 0; i < viewCount; i++)
+			{
+				PrepareVisibleObjects(cameras[i], batchData[i]);
+			}
+		}
+
 		void SceneManager::Update(const AppTime* time)
 		{
 			for (int32 i = 0;i<m_objects.getCount();i++)
@@ -49,6 +49,9 @@ namespace Apoc3D
 		class APAPI SceneManager
 		{
 		public:
+			/** The number of views that can be culled together, one bit each in a view mask. */
+			static const int32 MaxViews = 32;
+
 			SceneManager();
 			virtual ~SceneManager();
 		
@@ -63,6 +66,15 @@ namespace Apoc3D
 
 			virtual void PrepareVisibleObjects(Camera* camera, BatchData* batchData) = 0;
 
+			/**
+			 *  Finds the visible objects of several views at once, like the main view and the cascades 
+			 *  of a shadow map. The objects visible to the i-th camera go to the i-th BatchData.
+			 *  The default implementation prepares the views one after another; scene managers with
+			 *  a spatial structure override it to go through the structure only once.
+			 *  @param viewCount No more than MaxViews.
+			 */
+			virtual void PrepareVisibleObjects(Camera* const* cameras, BatchData* const* batchData, int32 viewCount);
+
 			virtual void Update(const AppTime* time);
 
 			virtual SceneObject* FindObject(const Ray& ray, IObjectFilter* filter) = 0;
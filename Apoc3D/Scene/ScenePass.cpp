@@ -67,6 +67,8 @@ namespace Apoc3D
 			memcpy(vtxData, pos, sizeof(pos));
 
 			m_quadBuffer->Unlock();
+
+			PrepareConditions();
 		}
 
 
@@ -77,80 +79,53 @@ namespace Apoc3D
 		}
 		
 		
-		void ScenePass::Invoke(const List<Camera*>& cameras, SceneManager* sceMgr, BatchData* batchData)
+		Camera* ScenePass::SelectCamera(const List<Camera*>& cameras) const
 		{
-			//uint64 selectorMask = 1<<m_selectorID;
 			if (m_renderer->GlobalCameraOverride != -1)
 			{
-				m_currentCamera = cameras[m_renderer->GlobalCameraOverride];
-			}
-			else
-			{
-				m_currentCamera = cameras[m_cameraID];
+				return cameras[m_renderer->GlobalCameraOverride];
 			}
-			RendererEffectParams::CurrentCamera = m_currentCamera;
+			return cameras[m_cameraID];
+		}
 
-			if (m_currentCamera != m_parentProc->getLastCamera())
-			{
-				// only re add visible objects into table when the camera is changed.
-				batchData->Clear();
-				sceMgr->PrepareVisibleObjects(m_currentCamera, batchData);
-			}
+		void ScenePass::Invoke(const List<Camera*>& cameras, BatchData* batchData)
+		{
+			//uint64 selectorMask = 1<<m_selectorID;
+			m_currentCamera = SelectCamera(cameras);
+			RendererEffectParams::CurrentCamera = m_currentCamera;
 
 			// execute scene pass render script
 			for (int i=0;i<m_instuctions.getCount();i++)
 			{
+				int32 condIdx = m_conditionStarts[i];
+				if (condIdx != -1)
+				{
+					ConditionCache& cond = m_conditions[condIdx];
+					const SceneInstruction& jump = m_instuctions[cond.Jump];
+
+					bool result = EvaluateCondition(cond);
+					bool taken = jump.Operation == SOP_JZ ? !result : result;
+
+					i = taken ? jump.Next - 1 : cond.Jump;
+					continue;
+				}
+
 				const SceneInstruction& inst = m_instuctions[i];
 				switch (inst.Operation)
 				{
 					case SOP_And:
-					{
-						ExecutionValue val1 = m_execStack.Pop();
-						ExecutionValue val2 = m_execStack.Pop();
-						ExecutionValue result;
-
-						result.Value[0] = val1.Value[0] & val2.Value[0];
-						result.Value[1] = val1.Value[1] & val2.Value[1];
-
-						m_execStack.Push(result);
-						break;
-					}
 					case SOP_Or:
-					{
-						ExecutionValue val1 = m_execStack.Pop();
-						ExecutionValue val2 = m_execStack.Pop();
-						ExecutionValue result;
-
-						result.Value[0] = val1.Value[0] | val2.Value[0];
-						result.Value[1] = val1.Value[1] | val2.Value[1];
-
-						m_execStack.Push(result);
-						break;
-					}
 					case SOP_Not:
-					{
-						ExecutionValue val = m_execStack.Pop();
-						ExecutionValue result;
-						result.Value[0] = !val.Value[0];
-						result.Value[1] = !val.Value[1];
-						m_execStack.Push(result);
-						break;
-					}
 					case SOP_Load:
+						ExecuteOperator(inst);
+						break;
+					case SOP_Pop:
 					{
-						ExecutionValue val;
-						if (inst.Args[0].IsImmediate)
-						{
-							val.Value[0] = inst.Args[0].DefaultValue[0];
-							val.Value[1] = inst.Args[0].DefaultValue[1];
-						}
-						else
+						ExecutionValue val = m_execStack.Pop();
+						if (inst.Args.getCount() > 0 && !inst.Args[0].IsImmediate)
 						{
-							val.Value[0] = inst.Args[0].Var->Value[0];
-							val.Value[1] = inst.Args[0].Var->Value[1];
+							inst.Args[0].Var->SetValue(val.Value[0], val.Value[1]);
 						}
-
-						m_execStack.Push(val);
 						break;
 					}
 					case SOP_JNZ:
@@ -177,7 +152,7 @@ namespace Apoc3D
 						Clear(inst);
 						break;
 					case SOP_Render:
-						m_renderer->RenderBatch(m_selectorID);
+						batchData->RenderBatch(m_renderDevice, m_selectorID);
 						break;
 					case SOP_RenderQuad:
 						RenderQuad(inst);
@@ -195,7 +170,9 @@ namespace Apoc3D
 						}
 						uint64 selectMask = 1ULL << selectorID;
 						bool result = batchData->HasObject(selectMask);
-						inst.Args[1].Var->Value[0] = result ? 1 : 0;
+
+						SceneVariable* ret = inst.Args[1].Var;
+						ret->SetValue(result ? 1 : 0, ret->Value[1]);
 						break;
 					}
 
@@ -210,6 +187,132 @@ namespace Apoc3D
 			}
 		}
 
+		void ScenePass::PrepareConditions()
+		{
+			m_conditionStarts.ReserveDiscard(m_instuctions.getCount());
+			for (int32 i = 0; i < m_instuctions.getCount(); i++)
+				m_conditionStarts[i] = -1;
+
+			for (int32 i = 0; i < m_instuctions.getCount(); i++)
+			{
+				const SceneInstruction& inst = m_instuctions[i];
+				if (inst.Operation != SOP_JZ && inst.Operation != SOP_JNZ)
+					continue;
+
+				// the expression is the operators right before the jump
+				int32 start = i;
+				while (start > 0)
+				{
+					SceneOpCode op = m_instuctions[start - 1].Operation;
+					if (op != SOP_Load && op != SOP_And && op != SOP_Or && op != SOP_Not)
+						break;
+					start--;
+				}
+
+				if (start == i || m_conditionStarts[start] != -1)
+					continue;
+
+				ConditionCache cond;
+				cond.Start = start;
+				cond.Jump = i;
+
+				for (int32 j = start; j < i; j++)
+				{
+					const SceneInstruction& ld = m_instuctions[j];
+					if (ld.Operation == SOP_Load && !ld.Args[0].IsImmediate && cond.Variables.IndexOf(ld.Args[0].Var) == -1)
+					{
+						cond.Variables.Add(ld.Args[0].Var);
+						cond.Versions.Add(0);
+					}
+				}
+
+				m_conditionStarts[start] = m_conditions.getCount();
+				m_conditions.Add(cond);
+			}
+		}
+
+		bool ScenePass::EvaluateCondition(ConditionCache& cond)
+		{
+			if (cond.Evaluated)
+			{
+				bool changed = false;
+				for (int32 i = 0; i < cond.Variables.getCount() && !changed; i++)
+					changed = cond.Variables[i]->Version != cond.Versions[i];
+
+				if (!changed)
+					return cond.Result;
+			}
+
+			for (int32 i = cond.Start; i < cond.Jump; i++)
+				ExecuteOperator(m_instuctions[i]);
+
+			ExecutionValue val = m_execStack.Pop();
+			cond.Result = val.Value[0] || val.Value[1];
+			cond.Evaluated = true;
+
+			for (int32 i = 0; i < cond.Variables.getCount(); i++)
+				cond.Versions[i] = cond.Variables[i]->Version;
+
+			return cond.Result;
+		}
+
+		void ScenePass::ExecuteOperator(const SceneInstruction& inst)
+		{
+			switch (inst.Operation)
+			{
+				case SOP_And:
+				{
+					ExecutionValue val1 = m_execStack.Pop();
+					ExecutionValue val2 = m_execStack.Pop();
+					ExecutionValue result;
+
+					result.Value[0] = val1.Value[0] & val2.Value[0];
+					result.Value[1] = val1.Value[1] & val2.Value[1];
+
+					m_execStack.Push(result);
+					break;
+				}
+				case SOP_Or:
+				{
+					ExecutionValue val1 = m_execStack.Pop();
+					ExecutionValue val2 = m_execStack.Pop();
+					ExecutionValue result;
+
+					result.Value[0] = val1.Value[0] | val2.Value[0];
+					result.Value[1] = val1.Value[1] | val2.Value[1];
+
+					m_execStack.Push(result);
+					break;
+				}
+				case SOP_Not:
+				{
+					ExecutionValue val = m_execStack.Pop();
+					ExecutionValue result;
+					result.Value[0] = !val.Value[0];
+					result.Value[1] = !val.Value[1];
+					m_execStack.Push(result);
+					break;
+				}
+				case SOP_Load:
+				{
+					ExecutionValue val;
+					if (inst.Args[0].IsImmediate)
+					{
+						val.Value[0] = inst.Args[0].DefaultValue[0];
+						val.Value[1] = inst.Args[0].DefaultValue[1];
+					}
+					else
+					{
+						val.Value[0] = inst.Args[0].Var->Value[0];
+						val.Value[1] = inst.Args[0].Var->Value[1];
+					}
+
+					m_execStack.Push(val);
+					break;
+				}
+			}
+		}
+
 		void ScenePass::Clear(const SceneInstruction& inst)
 		{
 			int flags=0;
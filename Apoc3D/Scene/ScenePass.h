@@ -47,8 +47,14 @@ namespace Apoc3D
 			ScenePass(RenderDevice* dev, SceneRenderer* renderer, SceneProcedure* parent, const ScenePassData* passData);
 			~ScenePass();
 
-			/** Begins executing the pass' procedure for once. */
-			void Invoke(const List<Camera*>& cameras, SceneManager* sceMgr, BatchData* batchData);
+			/** 
+			 *  Begins executing the pass' procedure for once. 
+			 *  @param batchData The visible objects of the pass' camera, already prepared by the SceneProcedure.
+			 */
+			void Invoke(const List<Camera*>& cameras, BatchData* batchData);
+
+			/** Gets the camera this pass renders with, out of the ones registered at SceneRenderer. */
+			Camera* SelectCamera(const List<Camera*>& cameras) const;
 			
 			/** Gets the camera used in this scene pass. */
 			const Camera* getCurrentCamera() const { return m_currentCamera; }
@@ -74,6 +80,21 @@ namespace Apoc3D
 			{
 				uint Value[2];
 			};
+
+			/** 
+			 *  An expression followed by a conditional jump. The result is kept until 
+			 *  one of the variables it loads changes.
+			 */
+			struct ConditionCache
+			{
+				int32 Start = 0;
+				int32 Jump = 0;
+				List<SceneVariable*> Variables;
+				List<uint32> Versions;
+
+				bool Evaluated = false;
+				bool Result = false;
+			};
 		private:
 			RenderDevice* m_renderDevice;
 			SceneRenderer* m_renderer;
@@ -89,10 +110,18 @@ namespace Apoc3D
 			List<SceneInstruction> m_instuctions;
 			Stack<ExecutionValue> m_execStack;
 
+			List<ConditionCache> m_conditions;
+			/** For each instruction, the index of the condition starting there, or -1. */
+			List<int32> m_conditionStarts;
+
 			float m_floatBuffer[60];
 
 			Camera* m_currentCamera;
 
+			void PrepareConditions();
+			bool EvaluateCondition(ConditionCache& cond);
+			void ExecuteOperator(const SceneInstruction& inst);
+
 			void Clear(const SceneInstruction& inst);
 			void RenderQuad(const SceneInstruction& inst);
 			void UseRT(const SceneInstruction& inst);
@@ -112,10 +112,24 @@ namespace Apoc3D
 
 			void* ObjectValue = nullptr;
 
+			/** Incremented when Value changes, so cached conditions know when to evaluate again. */
+			uint32 Version = 0;
+
 			SceneVariable()
 			{
 				memset(Value, 0, sizeof(Value));
 			}
+
+			/** Sets the first 2 values, which are what the execution stack works with. */
+			void SetValue(uint v0, uint v1)
+			{
+				if (Value[0] != v0 || Value[1] != v1)
+				{
+					Value[0] = v0;
+					Value[1] = v1;
+					Version++;
+				}
+			}
 		};
 
 		/** Defines some opcodes */
@@ -18,6 +18,9 @@
 
 #include "SceneRenderScriptParser.h"
 #include "ScenePass.h"
+#include "SceneManager.h"
+#include "SceneRenderer.h"
+#include "apoc3d/Graphics/Camera.h"
 #include "apoc3d/Core/ResourceHandle.h"
 #include "apoc3d/Core/Logging.h"
 #include "apoc3d/Graphics/EffectSystem/EffectManager.h"
@@ -47,6 +50,8 @@ namespace Apoc3D
 			m_createdTextures.DeleteAndClear();
 			m_createdRenderTarget.DeleteAndClear();
 			m_createDepthStencil.DeleteAndClear();
+			m_externalRenderTargets.DeleteAndClear();
+			m_externalDepthStencils.DeleteAndClear();
 			
 			for (ProcGaussBlurFilter& f : m_createdGaussFilters)
 			{
@@ -61,6 +66,8 @@ namespace Apoc3D
 
 		void SceneProcedure::Load(SceneRenderer* renderer, const ResourceLocation& rl)
 		{
+			m_renderer = renderer;
+
 			SceneRenderScriptParser parser(m_renderDevice);
 			parser.Parse(rl);
 			m_name = parser.getSceneName();
@@ -129,87 +136,10 @@ namespace Apoc3D
 			// initialize resources
 			if (m_isAvailable)
 			{
-				ObjectFactory* factory = m_renderDevice->getObjectFactory();
-
 				for (SceneVariable* var : m_variables)
 				{
 					switch (var->Type)
 					{
-						case SceneVariableType::DepthStencil:
-						case SceneVariableType::RenderTarget:
-						{
-							uint width = var->Value[0];
-							uint height = var->Value[1];
-							float wscale;
-							float hscale;
-							bool usePercentageLock = false;
-
-							if (!width || !height)
-							{
-								wscale = reinterpret_cast<const float&>(var->Value[2]);
-								hscale = reinterpret_cast<const float&>(var->Value[3]);
-
-								Viewport vp = m_renderDevice->getViewport();
-								width = static_cast<uint>(vp.Width * wscale + 0.5f);
-								height = static_cast<uint>(vp.Height * hscale + 0.5f);
-								usePercentageLock = true;
-							}
-
-							uint32 sampleCount = var->Value[5];
-
-							if (var->Type == SceneVariableType::RenderTarget)
-							{
-								PixelFormat fmt = static_cast<PixelFormat>(var->Value[4]);
-
-								RenderTarget* rt;
-								if (sampleCount != 0)
-								{
-									const String* profile = m_renderDevice->getCapabilities()->FindClosesetMultisampleMode(sampleCount, fmt, DEPFMT_Count);
-									assert(profile);
-
-									rt = factory->CreateRenderTarget(width, height, fmt, *profile);
-								}
-								else
-								{
-									rt = factory->CreateRenderTarget(width, height, fmt, L"");
-								}
-
-								if (usePercentageLock)
-								{
-									rt->SetPercentageLock(wscale, hscale);
-								}
-
-								var->RTValue = rt;
-								m_createdRenderTarget.Add(rt);
-							}
-							else if (var->Type == SceneVariableType::DepthStencil)
-							{
-								DepthFormat fmt = static_cast<DepthFormat>(var->Value[4]);
-
-								DepthStencilBuffer* dsb;
-								if (sampleCount != 0)
-								{
-									const String* profile = m_renderDevice->getCapabilities()->FindClosesetMultisampleMode(sampleCount, FMT_Count, fmt);
-									assert(profile);
-
-									dsb = factory->CreateDepthStencilBuffer(width, height, fmt, *profile);
-								}
-								else
-								{
-									dsb = factory->CreateDepthStencilBuffer(width, height, fmt, L"");
-								}
-
-								if (usePercentageLock)
-								{
-									dsb->SetPercentageLock(wscale, hscale);
-								}
-
-								var->DSValue = dsb;
-								m_createDepthStencil.Add(dsb);
-							}
-							break;
-						}
-
 							////VARTYPE_Matrix,
 							////VARTYPE_Vector4,
 							//VARTYPE_Vector3,
@@ -281,6 +211,10 @@ namespace Apoc3D
 							//VARTYPE_Effect
 					}
 				}
+
+				m_passData = parser.PassData;
+				m_graph.Compile(m_passData, m_variables);
+				AllocateTargets();
 			}
 		}
 
@@ -288,15 +222,54 @@ namespace Apoc3D
 		{
 			CheckDimensions();
 
+			PrepareViews(cameras, sceMgr, batchData);
+
 			m_lastCamera = 0;
-			// pass each scene pass
-			for (ScenePass* pass : m_passes)
+			// pass each live scene pass
+			const List<int32>& livePasses = m_graph.getLivePasses();
+			for (int32 i = 0; i < livePasses.getCount(); i++)
 			{
-				pass->Invoke(cameras, sceMgr, batchData);
+				ScenePass* pass = m_passes[livePasses[i]];
+				pass->Invoke(cameras, m_viewBatchData[m_passViews[i]]);
 				m_lastCamera = pass->getCurrentCamera();
 			}
 		}
 
+		void SceneProcedure::PrepareViews(const List<Camera*>& cameras, SceneManager* sceMgr, BatchData* batchData)
+		{
+			m_viewCameras.Clear();
+			m_viewBatchData.Clear();
+			m_passViews.Clear();
+
+			for (int32 i : m_graph.getLivePasses())
+			{
+				Camera* camera = m_passes[i]->SelectCamera(cameras);
+
+				int32 view = m_viewCameras.IndexOf(camera);
+				if (view == -1)
+				{
+					view = m_viewCameras.getCount();
+
+					BatchData* data = view == 0 ? batchData : m_renderer->getViewBatchData(view);
+					data->Clear();
+					const Matrix& invView = camera->getInvViewMatrix();
+					data->setViewPosition(Vector3(invView.M41, invView.M42, invView.M43));
+
+					m_viewCameras.Add(camera);
+					m_viewBatchData.Add(data);
+				}
+				m_passViews.Add(view);
+			}
+
+			// every camera in the script is culled in one go, instead of again each time a pass switches camera
+			const int32 viewCount = m_viewCameras.getCount();
+			for (int32 start = 0; start < viewCount; start += SceneManager::MaxViews)
+			{
+				sceMgr->PrepareVisibleObjects(m_viewCameras.getElements() + start, m_viewBatchData.getElements() + start,
+					Math::Min(SceneManager::MaxViews, viewCount - start));
+			}
+		}
+
 		void SceneProcedure::CheckDimensions()
 		{
 			Viewport vp = m_renderDevice->getViewport();
@@ -315,24 +288,194 @@ namespace Apoc3D
 			}
 		}
 
-		RenderTarget* SceneProcedure::FindRenderTargetVar(const String& name) const
+		void SceneProcedure::AllocateTargets()
+		{
+			for (int32 i = 0; i < m_graph.getSlotCount(); i++)
+			{
+				const SceneVariable* desc = m_graph.getSlotVariable(i);
+
+				if (desc->Type == SceneVariableType::RenderTarget)
+					m_createdRenderTarget.Add(CreateRenderTarget(desc));
+				else
+					m_createDepthStencil.Add(CreateDepthStencil(desc));
+			}
+
+			// variables in the same slot share the buffer
+			int32 rtIndex = 0;
+			int32 dsIndex = 0;
+			List<int32> slotBuffers(m_graph.getSlotCount());
+			for (int32 i = 0; i < m_graph.getSlotCount(); i++)
+			{
+				if (m_graph.getSlotVariable(i)->Type == SceneVariableType::RenderTarget)
+					slotBuffers.Add(rtIndex++);
+				else
+					slotBuffers.Add(dsIndex++);
+			}
+
+			for (SceneVariable* var : m_variables)
+			{
+				if (m_graph.isExternal(var))
+					continue;
+
+				int32 slot = m_graph.getSlot(var);
+				if (var->Type == SceneVariableType::RenderTarget)
+					var->RTValue = slot != SceneRenderGraph::NoSlot ? m_createdRenderTarget[slotBuffers[slot]] : nullptr;
+				else if (var->Type == SceneVariableType::DepthStencil)
+					var->DSValue = slot != SceneRenderGraph::NoSlot ? m_createDepthStencil[slotBuffers[slot]] : nullptr;
+			}
+		}
+
+		void SceneProcedure::ReleaseTargets()
+		{
+			for (SceneVariable* var : m_variables)
+			{
+				if (!m_graph.isExternal(var))
+				{
+					var->RTValue = nullptr;
+					var->DSValue = nullptr;
+				}
+			}
+
+			m_createdRenderTarget.DeleteAndClear();
+			m_createDepthStencil.DeleteAndClear();
+		}
+
+		void SceneProcedure::MakeExternal(SceneVariable* var)
+		{
+			if (!m_graph.MarkExternal(var))
+				return;
+
+			if (var->Type == SceneVariableType::RenderTarget)
+			{
+				var->RTValue = CreateRenderTarget(var);
+				m_externalRenderTargets.Add(var->RTValue);
+			}
+			else if (var->Type == SceneVariableType::DepthStencil)
+			{
+				var->DSValue = CreateDepthStencil(var);
+				m_externalDepthStencils.Add(var->DSValue);
+			}
+
+			// the passes writing it may have been culled, and the slots change with them
+			ReleaseTargets();
+			m_graph.Compile(m_passData, m_variables);
+			AllocateTargets();
+		}
+
+		/** Gets the size of a render target or depth stencil buffer variable, and its size relative to the viewport if it has one. */
+		static void GetTargetSize(RenderDevice* device, const SceneVariable* desc, uint& width, uint& height, 
+			bool& usePercentageLock, float& wscale, float& hscale)
+		{
+			width = desc->Value[0];
+			height = desc->Value[1];
+			usePercentageLock = false;
+
+			if (!width || !height)
+			{
+				wscale = reinterpret_cast<const float&>(desc->Value[2]);
+				hscale = reinterpret_cast<const float&>(desc->Value[3]);
+
+				Viewport vp = device->getViewport();
+				width = static_cast<uint>(vp.Width * wscale + 0.5f);
+				height = static_cast<uint>(vp.Height * hscale + 0.5f);
+				usePercentageLock = true;
+			}
+		}
+
+		RenderTarget* SceneProcedure::CreateRenderTarget(const SceneVariable* desc)
+		{
+			ObjectFactory* factory = m_renderDevice->getObjectFactory();
+
+			uint width, height;
+			bool usePercentageLock;
+			float wscale, hscale;
+			GetTargetSize(m_renderDevice, desc, width, height, usePercentageLock, wscale, hscale);
+
+			uint32 sampleCount = desc->Value[5];
+			PixelFormat fmt = static_cast<PixelFormat>(desc->Value[4]);
+
+			RenderTarget* rt;
+			if (sampleCount != 0)
+			{
+				const String* profile = m_renderDevice->getCapabilities()->FindClosesetMultisampleMode(sampleCount, fmt, DEPFMT_Count);
+				assert(profile);
+
+				rt = factory->CreateRenderTarget(width, height, fmt, *profile);
+			}
+			else
+			{
+				rt = factory->CreateRenderTarget(width, height, fmt, L"");
+			}
+
+			if (usePercentageLock)
+			{
+				rt->SetPercentageLock(wscale, hscale);
+			}
+			return rt;
+		}
+
+		DepthStencilBuffer* SceneProcedure::CreateDepthStencil(const SceneVariable* desc)
+		{
+			ObjectFactory* factory = m_renderDevice->getObjectFactory();
+
+			uint width, height;
+			bool usePercentageLock;
+			float wscale, hscale;
+			GetTargetSize(m_renderDevice, desc, width, height, usePercentageLock, wscale, hscale);
+
+			uint32 sampleCount = desc->Value[5];
+			DepthFormat fmt = static_cast<DepthFormat>(desc->Value[4]);
+
+			DepthStencilBuffer* dsb;
+			if (sampleCount != 0)
+			{
+				const String* profile = m_renderDevice->getCapabilities()->FindClosesetMultisampleMode(sampleCount, FMT_Count, fmt);
+				assert(profile);
+
+				dsb = factory->CreateDepthStencilBuffer(width, height, fmt, *profile);
+			}
+			else
+			{
+				dsb = factory->CreateDepthStencilBuffer(width, height, fmt, L"");
+			}
+
+			if (usePercentageLock)
+			{
+				dsb->SetPercentageLock(wscale, hscale);
+			}
+			return dsb;
+		}
+
+		RenderTarget* SceneProcedure::FindRenderTargetVar(const String& name)
 		{
 			if (!m_isAvailable)
 				return nullptr;
 
 			for (SceneVariable* var : m_variables)
+			{
 				if (var->Name == name)
+				{
+					if (var->Type == SceneVariableType::RenderTarget)
+						MakeExternal(var);
 					return var->RTValue;
+				}
+			}
 			return nullptr;
 		}
-		DepthStencilBuffer* SceneProcedure::FindDepthStencilVar(const String& name) const
+		DepthStencilBuffer* SceneProcedure::FindDepthStencilVar(const String& name)
 		{
 			if (!m_isAvailable)
 				return nullptr;
 
 			for (SceneVariable* var : m_variables)
+			{
 				if (var->Name == name)
+				{
+					if (var->Type == SceneVariableType::DepthStencil)
+						MakeExternal(var);
 					return var->DSValue;
+				}
+			}
 			return nullptr;
 		}
 
@@ -355,7 +498,7 @@ namespace Apoc3D
 				if (var->Name == name)
 				{
 					assert(var->Type == SceneVariableType::Boolean);
-					var->Value[0] = val ? 1 : 0;
+					var->SetValue(val ? 1 : 0, var->Value[1]);
 					break;
 				}
 			}
@@ -367,7 +510,11 @@ namespace Apoc3D
 				if (var->Name == name)
 				{
 					assert(var->Type == SceneVariableType::Vector4);
-					memcpy(var->Value, &val, sizeof(float) * 4);
+					if (memcmp(var->Value, &val, sizeof(float) * 4))
+					{
+						memcpy(var->Value, &val, sizeof(float) * 4);
+						var->Version++;
+					}
 					break;
 				}
 			}
@@ -379,7 +526,11 @@ namespace Apoc3D
 				if (var->Name == name)
 				{
 					assert(var->Type == SceneVariableType::Vector2);
-					memcpy(var->Value, &val, sizeof(float) * 2);
+					if (memcmp(var->Value, &val, sizeof(float) * 2))
+					{
+						memcpy(var->Value, &val, sizeof(float) * 2);
+						var->Version++;
+					}
 					break;
 				}
 			}
@@ -391,7 +542,7 @@ namespace Apoc3D
 				if (var->Name == name)
 				{
 					assert(var->Type == SceneVariableType::Single);
-					*reinterpret_cast<float*>(var->Value) = val;
+					var->SetValue(reinterpret_cast<const uint&>(val), var->Value[1]);
 					break;
 				}
 			}
@@ -19,6 +19,7 @@
  */
 
 #include "ScenePassTypes.h"
+#include "SceneRenderGraph.h"
 
 #include "apoc3d/Math/Vector.h"
 
@@ -75,7 +76,9 @@ namespace Apoc3D
 		 *
 		 *   Immediate Value Types
 		 *
-		 *
+		 *   The passes are put in a SceneRenderGraph when loaded. Only the live passes
+		 *   are invoked, and transient render targets and depth stencil buffers of the
+		 *   same description share buffers.
 		 */
 		class APAPI SceneProcedure
 		{
@@ -91,7 +94,7 @@ namespace Apoc3D
 
 			void Load(SceneRenderer* renderer, const ResourceLocation& rl);
 
-			/** Execute the procedure, respectively invoking a series of Scene Passes. */
+			/** Execute the procedure, respectively invoking the live Scene Passes. */
 			void Invoke(const List<Camera*> cameras, SceneManager* sceMgr, BatchData* batchData);
 			
 			/**
@@ -103,12 +106,16 @@ namespace Apoc3D
 			ScenePass* getPass(int32 index) const { return m_passes[index]; }
 			int32 getPassCount() const { return m_passes.getCount(); }
 			
+			const SceneRenderGraph& getRenderGraph() const { return m_graph; }
+
 			/**
 			 *  Find a variable define in the procedure script by name; 
 			 *  then returns as a RenderTarget.
+			 *  The first time a variable is found this way, it is made external so it keeps 
+			 *  its own buffer and the passes writing it are not culled.
 			 */
-			RenderTarget* FindRenderTargetVar(const String& name) const;
-			DepthStencilBuffer* FindDepthStencilVar(const String& name) const;
+			RenderTarget* FindRenderTargetVar(const String& name);
+			DepthStencilBuffer* FindDepthStencilVar(const String& name);
 
 			void SetTextureVar(const String& name, ResourceHandle<Texture>* tex);
 			void SetBooleanVar(const String& name, bool val);
@@ -125,14 +132,31 @@ namespace Apoc3D
 				float HeightPercentage;
 			};
 			void CheckDimensions();
+			/** Culls the views of all the cameras used by the live passes, and picks each pass' batch data. */
+			void PrepareViews(const List<Camera*>& cameras, SceneManager* sceMgr, BatchData* batchData);
+
+			void AllocateTargets();
+			void ReleaseTargets();
+			void MakeExternal(SceneVariable* var);
+
+			RenderTarget* CreateRenderTarget(const SceneVariable* desc);
+			DepthStencilBuffer* CreateDepthStencil(const SceneVariable* desc);
 
 			RenderDevice* m_renderDevice;
+			SceneRenderer* m_renderer = nullptr;
 
 			List<ScenePass*> m_passes;
+			List<ScenePassData> m_passData;
 			List<SceneVariable*> m_variables;
 
+			SceneRenderGraph m_graph;
+
+			/** One for each slot of the graph. */
 			List<RenderTarget*> m_createdRenderTarget;
 			List<DepthStencilBuffer*> m_createDepthStencil;
+			/** The ones of external variables, which stay the same when the slots are allocated again. */
+			List<RenderTarget*> m_externalRenderTargets;
+			List<DepthStencilBuffer*> m_externalDepthStencils;
 			List<ResourceHandle<Texture>*> m_createdTextures;
 			List<ProcGaussBlurFilter> m_createdGaussFilters;
 
@@ -140,6 +164,12 @@ namespace Apoc3D
 			String m_name;
 
 			const Camera* m_lastCamera;
+
+			/** The cameras used in the current frame, each with the batch data its visible objects go to. */
+			List<Camera*> m_viewCameras;
+			List<BatchData*> m_viewBatchData;
+			/** The view of each live pass, in the order of SceneRenderGraph::getLivePasses. */
+			List<int32> m_passViews;
 		};
 	};
 };
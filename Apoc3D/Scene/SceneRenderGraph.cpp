@@ -0,0 +1,424 @@
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "SceneRenderGraph.h"
+
+#include <algorithm>
+
+namespace Apoc3D
+{
+	namespace Scene
+	{
+		/** Whether a Clear argument clears never, always, or depending on a variable */
+		enum ClearState
+		{
+			CS_Never,
+			CS_Always,
+			CS_Maybe
+		};
+
+		static ClearState GetClearState(const SceneOpArg& arg)
+		{
+			if (!arg.IsImmediate)
+				return CS_Maybe;
+			return arg.DefaultValue[0] ? CS_Always : CS_Never;
+		}
+
+		static bool IsSameDescription(const SceneVariable* a, const SceneVariable* b)
+		{
+			// size, size percentages, format and sample count
+			return a->Type == b->Type && memcmp(a->Value, b->Value, sizeof(uint) * 6) == 0;
+		}
+
+		void SceneRenderGraph::Compile(const List<ScenePassData>& passes, const List<SceneVariable*>& vars)
+		{
+			m_passes.Clear();
+			m_resources.Clear();
+			m_livePasses.Clear();
+			m_slots.Clear();
+
+			m_backBuffer = vars.getCount();
+			m_defaultDepth = m_backBuffer + 1;
+			m_bindings = m_defaultDepth + 1;
+
+			m_passes.ReserveDiscard(passes.getCount());
+			m_resources.ReserveDiscard(m_bindings + BindingCount);
+
+			for (int32 i = 0; i < vars.getCount(); i++)
+				m_resources[i].Var = vars[i];
+
+			// What each binding may hold as the passes run one after another. A frame starts with the defaults.
+			List<int32> bound[BindingCount];
+			bound[0].Add(m_backBuffer);
+			bound[DepthBinding].Add(m_defaultDepth);
+
+			for (int32 i = 0; i < passes.getCount(); i++)
+			{
+				AnalyzePass(i, passes[i], bound);
+			}
+
+			CullPasses();
+			AssignSlots();
+		}
+
+		bool SceneRenderGraph::MarkExternal(const SceneVariable* var)
+		{
+			if (isExternal(var))
+				return false;
+
+			m_externals.Add(var);
+			return true;
+		}
+
+		int32 SceneRenderGraph::getSlot(const SceneVariable* var) const
+		{
+			int32 idx = FindResource(var);
+			return idx != -1 ? m_resources[idx].Slot : NoSlot;
+		}
+
+		void SceneRenderGraph::AnalyzePass(int32 passIndex, const ScenePassData& data, List<int32>* bound)
+		{
+			const List<SceneInstruction>& insts = data.Instructions;
+
+			// instructions skipped by a jump may not run
+			List<bool> conditional;
+			conditional.ReserveDiscard(insts.getCount());
+			for (int32 i = 0; i < insts.getCount(); i++)
+				conditional[i] = false;
+
+			for (int32 i = 0; i < insts.getCount(); i++)
+			{
+				const SceneInstruction& inst = insts[i];
+				if (inst.Operation == SOP_JZ || inst.Operation == SOP_JNZ)
+				{
+					for (int32 j = i + 1; j < inst.Next && j < insts.getCount(); j++)
+						conditional[j] = true;
+				}
+			}
+
+			// bindings surely set in this pass. Draws use the ones from earlier passes for the rest.
+			bool boundInPass[BindingCount] = { };
+
+			auto bind = [&](int32 index, int32 target, bool cond)
+			{
+				Access(passIndex, m_bindings + index, ACC_Write, cond);
+				if (target != -1)
+					Access(passIndex, target, ACC_Touch, cond);
+
+				if (!cond)
+				{
+					bound[index].Clear();
+					boundInPass[index] = true;
+				}
+				if (target != -1 && bound[index].IndexOf(target) == -1)
+					bound[index].Add(target);
+			};
+
+			for (int32 i = 0; i < insts.getCount(); i++)
+			{
+				const SceneInstruction& inst = insts[i];
+				const bool cond = conditional[i];
+
+				switch (inst.Operation)
+				{
+					case SOP_Load:
+						AccessArg(passIndex, inst.Args[0], ACC_Read, cond);
+						break;
+					case SOP_Pop:
+						if (inst.Args.getCount() > 0)
+							AccessArg(passIndex, inst.Args[0], ACC_Write, cond);
+						break;
+					case SOP_VisibleTo:
+						AccessArg(passIndex, inst.Args[0], ACC_Read, cond);
+						AccessArg(passIndex, inst.Args[1], ACC_Write, cond);
+						break;
+
+					case SOP_UseRT:
+					{
+						const SceneOpArg& indexArg = inst.Args[0];
+						AccessArg(passIndex, indexArg, ACC_Read, cond);
+
+						int32 target = inst.Args[1].IsImmediate ? -1 : FindResource(inst.Args[1].Var);
+
+						if (indexArg.IsImmediate)
+						{
+							int32 index = reinterpret_cast<const int32&>(indexArg.DefaultValue[0]);
+							if (index >= 0 && index < DepthBinding)
+							{
+								// setting null to the first one restores the back buffer
+								bind(index, (target == -1 && index == 0) ? m_backBuffer : target, cond);
+							}
+						}
+						else
+						{
+							for (int32 j = 0; j < DepthBinding; j++)
+								bind(j, target, true);
+						}
+						break;
+					}
+					case SOP_UseDS:
+					{
+						int32 target = inst.Args[0].IsImmediate ? m_defaultDepth : FindResource(inst.Args[0].Var);
+						bind(DepthBinding, target, cond);
+						break;
+					}
+
+					case SOP_Clear:
+					{
+						for (const SceneOpArg& arg : inst.Args)
+							AccessArg(passIndex, arg, ACC_Read, cond);
+
+						ClearState color = GetClearState(inst.Args[0]);
+						ClearState depth = GetClearState(inst.Args[1]);
+						ClearState stencil = GetClearState(inst.Args[2]);
+
+						uint32 colorFlags = color != CS_Never ? ACC_Write : 0;
+						uint32 depthFlags = depth != CS_Never ? ACC_Write : 0;
+						if (stencil != CS_Never && depth != CS_Always)
+						{
+							// clearing the stencil alone keeps the depth
+							depthFlags |= ACC_Read | ACC_Write;
+						}
+
+						Draw(passIndex, bound, boundInPass, colorFlags, depthFlags, cond || color != CS_Always, cond || depth != CS_Always);
+						break;
+					}
+					case SOP_Render:
+						Draw(passIndex, bound, boundInPass, ACC_Read | ACC_Write, ACC_Read | ACC_Write, cond, cond);
+						break;
+					case SOP_RenderQuad:
+					{
+						for (int32 j = 2; j < inst.Args.getCount(); j++)
+						{
+							const SceneOpArg& arg = inst.Args[j];
+
+							// properties like Width do not need the content
+							bool propertyOnly = !arg.IsImmediate && arg.Var->Type == SceneVariableType::RenderTarget && arg.StrData.size();
+							AccessArg(passIndex, arg, propertyOnly ? ACC_Touch : ACC_Read, cond);
+						}
+
+						Draw(passIndex, bound, boundInPass, ACC_Read | ACC_Write, ACC_Read | ACC_Write, cond, cond);
+						break;
+					}
+				}
+			}
+		}
+
+		void SceneRenderGraph::Draw(int32 passIndex, const List<int32>* bound, const bool* boundInPass,
+			uint32 colorFlags, uint32 depthFlags, bool colorConditional, bool depthConditional)
+		{
+			if (colorFlags == 0 && depthFlags == 0)
+				return;
+
+			for (int32 i = 0; i < BindingCount; i++)
+			{
+				uint32 flags = i == DepthBinding ? depthFlags : colorFlags;
+				bool cond = i == DepthBinding ? depthConditional : colorConditional;
+
+				if (flags == 0)
+					continue;
+
+				if (!boundInPass[i])
+					Access(passIndex, m_bindings + i, ACC_Read, cond);
+
+				for (int32 target : bound[i])
+					Access(passIndex, target, flags, cond);
+			}
+		}
+
+		void SceneRenderGraph::Access(int32 passIndex, int32 resource, uint32 flags, bool conditional)
+		{
+			if (resource == -1)
+				return;
+
+			ResourceInfo& res = m_resources[resource];
+			PassInfo& pass = m_passes[passIndex];
+
+			if (flags & ACC_Read)
+			{
+				// Variables read before written in a frame get the content of the last frame.
+				// The back buffer and default depth stencil buffer are left to the application.
+				if (resource < m_backBuffer && !res.WrittenInFrame)
+					res.Persistent = true;
+
+				if (pass.Reads.IndexOf(resource) == -1)
+					pass.Reads.Add(resource);
+			}
+			if (flags & ACC_Write)
+			{
+				if (!conditional)
+					res.WrittenInFrame = true;
+
+				if (pass.Writes.IndexOf(resource) == -1)
+					pass.Writes.Add(resource);
+			}
+			if (flags & ACC_Touch)
+			{
+				if (pass.Touches.IndexOf(resource) == -1)
+					pass.Touches.Add(resource);
+			}
+		}
+
+		void SceneRenderGraph::AccessArg(int32 passIndex, const SceneOpArg& arg, uint32 flags, bool conditional)
+		{
+			if (arg.IsImmediate || arg.Var == nullptr)
+				return;
+
+			int32 idx = FindResource(arg.Var);
+			if (idx == -1)
+				return;
+
+			if (flags & ACC_Read)
+				m_resources[idx].ReadInScript = true;
+
+			Access(passIndex, idx, flags, conditional);
+		}
+
+		void SceneRenderGraph::CullPasses()
+		{
+			for (int32 i = 0; i < m_resources.getCount(); i++)
+				m_resources[i].Needed = IsOutput(i);
+
+			// a pass is live if it writes something needed, then what it reads is needed by earlier passes
+			for (int32 i = m_passes.getCount() - 1; i >= 0; i--)
+			{
+				PassInfo& pass = m_passes[i];
+
+				pass.Live = false;
+				for (int32 w : pass.Writes)
+				{
+					if (m_resources[w].Needed)
+					{
+						pass.Live = true;
+						break;
+					}
+				}
+
+				if (pass.Live)
+				{
+					for (int32 r : pass.Reads)
+						m_resources[r].Needed = true;
+				}
+			}
+
+			for (int32 i = 0; i < m_passes.getCount(); i++)
+			{
+				if (m_passes[i].Live)
+					m_livePasses.Add(i);
+			}
+		}
+
+		void SceneRenderGraph::AssignSlots()
+		{
+			for (int32 passIndex : m_livePasses)
+			{
+				const PassInfo& pass = m_passes[passIndex];
+				const List<int32>* accessLists[] = { &pass.Reads, &pass.Writes, &pass.Touches };
+
+				for (const List<int32>* lst : accessLists)
+				{
+					for (int32 r : *lst)
+					{
+						ResourceInfo& res = m_resources[r];
+						if (res.FirstPass == -1)
+							res.FirstPass = passIndex;
+						res.LastPass = passIndex;
+					}
+				}
+			}
+
+			List<int32> targets;
+			for (int32 i = 0; i < m_backBuffer; i++)
+			{
+				const ResourceInfo& res = m_resources[i];
+				if (IsTarget(i) && res.FirstPass != -1 && !isExternal(res.Var))
+					targets.Add(i);
+			}
+
+			std::stable_sort(targets.begin(), targets.end(),
+				[this](int32 a, int32 b) { return m_resources[a].FirstPass < m_resources[b].FirstPass; });
+
+			// greedy interval allocation, each target goes to the first compatible slot free by then
+			List<int32> slotLastPass;
+			List<bool> slotShared;
+
+			for (int32 r : targets)
+			{
+				ResourceInfo& res = m_resources[r];
+				bool transient = !IsOutput(r);
+
+				int32 slot = NoSlot;
+				if (transient)
+				{
+					for (int32 i = 0; i < m_slots.getCount(); i++)
+					{
+						if (slotShared[i] && slotLastPass[i] < res.FirstPass &&
+							IsSameDescription(m_resources[m_slots[i]].Var, res.Var))
+						{
+							slot = i;
+							break;
+						}
+					}
+				}
+
+				if (slot == NoSlot)
+				{
+					slot = m_slots.getCount();
+					m_slots.Add(r);
+					slotLastPass.Add(-1);
+					slotShared.Add(transient);
+				}
+
+				slotLastPass[slot] = res.LastPass;
+				res.Slot = slot;
+			}
+		}
+
+		int32 SceneRenderGraph::FindResource(const SceneVariable* var) const
+		{
+			for (int32 i = 0; i < m_backBuffer; i++)
+			{
+				if (m_resources[i].Var == var)
+					return i;
+			}
+			return -1;
+		}
+
+		bool SceneRenderGraph::IsOutput(int32 resource) const
+		{
+			if (resource == m_backBuffer)
+				return true;
+			if (resource > m_backBuffer)
+				return false;
+
+			const ResourceInfo& res = m_resources[resource];
+			if (res.Persistent || isExternal(res.Var))
+				return true;
+
+			// render targets nothing in the script reads are there for the code using the procedure
+			return res.Var->Type == SceneVariableType::RenderTarget && !res.ReadInScript;
+		}
+
+		bool SceneRenderGraph::IsTarget(int32 resource) const
+		{
+			if (resource >= m_backBuffer)
+				return false;
+
+			SceneVariableType type = m_resources[resource].Var->Type;
+			return type == SceneVariableType::RenderTarget || type == SceneVariableType::DepthStencil;
+		}
+	}
+}
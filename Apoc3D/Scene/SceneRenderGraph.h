@@ -0,0 +1,144 @@
+#pragma once
+#ifndef APOC3D_SCENE_RENDERGRAPH_H
+#define APOC3D_SCENE_RENDERGRAPH_H
+
+/* -----------------------------------------------------------------------
+ * This source file is part of Apoc3D Framework
+ *
+ * Copyright (c) 2009-2018 Tao Xin
+ *
+ * This content of this file is subject to the terms of the Mozilla Public
+ * License v2.0. If a copy of the MPL was not distributed with this file,
+ * you can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * WITHOUT WARRANTY OF ANY KIND; either express or implied. See the
+ * Mozilla Public License for more details.
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "ScenePassTypes.h"
+
+using namespace Apoc3D::Collections;
+
+namespace Apoc3D
+{
+	namespace Scene
+	{
+		/**
+		 *  The dependencies between the passes of a scene render script, worked out once
+		 *  when the script is loaded.
+		 *
+		 *  Passes only talk to each other through the script's variables: render targets
+		 *  and depth stencil buffers drawn to after UseRT/UseDS and read by RenderQuad, and
+		 *  values written by VisibleTo or expression statements and tested in conditions.
+		 *  Branches are not followed, so everything a pass may do is taken into account.
+		 *
+		 *  A pass is live if it draws to the back buffer, or writes something a later live
+		 *  pass reads, or writes an output. The other passes are culled. Outputs are render
+		 *  targets no pass reads, which are only there for code to get with
+		 *  SceneProcedure::FindRenderTargetVar, those marked external, and ones read before
+		 *  being written in a frame, which carry their content to the next frame.
+		 *
+		 *  The other render targets and depth stencil buffers are transient. They are put in
+		 *  slots that share one buffer, when they have the same description and are used by
+		 *  disjoint ranges of live passes.
+		 */
+		class APAPI SceneRenderGraph
+		{
+		public:
+			static const int32 NoSlot = -1;
+
+			/**
+			 *  Builds the graph. The variables marked external before are kept as external.
+			 *  @param vars The variables the instructions refer to.
+			 */
+			void Compile(const List<ScenePassData>& passes, const List<SceneVariable*>& vars);
+
+			/**
+			 *  Keeps a render target or depth stencil buffer out of the slots and treats it as an output.
+			 *  Compile needs to be called again after this.
+			 *  @return false if it is already external.
+			 */
+			bool MarkExternal(const SceneVariable* var);
+			bool isExternal(const SceneVariable* var) const { return m_externals.IndexOf(var) != -1; }
+
+			/** The indices of the passes to run, in order. */
+			const List<int32>& getLivePasses() const { return m_livePasses; }
+			bool isPassLive(int32 index) const { return m_passes[index].Live; }
+
+			/**
+			 *  Gets the slot of a transient or output render target or depth stencil buffer.
+			 *  Variables used by no live pass, and external ones, return NoSlot.
+			 */
+			int32 getSlot(const SceneVariable* var) const;
+			int32 getSlotCount() const { return m_slots.getCount(); }
+			/** Gets the variable whose description the slot's buffer is created with. */
+			const SceneVariable* getSlotVariable(int32 slot) const { return m_resources[m_slots[slot]].Var; }
+
+		private:
+			enum AccessFlags
+			{
+				ACC_Read = 1 << 0,
+				ACC_Write = 1 << 1,
+				/** Only the object is used, like its size. The content is not needed. */
+				ACC_Touch = 1 << 2
+			};
+
+			struct PassInfo
+			{
+				List<int32> Reads;
+				List<int32> Writes;
+				List<int32> Touches;
+				bool Live = false;
+			};
+
+			struct ResourceInfo
+			{
+				SceneVariable* Var = nullptr;
+
+				bool ReadInScript = false;
+				bool WrittenInFrame = false;
+				bool Persistent = false;
+				bool Needed = false;
+
+				int32 FirstPass = -1;
+				int32 LastPass = -1;
+				int32 Slot = NoSlot;
+			};
+
+			/** Render target binding indices tracked, plus one for the depth stencil buffer. */
+			static const int32 BindingCount = 5;
+			static const int32 DepthBinding = BindingCount - 1;
+
+			void AnalyzePass(int32 passIndex, const ScenePassData& data, List<int32>* bound);
+			void Access(int32 passIndex, int32 resource, uint32 flags, bool conditional);
+			void AccessArg(int32 passIndex, const SceneOpArg& arg, uint32 flags, bool conditional);
+			void Draw(int32 passIndex, const List<int32>* bound, const bool* boundInPass, 
+				uint32 colorFlags, uint32 depthFlags, bool colorConditional, bool depthConditional);
+
+			void CullPasses();
+			void AssignSlots();
+
+			int32 FindResource(const SceneVariable* var) const;
+			bool IsOutput(int32 resource) const;
+			bool IsTarget(int32 resource) const;
+
+			List<PassInfo> m_passes;
+			/** One for each variable, followed by the back buffer, the default depth stencil buffer and the bindings. */
+			List<ResourceInfo> m_resources;
+			int32 m_backBuffer = 0;
+			int32 m_defaultDepth = 0;
+			int32 m_bindings = 0;
+
+			List<int32> m_livePasses;
+			/** The resource each slot is described by. */
+			List<int32> m_slots;
+
+			List<const SceneVariable*> m_externals;
+		};
+	}
+}
+
+#endif
@@ -199,6 +199,12 @@ namespace Apoc3D
 			else
 				selectorMask = (uint64)1<<selectorID;
 
+			if (m_mode == BatchQueueMode::SortedKeys)
+			{
+				RenderKeyed(device, selectorMask, selectorID);
+				return;
+			}
+
 			BatchDataBufferCache::InvalidGeoPointerList& invalidGeoPointers = *m_bufferCache.getInvalidGeoPointerBuffer();
 			BatchDataBufferCache::InvalidMtrlPointerList& invalidMtrlPointers = *m_bufferCache.getInvalidMtrlPointerBuffer();
 
@@ -312,31 +318,10 @@ namespace Apoc3D
 							op.RootTransform = temp;
 						}
 
-						uint priority = Math::Min(mtrl->getPriority(), MaxPriority - 1);
-
-						// add the rop from outer table to inner table(top down)
-						MaterialTable* mtrlTable;
-						if (!m_priTable.TryGetValue(priority, mtrlTable))
-						{
-							mtrlTable = m_bufferCache.ObtainNewMaterialTable();
-							m_priTable.Add(priority, mtrlTable);
-						}
-
-						GeometryTable* geoTable;
-						if (!mtrlTable->TryGetValue(mtrl, geoTable))
-						{
-							geoTable = m_bufferCache.ObtainNewGeometryTable();
-							mtrlTable->Add(mtrl, geoTable);
-						}
-
-						OperationList* opList;
-						if (!geoTable->TryGetValue(geoData, opList))
-						{
-							opList = m_bufferCache.ObtainNewOperationList();
-							geoTable->Add(geoData, opList);
-						}
-
-						opList->Add(op);
+						if (m_mode == BatchQueueMode::SortedKeys)
+							AddKeyedOperation(op);
+						else
+							AddTableOperation(op);
 					}
 				}
 			}
@@ -344,39 +329,206 @@ namespace Apoc3D
 		
 		void BatchData::AddRenderOperation(const RenderOperationBuffer& ops)
 		{
-			for (RenderOperation op : ops)
+			for (const RenderOperation& op : ops)
+			{
+				if (op.Material && op.GeometryData)
+				{
+					if (m_mode == BatchQueueMode::SortedKeys)
+						AddKeyedOperation(op);
+					else
+						AddTableOperation(op);
+				}
+			}
+		}
+
+		void BatchData::AddTableOperation(const RenderOperation& op)
+		{
+			Material* mtrl = op.Material;
+			GeometryData* geoData = op.GeometryData;
+
+			uint priority = Math::Min(mtrl->getPriority(), MaxPriority - 1);
+
+			// add the rop from outer table to inner table(top down)
+			MaterialTable* mtrlTable;
+			if (!m_priTable.TryGetValue(priority, mtrlTable))
+			{
+				mtrlTable = m_bufferCache.ObtainNewMaterialTable();
+				m_priTable.Add(priority, mtrlTable);
+			}
+
+			GeometryTable* geoTable;
+			if (!mtrlTable->TryGetValue(mtrl, geoTable))
+			{
+				geoTable = m_bufferCache.ObtainNewGeometryTable();
+				mtrlTable->Add(mtrl, geoTable);
+			}
+
+			OperationList* opList;
+			if (!geoTable->TryGetValue(geoData, opList))
+			{
+				opList = m_bufferCache.ObtainNewOperationList();
+				geoTable->Add(geoData, opList);
+			}
+
+			opList->Add(op);
+		}
+
+		void BatchData::AddKeyedOperation(const RenderOperation& op)
+		{
+			Material* mtrl = op.Material;
+			uint32 priority = Math::Min(mtrl->getPriority(), MaxPriority - 1);
+
+			DrawKey dk;
+			dk.Key = MakeDrawKey(op, priority);
+			dk.Index = m_keyedOps.getCount();
+
+			m_keyedOps.Add(op);
+			m_keys.Add(dk);
+
+			m_keysSorted = false;
+			m_keyedPassFlags |= mtrl->getPassFlags();
+		}
+
+		/**
+		 *  Opaque:      priority(5) | 0 | material(20) | geometry(20) | depth(18)
+		 *  Transparent: priority(5) | 1 | far-to-near depth(18) | material(20) | geometry(20)
+		 */
+		uint64 BatchData::MakeDrawKey(const RenderOperation& op, uint32 priority) const
+		{
+			const int32 DepthBits = 18;
+			const uint64 DepthMask = (1ULL << DepthBits) - 1;
+			const uint64 IDMask = (1ULL << 20) - 1;
+
+			Vector3 pos(op.RootTransform.M41, op.RootTransform.M42, op.RootTransform.M43);
+			float distSq = Vector3::DistanceSquared(pos, m_viewPos);
+
+			// bits of non-negative floats are ordered the same way as their values
+			uint64 depth = reinterpret_cast<const uint32&>(distSq) >> (32 - DepthBits);
+			uint64 mtrlID = op.Material->getBatchID() & IDMask;
+			uint64 geoID = op.GeometryData->BatchID & IDMask;
+
+			uint64 key = (uint64)priority << 59;
+			if (op.Material->IsBlendTransparent)
+			{
+				key |= 1ULL << 58;
+				key |= (DepthMask - depth) << 40;
+				key |= mtrlID << 20;
+				key |= geoID;
+			}
+			else
+			{
+				key |= mtrlID << 38;
+				key |= geoID << 18;
+				key |= depth;
+			}
+			return key;
+		}
+
+		void BatchData::SortKeys()
+		{
+			// LSD radix sort, 8 bits a pass
+			const int32 count = m_keys.getCount();
+
+			if (count > 1)
 			{
-				Material* mtrl = op.Material;
-				GeometryData* geoData = op.GeometryData;
+				m_keyScratch.ReserveDiscard(count);
+
+				uint32 histograms[8][256];
+				memset(histograms, 0, sizeof(histograms));
 
-				if (mtrl && geoData)
+				for (const DrawKey& dk : m_keys)
 				{
-					uint priority = Math::Min(mtrl->getPriority(), MaxPriority - 1);
+					for (int32 p = 0; p < 8; p++)
+						histograms[p][(dk.Key >> (p * 8)) & 0xff]++;
+				}
 
-					// add the rop from outer table to inner table(top down)
-					MaterialTable* mtrlTable;
-					if (!m_priTable.TryGetValue(priority, mtrlTable))
-					{
-						mtrlTable = m_bufferCache.ObtainNewMaterialTable();
-						m_priTable.Add(priority, mtrlTable);
-					}
+				DrawKey* src = m_keys.getElements();
+				DrawKey* dst = m_keyScratch.getElements();
+
+				for (int32 p = 0; p < 8; p++)
+				{
+					uint32* hist = histograms[p];
+					const int32 shift = p * 8;
+
+					// nothing to do when all keys have the same digit
+					if (hist[(src[0].Key >> shift) & 0xff] == (uint32)count)
+						continue;
 
-					GeometryTable* geoTable;
-					if (!mtrlTable->TryGetValue(mtrl, geoTable))
+					uint32 offset = 0;
+					for (int32 i = 0; i < 256; i++)
 					{
-						geoTable = m_bufferCache.ObtainNewGeometryTable();
-						mtrlTable->Add(mtrl, geoTable);
+						uint32 c = hist[i];
+						hist[i] = offset;
+						offset += c;
 					}
 
-					OperationList* opList;
-					if (!geoTable->TryGetValue(geoData, opList))
+					for (int32 i = 0; i < count; i++)
 					{
-						opList = m_bufferCache.ObtainNewOperationList();
-						geoTable->Add(geoData, opList);
+						const DrawKey& dk = src[i];
+						dst[hist[(dk.Key >> shift) & 0xff]++] = dk;
 					}
 
-					opList->Add(op);
+					std::swap(src, dst);
 				}
+
+				if (src != m_keys.getElements())
+					memcpy(m_keys.getElements(), src, sizeof(DrawKey) * count);
+			}
+
+			m_keysSorted = true;
+		}
+
+		void BatchData::RenderKeyed(RenderDevice* device, uint64 selectorMask, int selectorID)
+		{
+			if (!m_keysSorted)
+				SortKeys();
+
+			const RenderOperation* ops = m_keyedOps.getElements();
+			const DrawKey* keys = m_keys.getElements();
+			const int32 count = m_keys.getCount();
+
+			for (int32 i = 0; i < count; )
+			{
+				Material* mtrl = ops[keys[i].Index].Material;
+				GeometryData* geoData = ops[keys[i].Index].GeometryData;
+
+				int32 end = i + 1;
+				while (end < count && ops[keys[end].Index].Material == mtrl && ops[keys[end].Index].GeometryData == geoData)
+					end++;
+
+				if ((mtrl->getPassFlags() & selectorMask) && !geoData->Discard)
+				{
+					device->Render(mtrl, GetRunOperations(i, end - i), end - i, selectorID);
+				}
+
+				i = end;
+			}
+		}
+
+		const RenderOperation* BatchData::GetRunOperations(int32 first, int32 count)
+		{
+			const DrawKey* keys = m_keys.getElements() + first;
+
+			// usually an object's operations are added together and stay in order
+			bool adjacent = true;
+			for (int32 i = 1; i < count && adjacent; i++)
+				adjacent = keys[i].Index == keys[0].Index + i;
+
+			if (adjacent)
+				return m_keyedOps.getElements() + keys[0].Index;
+
+			m_runScratch.Clear();
+			for (int32 i = 0; i < count; i++)
+				m_runScratch.Add(m_keyedOps[keys[i].Index]);
+			return m_runScratch.getElements();
+		}
+
+		void BatchData::setQueueMode(BatchQueueMode mode)
+		{
+			if (m_mode != mode)
+			{
+				Clear();
+				m_mode = mode;
 			}
 		}
 
@@ -384,6 +536,12 @@ namespace Apoc3D
 		{
 			m_objectCount = 0;
 
+			m_keyedOps.Clear();
+			m_runScratch.Clear();
+			m_keys.Clear();
+			m_keysSorted = true;
+			m_keyedPassFlags = 0;
+
 			// this will only clear the rop list inside. The hashtables are remained as 
 			// it is highly possible the next time the buckets in them are reused.
 			for (MaterialTable* mtrlTbl : m_priTable.getValueAccessor())
@@ -400,6 +558,8 @@ namespace Apoc3D
 		}
 		void BatchData::Reset()
 		{
+			Clear();
+
 			for (MaterialTable* mtrlTbl : m_priTable.getValueAccessor())
 			{
 				for (GeometryTable* geoTbl : mtrlTbl->getValueAccessor())
@@ -415,6 +575,9 @@ namespace Apoc3D
 		}
 		bool BatchData::HasObject(uint64 selectMask)
 		{
+			if (m_mode == BatchQueueMode::SortedKeys)
+				return (m_keyedPassFlags & selectMask) != 0;
+
 			for (MaterialTable* mtrlTbl : m_priTable.getValueAccessor())
 			{
 				for (Material* m : mtrlTbl->getKeyAccessor())
@@ -443,6 +606,7 @@ namespace Apoc3D
 			{
 				delete m_procFallbacks[i];
 			}
+			m_viewBatchData.DeleteAndClear();
 		}
 
 		void SceneRenderer::Load(Configuration* config)
@@ -493,9 +657,32 @@ namespace Apoc3D
 			m_batchData.RenderBatch(m_renderDevice, selectorID);
 		}
 
+		BatchData* SceneRenderer::getViewBatchData(int32 view)
+		{
+			if (view == 0)
+				return &m_batchData;
+
+			while (m_viewBatchData.getCount() < view)
+			{
+				BatchData* data = new BatchData();
+				data->setQueueMode(m_batchData.getQueueMode());
+				m_viewBatchData.Add(data);
+			}
+			return m_viewBatchData[view - 1];
+		}
+
+		void SceneRenderer::setBatchQueueMode(BatchQueueMode mode)
+		{
+			m_batchData.setQueueMode(mode);
+			for (BatchData* data : m_viewBatchData)
+				data->setQueueMode(mode);
+		}
+
 		void SceneRenderer::ResetBatchTable()
 		{
 			m_batchData.Reset();
+			for (BatchData* data : m_viewBatchData)
+				data->Reset();
 		}
 	};
 };
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include "apoc3d/Collections/List.h"
 #include "apoc3d/Collections/HashMap.h"
 #include "apoc3d/Collections/Queue.h"
+#include "apoc3d/Math/Vector.h"
 
 using namespace Apoc3D::Collections;
 using namespace Apoc3D::Config;
@@ -80,6 +81,18 @@ namespace Apoc3D
 			InvalidGeoPointerList* m_invalidGeoPointers;
 		};
 
+		/** Specifies how BatchData organizes the render operations added. */
+		enum struct BatchQueueMode
+		{
+			/** Operations are classified into nested priority, material and geometry hash tables. The default. */
+			HashTables,
+			/**
+			 *  Operations are stored in a flat array with 64-bit draw keys packing priority, material, 
+			 *  geometry and depth. The keys are radix sorted once before rendering.
+			 */
+			SortedKeys
+		};
+
 		/**
 		 *  A hirerachy of tables to store classified render operations.
 		 *
@@ -89,6 +102,11 @@ namespace Apoc3D
 		 *  grouped together. This is good for minimizing render state changes if grouped 
 		 *  render operations are drawn one time. 
 		 *  Also instancing is automatic as long as the shader effect supports.
+		 *
+		 *  In BatchQueueMode::SortedKeys mode, the render operations are instead kept in a contiguous
+		 *  array in the order added, and only their sort keys are ordered, so rendering walks through 
+		 *  runs of the same material and geometry. Transparent materials are ordered back to front within 
+		 *  their priority.
 		 */
 		class APAPI BatchData
 		{
@@ -136,12 +154,49 @@ namespace Apoc3D
 			void Reset();
 
 			BatchDataBufferCache& getBufferCache() { return m_bufferCache; }
+
+			/** Changes the queue mode. All render operations added are cleared. */
+			void setQueueMode(BatchQueueMode mode);
+			BatchQueueMode getQueueMode() const { return m_mode; }
+
+			/** Sets the view point used to calculate the depth part of the sort keys. */
+			void setViewPosition(const Vector3& pos) { m_viewPos = pos; }
+
 		private:
+			/** A sort key with the index of the render operation it belongs to. */
+			struct DrawKey
+			{
+				uint64 Key;
+				int32 Index;
+			};
+
+			void AddTableOperation(const RenderOperation& op);
+			void AddKeyedOperation(const RenderOperation& op);
+
+			uint64 MakeDrawKey(const RenderOperation& op, uint32 priority) const;
+			void SortKeys();
+			void RenderKeyed(RenderDevice* device, uint64 selectorMask, int selectorID);
+
+			/** Gets the operations of a run of sorted keys as an array, gathering them only if needed. */
+			const RenderOperation* GetRunOperations(int32 first, int32 count);
+
 			PriorityTable m_priTable;
 			int m_objectCount;
 
 			BatchDataBufferCache m_bufferCache;
 
+			BatchQueueMode m_mode = BatchQueueMode::HashTables;
+			Vector3 m_viewPos = Vector3::Zero;
+
+			List<RenderOperation> m_keyedOps;
+			/** Holds a run of operations not adjacent in m_keyedOps while it is rendered */
+			List<RenderOperation> m_runScratch;
+			List<DrawKey> m_keys;
+			List<DrawKey> m_keyScratch;
+			bool m_keysSorted = true;
+
+			/** Union of pass flags of materials added in SortedKeys mode */
+			uint64 m_keyedPassFlags = 0;
 		};
 
 		/**
@@ -210,6 +265,15 @@ namespace Apoc3D
 
 			const BatchData& getBatchData() const { return m_batchData; }
 
+			/**
+			 *  Gets the batch data holding the visible objects of one of the views culled together
+			 *  in a frame. View 0 is the one RenderBatch draws; the others are created when first used.
+			 */
+			BatchData* getViewBatchData(int32 view);
+
+			void setBatchQueueMode(BatchQueueMode mode);
+			BatchQueueMode getBatchQueueMode() const { return m_batchData.getQueueMode(); }
+
 			void ResetBatchTable();
 
 			int GlobalCameraOverride;
@@ -218,6 +282,8 @@ namespace Apoc3D
 			RenderDevice* m_renderDevice;
 			//List<ScenePass*> m_passes;
 			BatchData m_batchData;
+			/** The batch data of views after the first. */
+			List<BatchData*> m_viewBatchData;
 
 			List<SceneProcedure*> m_procFallbacks;
 			int m_selectedProc;
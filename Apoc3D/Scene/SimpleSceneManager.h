@@ -49,6 +49,7 @@ namespace Apoc3D
 			virtual void AddObject(SceneObject* const obj);
 			virtual bool RemoveObject(SceneObject* const obj);
 
+			using SceneManager::PrepareVisibleObjects;
 			virtual void PrepareVisibleObjects(Camera* camera, BatchData* batchData);
 			virtual SceneObject* FindObject(const Ray& ray, IObjectFilter* filter);
 		};
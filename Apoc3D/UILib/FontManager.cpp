@@ -59,12 +59,10 @@ namespace Apoc3D
 		};
 
 		Font::Font(RenderDevice* device, const ResourceLocation& rl)
-			: m_charTable(255), m_resource(rl.Clone())
+			: m_device(device), m_charTable(255), m_resource(rl.Clone())
 		{
 			m_selectTextureSize = FontManager::MaxTextureSize;
 
-			ObjectFactory* fac = device->getObjectFactory();
-			
 			BinaryReader br(rl);
 
 			int32 fileID = br.ReadInt32();
@@ -188,86 +186,46 @@ namespace Apoc3D
 			} while (estEdgeCount * estEdgeCount > glyphCount * 1.5f && m_selectTextureSize > MinTextureSize);
 			m_selectTextureSize *= 2;
 
-			m_fontPack = fac->CreateTexture(m_selectTextureSize, m_selectTextureSize, 1, TU_Static, FMT_A8L8);
-
-			m_edgeCount = m_selectTextureSize / maxHeight;
-			m_grids = new Grid[m_edgeCount*m_edgeCount];
-			m_currentFreqTable = new int32[m_edgeCount*m_edgeCount]();
-			m_lastFreqTable = new int32[m_edgeCount*m_edgeCount]();
-
-			// initializes the grids
-			for (int32 i = 0; i < m_edgeCount; i++)
-			{
-				for (int32 j = 0; j < m_edgeCount; j++)
-				{
-					Grid& grd = m_grids[i*m_edgeCount + j];
-
-					grd.GridIndex = i * m_edgeCount + j;
-					grd.SrcRect = RectangleF((float)(j*maxHeight), (float)(i*maxHeight), (float)maxHeight, (float)maxHeight);
-				}
-			}
-			m_rowGridsFreqClassificationCount = new int32[m_edgeCount*MaxFreq]();
-			m_lasttime_rowGridsFreqClassificationCount = new int32[m_edgeCount*MaxFreq]();
+			CreatePage();
 
-			// set the ClassificationCount to max for each row for Freq 0
-			for (int32 i = 0; i < m_edgeCount; i++)
+			// now put the glyphs into the first page. The tallest glyphs are inserted first,
+			// which leaves the least holes under the skyline.
 			{
-				m_rowGridsFreqClassificationCount[i * MaxFreq + 0] = m_edgeCount;
-				m_lasttime_rowGridsFreqClassificationCount[i * MaxFreq + 0] = m_edgeCount;
-			}
-
+				int32* order = new int32[glyphCount];
+				for (int32 i = 0; i < glyphCount; i++)
+					order[i] = i;
 
-			
-			// now put the glyphs into the grids. Initially the largest glyphs are inserted.
-			{
-				// this temp list is used to store sorting without changing the original one
-				Glyph* tempList = new Glyph[glyphCount];
-				memcpy(tempList, m_glyphList, sizeof(Glyph) * glyphCount);
+				auto tallerFirst = [this](int32 a, int32 b)->int32
+				{
+					const Glyph& ga = m_glyphList[a];
+					const Glyph& gb = m_glyphList[b];
+					if (ga.Height != gb.Height)
+						return Apoc3D::Collections::OrderComparer(gb.Height, ga.Height);
+					return Apoc3D::Collections::OrderComparer(gb.Width, ga.Width);
+				};
 
-				// sort glyphs from wider to thiner in width.
 				if (glyphCount > 0)
-				{
-					QuickSort(tempList, 0, glyphCount - 1,
-						[](const Glyph& ga, const Glyph& gb)->int32
-					{
-						return Apoc3D::Collections::OrderComparer(ga.Width, gb.Width);
-					});
-				}
+					QuickSort(order, 0, glyphCount - 1, tallerFirst);
 
 				m_isUsingCaching = false;
 
-				int32 gridY = 0;
-				int32* gridX = new int32[m_edgeCount]();
-				
-				// use up the grids from column to column.
-				// The first column will have the fattest glyph, while the latter ones will have thiner ones.
 				for (int32 i = 0; i < glyphCount; i++)
 				{
-					if (gridX[gridY] >= m_edgeCount)
+					Glyph& glyph = m_glyphList[order[i]];
+
+					if (PackGlyphInPage(0, glyph))
 					{
-						m_isUsingCaching = true;
+						LoadGlyphData(&br, glyph);
 					}
-
-					int32 startX = gridX[gridY];
-
-					Glyph& glyph = tempList[i];
-					int32 gridsNeeded = (int32)ceil((double)glyph.Width / maxHeight);
-
-					if (startX + gridsNeeded - 1 < m_edgeCount)
+					else
 					{
-						Glyph& oglyph = m_glyphList[glyph.Index];
-
-						UseGrids(&oglyph, gridY, startX, gridsNeeded);
-
-						LoadGlyphData(&br, oglyph);
-
-						gridX[gridY] += gridsNeeded;
+						m_isUsingCaching = true;
 					}
-					gridY = (gridY + 1) % m_edgeCount;
 				}
 
-				delete[] tempList;
-				delete[] gridX;
+				delete[] order;
+
+				UploadGlyphs();
 			}
 
 
@@ -284,16 +242,17 @@ namespace Apoc3D
 
 		Font::~Font()
 		{
-			delete[] m_currentFreqTable;
-			delete[] m_lastFreqTable;
+			ClearLayoutCache();
 
-			delete[] m_lasttime_rowGridsFreqClassificationCount;
-			delete[] m_rowGridsFreqClassificationCount;
+			for (AtlasPage& page : m_pages)
+			{
+				delete page.Graphic;
+				delete[] page.Pixels;
+			}
+			m_pages.Clear();
 
-			delete[] m_grids;
 			delete[] m_glyphList;
 
-			delete m_fontPack;
 			delete m_resource;
 		}
 
@@ -305,6 +264,8 @@ namespace Apoc3D
 				c->Left = left;
 				c->Top = top;
 				c->AdvanceX = adcanceX;
+
+				ClearLayoutCache();
 				return true;
 			}
 			return false;
@@ -330,7 +291,7 @@ namespace Apoc3D
 				for (auto& ch : fnt->m_charTable.getValueAccessor())
 				{
 					Glyph& g = fnt->m_glyphList[ch.GlyphIndex];
-					RegisterCustomGlyph(ch._Character, fnt->m_fontPack, g.MappedRect, ch.Left, ch.Top, ch.AdvanceX);
+					RegisterCustomGlyph(ch._Character, fnt->getInternalTexture(), g.MappedRect, ch.Left, ch.Top, ch.AdvanceX);
 				}
 			}
 		}
@@ -349,6 +310,7 @@ namespace Apoc3D
 			cg.SrcRectF = srcRect;
 
 			m_customCharacters.Add(code, cg);
+			ClearLayoutCache();
 		}
 		void Font::RegisterCustomGlyph(int32 charCode, Texture* graphic, const Apoc3D::Math::Rectangle& srcRect)
 		{
@@ -380,8 +342,8 @@ namespace Apoc3D
 			RegisterCustomGlyph(charCode, graphic, srcRect, left, top, advX);
 		}
 
-		void Font::UnregisterCustomGlyph(int32 utf16code) { m_customCharacters.Remove(utf16code); }
-		void Font::ClearCustomGlyph() { m_customCharacters.Clear(); }
+		void Font::UnregisterCustomGlyph(int32 utf16code) { m_customCharacters.Remove(utf16code); ClearLayoutCache(); }
+		void Font::ClearCustomGlyph() { m_customCharacters.Clear(); ClearLayoutCache(); }
 		
 		void Font::DrawDisolvingCharacter(Sprite* sprite, Texture* fontPack, float x, float y,
 			int32 seed, const Apoc3D::Math::RectangleF& _srcRect, int32 glyphLeft, int32 glyphTop, int32 glyphWidth, int32 glyphHeight, uint32 color,
@@ -437,6 +399,8 @@ namespace Apoc3D
 			x = origin.X;
 			y = origin.Y;
 
+			m_useStamp++;
+
 			size_t maxLen = text.length();
 			int32 loopCount;
 			
@@ -578,12 +542,21 @@ namespace Apoc3D
 							if (!glyph.IsMapped)
 							{
 								EnsureGlyph(glyph);
+								UploadGlyphs();
+
+								if (!glyph.IsMapped)
+								{
+									x += chdef.AdvanceX;
+									continue;
+								}
 							}
-							SetUseFreqToMax(glyph);
+							TouchPage(glyph.Page);
+
+							Texture* fontPack = m_pages[glyph.Page].Graphic;
 
 							if (shouldDissolve)
 							{
-								DrawDisolvingCharacter(sprite, m_fontPack, x, y, i,
+								DrawDisolvingCharacter(sprite, fontPack, x, y, i,
 									glyph.MappedRectF, chdef.Left, chdef.Top, glyph.Width, glyph.Height, color,
 									dissolvePatchSize, dissolveProgress);
 							}
@@ -595,7 +568,7 @@ namespace Apoc3D
 								rect.Width = (float)glyph.Width;
 								rect.Height = (float)glyph.Height;
 
-								sprite->Draw(m_fontPack, rect, &glyph.MappedRectF, color);
+								sprite->Draw(fontPack, rect, &glyph.MappedRectF, color);
 							}
 
 							x += chdef.AdvanceX;
@@ -626,6 +599,27 @@ namespace Apoc3D
 			return length != -1 ? Math::Min(length, (int32)text.length()) : (int32)text.length();
 		}
 
+		static uint64 HashTextLayout(const String& text, int32 len, float width, float extLineSpace, char16_t suffix, float hozShrink)
+		{
+			// FNV-1a
+			uint64 hash = 14695981039346656037ull;
+			auto mix = [&hash](uint32 v)
+			{
+				hash ^= v;
+				hash *= 1099511628211ull;
+			};
+
+			for (int32 i = 0; i < len; i++)
+				mix(text[i]);
+
+			mix((uint32)len);
+			mix(reinterpret_cast<const uint32&>(width));
+			mix(reinterpret_cast<const uint32&>(extLineSpace));
+			mix(reinterpret_cast<const uint32&>(hozShrink));
+			mix(suffix);
+			return hash;
+		}
+
 		void Font::DrawStringEx(Sprite* sprite, const String& text, float x, float y, uint color, int32 length, float extLineSpace, char16_t suffix, float hozShrink)
 		{
 			DrawStringExT(sprite, text, x, y, color, 0, length, extLineSpace, suffix, hozShrink);
@@ -657,25 +651,12 @@ namespace Apoc3D
 		void Font::DrawStringExT(Sprite* sprite, const String& text, UnitType x, UnitType y, uint color, 
 			int32 _width, int32 length, UnitType _extLineSpace, char16_t suffix, float hozShrink)
 		{
-			const float extLineSpace = (float)_extLineSpace;
-			const float width = (float)_width;
-
 			const int32 len = GetLength(text, length);
 			const PointF orig = GetOrigin(x, y);
-			PointF pos = orig;
 
-			for (int32 i = 0; i < len; i++)
-			{
-				char16_t ch = text[i];
-				ScanColorControlCodes(text, ch, i, len, &color);
-				ScanMoveControlCode(text, ch, i, len, &orig, &pos);
-				ScanOtherControlCodes(text, ch, i, len);
+			const TextLayout& layout = GetLayout(text, len, (float)_width, (float)_extLineSpace, suffix, hozShrink);
 
-				DrawCharacter(sprite, ch, pos, color, hozShrink, extLineSpace, width, orig.X, true);
-			}
-
-			if (suffix)
-				DrawCharacter(sprite, suffix, pos, color, hozShrink, extLineSpace, width, orig.X, true);
+			DrawQuads(sprite, layout.Quads, orig, color);
 		}
 
 		template void Font::DrawStringExT<int32>(Sprite* sprite, const String& text, int32 x, int32 y, uint color, 
@@ -694,6 +675,8 @@ namespace Apoc3D
 			const PointF orig = GetOrigin(_x, _y);
 			PointF pos = orig;
 
+			m_useStamp++;
+
 			for (int32 i = 0; i < len; i++)
 			{
 				float lerpAmount = len > 1 ? (i / (float)(len - 1)) : 0;
@@ -703,126 +686,222 @@ namespace Apoc3D
 				char16_t ch = text[i];
 				ScanMoveControlCode(text, ch, i, len, &orig, &pos);
 
-				DrawCharacter(sprite, ch, pos, curColor.ToArgb(), 0, 0, 0, orig.X, true);
+				// every character has its own color, so this is not cached
+				uint32 pageMask = 0;
+				m_scratchQuads.Clear();
+				LayoutCharacter(m_scratchQuads, pageMask, ch, pos, false, 0, 0, 0, 0, orig.X);
+				UploadGlyphs();
+
+				DrawQuads(sprite, m_scratchQuads, PointF(0, 0), curColor.ToArgb());
 			}
 		}
 
-		FORCE_INLINE void Font::DrawCharacter(Sprite* sprite, int32 ch, PointF& pos, uint color, float horizShrink, float extLineSpace, float widthCap, float xOrig, bool pixelAligned)
+		const Font::TextLayout& Font::GetLayout(const String& text, int32 len, float width, float extLineSpace, char16_t suffix, float hozShrink)
 		{
-			const float lineSpacing = extLineSpace != 0 ? 
-				(pixelAligned ? floorf(extLineSpace) : extLineSpace) : 
-				(pixelAligned ? floorf(m_glyphHeight + m_lineGap) : (m_glyphHeight + m_lineGap));
-		
-			float& x = pos.X;
-			float& y = pos.Y;
+			uint64 key = HashTextLayout(text, len, width, extLineSpace, suffix, hozShrink);
 
-			if (ch != '\n')
+			TextLayout* layout = nullptr;
+			if (m_layoutCache.TryGetValue(key, layout))
 			{
-				if (IgnoreCharDrawing(ch))
-					return;
-
-				// draw custom characters
-				CustomGlyph* cgdef = m_customCharacters.TryGetValue(ch);
-				if (cgdef)
+				if (layout->AtlasGeneration == m_atlasGeneration &&
+					layout->Width == width && layout->ExtLineSpace == extLineSpace && 
+					layout->Suffix == suffix && layout->HozShrink == hozShrink &&
+					layout->Text.size() == (size_t)len && text.compare(0, len, layout->Text) == 0)
 				{
-					if (widthCap)
+					m_useStamp++;
+					for (int32 i = 0; i < m_pages.getCount(); i++)
 					{
-						float nextX = x + cgdef->AdvanceX;
-						if (nextX >= widthCap + xOrig)
-						{
-							x = xOrig;
-							nextX = x + cgdef->AdvanceX;
-							y += lineSpacing;
-						}
+						if (layout->PageMask & (1u << i))
+							TouchPage(i);
 					}
 
-					if (pixelAligned)
-					{
-						Apoc3D::Math::Rectangle rect;
-						rect.X = (int32)(x + 0.5f) + cgdef->Left;
-						rect.Y = (int32)(y + 0.5f) + cgdef->Top;
-						rect.Width = (int32)cgdef->SrcRectF.Width;
-						rect.Height = (int32)cgdef->SrcRectF.Height;
+					layout->LastUsedFrame = m_frameIndex;
+					return *layout;
+				}
 
-						sprite->Draw(cgdef->Graphic, rect, &cgdef->SrcRect, color);
-					}
-					else
-					{
-						Apoc3D::Math::RectangleF rect;
-						rect.X = x + (float)cgdef->Left;
-						rect.Y = y + (float)cgdef->Top;
-						rect.Width = cgdef->SrcRectF.Width;
-						rect.Height = cgdef->SrcRectF.Height;
+				// out of date, or a different text with the same hash. Laid out again below.
+			}
+			else
+			{
+				if (m_layoutCache.getCount() >= MaxCachedLayouts)
+					ClearLayoutCache();
 
-						sprite->Draw(cgdef->Graphic, rect, &cgdef->SrcRectF, color);
-					}
+				layout = new TextLayout();
+				m_layoutCache.Add(key, layout);
+			}
 
-					x += cgdef->AdvanceX + horizShrink;
-				}
-				else
-				{
-					Character chdef;
-					if (m_charTable.TryGetValue(ch, chdef))
-					{
-						// draw characters that are part of the font
+			layout->Text.assign(text, 0, len);
+			layout->Width = width;
+			layout->ExtLineSpace = extLineSpace;
+			layout->Suffix = suffix;
+			layout->HozShrink = hozShrink;
+			layout->LastUsedFrame = m_frameIndex;
 
-						Glyph& glyph = m_glyphList[chdef.GlyphIndex];
+			BuildLayout(*layout, text, len);
+			return *layout;
+		}
 
-						if (glyph.Width == 0 || glyph.Height == 0)
-						{
-							x += chdef.AdvanceX + horizShrink;
-							return;
-						}
+		void Font::BuildLayout(TextLayout& layout, const String& text, int32 len)
+		{
+			m_useStamp++;
 
-						if (widthCap)
-						{
-							// change line if a width cap is present
-							float nextX = x + chdef.AdvanceX + horizShrink;
-							if (nextX >= widthCap + xOrig)
-							{
-								x = xOrig;
-								nextX = x + chdef.AdvanceX;
-								y += lineSpacing;
-							}
-						}
+			layout.Quads.Clear();
+			layout.PageMask = 0;
 
-						if (!glyph.IsMapped)
-						{
-							// load glyph bitmap if not loaded
-							EnsureGlyph(glyph);
-						}
+			const PointF orig = PointF(0, 0);
+			PointF pos = orig;
 
-						SetUseFreqToMax(glyph);
+			uint color = 0;
+			bool hasColor = false;
 
-						if (pixelAligned)
-						{
-							Apoc3D::Math::Rectangle rect;
-							rect.X = (int32)(x + 0.5f) + chdef.Left;
-							rect.Y = (int32)(y + 0.5f) + chdef.Top;
-							rect.Width = glyph.Width;
-							rect.Height = glyph.Height;
+			for (int32 i = 0; i < len; i++)
+			{
+				char16_t ch = text[i];
 
-							sprite->Draw(m_fontPack, rect, &glyph.MappedRect, color);
-						}
-						else
-						{
-							Apoc3D::Math::RectangleF rect;
-							rect.X = x + chdef.Left;
-							rect.Y = y + chdef.Top;
-							rect.Width = (float)glyph.Width;
-							rect.Height = (float)glyph.Height;
+				int32 codeStart = i;
+				ScanColorControlCodes(text, ch, i, len, &color);
+				if (i != codeStart)
+					hasColor = true;
 
-							sprite->Draw(m_fontPack, rect, &glyph.MappedRectF, color);
-						}
+				ScanMoveControlCode(text, ch, i, len, &orig, &pos);
+				ScanOtherControlCodes(text, ch, i, len);
 
-						x += chdef.AdvanceX + horizShrink;
-					}
-				}
+				LayoutCharacter(layout.Quads, layout.PageMask, ch, pos, hasColor, color, layout.HozShrink, layout.ExtLineSpace, layout.Width, orig.X);
 			}
-			else
+
+			if (layout.Suffix)
+				LayoutCharacter(layout.Quads, layout.PageMask, layout.Suffix, pos, hasColor, color, layout.HozShrink, layout.ExtLineSpace, layout.Width, orig.X);
+
+			// all the glyphs newly loaded for the text go to the textures at once
+			UploadGlyphs();
+
+			layout.AtlasGeneration = m_atlasGeneration;
+		}
+
+		void Font::ClearLayoutCache()
+		{
+			m_layoutCache.DeleteValuesAndClear();
+		}
+
+		void Font::LayoutCharacter(List<TextQuad>& quads, uint32& pageMask, int32 ch, PointF& pos, bool hasColor, uint32 color, 
+			float horizShrink, float extLineSpace, float widthCap, float xOrig)
+		{
+			const float lineSpacing = extLineSpace != 0 ? floorf(extLineSpace) : floorf(m_glyphHeight + m_lineGap);
+
+			float& x = pos.X;
+			float& y = pos.Y;
+
+			if (ch == '\n')
 			{
 				x = xOrig;
 				y += lineSpacing;
+				return;
+			}
+
+			if (IgnoreCharDrawing(ch))
+				return;
+
+			TextQuad quad;
+			quad.HasColor = hasColor;
+			quad.Color = color;
+
+			// custom characters
+			CustomGlyph* cgdef = m_customCharacters.TryGetValue(ch);
+			if (cgdef)
+			{
+				if (widthCap)
+				{
+					float nextX = x + cgdef->AdvanceX;
+					if (nextX >= widthCap + xOrig)
+					{
+						x = xOrig;
+						y += lineSpacing;
+					}
+				}
+
+				quad.Graphic = cgdef->Graphic;
+				quad.PenX = x;
+				quad.PenY = y;
+				quad.Left = cgdef->Left;
+				quad.Top = cgdef->Top;
+				quad.SrcRectF = cgdef->SrcRect;
+				quads.Add(quad);
+
+				x += cgdef->AdvanceX + horizShrink;
+				return;
+			}
+
+			// characters that are part of the font
+			Character chdef;
+			if (!m_charTable.TryGetValue(ch, chdef))
+				return;
+
+			Glyph& glyph = m_glyphList[chdef.GlyphIndex];
+
+			if (glyph.Width == 0 || glyph.Height == 0)
+			{
+				x += chdef.AdvanceX + horizShrink;
+				return;
+			}
+
+			if (widthCap)
+			{
+				// change line if a width cap is present
+				float nextX = x + chdef.AdvanceX + horizShrink;
+				if (nextX >= widthCap + xOrig)
+				{
+					x = xOrig;
+					y += lineSpacing;
+				}
+			}
+
+			if (!glyph.IsMapped)
+			{
+				// load glyph bitmap if not loaded
+				EnsureGlyph(glyph);
+			}
+
+			if (glyph.IsMapped)
+			{
+				TouchPage(glyph.Page);
+				pageMask |= 1u << glyph.Page;
+
+				quad.Page = glyph.Page;
+				quad.PenX = x;
+				quad.PenY = y;
+				quad.Left = chdef.Left;
+				quad.Top = chdef.Top;
+				quad.SrcRect = glyph.MappedRect;
+				quads.Add(quad);
+			}
+
+			x += chdef.AdvanceX + horizShrink;
+		}
+
+		void Font::DrawQuads(Sprite* sprite, const List<TextQuad>& quads, const PointF& orig, uint32 color)
+		{
+			for (const TextQuad& quad : quads)
+			{
+				uint32 quadColor = quad.HasColor ? quad.Color : color;
+
+				Apoc3D::Math::Rectangle rect;
+				rect.X = (int32)(orig.X + quad.PenX + 0.5f) + quad.Left;
+				rect.Y = (int32)(orig.Y + quad.PenY + 0.5f) + quad.Top;
+
+				if (quad.Graphic)
+				{
+					rect.Width = (int32)quad.SrcRectF.Width;
+					rect.Height = (int32)quad.SrcRectF.Height;
+
+					sprite->Draw(quad.Graphic, rect, &quad.SrcRectF, quadColor);
+				}
+				else
+				{
+					rect.Width = quad.SrcRect.Width;
+					rect.Height = quad.SrcRect.Height;
+
+					sprite->Draw(m_pages[quad.Page].Graphic, rect, &quad.SrcRect, quadColor);
+				}
 			}
 		}
 		
@@ -1053,39 +1132,32 @@ namespace Apoc3D
 
 		void Font::FrameStartReset()
 		{
-			if (m_isUsingCaching)
-			{
-				// copy the data to its "last-frame" buffer
-				memcpy(m_lasttime_rowGridsFreqClassificationCount, m_rowGridsFreqClassificationCount, sizeof(int32)*m_edgeCount*MaxFreq);
-				memcpy(m_lastFreqTable, m_currentFreqTable, sizeof(int32)*m_edgeCount*m_edgeCount);
+			m_frameIndex++;
 
+			// pages added past the limit go again once a frame has not drawn from them
+			while (m_pages.getCount() > GetMaxPageCount() && m_pages.LastItem().LastUsedFrame + 1 < m_frameIndex)
+			{
+				EvictPage(m_pages.getCount() - 1);
 
-				// then reset the current to zero for statistics in the current frame
-				// this will be recalcualted below
-				memset(m_rowGridsFreqClassificationCount, 0, sizeof(int32)*m_edgeCount*MaxFreq);
+				AtlasPage& page = m_pages.LastItem();
+				delete page.Graphic;
+				delete[] page.Pixels;
+				m_pages.RemoveAt(m_pages.getCount() - 1);
+			}
 
-				if (m_usedInFrame)
+			// drop the texts not drawn lately
+			if (m_layoutCache.getCount() > 0)
+			{
+				List<uint64> oldKeys;
+				for (auto e : m_layoutCache)
 				{
-					// decay used frequency in m_currentFreqTable
-					// and calculate current ClassificationCount based on current Freq table
-
-					for (int32 i = 0; i < m_edgeCount; i++)
-					{
-						for (int32 j = 0; j < m_edgeCount; j++)
-						{
-							int32& f = m_currentFreqTable[i*m_edgeCount + j];
-							if (f > 0)
-							{
-								f--;
-								if (f < 0) f = 0;
-							}
-							m_rowGridsFreqClassificationCount[i*MaxFreq + f]++;
-						}
-					}
-					m_usedInFrame = false;
+					if (m_frameIndex - e.Value->LastUsedFrame > LayoutCacheFrames)
+						oldKeys.Add(e.Key);
 				}
-			}
 
+				for (uint64 key : oldKeys)
+					m_layoutCache.RemoveAndDelete(key);
+			}
 		}
 
 		void Font::ReadGlyphData(BinaryReader* br, void* buf, int32 pixelSize, Glyph& glyph)
@@ -1120,26 +1192,18 @@ namespace Apoc3D
 			assert(glyph.Width <= m_selectTextureSize && glyph.Width >=0);
 			assert(glyph.Height <= m_selectTextureSize && glyph.Height >=0);
 
-
-			Apoc3D::Math::Rectangle lockRect((int32)glyph.MappedRect.X, (int32)glyph.MappedRect.Y,
-				(int32)glyph.MappedRect.Width, (int32)glyph.MappedRect.Height);
-			DataRectangle dataRect = m_fontPack->Lock(0, LOCK_None, lockRect);
+			AtlasPage& page = m_pages[glyph.Page];
+			const int32 pitch = m_selectTextureSize;
+			uint16* dest = page.Pixels + glyph.MappedRect.Y * pitch + glyph.MappedRect.X;
 
 			if (m_hasLuminance)
 			{
 				uint16* buf = new uint16[glyph.Width * glyph.Height];
 				ReadGlyphData(br, buf, sizeof(*buf), glyph);
 
-				for (int32 j = 0; j < dataRect.getHeight(); j++)
+				for (int32 j = 0; j < glyph.Height; j++)
 				{
-					uint16* src = buf + j*glyph.Width;
-					char* dest = (char*)dataRect.getDataPointer() + j*dataRect.getPitch();
-					for (int32 i = 0; i < dataRect.getWidth(); i++)
-					{
-						uint16* pix = (uint16*)(dest)+i;
-
-						*pix = *(src + i);
-					}
+					memcpy(dest + j*pitch, buf + j*glyph.Width, sizeof(uint16) * glyph.Width);
 				}
 				delete[] buf;
 			}
@@ -1148,149 +1212,284 @@ namespace Apoc3D
 				char* buf = new char[glyph.Width * glyph.Height];
 				ReadGlyphData(br, buf, sizeof(*buf), glyph);
 
-				for (int32 j = 0; j < dataRect.getHeight(); j++)
+				for (int32 j = 0; j < glyph.Height; j++)
 				{
 					char* src = buf + j*glyph.Width;
-					char* dest = (char*)dataRect.getDataPointer() + j*dataRect.getPitch();
-					for (int32 i = 0; i < dataRect.getWidth(); i++)
+					uint16* pix = dest + j*pitch;
+					for (int32 i = 0; i < glyph.Width; i++)
 					{
-						uint16* pix = (uint16*)(dest)+i;
-
 						ushort highA = (byte)*(src + i);
 
-						*pix = highA << 8 | 0xff;
+						pix[i] = highA << 8 | 0xff;
 					}
 				}
 				delete[] buf;
 			}
-			
-			m_fontPack->Unlock(0);
+
+			// clear what an evicted glyph may have left in the padding
+			Apoc3D::Math::Rectangle area = glyph.MappedRect;
+			if (area.getRight() < pitch)
+			{
+				area.Width++;
+				for (int32 j = 0; j < glyph.Height; j++)
+					dest[j*pitch + glyph.Width] = 0;
+			}
+			if (area.getBottom() < pitch)
+			{
+				area.Height++;
+				memset(dest + glyph.Height*pitch, 0, sizeof(uint16) * area.Width);
+			}
+
+			if (page.Dirty)
+			{
+				page.DirtyRect = Apoc3D::Math::Rectangle::Union(page.DirtyRect, area);
+			}
+			else
+			{
+				page.DirtyRect = area;
+				page.Dirty = true;
+			}
 		}
-		void Font::EnsureGlyph(Glyph& glyph)
+
+		void Font::UploadGlyphs()
 		{
-			// grids are squares. m_maxGlyphHeight is the edge length in pixels of a grid
-			int32 gridsNeeded = (int32)ceil((double)glyph.Width / m_maxGlyphHeight);
+			for (AtlasPage& page : m_pages)
+			{
+				if (!page.Dirty)
+					continue;
 
-			bool done = false;
+				const Apoc3D::Math::Rectangle& rect = page.DirtyRect;
+				DataRectangle dataRect = page.Graphic->Lock(0, LOCK_None, rect);
 
-			// find enough space for the glyph, testing from lower use time to higher use time
-			int32 startColumnffset = m_gridSearchRandomizer.NextExclusive(m_edgeCount);
-			for (int32 freq = 0; freq < MaxFreq && !done; freq++)
-			{
-				// search by row
-				for (int32 ii = 0; ii < m_edgeCount && !done; ii++)
+				for (int32 j = 0; j < rect.Height; j++)
 				{
-					// some randomness to be at some chances finding unused glyph that is out of the range of use freq stat
-					int32 i = (startColumnffset + ii) % m_edgeCount;
+					const uint16* src = page.Pixels + (rect.Y + j) * m_selectTextureSize + rect.X;
+					char* dest = (char*)dataRect.getDataPointer() + j*dataRect.getPitch();
 
-					int32 freqIdx = freq + i * MaxFreq;
-					if (m_rowGridsFreqClassificationCount[freqIdx] >= gridsNeeded &&
-						m_lasttime_rowGridsFreqClassificationCount[freqIdx] >= gridsNeeded)
-					{
-						// even though the number of grids in the row is sufficient enough
-						// whether they are consecutive still needed to be checked here.
-						int32 numOfConsqGrids = 0;
-						int32 gridPosition = -1;
-						for (int32 j = 0; j < m_edgeCount && numOfConsqGrids < gridsNeeded; j++)
-						{
-							int32 cellIdx = i*m_edgeCount + j;
-							if (m_currentFreqTable[cellIdx] <= freq && m_lastFreqTable[cellIdx] <= freq)
-							{
-								numOfConsqGrids++;
-								if (gridPosition == -1)
-									gridPosition = j;
-							}
-							else
-							{
-								numOfConsqGrids = 0; // resets if it meets any obstacle
-							}
-						}
+					memcpy(dest, src, sizeof(uint16) * rect.Width);
+				}
 
-						if (numOfConsqGrids == gridsNeeded)
-						{
-							// once the space has been located,
-							// load the glyph
+				page.Graphic->Unlock(0);
+				page.Dirty = false;
+			}
+		}
 
-							// 1. Clears the grids
-							UseGrids(nullptr, i, gridPosition, gridsNeeded);
+		void Font::EnsureGlyph(Glyph& glyph)
+		{
+			if (PackGlyph(glyph))
+			{
+				Stream* strm = m_resource->GetReadStream();
+				BinaryReader br(strm, true);
 
-							Stream* strm = m_resource->GetReadStream();
-							BinaryReader br(strm, true);
+				LoadGlyphData(&br, glyph);
+			}
+		}
 
-							// 2. Tag the grids
-							UseGrids(&glyph, i, gridPosition, gridsNeeded);
+		bool Font::PackGlyph(Glyph& glyph)
+		{
+			for (int32 i = 0; i < m_pages.getCount(); i++)
+			{
+				if (PackGlyphInPage(i, glyph))
+					return true;
+			}
 
-							// 3. Load the data
-							LoadGlyphData(&br, glyph);
+			if (m_pages.getCount() < GetMaxPageCount())
+			{
+				return PackGlyphInPage(CreatePage(), glyph);
+			}
 
+			// Empty the least recently used page. Pages used by the text being drawn are kept,
+			// and the ones used in this frame are only taken when there is no other choice.
+			int32 victim = -1;
+			for (int32 i = 0; i < m_pages.getCount(); i++)
+			{
+				const AtlasPage& page = m_pages[i];
+				if (page.LastUsedStamp == m_useStamp)
+					continue;
 
-							done = true;
+				if (victim == -1)
+				{
+					victim = i;
+					continue;
+				}
 
-							break;
-						}
+				const AtlasPage& best = m_pages[victim];
+				bool usedInFrame = page.LastUsedFrame == m_frameIndex;
+				bool bestUsedInFrame = best.LastUsedFrame == m_frameIndex;
 
-					}
-				}
+				if (usedInFrame != bestUsedInFrame ? !usedInFrame : page.LastUsedStamp < best.LastUsedStamp)
+					victim = i;
 			}
+
+			// The sprites queued in this frame still sample the pages drawn from. Rather than changing
+			// their pixels before the batch is flushed, a page is added past the limit for the frame.
+			if (victim == -1 || m_pages[victim].LastUsedFrame == m_frameIndex)
+			{
+				if (m_pages.getCount() < 32)
+					return PackGlyphInPage(CreatePage(), glyph);
+				return false;
+			}
+
+			EvictPage(victim);
+			return PackGlyphInPage(victim, glyph);
 		}
-		void Font::SetUseFreqToMax(const Glyph& glyph)
+
+		bool Font::PackGlyphInPage(int32 pageIndex, Glyph& glyph)
 		{
-			if (m_isUsingCaching)
+			AtlasPage& page = m_pages[pageIndex];
+
+			if (glyph.Width == 0 || glyph.Height == 0)
 			{
-				m_usedInFrame = true;
+				// nothing to store
+				glyph.IsMapped = true;
+				glyph.Page = pageIndex;
+				glyph.MappedRect = Apoc3D::Math::Rectangle(0, 0, 0, 0);
+				glyph.MappedRectF = Apoc3D::Math::RectangleF(0, 0, 0, 0);
+				return true;
+			}
 
-				for (int32 i = 0; i < glyph.NumberOfGridsUsing; i++)
-				{
-					const Grid& grd = m_grids[glyph.StartingParentGrid + i];
-					int32& freq = m_currentFreqTable[grd.GridIndex];
-					int32 rowIndex = grd.GridIndex / m_edgeCount;
-					int32 spFreqRowIdx = rowIndex*MaxFreq;
+			const int32 size = m_selectTextureSize;
+			const int32 width = glyph.Width + GlyphPadding;
+			const int32 height = glyph.Height + GlyphPadding;
 
-					m_rowGridsFreqClassificationCount[freq + spFreqRowIdx]--;
+			// bottom-left rule: the position where the glyph's top is the lowest, then the leftmost
+			int32 bestIndex = -1;
+			int32 bestX = 0;
+			int32 bestY = 0;
+			int32 bestTop = size + 1;
 
-					freq = MaxFreq - 1;
+			const SkylineNode* nodes = page.Skyline.getElements();
+			const int32 nodeCount = page.Skyline.getCount();
+			for (int32 i = 0; i < nodeCount; i++)
+			{
+				const int32 x = nodes[i].X;
+				if (x + width > size + GlyphPadding)
+					break;
 
-					m_rowGridsFreqClassificationCount[freq + spFreqRowIdx]++;
+				// the glyph rests on the highest level it spans
+				int32 y = 0;
+				int32 remaining = width;
+				for (int32 j = i; j < nodeCount && remaining > 0; j++)
+				{
+					y = Math::Max(y, nodes[j].Y);
+					remaining -= nodes[j].Width;
+				}
+
+				if (y + height > size + GlyphPadding)
+					continue;
+
+				if (y + height < bestTop)
+				{
+					bestTop = y + height;
+					bestIndex = i;
+					bestX = x;
+					bestY = y;
 				}
 			}
-		}
-		void Font::UseGrids(Glyph* g, int32 i, int32 j, int32 amount)
-		{
-			if (g)
+
+			if (bestIndex == -1)
+				return false;
+
+			// add the new level, and cut the ones under it
+			page.Skyline.Insert(bestIndex, { bestX, bestTop, width });
+
+			for (int32 i = bestIndex + 1; i < page.Skyline.getCount(); )
 			{
-				// use grids
-				const Apoc3D::Math::RectangleF& bukRect = m_grids[i*m_edgeCount + j].SrcRect;
+				const SkylineNode& prev = page.Skyline[i - 1];
+				SkylineNode& node = page.Skyline[i];
 
-				g->NumberOfGridsUsing = amount;
-				g->StartingParentGrid = i*m_edgeCount + j;
-				for (int32 k = 0; k < amount; k++)
+				int32 overlap = prev.X + prev.Width - node.X;
+				if (overlap <= 0)
+					break;
+
+				if (node.Width <= overlap)
 				{
-					m_grids[i*m_edgeCount + j + k].CurrentGlyph = g->Index;
+					page.Skyline.RemoveAt(i);
+					continue;
 				}
-				g->MappedRect = Apoc3D::Math::Rectangle((int32)bukRect.X, (int32)bukRect.Y, g->Width, g->Height);
-				g->MappedRectF = Apoc3D::Math::RectangleF(bukRect.X, bukRect.Y, (float)g->Width, (float)g->Height);
-				g->IsMapped = true;
+
+				node.X += overlap;
+				node.Width -= overlap;
+				break;
 			}
-			else
+
+			// merge neighbouring levels of the same height
+			for (int32 i = 0; i < page.Skyline.getCount() - 1; )
 			{
-				// clear the requested amount of grids one by one
-				for (int32 s = 0; s < amount; s++)
-				{
-					int32 index = m_grids[i*m_edgeCount + j + s].CurrentGlyph;
-					if (index != -1)
-					{
-						Glyph& oglyph = m_glyphList[index];
-						oglyph.IsMapped = false;
+				SkylineNode& node = page.Skyline[i];
+				const SkylineNode& next = page.Skyline[i + 1];
 
-						for (int32 k = 0; k < oglyph.NumberOfGridsUsing; k++)
-						{
-							m_grids[oglyph.StartingParentGrid + k].CurrentGlyph = -1;
-						}
-						oglyph.StartingParentGrid = -1;
-						oglyph.NumberOfGridsUsing = 0;
-					}
+				if (node.Y == next.Y)
+				{
+					node.Width += next.Width;
+					page.Skyline.RemoveAt(i + 1);
+				}
+				else
+				{
+					i++;
 				}
 			}
+
+			glyph.IsMapped = true;
+			glyph.Page = pageIndex;
+			glyph.MappedRect = Apoc3D::Math::Rectangle(bestX, bestY, glyph.Width, glyph.Height);
+			glyph.MappedRectF = Apoc3D::Math::RectangleF((float)bestX, (float)bestY, (float)glyph.Width, (float)glyph.Height);
+
+			page.Glyphs.Add(glyph.Index);
+			return true;
+		}
+
+		int32 Font::CreatePage()
+		{
+			ObjectFactory* fac = m_device->getObjectFactory();
+			const int32 size = m_selectTextureSize;
+
+			m_pages.Add(AtlasPage());
+			AtlasPage& page = m_pages.LastItem();
+
+			page.Graphic = fac->CreateTexture(size, size, 1, TU_Static, FMT_A8L8);
+			page.Pixels = new uint16[size * size]();
+			page.Skyline.Add({ 0, 0, size });
+
+			// the texture starts out with undefined content
+			page.Dirty = true;
+			page.DirtyRect = Apoc3D::Math::Rectangle(0, 0, size, size);
+
+			page.LastUsedStamp = m_useStamp;
+			page.LastUsedFrame = m_frameIndex;
+
+			return m_pages.getCount() - 1;
+		}
+
+		void Font::EvictPage(int32 pageIndex)
+		{
+			AtlasPage& page = m_pages[pageIndex];
+
+			for (int32 glyphIndex : page.Glyphs)
+			{
+				Glyph& g = m_glyphList[glyphIndex];
+				g.IsMapped = false;
+				g.Page = -1;
+			}
+			page.Glyphs.Clear();
+
+			page.Skyline.Clear();
+			page.Skyline.Add({ 0, 0, m_selectTextureSize });
+
+			// old pixels are overwritten as new glyphs come in
+			m_atlasGeneration++;
+		}
+
+		int32 Font::GetMaxPageCount()
+		{
+			return Math::Clamp(FontManager::MaxAtlasPages, 1, 32);
+		}
+
+		void Font::TouchPage(int32 pageIndex)
+		{
+			AtlasPage& page = m_pages[pageIndex];
+			page.LastUsedStamp = m_useStamp;
+			page.LastUsedFrame = m_frameIndex;
 		}
 		
 		void Font::AdvanceXSimple(float& x, char16_t ch)
@@ -1440,6 +1639,7 @@ namespace Apoc3D
 		SINGLETON_IMPL(FontManager);
 
 		int32 FontManager::MaxTextureSize = 1024;
+		int32 FontManager::MaxAtlasPages = 4;
 
 		FontManager::FontManager()
 			: m_fontTable()
@@ -1483,7 +1683,7 @@ namespace Apoc3D
 			int32 numLargeFont = 0;
 			for (Font* fnt : m_fontTable.getValueAccessor())
 			{
-				bytesUsed += fnt->m_selectTextureSize * fnt->m_selectTextureSize * 2;
+				bytesUsed += fnt->m_selectTextureSize * fnt->m_selectTextureSize * 2 * fnt->m_pages.getCount();
 
 				if (fnt->m_isUsingCaching)
 				{
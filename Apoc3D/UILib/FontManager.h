@@ -19,8 +19,8 @@
  */
 
 #include "apoc3d/Collections/HashMap.h"
+#include "apoc3d/Collections/List.h"
 #include "apoc3d/Math/Rectangle.h"
-#include "apoc3d/Math/RandomUtils.h"
 
 namespace Apoc3D
 {
@@ -45,10 +45,14 @@ namespace Apoc3D
 		 *
 		 *  When the Font class can not hold the number of glyph bitmaps at once, caching is used.
 		 *  Initially the first glyphs in the font will be loaded and packed into texture. 
-		 *  When drawing a string, if any required glyph is not yet loaded, the ones seldom used 
-		 *  will be unloaded to make room for the requested one.
+		 *  When drawing a string, if any required glyph is not yet loaded, it is packed into
+		 *  the atlas, which can grow to more pages. Once all pages are full, the page used
+		 *  least recently is emptied to make room for the requested one.
 		 *  This circumstances happens for big fonts or languages like Chinese, Korean, which has
 		 *  a large number of characters.
+		 *
+		 *  Strings drawn with DrawString and DrawStringEx are laid out once and kept as a list of
+		 *  quads. Drawing the same string again with the same settings replays them.
 		 */
 		class APAPI Font
 		{
@@ -110,10 +114,16 @@ namespace Apoc3D
 
 			void getStandardMetrics(float& ascender, float& descender) const { ascender = m_ascender; descender = m_descender; }
 
-			Texture* getInternalTexture() const { return m_fontPack; }
+			/** The first page of the glyph atlas. */
+			Texture* getInternalTexture() const { return m_pages[0].Graphic; }
 
 		private:
-			static const int32 MaxFreq = 10;
+			/** Empty pixels kept to the right and bottom of each glyph in the atlas, so filtering does not pick up its neighbours. */
+			static const int32 GlyphPadding = 1;
+
+			/** Laid out text runs not drawn for this many frames are dropped from the cache. */
+			static const int32 LayoutCacheFrames = 120;
+			static const int32 MaxCachedLayouts = 1024;
 
 			/**
 			 *  Represents a character supported by the font.
@@ -143,21 +153,16 @@ namespace Apoc3D
 				int64 Offset = 0;
 
 				/**
-				 * Is the glyph bitmap stored in the texture pack currently?
+				 * Is the glyph bitmap stored in the atlas currently?
 				 */
 				bool IsMapped = false;
 				Apoc3D::Math::Rectangle MappedRect;
 				Apoc3D::Math::RectangleF MappedRectF;
 
 				/**
-				 *  The number of consecutive grids that the glyph is using.
-				 */
-				int32 NumberOfGridsUsing = 0;
-
-				/**
-				 * The index of the first grid currently used.
+				 * The index of the atlas page the glyph is in.
 				 */
-				int32 StartingParentGrid = -1;
+				int32 Page = -1;
 			};
 
 			struct CustomGlyph
@@ -173,48 +178,125 @@ namespace Apoc3D
 				Texture* Graphic;
 			};
 
-			struct Grid
+			/**
+			 *  A segment of the skyline of an atlas page. Everything below Y over the
+			 *  segment's span is taken.
+			 */
+			struct SkylineNode
 			{
-				/**
-				 * If the grid is used by any glyph currently,
-				 * the index of the glyph. Otherwise -1.
-				 */
-				int32 CurrentGlyph = -1;
+				int32 X;
+				int32 Y;
+				int32 Width;
+			};
 
-				/**
-				 * The rect area mapping into the texture pad
-				 */
-				Apoc3D::Math::RectangleF SrcRect;
+			/**
+			 *  One texture of the glyph atlas.
+			 *
+			 *  Glyphs are packed bottom-left along the skyline and never removed one by one.
+			 *  When the atlas is full, the least recently used page is emptied as a whole.
+			 *  Glyph bitmaps are first written into Pixels; the dirty part is copied into 
+			 *  the texture with one lock, before any quad using them is handed to the sprite.
+			 */
+			struct AtlasPage
+			{
+				Texture* Graphic = nullptr;
+				uint16* Pixels = nullptr;
 
-				/**
-				 * The index of the grid in the grid array
-				 */
-				int32 GridIndex;
+				List<SkylineNode> Skyline;
+				List<int32> Glyphs;
+
+				bool Dirty = false;
+				Apoc3D::Math::Rectangle DirtyRect;
+
+				uint32 LastUsedStamp = 0;
+				uint32 LastUsedFrame = 0;
+			};
+
+			/**
+			 *  A positioned character of a laid out text, relative to the text's origin.
+			 */
+			struct TextQuad
+			{
+				/** The custom glyph's texture. Null for glyphs in the atlas. */
+				Texture* Graphic = nullptr;
+				int32 Page = -1;
+
+				float PenX = 0;
+				float PenY = 0;
+				int32 Left = 0;
+				int32 Top = 0;
+
+				Apoc3D::Math::Rectangle SrcRect;
+				Apoc3D::Math::RectangleF SrcRectF;
+
+				/** The color from a color control code before the character, if any. Otherwise the text's color is used. */
+				uint32 Color = 0;
+				bool HasColor = false;
 			};
 
 			/**
-			 *  Load the glyph bitmap data for a mapped glyph into the m_fontPack texture
+			 *  A cached text run, laid out as a list of quads.
+			 *  Only valid while the atlas has not evicted any page since AtlasGeneration.
+			 */
+			struct TextLayout
+			{
+				String Text;
+				float Width = 0;
+				float ExtLineSpace = 0;
+				float HozShrink = 0;
+				char16_t Suffix = 0;
+
+				uint32 AtlasGeneration = 0;
+				uint32 PageMask = 0;
+				uint32 LastUsedFrame = 0;
+
+				List<TextQuad> Quads;
+			};
+
+			/**
+			 *  Load the glyph bitmap data for a mapped glyph into its atlas page
 			 */
 			void LoadGlyphData(BinaryReader* br, Glyph& glyph);
 			void ReadGlyphData(BinaryReader* br, void* buf, int32 pixelSize, Glyph& glyph);
 
 			/**
-			 *  Make sure the glyph is loaded and packed in to texture pack
+			 *  Make sure the glyph is loaded and packed in to the atlas
 			 */
 			void EnsureGlyph(Glyph& glyph);
 
 			/**
-			*  Marks a glyph and its grids using by the given glyph or
-			*  clears the use when the given glyph pointer is 0
-			*/
-			void UseGrids(Glyph* g, int32 i, int32 j, int32 amount);
+			 *  Finds room for the glyph in the atlas, adding or emptying a page if needed,
+			 *  and maps the glyph there.
+			 */
+			bool PackGlyph(Glyph& glyph);
+			bool PackGlyphInPage(int32 pageIndex, Glyph& glyph);
+
+			int32 CreatePage();
+			void EvictPage(int32 pageIndex);
+			static int32 GetMaxPageCount();
+
+			/** Copies the glyphs written since the last call into the page textures. */
+			void UploadGlyphs();
+
+			void TouchPage(int32 pageIndex);
 
 			void FrameStartReset();
 
 			/**
-			*  Increase the frequency of use of the grids used by the given glyph
-			*/
-			void SetUseFreqToMax(const Glyph& g);
+			 *  Gets the laid out quads for the text, from the cache if possible.
+			 */
+			const TextLayout& GetLayout(const String& text, int32 len, float width, float extLineSpace, char16_t suffix, float hozShrink);
+			void BuildLayout(TextLayout& layout, const String& text, int32 len);
+			void ClearLayoutCache();
+
+			/**
+			 *  Lays out one character at pos and advances pos. Glyphs not yet in the atlas are loaded,
+			 *  but not uploaded.
+			 */
+			void LayoutCharacter(List<TextQuad>& quads, uint32& pageMask, int32 ch, PointF& pos, bool hasColor, uint32 color,
+				float hozShrink, float extLineSpace, float widthCap, float xOrig);
+
+			void DrawQuads(Sprite* sprite, const List<TextQuad>& quads, const PointF& orig, uint32 color);
 
 			/**
 			 * Get the initial font rendering offset coordinate, top left padding
@@ -232,8 +314,6 @@ namespace Apoc3D
 			void DrawStringExT(Sprite* sprite, const String& text, UnitType x, UnitType y, uint color, int32 width = 0,
 				int32 length = -1, UnitType extLineSpace = 0, char16_t suffix = 0, float hozShrink = 0);
 
-			void DrawCharacter(Sprite* sprite, int32 ch, PointF& pos, uint color, float hozShrink, float extLineSpace, float widthCap, float xOrig, bool pixelAligned);
-
 			void DrawDisolvingCharacter(Sprite* sprite, Texture* fontPack, float x, float y,
 				int32 seed, const Apoc3D::Math::RectangleF& srcRect, int32 glyphLeft, int32 glyphTop, int32 glyphWidth, int32 glyphHeight, uint32 color,
 				const Point& dissolvePatchSize, float progress);
@@ -249,10 +329,16 @@ namespace Apoc3D
 			static void ScanOtherControlCodes(const String& str, char16_t& cur, int32& i, int32 len);
 
 			/**
-			 * A texture that packs as much glyphs as possible within its limits size
-			 * This is managed with m_grids.
+			 * The glyph atlas. Page 0 is created at load; fonts using caching can grow up to
+			 * FontManager::MaxAtlasPages pages, and beyond for a frame that draws from all of them.
 			 */
-			Texture* m_fontPack = nullptr;
+			List<AtlasPage> m_pages;
+
+			/** Increased every time a page is emptied, which makes all cached layouts out of date. */
+			uint32 m_atlasGeneration = 0;
+			/** Increased for every text drawn, so pages used by the current text are not evicted. */
+			uint32 m_useStamp = 0;
+			uint32 m_frameIndex = 0;
 
 			/**
 			 * The height of the glyph bitmaps. Typically glyphs in a font are considered to have a fixed height.
@@ -282,55 +368,23 @@ namespace Apoc3D
 			int32 m_maxGlyphWidth = 1;
 			int32 m_maxGlyphHeight = 1;
 
-			/**
-			 *  Number of grids on one edge
-			 */
-			int32 m_edgeCount = 0;
 			/**
 			 *  A copy of the resource location initially used for loading is store here
 			 *  for dynamically loading glyphs if needed.
 			 */
 			ResourceLocation* m_resource = nullptr;
+			RenderDevice* m_device;
 
 			HashMap<int32, Character> m_charTable;
 			Glyph* m_glyphList = nullptr;
 
 			HashMap<int32, CustomGlyph> m_customCharacters;
 
+			/** Laid out texts, by a hash of the text and layout settings. */
+			HashMap<uint64, TextLayout*> m_layoutCache;
+			List<TextQuad> m_scratchQuads;
 
-			/** 
-			 *  The entire texture area is divided into 2d plane of grids(m_edgeCount*m_edgeCount), 
-			 *  which records the use of every small texture region
-			 *
-			 *  Grids are row major. Fat glyph use will use more than one grid in a row.
-			 *  Other mechanism like m_rowGridsFreqClassificationCount depends on rows too.
-			 */
-			Grid* m_grids = nullptr;
-			
-			/** 
-			 *  A one to one array containing the use frequency of each grid.
-			 *  The frequency here indicates that approximately how many time the 
-			 *  grid is used since the beginning of the last frame.
-			 */
-			int32* m_currentFreqTable = nullptr;
-			/** 
-			 *  A one to one array containing the last-frame frequency of each grid.
-			 *  This is statistical as texts are drawn.
-			 */
-			int32* m_lastFreqTable = nullptr;
-			/** 
-			 *  An array of m_edgeCount*MaxFreq, 
-			 *  indicates how many grids are there with specific freqs in each row.
-			 */
-			int32* m_rowGridsFreqClassificationCount = nullptr;
-			/** 
-			 *  The back up copy of last-frame m_rowGridsFreqClassificationCount
-			 */
-			int32* m_lasttime_rowGridsFreqClassificationCount = nullptr;
-
-			Random m_gridSearchRandomizer;
 			bool m_isUsingCaching = false;
-			bool m_usedInFrame = false;
 
 			friend class FontManager;
 		
@@ -344,13 +398,15 @@ namespace Apoc3D
 			SINGLETON_DECL(FontManager);
 		public:
 			static int32 MaxTextureSize;
+			/** The number of atlas textures a font using caching can have, up to 32. */
+			static int32 MaxAtlasPages;
 
 			FontManager();
 			~FontManager();
 
 			/**
-			 *  Should be called at the beginning of each frame to 
-			 *  reset every Font's internal frequency statistics
+			 *  Should be called at the beginning of each frame. Fonts use it to
+			 *  tell recently used atlas pages and cached texts from old ones.
 			 */
 			void StartFrame();
 			Font* LoadFont(RenderDevice* device, const String& name, const ResourceLocation& rl);
@@ -628,6 +628,386 @@ namespace Apoc3D
 		void TreeView::OnPress() { }
 		void TreeView::OnRelease() { }
 
+		/************************************************************************/
+		/*  VirtualTreeView                                                     */
+		/************************************************************************/
+
+		VirtualTreeView::VirtualTreeView(const StyleSkin* skin, const Point& position, const Point& size, TreeViewDataSource* source)
+			: ScrollableControl(skin, position, size), m_source(source)
+		{
+			BackgroundGraphic = UIGraphic(skin->SkinTexture, skin->ListBoxBackground);
+			Margin = skin->ListBoxMargin;
+
+			ItemSettings.TextColor = skin->TextColor;
+			ItemSettings.TextColorDisabled = skin->TextColor; // same color
+			ItemSettings.HorizontalAlignment = TextHAlign::Left;
+
+			InitScrollbars(skin);
+			EnableVScrollBar = true;
+
+			m_root.Item = TreeViewDataSource::RootItem;
+			ReloadChildCounts(&m_root, false);
+		}
+
+		VirtualTreeView::~VirtualTreeView()
+		{
+			for (ExpandedItem* ei : m_root.Children)
+				DeleteExpanded(ei);
+			m_root.Children.Clear();
+		}
+
+		void VirtualTreeView::Update(const AppTime* time)
+		{
+			UpdateScrollBarsGeneric(getArea(), time);
+
+			Apoc3D::Math::Rectangle cntArea = GetContentArea();
+			m_visibleItems = (int32)ceilf((float)cntArea.Height / GetItemHeight());
+
+			m_vscrollbar->VisibleRange = m_visibleItems;
+			m_vscrollbar->Maximum = Math::Max(0, getRowCount() - m_visibleItems);
+			m_vscrollbar->Step = Math::Max(1, m_vscrollbar->Maximum / 15);
+
+			if (m_hscrollbar)
+				m_hscrollbar->Maximum = Math::Max(0, m_maxRowRight - cntArea.Width);
+
+			m_hoverRow = -1;
+
+			if (!IsInteractive)
+				return;
+
+			Mouse* mouse = InputAPIManager::getSingleton().getMouse();
+			Point mousePos = mouse->GetPosition();
+
+			if (getAbsoluteArea().Contains(mousePos) && mouse->getDZ())
+			{
+				m_vscrollbar->SetValue(m_vscrollbar->getValue() - mouse->getDZ() / 60);
+			}
+
+			if (cntArea.Contains(mousePos))
+			{
+				int32 row = m_vscrollbar->getValue() + (mousePos.Y - cntArea.Y) / GetItemHeight();
+				if (row < getRowCount())
+					m_hoverRow = row;
+			}
+
+			if (m_hoverRow == -1)
+				return;
+
+			if (mouse->IsLeftPressed())
+			{
+				uint64 previousItem = m_selectedItem;
+				m_selectedRow = m_hoverRow;
+				m_selectedItem = getRowItem(m_hoverRow);
+
+				eventSelect.Invoke(this);
+				if (m_selectedItem != previousItem)
+					eventSelectionChanged.Invoke(this);
+			}
+			else if (mouse->IsLeftUp() && m_hoverRow == m_selectedRow)
+			{
+				if (isRowExpanded(m_selectedRow))
+					CollapseRow(m_selectedRow);
+				else
+					ExpandRow(m_selectedRow);
+			}
+		}
+
+		void VirtualTreeView::Draw(Sprite* sprite)
+		{
+			DrawBackground(sprite);
+
+			{
+				Apoc3D::Math::Rectangle scissorRect = getAbsoluteArea();
+				ScissorTestScope sts(scissorRect, sprite);
+
+				if (!sts.isEmpty())
+				{
+					Apoc3D::Math::Rectangle cntArea = GetContentArea();
+					Texture* whitePix = SystemUI::GetWhitePixel();
+
+					int32 itemHeight = GetItemHeight();
+					int32 firstRow = m_vscrollbar->getValue();
+					int32 endRow = Math::Min(getRowCount(), firstRow + m_visibleItems);
+
+					for (int32 i = firstRow; i < endRow; i++)
+					{
+						const CachedRow* cr = GetCachedRow(i);
+						if (cr == nullptr)
+							break;
+
+						Apoc3D::Math::Rectangle rowArea(cntArea.X, cntArea.Y + (i - firstRow) * itemHeight, cntArea.Width, itemHeight);
+
+						if (i == m_selectedRow)
+							sprite->Draw(whitePix, rowArea, CV_LightGray);
+						else if (i == m_hoverRow)
+							sprite->Draw(whitePix, rowArea, CV_Silver);
+
+						Point itemOffset = rowArea.getTopLeft();
+						itemOffset.X += 2 + cr->Info.Depth * TreeViewIntent;
+						if (m_hscrollbar)
+							itemOffset.X -= m_hscrollbar->getValue();
+
+						if (cr->Icon)
+						{
+							sprite->Draw(cr->Icon, itemOffset.X, itemOffset.Y, CV_White);
+							itemOffset.X += cr->Icon->getWidth();
+						}
+
+						ItemSettings.Draw(sprite, m_fontRef, cr->Text, itemOffset, Point(0, itemHeight), Enabled);
+					}
+				}
+			}
+
+			DrawScrollBars(sprite);
+		}
+
+		void VirtualTreeView::DrawBackground(Sprite* sprite)
+		{
+			Apoc3D::Math::Rectangle graphicalArea = getAbsoluteArea();
+			graphicalArea = Margin.InflateRect(graphicalArea);
+
+			BackgroundGraphic.Draw(sprite, graphicalArea);
+		}
+
+		bool VirtualTreeView::ExpandRow(int32 row)
+		{
+			RowInfo info;
+			if (!ResolveRow(row, info))
+				return false;
+			if (info.Expanded)
+				return true;
+
+			int32 childCount = m_source->getChildCount(info.Item);
+			if (childCount <= 0)
+				return false;
+
+			ExpandedItem* ei = new ExpandedItem();
+			ei->Item = info.Item;
+			ei->IndexInParent = info.IndexInParent;
+			ei->ChildCount = childCount;
+			ei->Parent = info.Parent;
+
+			List<ExpandedItem*>& siblings = info.Parent->Children;
+			int32 pos = 0;
+			while (pos < siblings.getCount() && siblings[pos]->IndexInParent < ei->IndexInParent)
+				pos++;
+			siblings.Insert(pos, ei);
+
+			AddVisibleCount(ei, childCount);
+
+			if (m_selectedRow > row)
+				m_selectedRow += childCount;
+			return true;
+		}
+
+		void VirtualTreeView::CollapseRow(int32 row)
+		{
+			RowInfo info;
+			if (!ResolveRow(row, info) || info.Expanded == nullptr)
+				return;
+
+			ExpandedItem* ei = info.Expanded;
+			int32 removedRows = ei->VisibleCount;
+
+			AddVisibleCount(ei->Parent, -removedRows);
+			ei->Parent->Children.Remove(ei);
+			DeleteExpanded(ei);
+
+			if (m_selectedRow > row + removedRows)
+			{
+				m_selectedRow -= removedRows;
+			}
+			else if (m_selectedRow > row)
+			{
+				// the selected item is hidden, select the collapsed one instead
+				m_selectedRow = row;
+				m_selectedItem = info.Item;
+				eventSelectionChanged.Invoke(this);
+			}
+		}
+
+		bool VirtualTreeView::isRowExpanded(int32 row)
+		{
+			RowInfo info;
+			return ResolveRow(row, info) && info.Expanded;
+		}
+
+		uint64 VirtualTreeView::getRowItem(int32 row)
+		{
+			RowInfo info;
+			if (ResolveRow(row, info))
+				return info.Item;
+			return TreeViewDataSource::RootItem;
+		}
+
+		void VirtualTreeView::RefreshItem(uint64 item)
+		{
+			ExpandedItem* ei = FindExpanded(&m_root, item);
+			if (ei == nullptr)
+				return;
+
+			int32 previousRowCount = getRowCount();
+			ReloadChildCounts(ei, false);
+
+			// rows may have moved by an unknown amount
+			if (getRowCount() != previousRowCount)
+			{
+				m_selectedRow = -1;
+				m_selectedItem = TreeViewDataSource::RootItem;
+			}
+		}
+
+		void VirtualTreeView::Refresh()
+		{
+			ReloadChildCounts(&m_root, true);
+
+			m_maxRowRight = 0;
+			m_selectedRow = -1;
+			m_selectedItem = TreeViewDataSource::RootItem;
+		}
+
+		bool VirtualTreeView::ResolveRow(int32 row, RowInfo& info)
+		{
+			if (row < 0 || row >= m_root.VisibleCount)
+				return false;
+
+			ExpandedItem* parent = &m_root;
+			int32 depth = 0;
+
+			// walk down the expanded items, skipping over the rows of the ones before the row
+			for (;;)
+			{
+				int32 nextIndex = 0;
+				ExpandedItem* descend = nullptr;
+
+				for (ExpandedItem* c : parent->Children)
+				{
+					int32 collapsedBefore = c->IndexInParent - nextIndex;
+					if (row < collapsedBefore)
+						break;
+					row -= collapsedBefore;
+
+					if (row == 0)
+					{
+						info.Item = c->Item;
+						info.Depth = depth;
+						info.Expanded = c;
+						info.Parent = parent;
+						info.IndexInParent = c->IndexInParent;
+						return true;
+					}
+					row--;
+
+					if (row < c->VisibleCount)
+					{
+						descend = c;
+						break;
+					}
+					row -= c->VisibleCount;
+					nextIndex = c->IndexInParent + 1;
+				}
+
+				if (descend == nullptr)
+				{
+					info.IndexInParent = nextIndex + row;
+					info.Item = m_source->getChild(parent->Item, info.IndexInParent);
+					info.Depth = depth;
+					info.Expanded = nullptr;
+					info.Parent = parent;
+					return true;
+				}
+
+				parent = descend;
+				depth++;
+			}
+		}
+
+		const VirtualTreeView::CachedRow* VirtualTreeView::GetCachedRow(int32 row)
+		{
+			int32 slotCount = m_visibleItems + 1;
+			if (m_rowCache.getCount() != slotCount)
+				m_rowCache.ReserveDiscard(slotCount);
+
+			CachedRow& cr = m_rowCache[row % slotCount];
+			if (cr.Row != row || cr.Structure != m_structure)
+			{
+				if (!ResolveRow(row, cr.Info))
+				{
+					cr.Row = -1;
+					return nullptr;
+				}
+
+				cr.Row = row;
+				cr.Structure = m_structure;
+				cr.Icon = m_source->getIcon(cr.Info.Item);
+				cr.Text = m_source->getText(cr.Info.Item);
+
+				cr.Width = 2 + cr.Info.Depth * TreeViewIntent + m_fontRef->MeasureString(cr.Text).X;
+				if (cr.Icon)
+					cr.Width += cr.Icon->getWidth();
+
+				if (cr.Width > m_maxRowRight)
+					m_maxRowRight = cr.Width;
+			}
+			return &cr;
+		}
+
+		void VirtualTreeView::AddVisibleCount(ExpandedItem* ei, int32 delta)
+		{
+			for (ExpandedItem* p = ei; p; p = p->Parent)
+				p->VisibleCount += delta;
+
+			m_structure++;
+		}
+
+		void VirtualTreeView::DeleteExpanded(ExpandedItem* ei)
+		{
+			for (ExpandedItem* c : ei->Children)
+				DeleteExpanded(c);
+			delete ei;
+		}
+
+		VirtualTreeView::ExpandedItem* VirtualTreeView::FindExpanded(ExpandedItem* ei, uint64 item)
+		{
+			if (ei->Item == item)
+				return ei;
+
+			for (ExpandedItem* c : ei->Children)
+			{
+				ExpandedItem* r = FindExpanded(c, item);
+				if (r)
+					return r;
+			}
+			return nullptr;
+		}
+
+		void VirtualTreeView::ReloadChildCounts(ExpandedItem* ei, bool recursive)
+		{
+			ei->ChildCount = Math::Max(0, m_source->getChildCount(ei->Item));
+
+			while (ei->Children.getCount() > 0 && ei->Children.LastItem()->IndexInParent >= ei->ChildCount)
+			{
+				DeleteExpanded(ei->Children.LastItem());
+				ei->Children.RemoveAt(ei->Children.getCount() - 1);
+			}
+
+			int32 visibleCount = ei->ChildCount;
+			for (ExpandedItem* c : ei->Children)
+			{
+				c->Item = m_source->getChild(ei->Item, c->IndexInParent);
+
+				// the children add their own changes along the parent chain
+				if (recursive)
+					ReloadChildCounts(c, true);
+
+				visibleCount += c->VisibleCount;
+			}
+
+			AddVisibleCount(ei, visibleCount - ei->VisibleCount);
+		}
+
+		int32 VirtualTreeView::GetItemHeight() const { return (int32)(1.05f * m_fontRef->getLineHeight()); }
+
 		/************************************************************************/
 		/*  ListView                                                            */
 		/************************************************************************/
@@ -641,6 +1021,15 @@ namespace Apoc3D
 			TextSettings.TextPadding.SetLeftRight(4, 4);
 		}
 
+		ListView::ListView(const StyleSkin* skin, const Point& position, const Point& size, ListViewDataSource* source)
+			: ScrollableControl(skin, position, size), m_items(1, 1), m_source(source)
+		{
+			Initialize(skin);
+
+			TextSettings.HorizontalAlignment = TextHAlign::Left;
+			TextSettings.TextPadding.SetLeftRight(4, 4);
+		}
+
 		ListView::~ListView()
 		{
 		}
@@ -717,7 +1106,7 @@ namespace Apoc3D
 			{
 				for (int y = itemStart; y < itemEnd; y++)
 				{
-					if (!m_items.isIndexInRange(y))
+					if (!IsRowInRange(y))
 						continue;
 
 					Apoc3D::Math::Rectangle selectionRect;
@@ -743,15 +1132,17 @@ namespace Apoc3D
 				int32 baseX = cellArea.X;
 				int32 baseY = cellArea.Y;
 
+				int32 columnCount = GetColumnCount();
+
 				for (int y = itemStart; y < itemEnd; y++)
 				{
-					if (!m_items.isIndexInRange(y))
+					if (!IsRowInRange(y))
 						continue;
 
 					cellArea.X = baseX;
 					cellArea.Y = baseY + y * cellArea.Height;
 
-					for (int x = 0; x < m_items.getWidth(); x++)
+					for (int x = 0; x < columnCount; x++)
 					{
 						cellArea.Width = m_columnHeader[x].Width;
 
@@ -850,7 +1241,7 @@ namespace Apoc3D
 
 			m_hscrollbar->Step = Math::Max(1, m_hscrollbar->Maximum / 15);
 
-			int rowCount = m_items.getCount();
+			int rowCount = GetRowCount();
 			int visiCount = GetVisibleItems();
 			m_vscrollbar->VisibleRange = visiCount;
 			m_vscrollbar->Maximum = Math::Max(0, rowCount - visiCount);
@@ -1033,16 +1424,17 @@ namespace Apoc3D
 
 			int32 baseX = cellArea.X;
 			int32 baseY = cellArea.Y;
+			int32 columnCount = GetColumnCount();
 
 			for (int y = itemStart; y < itemEnd; y++)
 			{
-				if (!m_items.isIndexInRange(y))
+				if (!IsRowInRange(y))
 					continue;
 
 				cellArea.X = baseX;
 				cellArea.Y = baseY + y * cellArea.Height;
 
-				for (int x = 0; x < m_items.getWidth(); x++)
+				for (int x = 0; x < columnCount; x++)
 				{
 					cellArea.Width = m_columnHeader[x].Width;
 
@@ -1058,10 +1450,7 @@ namespace Apoc3D
 						DrawSelectedBox(sprite, cellArea);
 
 					{
-						// truncate text
-						String text = m_items[y][x];
-
-						guiOmitLineText(m_fontRef, cellArea.Width - TextSettings.TextPadding.getHorizontalSum(), text);
+						const String& text = GetCellText(y, x, cellArea.Width - TextSettings.TextPadding.getHorizontalSum());
 
 						//m_fontRef->DrawString(sprite, text, cellArea.getTopLeft(), CV_Black);
 						TextSettings.Draw(sprite, m_fontRef, text, cellArea, Enabled);
@@ -1118,5 +1507,42 @@ namespace Apoc3D
 			start = m_vscrollbar->getValue();
 			end = start + GetVisibleItems();
 		}
+
+		int32 ListView::GetRowCount() { return m_source ? m_source->getRowCount() : m_items.getCount(); }
+		int32 ListView::GetColumnCount()
+		{
+			int32 count = m_source ? m_source->getColumnCount() : m_items.getWidth();
+			return Math::Min(count, m_columnHeader.getCount());
+		}
+		bool ListView::IsRowInRange(int32 row) { return row >= 0 && row < GetRowCount(); }
+
+		const String& ListView::GetCellText(int32 row, int32 column, int32 width)
+		{
+			int32 slotCount = GetVisibleItems() + 1;
+			if (m_rowCache.getCount() != slotCount)
+				m_rowCache.ReserveDiscard(slotCount);
+
+			CachedRow& cr = m_rowCache[row % slotCount];
+			if (cr.Row != row)
+			{
+				cr.Row = row;
+				cr.Cells.Clear();
+			}
+			if (cr.Cells.getCount() <= column)
+				cr.Cells.Reserve(column + 1);
+
+			// truncating measures the text over and over, so only do it when the text or column width changes
+			CachedCell& cell = cr.Cells[column];
+			String text = m_source ? m_source->getCellText(row, column) : m_items[row][column];
+
+			if (cell.Width != width || cell.Source != text)
+			{
+				cell.Width = width;
+				cell.Source = text;
+				cell.Text = text;
+				guiOmitLineText(m_fontRef, width, cell.Text);
+			}
+			return cell.Text;
+		}
 	}
 }
\ No newline at end of file
@@ -211,6 +211,153 @@ namespace Apoc3D
 			bool m_mouseHover = false;
 		};
 
+		/**
+		 *  Supplies the items of a VirtualTreeView on demand.
+		 *
+		 *  Items are identified by handles chosen by the source, which must stay the same
+		 *  while the item exists. RootItem is the parent of the top level items and cannot
+		 *  be used as an item handle.
+		 */
+		class APAPI TreeViewDataSource
+		{
+		public:
+			static const uint64 RootItem = 0;
+
+			virtual ~TreeViewDataSource() { }
+
+			virtual int32 getChildCount(uint64 item) = 0;
+			virtual uint64 getChild(uint64 item, int32 index) = 0;
+
+			virtual String getText(uint64 item) = 0;
+			virtual Texture* getIcon(uint64 item) { return nullptr; }
+		};
+
+		/**
+		 *  A tree view that does not own its items, but pulls the ones in the visible rows from a
+		 *  TreeViewDataSource.
+		 *
+		 *  Only the expanded items are kept, each with the number of rows shown below it. These
+		 *  counts are updated along the parent chain when an item is expanded or collapsed, so
+		 *  finding the item at a row takes time in the depth of the tree rather than its size.
+		 *  The horizontal extent is the widest row measured so far.
+		 *
+		 *  The source is not watched. Expanded items are kept by their index under the parent.
+		 *  Call RefreshItem when the children of an expanded item change, or Refresh after
+		 *  larger changes.
+		 */
+		class APAPI VirtualTreeView : public ScrollableControl
+		{
+			RTTI_DERIVED(VirtualTreeView, ScrollableControl);
+		public:
+			VirtualTreeView(const StyleSkin* skin, const Point& position, const Point& size, TreeViewDataSource* source);
+			virtual ~VirtualTreeView();
+
+			virtual void Update(const AppTime* time) override;
+			virtual void Draw(Sprite* sprite) override;
+
+			/** Expands the item shown at the given row. Returns false if it has no children. */
+			bool ExpandRow(int32 row);
+			/** Collapses the item shown at the given row. Expanded items below it are collapsed too. */
+			void CollapseRow(int32 row);
+			bool isRowExpanded(int32 row);
+
+			/** Re-reads the child count of an item, which must be expanded or the root. */
+			void RefreshItem(uint64 item);
+			/** Re-reads the child counts of all expanded items and forgets the measured widths. */
+			void Refresh();
+
+			uint64 getRowItem(int32 row);
+			int32 getRowCount() const { return m_root.VisibleCount; }
+
+			int32 getSelectedRow() const { return m_selectedRow; }
+			uint64 getSelectedItem() const { return m_selectedItem; }
+
+			TreeViewDataSource* getDataSource() const { return m_source; }
+
+			TextRenderSettings ItemSettings;
+
+			UIGraphic BackgroundGraphic;
+
+			ControlBounds Margin;
+
+			UIEventHandler eventSelect;
+			UIEventHandler eventSelectionChanged;
+
+		private:
+			struct ExpandedItem
+			{
+				uint64 Item = 0;
+				int32 IndexInParent = 0;
+				int32 ChildCount = 0;
+				/** Rows shown below this item, including the ones below its expanded children. */
+				int32 VisibleCount = 0;
+
+				ExpandedItem* Parent = nullptr;
+				/** Sorted by IndexInParent */
+				List<ExpandedItem*> Children;
+			};
+
+			struct RowInfo
+			{
+				uint64 Item = 0;
+				int32 Depth = 0;
+				/** Null when the item is collapsed. */
+				ExpandedItem* Expanded = nullptr;
+				ExpandedItem* Parent = nullptr;
+				int32 IndexInParent = 0;
+			};
+
+			struct CachedRow
+			{
+				int32 Row = -1;
+				uint32 Structure = 0;
+
+				RowInfo Info;
+				Texture* Icon = nullptr;
+				String Text;
+				int32 Width = 0;
+			};
+
+			int32 GetItemHeight() const;
+
+			bool ResolveRow(int32 row, RowInfo& info);
+			const CachedRow* GetCachedRow(int32 row);
+
+			void AddVisibleCount(ExpandedItem* ei, int32 delta);
+			void DeleteExpanded(ExpandedItem* ei);
+			ExpandedItem* FindExpanded(ExpandedItem* ei, uint64 item);
+			void ReloadChildCounts(ExpandedItem* ei, bool recursive);
+
+			void DrawBackground(Sprite* sprite);
+
+			TreeViewDataSource* m_source;
+
+			ExpandedItem m_root;
+
+			/** Row text and width, indexed by row modulo the number of slots. */
+			List<CachedRow> m_rowCache;
+			/** Changes whenever rows may have moved, invalidating the cached rows. */
+			uint32 m_structure = 1;
+
+			int32 m_maxRowRight = 0;
+			int32 m_visibleItems = 0;
+
+			int32 m_selectedRow = -1;
+			uint64 m_selectedItem = 0;
+			int32 m_hoverRow = -1;
+		};
+
+		/** Supplies the cells of a ListView on demand. */
+		class APAPI ListViewDataSource
+		{
+		public:
+			virtual ~ListViewDataSource() { }
+
+			virtual int32 getRowCount() = 0;
+			virtual int32 getColumnCount() = 0;
+			virtual String getCellText(int32 row, int32 column) = 0;
+		};
+
 		typedef EventDelegate<int, int> ListViewSelectionHandler;
 
 		class APAPI ListView : public ScrollableControl
@@ -238,12 +385,18 @@ namespace Apoc3D
 			};
 
 			ListView(const StyleSkin* skin, const Point& position, const Point& size, const List2D<String>& items);
+			/** Creates a list view that shows the cells of the source instead of its own items. */
+			ListView(const StyleSkin* skin, const Point& position, const Point& size, ListViewDataSource* source);
 			virtual ~ListView();
 
 			virtual void Update(const AppTime* time) override;
 			virtual void Draw(Sprite* sprite) override;
 
 			List2D<String>& getItems() { return m_items; }
+
+			ListViewDataSource* getDataSource() const { return m_source; }
+			void setDataSource(ListViewDataSource* source) { m_source = source; m_rowCache.Clear(); }
+
 			List<Header>& getColumnHeader() { return m_columnHeader; }
 			ListViewHeaderStyle getHeaderStyle() const { return m_headerStyle; }
 			void setHeaderStyle(ListViewHeaderStyle s) { m_headerStyle = s; }
@@ -259,8 +412,26 @@ namespace Apoc3D
 
 			ListViewSelectionHandler eventSelected;
 		private:
+			struct CachedCell
+			{
+				String Source;
+				/** Source text cut to fit Width */
+				String Text;
+				int32 Width = -1;
+			};
+			struct CachedRow
+			{
+				int32 Row = -1;
+				List<CachedCell> Cells;
+			};
+
 			void Initialize(const StyleSkin* skin);
 			int GetVisibleItems();
+
+			int32 GetRowCount();
+			int32 GetColumnCount();
+			bool IsRowInRange(int32 row);
+			const String& GetCellText(int32 row, int32 column, int32 width);
 			void GetVisibleItemsRange(int32& start, int32& end);
 
 			Point GetColumnHeaderOffset() const;
@@ -286,6 +457,10 @@ namespace Apoc3D
 			void OnRelease();
 
 			List2D<String> m_items;
+			ListViewDataSource* m_source = nullptr;
+
+			/** Truncated cell text, indexed by row modulo the number of slots. */
+			List<CachedRow> m_rowCache;
 
 			List<Header> m_columnHeader;
 			int32 m_headerHeight = 0;
@@ -13,7 +13,7 @@ namespace Apoc3D
 	{
 		//////////////////////////////////////////////////////////////////////////
 
-		GraphLayout::GraphLayout(int32 areaEdgeLength, int32 workerThreads)
+		GraphLayout::GraphLayout(int32 areaEdgeLength)
 			: m_areaEdgeLength(areaEdgeLength), m_quadTreeUpdateInterval(0), m_adaptiveLayoutIterationPerFrame(0),
 			m_adaptiveTimeScale(1), m_currentKEnergy(0)
 		{
@@ -41,11 +41,6 @@ namespace Apoc3D
 				m_leafNodes[qy * m_areaEdgeLeafNodeCount + qx] = node;
 			});
 
-			for (int32 i = 0; i < workerThreads;i++)
-			{
-				m_physicsWorkers.Add(new PhysicsWorker(i));
-			}
-
 			m_layoutThread = new std::thread(&GraphLayout::LayoutThreadEntry, this);
 			Platform::SetThreadName(m_layoutThread, L"Layout");
 		}
@@ -56,8 +51,6 @@ namespace Apoc3D
 			m_layoutThread->join();
 			DELETE_AND_NULL(m_layoutThread);
 
-			m_physicsWorkers.DeleteAndClear();
-
 			Reset();
 			delete m_quadTree;
 
@@ -566,47 +559,34 @@ namespace Apoc3D
 
 					//////////////////////////////////////////////////////////////////////////
 
-					int32 currentWorkerIndex = 0;
-					for (int32 i = 0; i < m_nodes.getCount();i++)
-					{
-						m_physicsWorkers[currentWorkerIndex++]->AddWorkItem({ PhysicsTask::Pre, m_nodes[i], dt2, selectedTech });
-						currentWorkerIndex %= m_physicsWorkers.getCount();
-					}
+					TaskScheduler& scheduler = TaskScheduler::getSingleton();
+					const int32 nodeCount = m_nodes.getCount();
 
-					for (auto p : m_physicsWorkers)
-						p->WaitUntilClear();
+					scheduler.ParallelFor(0, nodeCount, [this](int32 start, int32 end)
+					{
+						for (int32 i = start; i < end; i++)
+							m_nodes[i]->BeginPhysicsStep();
+					});
 
 					m_frameProgress = 0;
-					currentWorkerIndex = 0;
-					for (int32 i = 0; i < m_nodes.getCount(); i++)
-					{
-						m_physicsWorkers[currentWorkerIndex++]->AddWorkItem({ PhysicsTask::Mid, m_nodes[i], dt2, selectedTech });
-						currentWorkerIndex %= m_physicsWorkers.getCount();
-					}
+					std::atomic<int32> stepsDone(0);
 
-					for (;;)
+					scheduler.ParallelFor(0, nodeCount, [&](int32 start, int32 end)
 					{
-						int32 countRemaining = 0;
-						for (auto p : m_physicsWorkers)
-							countRemaining += p->WaitUntilClear(10);
+						for (int32 i = start; i < end; i++)
+							m_nodes[i]->PhysicsStep(dt2, selectedTech);
 
-						if (countRemaining == 0)
-							break;
-
-						m_frameProgress = 1 - ((float)countRemaining / m_nodes.getCount());
-					}
+						int32 done = stepsDone += end - start;
+						m_frameProgress = (float)done / nodeCount;
+					});
 
 					m_frameProgress = 1;
 
-					currentWorkerIndex = 0;
-					for (int32 i = 0; i < m_nodes.getCount(); i++)
+					scheduler.ParallelFor(0, nodeCount, [this](int32 start, int32 end)
 					{
-						m_physicsWorkers[currentWorkerIndex++]->AddWorkItem({ PhysicsTask::Post, m_nodes[i], dt2, selectedTech });
-						currentWorkerIndex %= m_physicsWorkers.getCount();
-					}
-
-					for (auto p : m_physicsWorkers)
-						p->WaitUntilClear();
+						for (int32 i = start; i < end; i++)
+							m_nodes[i]->EndPhysicsStep();
+					});
 
 					//////////////////////////////////////////////////////////////////////////
 
@@ -748,26 +728,6 @@ namespace Apoc3D
 
 
 
-		GraphLayout::PhysicsWorker::PhysicsWorker(int32 idx)
-		{
-			StartBackground(L"PhysicsWorker " + StringUtils::IntToString(idx), 1);
-		}
-		void GraphLayout::PhysicsWorker::BackgroundMainProcess(PhysicsTask& item)
-		{
-			switch (item.TaskType)
-			{
-				case PhysicsTask::Pre:
-					item.Subject->BeginPhysicsStep();
-					break;
-				case PhysicsTask::Mid:
-					item.Subject->PhysicsStep(item.DT, item.SelectedTechnique);
-					break;
-				case PhysicsTask::Post:
-					item.Subject->EndPhysicsStep();
-					break;
-			}
-		}
-
 
 		//////////////////////////////////////////////////////////////////////////
 
@@ -8,7 +8,7 @@
 #include "apoc3d/Collections/List.h"
 #include "apoc3d/Collections/LinkedList.h"
 #include "apoc3d/Collections/HashMap.h"
-#include "apoc3d/Core/BackgroundWorker.h"
+#include "apoc3d/Core/TaskScheduler.h"
 
 #include "apoc3d/Meta/FunctorReference.h"
 
@@ -74,7 +74,8 @@ namespace Apoc3D
 				TECH_Fuzzy
 
 			};
-			GraphLayout(int32 areaEdgeLength = 2048, int32 workerThreads = 4);
+			/** The physics steps run on the TaskScheduler, which needs to be initialized. */
+			GraphLayout(int32 areaEdgeLength = 2048);
 			~GraphLayout();
 
 			void Load(List<GraphNodeDefinition>& graphInfo, bool forceRandom);
@@ -117,30 +118,6 @@ namespace Apoc3D
 			Apoc3D::Math::RectangleF Viewport;
 
 		private:
-			struct PhysicsTask
-			{
-				enum 
-				{
-					Pre,
-					Mid,
-					Post
-				} TaskType;
-				
-				GraphNode* Subject = nullptr;
-				float DT = 0;
-				Technique SelectedTechnique;
-
-				PhysicsTask() { }
-				PhysicsTask(int32 tskType, GraphNode* obj, float dt, Technique tec)
-					: TaskType((decltype(TaskType))tskType), Subject(obj), DT(dt), SelectedTechnique(tec) { }
-			};
-
-			struct PhysicsWorker : public BackgroundWorker<PhysicsTask>
-			{
-				PhysicsWorker(int32 idx);
-				virtual void BackgroundMainProcess(PhysicsTask& item) override;
-			};
-
 			enum struct CommandType
 			{
 				Reset,
@@ -223,7 +200,6 @@ namespace Apoc3D
 			Queue<LayoutCommand> m_commandQueue;
 			
 			std::thread* m_layoutThread;
-			List<PhysicsWorker*> m_physicsWorkers;
 
 			std::mutex m_intersectingNodesLock;
 			List<GraphNodeInfo>* m_intersectingNodes = new List<GraphNodeInfo>();
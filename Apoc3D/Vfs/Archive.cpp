@@ -102,7 +102,24 @@ namespace Apoc3D
 				LogManager::getSingleton().Write(LOG_System, L"Pak archive format is invalid " + fl.getPath(), LOGLVL_Warning);
 			}
 			
-			m_fileStream = fl.GetReadStream();
+			// packs inside a mapped pack get their memory from the outer one
+			if (fl.isInArchive())
+			{
+				m_fileStream = fl.GetReadStream();
+			}
+			else
+			{
+				m_fileStream = new MappedFileStream(fl.getPath());
+
+				// files that can not be mapped, such as ones larger than the address space, are read instead
+				if (m_fileStream->getMappedData() == nullptr)
+				{
+					delete m_fileStream;
+					m_fileStream = new FileStream(fl.getPath());
+				}
+			}
+
+			m_mappedData = m_fileStream->getMappedData();
 		}
 		PakArchive::~PakArchive()
 		{
@@ -124,6 +141,9 @@ namespace Apoc3D
 
 			if (m_entries.TryGetValue(file, lpkEnt))
 			{
+				if (m_mappedData)
+					return new MemoryStream(m_mappedData + lpkEnt.Offset, lpkEnt.Size, m_fileStream->IsReadEndianIndependent());
+
 				VirtualStream* res = new VirtualStream(m_fileStream, lpkEnt.Offset, lpkEnt.Size);
 				res->setPosition( 0 );
 				return res;
@@ -67,7 +67,11 @@ namespace Apoc3D
 			int64 Size;
 		};
 
-		// the engine has built in support for a kind of uncompressed pak file.
+		/**
+		 *  The engine has built in support for a kind of uncompressed pak file.
+		 *  The pak file is mapped into memory. Entry streams read the mapping directly, each with its own
+		 *  position, so entries can be opened and read from multiple threads without copying the archive.
+		 */
 		class APAPI PakArchive : public Archive
 		{
 		public:
@@ -94,6 +98,8 @@ namespace Apoc3D
 			List<String> m_entryNames;
 
 			Stream* m_fileStream;
+			/** The content of m_fileStream, or nullptr if it is not in memory. */
+			const char* m_mappedData = nullptr;
 			//PakCompressionType m_compression;
 		};
 
@@ -96,10 +96,7 @@ namespace Apoc3D
 			{
 				Stream* s = m_parent->GetEntryStream(m_entryName);
 				assert(s);
-
-				VirtualStream* strm = up_cast<VirtualStream*>(s);
-				assert(strm);
-				return strm;
+				return s;
 			}
 			
 			return new FileStream(m_path);
@@ -19,6 +19,9 @@
 #include "apoc3d/Math/Viewport.h"
 #include "apoc3d/Math/RandomUtils.h"
 #include "apoc3d/Math/Math.h"
+#include "apoc3d/Math/MathBatch.h"
+#include "apoc3d/Graphics/PixelFormat.h"
+#include "apoc3d/Graphics/LockData.h"
 #include "apoc3d/Utility/Compression.h"
 #include "apoc3d/Utility/StringUtils.h"
 #include "apoc3d/Utility/StringTable.h"
@@ -26,6 +29,8 @@
 #include "apoc3d/Library/lz4hc.h"
 #include "apoc3d/Library/tinyxml.h"
 #include "apoc3d/Collections/LinkedList.h"
+#include "apoc3d/Core/Logging.h"
+#include "apoc3d/Core/TaskScheduler.h"
 #include "apoc3d/Collections/Stack.h"
 #include "apoc3d/Collections/Queue.h"
 #include "apoc3d/Vfs/File.h"
@@ -37,6 +42,7 @@
 #include <iostream>
 #include <chrono>
 #include <vector>
+#include <thread>
 //#include <functional>
 
 using namespace Apoc3D;
@@ -60,6 +66,9 @@ void TestIterator2();
 
 void TestHalfFloat();
 
+void TestPixelConversion();
+void TestLogging();
+
 void main()
 {
 	setlocale(LC_CTYPE, ".ACP");
@@ -89,6 +98,9 @@ void main()
 
 	//TestRandom();
 	//TestHalfFloat();
+
+	//TestPixelConversion();
+	TestLogging();
 	
 }
 
@@ -507,4 +519,167 @@ void TestHalfFloat()
 		c2 = getTimeDiff(t1, t2);
 	}
 	printf("HalfFloat: %lld,%lld\n", c1, c2);
-}
\ No newline at end of file
+}
+
+
+void TestPixelConversion()
+{
+	using namespace std::chrono;
+	using namespace Apoc3D::Graphics;
+	using namespace Apoc3D::Graphics::RenderSystem;
+
+	const int32 Width = 2048;
+	const int32 Height = 2048;
+	const int32 Iterations = 5;
+
+	const MathSIMDLevel detected = GetMathSIMDLevel();
+	const MathSIMDLevel levels[] = { MathSIMDLevel::Scalar, MathSIMDLevel::SSE2, MathSIMDLevel::AVX2 };
+
+	// big enough for the widest format
+	std::vector<byte> src(Width * Height * 16);
+	std::vector<byte> dst(Width * Height * 16);
+
+	printf("Pixel conversion, %dx%d, MPixel/s\n", Width, Height);
+	printf("%-20s %-20s %10s %10s %10s %10s\n", "Source", "Destination", "Scalar", "SSE2", "AVX2", "Parallel");
+
+	for (int32 i = FMT_Unknown + 1; i < FMT_Count; i++)
+	{
+		PixelFormat srcFmt = static_cast<PixelFormat>(i);
+		if (PixelFormatUtils::IsCompressed(srcFmt) || PixelFormatUtils::GetBPP(srcFmt) == 0)
+			continue;
+
+		// keep float sources in range, random bits would give nans and denormals
+		if (srcFmt == FMT_A32B32G32R32F)
+		{
+			float* f = reinterpret_cast<float*>(&src[0]);
+			for (int32 j = 0; j < Width * Height * 4; j++)
+				f[j] = (j % 1000) / 999.0f;
+		}
+		else if (srcFmt == FMT_A16B16G16R16F)
+		{
+			uint16* h = reinterpret_cast<uint16*>(&src[0]);
+			for (int32 j = 0; j < Width * Height * 4; j++)
+				h[j] = Math::R32ToR16((j % 1000) / 999.0f);
+		}
+		else
+		{
+			for (size_t j = 0; j < src.size(); j++)
+				src[j] = (byte)(j * 7 + (j >> 11));
+		}
+
+		DataBox srcBox(Width, Height, 1, PixelFormatUtils::GetMemorySize(Width, 1, 1, srcFmt),
+			PixelFormatUtils::GetMemorySize(Width, Height, 1, srcFmt), &src[0], srcFmt);
+
+		for (int32 j = FMT_Unknown + 1; j < FMT_Count; j++)
+		{
+			PixelFormat dstFmt = static_cast<PixelFormat>(j);
+			if (PixelFormatUtils::IsCompressed(dstFmt) || PixelFormatUtils::GetBPP(dstFmt) == 0)
+				continue;
+
+			DataBox dstBox(Width, Height, 1, PixelFormatUtils::GetMemorySize(Width, 1, 1, dstFmt),
+				PixelFormatUtils::GetMemorySize(Width, Height, 1, dstFmt), &dst[0], dstFmt);
+
+			// also warms up the buffers
+			if (!PixelFormatUtils::ConvertPixels(srcBox, dstBox, false))
+				continue;
+
+			double rates[4] = { 0 };
+			for (int32 k = 0; k < 4; k++)
+			{
+				bool parallel = k == 3;
+				MathSIMDLevel level = parallel ? detected : levels[k];
+				if (level > detected)
+					continue;
+
+				SetMathSIMDLevelLimit(level);
+
+				auto t1 = high_resolution_clock::now();
+				for (int32 n = 0; n < Iterations; n++)
+					PixelFormatUtils::ConvertPixels(srcBox, dstBox, parallel);
+				auto t2 = high_resolution_clock::now();
+
+				double seconds = duration_cast<duration<double>>(t2 - t1).count();
+				rates[k] = (double)Width * Height * Iterations / seconds / 1000000.0;
+			}
+			SetMathSIMDLevelLimit(MathSIMDLevel::AVX2);
+
+			printf("%-20ls %-20ls", PixelFormatUtils::ToString(srcFmt).c_str(), PixelFormatUtils::ToString(dstFmt).c_str());
+			for (double r : rates)
+			{
+				if (r > 0)
+					printf(" %10.1f", r);
+				else
+					printf(" %10s", "-");
+			}
+			printf("\n");
+		}
+	}
+}
+
+void TestLogging()
+{
+	using namespace std::chrono;
+	using namespace Apoc3D::Core;
+
+	const int32 ThreadCount = 4;
+	const int32 MessagesPerThread = 50000;
+
+	// the asynchronous mode drains the queues on the task scheduler
+	TaskScheduler::Initialize();
+	LogManager::Initialize();
+	LogManager& logs = LogManager::getSingleton();
+
+	auto writeAll = [&logs](int32 id, int64& maxTime)
+	{
+		String message = L"Worker " + StringUtils::IntToString(id) + L" loaded a resource";
+
+		maxTime = 0;
+		for (int32 i = 0; i < MessagesPerThread; i++)
+		{
+			auto t1 = high_resolution_clock::now();
+			logs.Write(LOG_System, message, LOGLVL_Infomation);
+			auto t2 = high_resolution_clock::now();
+
+			maxTime = Math::Max(maxTime, (int64)duration_cast<nanoseconds>(t2 - t1).count());
+		}
+	};
+
+	printf("Logging, %d threads x %d messages\n", ThreadCount, MessagesPerThread);
+	printf("%-10s %12s %16s %10s\n", "Mode", "ns/message", "max Write (us)", "dropped");
+
+	for (int32 k = 0; k < 2; k++)
+	{
+		bool async = k == 1;
+		if (async)
+			logs.StartAsync();
+
+		int64 maxTimes[ThreadCount];
+		std::thread* threads[ThreadCount];
+
+		auto t1 = high_resolution_clock::now();
+		for (int32 i = 0; i < ThreadCount; i++)
+			threads[i] = new std::thread(writeAll, i, std::ref(maxTimes[i]));
+		for (std::thread* th : threads)
+		{
+			th->join();
+			delete th;
+		}
+		logs.Flush();
+		auto t2 = high_resolution_clock::now();
+
+		int64 maxTime = 0;
+		for (int64 t : maxTimes)
+			maxTime = Math::Max(maxTime, t);
+
+		uint64 dropped = async ? logs.getAsyncStats().Dropped : 0;
+
+		double ns = (double)duration_cast<nanoseconds>(t2 - t1).count() / (ThreadCount * MessagesPerThread);
+		printf("%-10s %12.1f %16.1f %10llu\n", async ? "Async" : "Sync", ns, maxTime / 1000.0, dropped);
+
+		if (async)
+			logs.StopAsync();
+	}
+
+	LogManager::Finalize();
+	TaskScheduler::Finalize();
+}
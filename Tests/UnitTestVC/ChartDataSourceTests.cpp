@@ -0,0 +1,198 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Apoc3D::UI;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(ChartDataSourceTest)
+	{
+	public:
+		static const int32 SampleCount = 5003;
+
+		static constexpr double XStart = 10;
+		static constexpr double XStep = 0.5;
+
+		/** Integer valued samples, so sums are exact in any order and ties are common */
+		static void BuildSamples(List<double>& samples)
+		{
+			uint32 seed = 12345;
+			for (int32 i = 0; i < SampleCount; i++)
+			{
+				seed = seed * 1103515245 + 12345;
+				samples.Add((double)((seed >> 16) % 200) + (i / 100) * 10.0 - 250.0);
+			}
+		}
+
+		static ChartDataPoint MakePoint(const List<double>& samples, int32 i)
+		{
+			ChartDataPoint p;
+			p.m_x = XStart + i * XStep;
+			p.m_y = samples[i];
+			p.m_y_open = p.m_y_low = p.m_y_high = p.m_y;
+			return p;
+		}
+
+		/** The expected output of PyramidDataSource::GetData, from a linear scan of each bucket */
+		static void BruteForce(const List<double>& samples, ChartDecimationMode mode, double xPerPixel, double start, double end, List<ChartDataPoint>& data)
+		{
+			const int32 count = samples.getCount();
+
+			int32 first = (int32)Math::Clamp(ceil((start - XStart) / XStep), 0.0, (double)count);
+			int32 last = (int32)Math::Clamp(floor((end - XStart) / XStep), -1.0, (double)(count - 1));
+			if (first > last)
+				return;
+
+			double samplesPerPixel = xPerPixel / XStep;
+			if (samplesPerPixel < 2)
+			{
+				for (int32 i = first; i <= last; i++)
+					data.Add(MakePoint(samples, i));
+				return;
+			}
+
+			const int32 bucketSize = (int32)Math::Min(samplesPerPixel, (double)count);
+
+			struct Bucket
+			{
+				int32 Start;
+				int32 End;
+				int32 MinIndex;
+				int32 MaxIndex;
+				double Sum;
+			};
+
+			auto scan = [&](int32 s, int32 e)
+			{
+				Bucket b = { s, e, s, s, 0 };
+				for (int32 i = s; i < e; i++)
+				{
+					if (samples[i] < samples[b.MinIndex]) b.MinIndex = i;
+					if (samples[i] > samples[b.MaxIndex]) b.MaxIndex = i;
+					b.Sum += samples[i];
+				}
+				return b;
+			};
+
+			double prevX = 0, prevY = 0;
+
+			for (int32 k = first / bucketSize; k <= last / bucketSize; k++)
+			{
+				Bucket b = scan(k * bucketSize, Math::Min(count, (k + 1) * bucketSize));
+
+				if (mode == ChartDecimationMode::OHLC)
+				{
+					ChartDataPoint p;
+					p.m_x = XStart + b.Start * XStep;
+					p.m_y_open = samples[b.Start];
+					p.m_y = samples[b.End - 1];
+					p.m_y_low = samples[b.MinIndex];
+					p.m_y_high = samples[b.MaxIndex];
+					data.Add(p);
+				}
+				else if (mode == ChartDecimationMode::MinMax)
+				{
+					int32 a = Math::Min(b.MinIndex, b.MaxIndex);
+					int32 z = Math::Max(b.MinIndex, b.MaxIndex);
+
+					data.Add(MakePoint(samples, a));
+					if (z != a)
+						data.Add(MakePoint(samples, z));
+				}
+				else
+				{
+					if (k == first / bucketSize)
+					{
+						prevX = b.Start;
+						prevY = samples[b.Start];
+					}
+
+					double avgX, avgY;
+					if (b.End < count)
+					{
+						Bucket n = scan(b.End, Math::Min(count, b.End + bucketSize));
+						avgX = (n.Start + n.End - 1) * 0.5;
+						avgY = n.Sum / (n.End - n.Start);
+					}
+					else
+					{
+						avgX = b.End - 1;
+						avgY = samples[b.End - 1];
+					}
+
+					double areaMin = fabs((prevX - avgX) * (samples[b.MinIndex] - prevY) - (prevX - b.MinIndex) * (avgY - prevY));
+					double areaMax = fabs((prevX - avgX) * (samples[b.MaxIndex] - prevY) - (prevX - b.MaxIndex) * (avgY - prevY));
+					int32 chosen = areaMax > areaMin ? b.MaxIndex : b.MinIndex;
+
+					data.Add(MakePoint(samples, chosen));
+
+					prevX = chosen;
+					prevY = samples[chosen];
+				}
+			}
+		}
+
+		static void CheckMode(ChartDecimationMode mode)
+		{
+			List<double> samples;
+			BuildSamples(samples);
+
+			PyramidDataSource src(XStart, XStep, mode);
+			src.Append(&samples[0], samples.getCount());
+
+			double domainMin, domainMax;
+			Assert::IsTrue(src.GetDomain(domainMin, domainMax));
+			Assert::AreEqual(XStart, domainMin);
+			Assert::AreEqual(XStart + SampleCount * XStep, domainMax);
+
+			const double samplesPerPixel[] = { 1, 3, 16, 37, 256, 300, 4096, 100000 };
+			const double ranges[][2] =
+			{
+				{ domainMin, domainMax },
+				{ domainMin - 100, domainMin + 1000 },
+				{ 123.25, 2000 },
+				{ 1234, 1240 },
+				{ 2000, domainMax + 100 },
+			};
+
+			for (double spp : samplesPerPixel)
+			{
+				Assert::IsTrue(src.SetResolution(spp * XStep));
+
+				for (const auto& r : ranges)
+				{
+					List<ChartDataPoint> result;
+					List<ChartDataPoint> expected;
+					src.GetData(r[0], r[1], result);
+					BruteForce(samples, mode, spp * XStep, r[0], r[1], expected);
+
+					Assert::AreEqual(expected.getCount(), result.getCount());
+					for (int32 i = 0; i < expected.getCount(); i++)
+					{
+						Assert::AreEqual(expected[i].m_x, result[i].m_x);
+						Assert::AreEqual(expected[i].m_y, result[i].m_y);
+						Assert::AreEqual(expected[i].m_y_open, result[i].m_y_open);
+						Assert::AreEqual(expected[i].m_y_low, result[i].m_y_low);
+						Assert::AreEqual(expected[i].m_y_high, result[i].m_y_high);
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(PyramidDataSource_MinMax)
+		{
+			CheckMode(ChartDecimationMode::MinMax);
+		}
+
+		TEST_METHOD(PyramidDataSource_LTTB)
+		{
+			CheckMode(ChartDecimationMode::LTTB);
+		}
+
+		TEST_METHOD(PyramidDataSource_OHLC)
+		{
+			CheckMode(ChartDecimationMode::OHLC);
+		}
+
+	};
+}
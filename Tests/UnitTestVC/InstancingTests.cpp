@@ -0,0 +1,160 @@
+#include "TestCommon.h"
+
+#include "Apoc3D.NullRenderSystem/NRSRenderDevice.h"
+#include "Apoc3D.NullRenderSystem/NRSObjects.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Apoc3D::Graphics::NullRenderSystem;
+
+namespace UnitTestVC
+{
+	/** Takes the transforms and 2 blob values of each instance from the instance stream, and records the setups */
+	class StreamInstancingEffect : public Effect
+	{
+	public:
+		StreamInstancingEffect() { m_name = L"StreamInstancingEffect"; }
+
+		virtual void Setup(Material* mtrl, const RenderOperation* rop, int count) override
+		{
+			SetupCount++;
+			LastInstanceCount = count;
+		}
+
+		virtual void BeginPass(int passId) override { }
+		virtual void EndPass() override { }
+
+		virtual bool SupportsStreamInstancing() override { return true; }
+		virtual int32 getInstanceStreamBlobValueCount() override { return 2; }
+
+		int32 SetupCount = 0;
+		int32 LastInstanceCount = 0;
+
+	protected:
+		virtual int begin() override { return 1; }
+		virtual void end() override { }
+	};
+
+	TEST_CLASS(InstancingTest)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Setup)
+		{
+			LogManager::Initialize();
+		}
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			LogManager::Finalize();
+		}
+
+		TEST_METHOD(Instancing_FillInstanceStream)
+		{
+			NRSRenderDevice device;
+			device.Initialize();
+
+			NRSInstancingData instancing(&device);
+
+			const int32 count = 5;
+			RenderOperation ops[count];
+			InstanceInfoBlob blobs[count];
+			for (int32 i = 0; i < count; i++)
+			{
+				Matrix::CreateTranslation(ops[i].RootTransform, (float)i, 2.0f * i, 3.0f * i);
+
+				// only one value, the second is filled with zero
+				InstanceInfoBlobValue v;
+				v.Configure(0.5f * i);
+				blobs[i].Add(v);
+				ops[i].UserData = &blobs[i];
+			}
+
+			InstanceStreamRange range = instancing.FillInstanceStream(ops, count, 2);
+
+			const int32 instanceSize = InstancingData::InstanceStreamTransformSize + 2;
+			Assert::AreEqual(count, range.InstanceCount);
+			Assert::AreEqual(2, range.BlobValueCount);
+			Assert::AreEqual(instanceSize * (int32)sizeof(Vector4), range.Stride);
+
+			VertexBuffer* stream = instancing.getInstanceStream();
+			Assert::IsNotNull(stream);
+
+			const Vector4* data = reinterpret_cast<const Vector4*>(stream->Lock(range.Offset, range.Stride * count, LOCK_ReadOnly));
+			for (int32 i = 0; i < count; i++)
+			{
+				const Vector4* inst = data + i * instanceSize;
+				const Matrix& m = ops[i].RootTransform;
+
+				Assert::IsTrue(inst[0] == Vector4(m.M11, m.M21, m.M31, m.M41));
+				Assert::IsTrue(inst[1] == Vector4(m.M12, m.M22, m.M32, m.M42));
+				Assert::IsTrue(inst[2] == Vector4(m.M13, m.M23, m.M33, m.M43));
+
+				Assert::IsTrue(inst[3] == Vector4(0.5f * i, 0, 0, 0));
+				Assert::IsTrue(inst[4] == Vector4::Zero);
+			}
+			stream->Unlock();
+
+			// later groups go after the earlier ones
+			InstanceStreamRange next = instancing.FillInstanceStream(ops, 2, 0);
+			Assert::AreEqual(range.Offset + range.Stride * count, next.Offset);
+			Assert::AreEqual(InstancingData::InstanceStreamTransformSize * (int32)sizeof(Vector4), next.Stride);
+		}
+
+		TEST_METHOD(Instancing_NRSRenderStreamInstancing)
+		{
+			NRSRenderDevice device;
+			device.Initialize();
+
+			ObjectFactory* fac = device.getObjectFactory();
+
+			List<VertexElement> elems;
+			elems.Add(VertexElement(0, VEF_Vector3, VEU_Position, 0));
+			VertexDeclaration* decl = fac->CreateVertexDeclaration(elems);
+			VertexBuffer* vb = fac->CreateVertexBuffer(3, decl, BU_Static);
+			IndexBuffer* ib = fac->CreateIndexBuffer(IndexBufferFormat::Bit16, 3, BU_Static);
+
+			GeometryData geo;
+			geo.VertexBuffer = vb;
+			geo.VertexDecl = decl;
+			geo.VertexSize = decl->GetVertexSize();
+			geo.VertexCount = 3;
+			geo.PrimitiveCount = 1;
+			geo.PrimitiveType = PrimitiveType::TriangleList;
+
+			StreamInstancingEffect fx;
+			Material mtrl(&device);
+			mtrl.SetPassEffect(0, &fx);
+
+			const int32 count = 4;
+			RenderOperation ops[count];
+			for (int32 i = 0; i < count; i++)
+			{
+				ops[i].GeometryData = &geo;
+				ops[i].Material = &mtrl;
+				Matrix::CreateTranslation(ops[i].RootTransform, (float)i, 0, 0);
+			}
+
+			// non-indexed geometry is drawn an instance at a time
+			device.BeginFrame();
+			device.Render(&mtrl, ops, count, 0);
+			Assert::AreEqual((uint32)count, device.getBatchCount());
+			Assert::AreEqual((uint32)count, device.getPrimitiveCount());
+			Assert::AreEqual(1, fx.SetupCount);
+			Assert::AreEqual(count, fx.LastInstanceCount);
+			device.EndFrame();
+
+			// indexed geometry is drawn in one call
+			geo.IndexBuffer = ib;
+
+			device.BeginFrame();
+			device.Render(&mtrl, ops, count, 0);
+			Assert::AreEqual(1u, device.getBatchCount());
+			Assert::AreEqual((uint32)count, device.getPrimitiveCount());
+			Assert::AreEqual(2, fx.SetupCount);
+			Assert::AreEqual(count, fx.LastInstanceCount);
+			device.EndFrame();
+
+			delete ib;
+			delete vb;
+			delete decl;
+		}
+	};
+}
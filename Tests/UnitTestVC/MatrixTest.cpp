@@ -54,5 +54,221 @@ namespace UnitTestVC
 
 		}
 
+		TEST_METHOD(Matrix_BatchedFunctions)
+		{
+			const int32 count = 37;
+			Random rnd(1);
+
+			Matrix trans;
+			Matrix::CreateTranslation(trans, 1, -2, 3);
+			Matrix proj;
+			Matrix::CreatePerspectiveFovLH(proj, ToRadian(60), 1.5f, 1, 100);
+			Matrix transform;
+			Matrix::Multiply(transform, trans, proj);
+
+			Vector3 vecs[count];
+			Vector4 vec4s[count];
+			Matrix mats[count];
+			for (int32 i = 0; i < count; i++)
+			{
+				vecs[i] = Vector3(rnd.NextFloat() * 10, rnd.NextFloat() * 10, rnd.NextFloat() * 10);
+				vec4s[i] = Vector4(vecs[i], rnd.NextFloat());
+				Matrix::CreateRotationY(mats[i], rnd.NextFloat() * 6);
+				mats[i].SetTranslation(vecs[i]);
+			}
+
+			const MathSIMDLevel levels[] = { MathSIMDLevel::Scalar, MathSIMDLevel::SSE2, MathSIMDLevel::AVX2 };
+			for (MathSIMDLevel lvl : levels)
+			{
+				SetMathSIMDLevelLimit(lvl);
+
+				Vector3 coords[count];
+				Vector3 normals[count];
+				Vector4 results[count];
+				Matrix products[count];
+				Matrix pairProducts[count];
+
+				TransformCoordinates(coords, vecs, count, transform);
+				TransformNormals(normals, vecs, count, transform);
+				TransformVectors(results, vec4s, count, transform);
+				MultiplyMatrices(products, mats, transform, count);
+				MultiplyMatrices(pairProducts, mats, mats, count);
+
+				for (int32 i = 0; i < count; i++)
+				{
+					Vector3 c = Vector3::TransformCoordinate(vecs[i], transform);
+					Vector3 n = Vector3::TransformNormal(vecs[i], transform);
+					Vector4 r = Vector4::Transform(vec4s[i], transform);
+					Assert::AreEqual(0.0f, Vector3::Distance(c, coords[i]), 0.001f);
+					Assert::AreEqual(0.0f, Vector3::Distance(n, normals[i]), 0.001f);
+					Assert::AreEqual(0.0f, Vector4::Distance(r, results[i]), 0.001f);
+
+					Matrix p;
+					Matrix::Multiply(p, mats[i], transform);
+					Matrix pp;
+					Matrix::Multiply(pp, mats[i], mats[i]);
+					for (int32 j = 0; j < 16; j++)
+					{
+						Assert::AreEqual(p.Elements[j], products[i].Elements[j], 0.001f);
+						Assert::AreEqual(pp.Elements[j], pairProducts[i].Elements[j], 0.001f);
+					}
+				}
+			}
+			SetMathSIMDLevelLimit(MathSIMDLevel::AVX2);
+		}
+
+		TEST_METHOD(Animation_CompressedClipSampling)
+		{
+			using namespace Apoc3D::Graphics::Animation;
+
+			Quaternion r0, r1;
+			Quaternion::CreateRotationAxis(r0, Vector3(0, 1, 0), 0.5f);
+			Quaternion::CreateRotationAxis(r1, Vector3(1, 0, 1), -2.0f);
+
+			CompressedAnimationClip::Track track;
+			track.ObjectIndex = 3;
+			track.FirstKey = 0;
+			track.KeyCount = 2;
+			track.TranslationMin = Vector3(-1, 0, 2);
+			track.TranslationStep = Vector3(2, 4, 0) / 65535.0f;
+			track.ScaleMin = Vector3(1, 1, 1);
+			track.ScaleStep = Vector3(1, 0, 0) / 65535.0f;
+
+			CompressedAnimationClip::Key keys[2];
+			keys[0].Time = 0;
+			keys[1].Time = CompressedAnimationClip::TimeSteps;
+			CompressedAnimationClip::EncodeRotation(r0, keys[0].Rotation);
+			CompressedAnimationClip::EncodeRotation(r1, keys[1].Rotation);
+			for (int32 i = 0; i < 3; i++)
+			{
+				keys[0].Translation[i] = keys[0].Scale[i] = 0;
+				keys[1].Translation[i] = keys[1].Scale[i] = 65535;
+			}
+
+			List<CompressedAnimationClip::Track> tracks;
+			tracks.Add(track);
+			List<CompressedAnimationClip::Key> keyList;
+			keyList.Add(keys[0]);
+			keyList.Add(keys[1]);
+
+			CompressedAnimationClip clip(2.0f, tracks, keyList);
+
+			int32 hint = 0;
+			const float times[] = { 0, 0.5f, 1.0f, 2.0f };
+			for (float t : times)
+			{
+				Quaternion rot;
+				Vector3 pos, scl;
+				clip.Sample(0, t, rot, pos, scl, &hint);
+
+				float amount = t / 2.0f;
+				Quaternion expected;
+				Quaternion::Lerp(expected, r0, r1, amount);
+
+				Assert::AreEqual(1.0f, fabs(Quaternion::Dot(expected, rot)), 0.0001f);
+				Assert::AreEqual(0.0f, Vector3::Distance(Vector3(-1 + 2 * amount, 4 * amount, 2), pos), 0.0001f);
+				Assert::AreEqual(0.0f, Vector3::Distance(Vector3(1 + amount, 1, 1), scl), 0.0001f);
+			}
+		}
+
+		TEST_METHOD(Animation_SkinningBatch)
+		{
+			using namespace Apoc3D::Graphics::Animation;
+
+			const int32 BoneCount = 4;
+			List<Bone> bones;
+			for (int32 i = 0; i < BoneCount; i++)
+			{
+				Matrix bindPose;
+				Matrix::CreateTranslation(bindPose, 0, 1.0f + i, 0);
+
+				Bone b(i, bindPose, List<int32>(), i == 0 ? -1 : (i - 1) / 2, L"Bone" + StringUtils::IntToString(i));
+				Matrix reference;
+				Matrix::CreateRotationZ(reference, 0.1f * i);
+				b.setBoneReferenceTransform(reference);
+				bones.Add(b);
+			}
+
+			List<ModelKeyframe> keyframes;
+			for (int32 k = 0; k < 3; k++)
+			{
+				for (int32 i = 0; i < BoneCount; i++)
+				{
+					Matrix rot, trans, transform;
+					Matrix::CreateRotationY(rot, 0.3f * k + 0.2f * i);
+					Matrix::CreateTranslation(trans, (float)k, 0.5f * i, 0);
+					Matrix::Multiply(transform, rot, trans);
+					keyframes.Add(ModelKeyframe(i, 0.5f * k, transform));
+				}
+			}
+			ModelAnimationClip clip(1.5f, keyframes);
+
+			SkinnedAnimationPlayer reference(&bones);
+			reference.StartClip(&clip, 1, 0);
+
+			// enough players for more than one job
+			SkinningBatch batch;
+			List<SkinnedAnimationPlayer*> players;
+			for (int32 i = 0; i < 40; i++)
+			{
+				SkinnedAnimationPlayer* p = new SkinnedAnimationPlayer(&bones);
+				p->StartClip(&clip, 1, 0);
+				batch.Add(p);
+				players.Add(p);
+			}
+
+			AppTime time(0.3f, 60);
+			for (int32 frame = 0; frame < 4; frame++)
+			{
+				if (frame == 2)
+				{
+					// players leaving and joining between frames, the layout is redone once in Evaluate
+					for (int32 i = players.getCount() - 1; i >= 0; i -= 3)
+					{
+						delete players[i];
+						players.RemoveAt(i);
+					}
+
+					for (int32 i = 0; i < 5; i++)
+					{
+						SkinnedAnimationPlayer* p = new SkinnedAnimationPlayer(&bones);
+						p->StartClip(&clip, 1, 0);
+						for (int32 j = 0; j < frame; j++)
+							p->Update(&time);
+						batch.Add(p);
+						players.Add(p);
+					}
+				}
+
+				reference.Update(&time);
+				for (SkinnedAnimationPlayer* p : players)
+					p->Update(&time);
+				batch.Evaluate();
+
+				for (SkinnedAnimationPlayer* p : players)
+				{
+					for (int32 b = 0; b < BoneCount; b++)
+					{
+						const Matrix& expected = reference.GetSkinTransforms()[b];
+						const Matrix& actual = p->GetSkinTransforms()[b];
+						for (int32 j = 0; j < 16; j++)
+							Assert::AreEqual(expected.Elements[j], actual.Elements[j], 0.0001f);
+					}
+				}
+			}
+
+			// the palettes are in the shared buffer
+			Assert::IsTrue(players[0]->GetSkinTransforms() == batch.getPalettes());
+			Assert::AreEqual(players.getCount() * BoneCount, batch.getPaletteMatrixCount());
+			for (SkinnedAnimationPlayer* p : players)
+			{
+				const Matrix* palette = p->GetSkinTransforms();
+				Assert::IsTrue(palette >= batch.getPalettes() && palette < batch.getPalettes() + batch.getPaletteMatrixCount());
+			}
+
+			players.DeleteAndClear();
+			Assert::AreEqual(0, batch.getPlayerCount());
+		}
+
 	};
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(MeshSimplifierTest)
+	{
+	public:
+		/** A bumpy (n+1)*(n+1) vertex grid with 2*n*n faces */
+		static void BuildGrid(int32 n, List<Vector3>& vert, List<MeshFace>& tri)
+		{
+			for (int32 y = 0; y <= n; y++)
+				for (int32 x = 0; x <= n; x++)
+					vert.Add(Vector3((float)x, ((x * 7 + y * 3) % 5) * 0.1f, (float)y));
+
+			for (int32 y = 0; y < n; y++)
+			{
+				for (int32 x = 0; x < n; x++)
+				{
+					int32 i = y * (n + 1) + x;
+					tri.Add(MeshFace(i, i + 1, i + n + 1));
+					tri.Add(MeshFace(i + 1, i + n + 2, i + n + 1));
+				}
+			}
+		}
+
+		TEST_METHOD(MeshSimplifier_ProgressiveMesh)
+		{
+			List<Vector3> vert;
+			List<MeshFace> tri;
+			BuildGrid(16, vert, tri);
+
+			List<int> map;
+			List<int> permutation;
+			List<int32> faceCounts;
+			MeshSimplifier::ProgressiveMesh(vert, tri, map, permutation, faceCounts);
+
+			Assert::AreEqual(vert.getCount(), permutation.getCount());
+			Assert::AreEqual(vert.getCount(), map.getCount());
+			Assert::AreEqual(vert.getCount() + 1, faceCounts.getCount());
+
+			List<bool> placed;
+			placed.ReserveDiscard(vert.getCount());
+			for (int32 i = 0; i < placed.getCount(); i++)
+				placed[i] = false;
+
+			for (int32 i = 0; i < permutation.getCount(); i++)
+			{
+				int32 p = permutation[i];
+				Assert::IsTrue(p >= 0 && p < vert.getCount());
+				Assert::IsFalse(placed[p]);
+				placed[p] = true;
+			}
+
+			for (int32 j = 1; j < map.getCount(); j++)
+			{
+				Assert::IsTrue(map[j] >= 0);
+				Assert::IsTrue(map[j] < j);
+			}
+
+			Assert::AreEqual(tri.getCount(), faceCounts[vert.getCount()]);
+			for (int32 n = 1; n < faceCounts.getCount(); n++)
+				Assert::IsTrue(faceCounts[n - 1] <= faceCounts[n]);
+
+			// the faces left match the counts
+			for (int32 n : { 3, 50, 150, vert.getCount() })
+			{
+				List<MeshFace> result;
+				MeshSimplifier::CollapseFaces(tri, map, permutation, n, result);
+				Assert::AreEqual(faceCounts[n], result.getCount());
+
+				for (const MeshFace& f : result)
+				{
+					Assert::IsTrue(f.IndexA < n && f.IndexB < n && f.IndexC < n);
+					Assert::IsTrue(f.IndexA != f.IndexB && f.IndexB != f.IndexC && f.IndexA != f.IndexC);
+				}
+			}
+		}
+
+		TEST_METHOD(MeshSimplifier_LODChain)
+		{
+			List<Vector3> vert;
+			List<MeshFace> tri;
+			BuildGrid(32, vert, tri);
+
+			List<int32> targets;
+			targets.Add(tri.getCount() / 2);
+			targets.Add(tri.getCount() / 8);
+			targets.Add(40);
+
+			List<List<MeshFace>> lods;
+			MeshSimplifier::GenerateLODChain(vert, tri, targets, lods);
+
+			Assert::AreEqual(targets.getCount(), lods.getCount());
+			for (int32 i = 0; i < lods.getCount(); i++)
+			{
+				Assert::IsTrue(lods[i].getCount() <= targets[i]);
+				Assert::IsTrue(lods[i].getCount() > 0);
+
+				for (const MeshFace& f : lods[i])
+				{
+					Assert::IsTrue(f.IndexA >= 0 && f.IndexA < vert.getCount());
+					Assert::IsTrue(f.IndexB >= 0 && f.IndexB < vert.getCount());
+					Assert::IsTrue(f.IndexC >= 0 && f.IndexC < vert.getCount());
+				}
+
+				if (i > 0)
+					Assert::IsTrue(lods[i].getCount() <= lods[i - 1].getCount());
+			}
+		}
+
+		/** BuildGrid as a position only MeshData, with the faces in shuffled order over the materials */
+		static void BuildGridMesh(int32 n, int32 materialCount, bool shuffle, MeshData& md)
+		{
+			List<Vector3> vert;
+			List<MeshFace> tri;
+			BuildGrid(n, vert, tri);
+
+			md.VertexElements.Add(VertexElement(0, VEF_Vector3, VEU_Position, 0));
+			md.VertexSize = MeshData::ComputeVertexSize(md.VertexElements);
+			md.VertexCount = vert.getCount();
+			md.VertexData = new char[md.VertexCount * md.VertexSize];
+			memcpy(md.VertexData, vert.getElements(), md.VertexCount * md.VertexSize);
+
+			for (int32 i = 0; i < tri.getCount(); i++)
+				tri[i].MaterialID = (i / 7) % materialCount;
+
+			if (shuffle)
+			{
+				uint32 seed = 12345;
+				for (int32 i = tri.getCount() - 1; i > 0; i--)
+				{
+					seed = seed * 1664525 + 1013904223;
+					std::swap(tri[i], tri[(seed >> 8) % (i + 1)]);
+				}
+			}
+			md.Faces = tri;
+		}
+
+		static void GetFaceKeys(const MeshData& md, List<int64>& keys)
+		{
+			keys.Clear();
+			for (const MeshFace& f : md.Faces)
+				keys.Add((((int64)f.IndexA * 4096 + f.IndexB) * 4096 + f.IndexC) * 16 + f.MaterialID);
+			std::sort(keys.begin(), keys.end());
+		}
+
+		static void CheckSameKeys(const List<int64>& expected, const List<int64>& actual)
+		{
+			Assert::AreEqual(expected.getCount(), actual.getCount());
+			for (int32 i = 0; i < expected.getCount(); i++)
+				Assert::IsTrue(expected[i] == actual[i]);
+		}
+
+		static Vector3 GetPosition(const MeshData& md, int32 vtx)
+		{
+			return *reinterpret_cast<const Vector3*>(md.VertexData + vtx * md.VertexSize);
+		}
+
+		TEST_METHOD(MeshProcessing_VertexCache)
+		{
+			for (bool shuffle : { false, true })
+			{
+				MeshData md;
+				BuildGridMesh(24, 1, shuffle, md);
+
+				float before = APBuild::Utils::meshAnalyzeVertexCache(&md).ACMR;
+				APBuild::Utils::meshOptimizeVertexCache(&md);
+				float after = APBuild::Utils::meshAnalyzeVertexCache(&md).ACMR;
+
+				Assert::IsTrue(after <= before);
+				Assert::IsTrue(after >= 0.5f);
+			}
+		}
+
+		TEST_METHOD(MeshProcessing_SubMeshFacesKept)
+		{
+			MeshData md;
+			BuildGridMesh(20, 3, true, md);
+
+			List<int64> original;
+			GetFaceKeys(md, original);
+
+			APBuild::Utils::meshOptimizeVertexCache(&md);
+
+			List<int64> keys;
+			GetFaceKeys(md, keys);
+			CheckSameKeys(original, keys);
+
+			APBuild::Utils::meshOptimizeOverdraw(&md, 1.05f);
+
+			// the material is part of the key, so each sub mesh keeps exactly its faces
+			GetFaceKeys(md, keys);
+			CheckSameKeys(original, keys);
+		}
+
+		TEST_METHOD(MeshProcessing_VertexFetch)
+		{
+			MeshData md;
+			BuildGridMesh(12, 2, true, md);
+
+			List<Vector3> facePositions;
+			for (const MeshFace& f : md.Faces)
+			{
+				facePositions.Add(GetPosition(md, f.IndexA));
+				facePositions.Add(GetPosition(md, f.IndexB));
+				facePositions.Add(GetPosition(md, f.IndexC));
+			}
+
+			List<Vector3> vertices;
+			for (uint32 i = 0; i < md.VertexCount; i++)
+				vertices.Add(GetPosition(md, i));
+
+			APBuild::Utils::meshOptimizeVertexFetch(&md);
+
+			for (int32 i = 0; i < md.Faces.getCount(); i++)
+			{
+				const MeshFace& f = md.Faces[i];
+				Assert::IsTrue(GetPosition(md, f.IndexA) == facePositions[i * 3]);
+				Assert::IsTrue(GetPosition(md, f.IndexB) == facePositions[i * 3 + 1]);
+				Assert::IsTrue(GetPosition(md, f.IndexC) == facePositions[i * 3 + 2]);
+			}
+
+			// every vertex is still there once, the grid positions are all different
+			Assert::AreEqual((uint32)vertices.getCount(), md.VertexCount);
+			for (const Vector3& v : vertices)
+			{
+				int32 count = 0;
+				for (uint32 i = 0; i < md.VertexCount; i++)
+				{
+					if (GetPosition(md, i) == v)
+						count++;
+				}
+				Assert::AreEqual(1, count);
+			}
+		}
+	};
+}
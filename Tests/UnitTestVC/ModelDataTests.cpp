@@ -0,0 +1,204 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(ModelDataTest)
+	{
+	public:
+		struct TestVertex
+		{
+			Vector3 Position;
+			Vector3 Normal;
+			Vector2 TexCoord;
+		};
+
+		static const int32 GridSize = 12;
+		static const int32 MaterialCount = 3;
+
+		/** A (n+1)*(n+1) grid with normals pointing all around the sphere, faces spread over the materials */
+		static void BuildMesh(MeshData& md)
+		{
+			md.Name = L"Grid";
+			md.VertexElements.Add(VertexElement(0, VEF_Vector3, VEU_Position, 0));
+			md.VertexElements.Add(VertexElement(12, VEF_Vector3, VEU_Normal, 0));
+			md.VertexElements.Add(VertexElement(24, VEF_Vector2, VEU_TextureCoordinate, 0));
+			md.VertexSize = MeshData::ComputeVertexSize(md.VertexElements);
+			Assert::AreEqual((uint32)sizeof(TestVertex), md.VertexSize);
+
+			for (int32 i = 0; i < MaterialCount; i++)
+				md.Materials.Add(new MaterialData());
+
+			md.VertexCount = (GridSize + 1) * (GridSize + 1);
+			md.VertexData = new char[md.VertexCount * md.VertexSize];
+
+			TestVertex* vtx = reinterpret_cast<TestVertex*>(md.VertexData);
+			for (int32 y = 0; y <= GridSize; y++)
+			{
+				for (int32 x = 0; x <= GridSize; x++)
+				{
+					float u = (float)x / GridSize;
+					float v = (float)y / GridSize;
+
+					float theta = u * Math::PI * 2;
+					float phi = v * Math::PI;
+
+					TestVertex& t = vtx[y * (GridSize + 1) + x];
+					t.Position = Vector3((float)x, (x * y % 7) * 0.25f, (float)y);
+					t.Normal = Vector3(sinf(phi) * cosf(theta), sinf(phi) * sinf(theta), cosf(phi));
+					t.TexCoord = Vector2(u, 1 - v * 0.5f);
+				}
+			}
+
+			for (int32 y = 0; y < GridSize; y++)
+			{
+				for (int32 x = 0; x < GridSize; x++)
+				{
+					int32 i = y * (GridSize + 1) + x;
+					int32 mtrl = (x + y) % MaterialCount;
+					md.Faces.Add(MeshFace(i, i + 1, i + GridSize + 1, mtrl));
+					md.Faces.Add(MeshFace(i + 1, i + GridSize + 2, i + GridSize + 1, mtrl));
+				}
+			}
+		}
+
+		static void RoundTrip(const MeshData& src, const MeshStorageOptions& options, MeshData& dst)
+		{
+			TaggedDataWriter outData(true);
+			src.SaveData(&outData, options);
+
+			MemoryOutStream buffer(0xffff);
+			outData.Save(buffer);
+			buffer.setPosition(0);
+
+			TaggedDataReader inData(&buffer);
+			inData.SuspendStreamRelease();
+			dst.LoadData(&inData);
+		}
+
+		static void CheckFaces(const MeshData& src, const MeshData& dst)
+		{
+			// split indices come back grouped by material, in their original order within a group
+			List<MeshFace> expected;
+			for (int32 m = 0; m < MaterialCount; m++)
+			{
+				for (const MeshFace& f : src.Faces)
+				{
+					if (f.MaterialID == m)
+						expected.Add(f);
+				}
+			}
+
+			Assert::AreEqual(expected.getCount(), dst.Faces.getCount());
+			for (int32 i = 0; i < expected.getCount(); i++)
+			{
+				Assert::AreEqual(expected[i].IndexA, dst.Faces[i].IndexA);
+				Assert::AreEqual(expected[i].IndexB, dst.Faces[i].IndexB);
+				Assert::AreEqual(expected[i].IndexC, dst.Faces[i].IndexC);
+				Assert::AreEqual(expected[i].MaterialID, dst.Faces[i].MaterialID);
+			}
+		}
+
+		static void CheckVertices(const MeshData& src, const MeshData& dst, float normalTolerance, float texCoordTolerance)
+		{
+			Assert::AreEqual(src.VertexCount, dst.VertexCount);
+			Assert::AreEqual(src.VertexSize, dst.VertexSize);
+			Assert::AreEqual(src.VertexElements.getCount(), dst.VertexElements.getCount());
+
+			const TestVertex* a = reinterpret_cast<const TestVertex*>(src.VertexData);
+			const TestVertex* b = reinterpret_cast<const TestVertex*>(dst.VertexData);
+
+			for (uint32 i = 0; i < src.VertexCount; i++)
+			{
+				Assert::AreEqual(a[i].Position.X, b[i].Position.X);
+				Assert::AreEqual(a[i].Position.Y, b[i].Position.Y);
+				Assert::AreEqual(a[i].Position.Z, b[i].Position.Z);
+
+				Assert::AreEqual(a[i].Normal.X, b[i].Normal.X, normalTolerance);
+				Assert::AreEqual(a[i].Normal.Y, b[i].Normal.Y, normalTolerance);
+				Assert::AreEqual(a[i].Normal.Z, b[i].Normal.Z, normalTolerance);
+
+				Assert::AreEqual(a[i].TexCoord.X, b[i].TexCoord.X, texCoordTolerance);
+				Assert::AreEqual(a[i].TexCoord.Y, b[i].TexCoord.Y, texCoordTolerance);
+			}
+		}
+
+		TEST_METHOD(ModelData_SplitIndices)
+		{
+			MeshData src;
+			BuildMesh(src);
+
+			MeshStorageOptions options;
+			options.SplitIndices = true;
+
+			MeshData dst;
+			RoundTrip(src, options, dst);
+
+			Assert::AreEqual(0, dst.Faces.getCount());
+			Assert::AreEqual(MaterialCount, dst.Parts.getCount());
+			Assert::IsTrue(dst.PartIndices16);
+
+			for (const MeshPart& part : dst.Parts)
+			{
+				Assert::AreEqual(0, part.IndexCount % 3);
+				Assert::IsTrue(part.VertexCount <= part.VertexRangeCount);
+			}
+
+			dst.BuildFaces();
+			CheckFaces(src, dst);
+			CheckVertices(src, dst, 0, 0);
+		}
+
+		TEST_METHOD(ModelData_QuantizedVertices)
+		{
+			MeshData src;
+			BuildMesh(src);
+
+			MeshStorageOptions options;
+			options.HalfTexCoords = true;
+			options.OctahedralNormals = true;
+
+			MeshData dst;
+			RoundTrip(src, options, dst);
+
+			Assert::AreEqual(0, dst.Parts.getCount());
+			Assert::AreEqual(src.Faces.getCount(), dst.Faces.getCount());
+			for (int32 i = 0; i < src.Faces.getCount(); i++)
+			{
+				Assert::AreEqual(src.Faces[i].IndexA, dst.Faces[i].IndexA);
+				Assert::AreEqual(src.Faces[i].IndexB, dst.Faces[i].IndexB);
+				Assert::AreEqual(src.Faces[i].IndexC, dst.Faces[i].IndexC);
+				Assert::AreEqual(src.Faces[i].MaterialID, dst.Faces[i].MaterialID);
+			}
+
+			CheckVertices(src, dst, 1e-3f, 1e-3f);
+		}
+
+		TEST_METHOD(ModelData_SplitQuantized)
+		{
+			MeshData src;
+			BuildMesh(src);
+
+			MeshStorageOptions options;
+			options.SplitIndices = true;
+			options.HalfTexCoords = true;
+			options.OctahedralNormals = true;
+
+			MeshData dst;
+			RoundTrip(src, options, dst);
+
+			Assert::AreEqual(0, dst.Faces.getCount());
+			dst.BuildFaces();
+
+			CheckFaces(src, dst);
+			CheckVertices(src, dst, 1e-3f, 1e-3f);
+
+			// saving the loaded parts back without splitting must give the same faces
+			MeshData dst2;
+			RoundTrip(dst, MeshStorageOptions(), dst2);
+			CheckFaces(src, dst2);
+		}
+
+	};
+}
@@ -0,0 +1,183 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Apoc3D::Scene;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(OctreeCullingTest)
+	{
+	public:
+		/** A sphere with one render operation that points back to it, so the batch data tells which objects were added */
+		class CullTestObject : public SceneObject
+		{
+		public:
+			CullTestObject(int32 id, const Vector3& pos, float radius, bool dynamic, Material* mtrl, GeometryData* geo)
+				: m_id(id), m_dynamic(dynamic)
+			{
+				m_BoundingSphere.Center = pos;
+				m_BoundingSphere.Radius = radius;
+				Matrix::CreateTranslation(m_transformation, pos);
+
+				RenderOperation op;
+				op.Material = mtrl;
+				op.GeometryData = geo;
+				op.UserData = this;
+				m_ops.Add(op);
+			}
+
+			RenderOperationBuffer* GetRenderOperation(int level) override { return &m_ops; }
+			void Update(const AppTime* time) override { }
+			bool IsDynamicObject() const override { return m_dynamic; }
+
+			int32 getID() const { return m_id; }
+
+		private:
+			int32 m_id;
+			bool m_dynamic;
+			RenderOperationBuffer m_ops;
+		};
+
+		static const int32 ViewCount = 5;
+		static const int32 StaticCount = 600;
+		static const int32 FarCount = 30;
+		static const int32 DynamicCount = 30;
+		static const int32 ObjectCount = StaticCount + FarCount + DynamicCount;
+
+		TEST_METHOD_INITIALIZE(Setup)
+		{
+			TaskScheduler::Initialize();
+		}
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			TaskScheduler::Finalize();
+		}
+
+		static float Noise(uint32& seed)
+		{
+			seed = seed * 1103515245 + 12345;
+			return ((seed >> 8) & 0xffff) / 65535.0f;
+		}
+
+		static void BuildScene(OctreeSceneManager& scene, List<CullTestObject*>& objects, Material* mtrl, GeometryData* geo)
+		{
+			uint32 seed = 7;
+			for (int32 i = 0; i < ObjectCount; i++)
+			{
+				Vector3 pos(Noise(seed) * 190 - 95, Noise(seed) * 190 - 95, Noise(seed) * 190 - 95);
+				float radius = 0.25f + Noise(seed) * Noise(seed) * 20;
+
+				// far objects are outside the octree's range
+				if (i >= StaticCount && i < StaticCount + FarCount)
+					pos *= 3;
+
+				CullTestObject* obj = new CullTestObject(i, pos, radius, i >= StaticCount + FarCount, mtrl, geo);
+				objects.Add(obj);
+				scene.AddObject(obj);
+			}
+		}
+
+		static Camera* CreateCamera(const Vector3& pos, const Vector3& target, float fov, float farPlane)
+		{
+			Matrix view, proj;
+			Matrix::CreateLookAtLH(view, pos, target, Vector3::UnitY);
+			Matrix::CreatePerspectiveFovLH(proj, fov, 1.5f, 1.0f, farPlane);
+			return new Camera(view, proj);
+		}
+
+		/** Counts how many times each object was added to the batch data */
+		static void CollectObjects(const BatchData& batch, List<int32>& counts)
+		{
+			counts.Clear();
+			for (int32 i = 0; i < ObjectCount; i++)
+				counts.Add(0);
+
+			for (MaterialTable* mtrlTbl : batch.getTable().getValueAccessor())
+			{
+				for (GeometryTable* geoTbl : mtrlTbl->getValueAccessor())
+				{
+					for (OperationList* opList : geoTbl->getValueAccessor())
+					{
+						for (const RenderOperation& op : *opList)
+						{
+							const CullTestObject* obj = reinterpret_cast<const CullTestObject*>(op.UserData);
+							counts[obj->getID()]++;
+						}
+					}
+				}
+			}
+		}
+
+		static void CheckMultiView(OctreeCullingMode mode)
+		{
+			Material mtrl(nullptr);
+			GeometryData geo;
+
+			BoundingBox range(Vector3(-100, -100, -100), Vector3(100, 100, 100));
+			OctreeSceneManager* scene = new OctreeSceneManager(OctreeBox(range), 2.0f);
+			scene->setCullingMode(mode);
+
+			List<CullTestObject*> objects;
+			BuildScene(*scene, objects, &mtrl, &geo);
+
+			Camera* cameras[ViewCount] =
+			{
+				CreateCamera(Vector3(0, 0, -150), Vector3::Zero, ToRadian(60), 400),
+				CreateCamera(Vector3(0, 0, 0), Vector3(1, 0, 0), ToRadian(90), 80),
+				CreateCamera(Vector3(50, 50, 50), Vector3(-20, 0, 10), ToRadian(45), 120),
+				CreateCamera(Vector3(-80, 10, 0), Vector3(0, 10, 0), ToRadian(30), 500),
+				CreateCamera(Vector3(0, 300, 0), Vector3(0, 0, 1), ToRadian(75), 1000),
+			};
+
+			BatchData multi[ViewCount];
+			BatchData* multiPtrs[ViewCount];
+			for (int32 v = 0; v < ViewCount; v++)
+				multiPtrs[v] = &multi[v];
+
+			scene->PrepareVisibleObjects(cameras, multiPtrs, ViewCount);
+
+			int32 totalVisible = 0;
+			for (int32 v = 0; v < ViewCount; v++)
+			{
+				BatchData single;
+				scene->PrepareVisibleObjects(cameras[v], &single);
+
+				List<int32> multiCounts;
+				List<int32> singleCounts;
+				CollectObjects(multi[v], multiCounts);
+				CollectObjects(single, singleCounts);
+
+				Assert::AreEqual(single.getObjectCount(), multi[v].getObjectCount());
+
+				for (int32 i = 0; i < ObjectCount; i++)
+				{
+					Assert::AreEqual(singleCounts[i], multiCounts[i]);
+					Assert::IsTrue(multiCounts[i] <= 1);
+				}
+
+				totalVisible += multi[v].getObjectCount();
+			}
+
+			// the views should see some of the objects, but not all of them
+			Assert::IsTrue(totalVisible > 0);
+			Assert::IsTrue(totalVisible < ObjectCount * ViewCount);
+
+			for (Camera* cam : cameras)
+				delete cam;
+
+			delete scene;
+			objects.DeleteAndClear();
+		}
+
+		TEST_METHOD(OctreeCulling_MultiViewHierarchical)
+		{
+			CheckMultiView(OctreeCullingMode::Hierarchical);
+		}
+
+		TEST_METHOD(OctreeCulling_MultiViewFlattened)
+		{
+			CheckMultiView(OctreeCullingMode::FlattenedParallel);
+		}
+
+	};
+}
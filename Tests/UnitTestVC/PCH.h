@@ -40,6 +40,7 @@
 #include "apoc3d/Core/Resource.h"
 #include "apoc3d/Core/ResourceHandle.h"
 #include "apoc3d/Core/ResourceManager.h"
+#include "apoc3d/Core/TaskScheduler.h"
 
 #include "apoc3d/Graphics/BatchModelBuilder.h"
 #include "apoc3d/Graphics/Camera.h"
@@ -49,6 +50,7 @@
 #include "apoc3d/Graphics/Material.h"
 #include "apoc3d/Graphics/MaterialTypes.h"
 #include "apoc3d/Graphics/Mesh.h"
+#include "apoc3d/Graphics/MeshSimplifier.h"
 #include "apoc3d/Graphics/Model.h"
 #include "apoc3d/Graphics/ModelManager.h"
 #include "apoc3d/Graphics/ModelTypes.h"
@@ -66,6 +68,7 @@
 #include "apoc3d/Graphics/Animation/AnimationManager.h"
 #include "apoc3d/Graphics/Animation/AnimationPlayers.h"
 #include "apoc3d/Graphics/Animation/AnimationTypes.h"
+#include "apoc3d/Graphics/Animation/SkinningBatch.h"
 
 #include "apoc3d/Graphics/EffectSystem/Effect.h"
 #include "apoc3d/Graphics/EffectSystem/EffectManager.h"
@@ -110,6 +113,7 @@
 #include "apoc3d/Math/Frustum.h"
 #include "apoc3d/Math/GaussBlurFilter.h"
 #include "apoc3d/Math/Math.h"
+#include "apoc3d/Math/MathBatch.h"
 #include "apoc3d/Math/Matrix.h"
 #include "apoc3d/Math/OctreeBox.h"
 #include "apoc3d/Math/PerlinNoise.h"
@@ -133,6 +137,7 @@
 #include "apoc3d/Scene/ScenePass.h"
 #include "apoc3d/Scene/ScenePassTypes.h"
 #include "apoc3d/Scene/SceneProcedure.h"
+#include "apoc3d/Scene/SceneRenderGraph.h"
 #include "apoc3d/Scene/SceneRenderer.h"
 #include "apoc3d/Scene/SceneRenderScriptParser.h"
 #include "apoc3d/Scene/SimpleSceneManager.h"
@@ -169,6 +174,11 @@
 #include "Apoc3D.Essentials/EssentialCommon.h"
 #include "Apoc3D.Essentials/App.h"
 #include "Apoc3D.Essentials/AI/PathFinder.h"
+#include "Apoc3D.Essentials/UI/ChartDataSource.h"
+
+#include "APBuild/Utils/MeshProcessing.h"
+
+#include <algorithm>
 
 
 
@@ -0,0 +1,238 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(PixelFormatTest)
+	{
+	public:
+		TEST_METHOD(PixelFormat_ResizeSameSize)
+		{
+			const int32 width = 37;
+			const int32 height = 23;
+
+			List<byte> src;
+			src.ReserveDiscard(width * height * 4);
+			for (int32 i = 0; i < src.getCount(); i++)
+				src[i] = (byte)(i * 97 + (i >> 5));
+
+			const ResizeFilter filters[] = { ResizeFilter::Box, ResizeFilter::Triangle, ResizeFilter::Lanczos, ResizeFilter::Kaiser };
+			for (ResizeFilter flt : filters)
+			{
+				ResizeOptions options(flt);
+				options.GammaCorrect = true;
+
+				List<byte> dst;
+				dst.ReserveDiscard(src.getCount());
+				Assert::IsTrue(PixelFormatUtils::Resize(src.getElements(), width, height, dst.getElements(), width, height, FMT_A8R8G8B8, options));
+
+				for (int32 i = 0; i < src.getCount(); i++)
+					Assert::AreEqual(src[i], dst[i]);
+			}
+		}
+
+		TEST_METHOD(PixelFormat_ResizeBox)
+		{
+			const int32 width = 40;
+			const int32 height = 20;
+
+			List<byte> src;
+			src.ReserveDiscard(width * height);
+			for (int32 i = 0; i < src.getCount(); i++)
+				src[i] = (byte)(i * 31);
+
+			List<byte> dst;
+			dst.ReserveDiscard(width * height / 4);
+			PixelFormatUtils::Resize(src.getElements(), width, height, dst.getElements(), width / 2, height / 2, FMT_Luminance8, ResizeOptions(ResizeFilter::Box));
+
+			for (int32 y = 0; y < height / 2; y++)
+			{
+				for (int32 x = 0; x < width / 2; x++)
+				{
+					int32 sum = src[y * 2 * width + x * 2] + src[y * 2 * width + x * 2 + 1] +
+						src[(y * 2 + 1) * width + x * 2] + src[(y * 2 + 1) * width + x * 2 + 1];
+
+					Assert::IsTrue(abs(sum / 4.0f - dst[y * width / 2 + x]) <= 0.5f);
+				}
+			}
+		}
+
+		TEST_METHOD(PixelFormat_ResizeConstant)
+		{
+			// a flat color stays flat, whatever the filter and options
+			const float color[4] = { 0.75f, 0.1f, 0.5f, 0.25f };
+
+			List<float> src;
+			src.ReserveDiscard(13 * 9 * 4);
+			for (int32 i = 0; i < src.getCount(); i++)
+				src[i] = color[i % 4];
+
+			ResizeOptions options(ResizeFilter::Lanczos);
+			options.PremultipliedAlpha = true;
+
+			List<float> dst;
+			dst.ReserveDiscard(31 * 4 * 4);
+			PixelFormatUtils::Resize(src.getElements(), 13, 9, dst.getElements(), 31, 4, FMT_A32B32G32R32F, options);
+
+			for (int32 i = 0; i < dst.getCount(); i++)
+				Assert::AreEqual(color[i % 4], dst[i], 1e-5f);
+		}
+
+		TEST_METHOD(PixelFormat_GenerateMipmaps)
+		{
+			TextureData data;
+			data.Type = TextureType::Texture2D;
+			data.Format = FMT_A8R8G8B8;
+			data.Flags = 0;
+			data.LevelCount = 1;
+			data.Levels.ReserveDiscard(1);
+
+			TextureLevelData& lvl = data.Levels[0];
+			lvl.Width = 64;
+			lvl.Height = 16;
+			lvl.Depth = 1;
+			lvl.LevelSize = PixelFormatUtils::GetMemorySize(64, 16, 1, FMT_A8R8G8B8);
+			lvl.ContentData = new char[lvl.LevelSize];
+			memset(lvl.ContentData, 0x80, lvl.LevelSize);
+			data.ContentSize = lvl.LevelSize;
+
+			Assert::IsTrue(data.GenerateMipmaps());
+
+			Assert::AreEqual(7, data.LevelCount);
+			Assert::AreEqual(7, data.Levels.getCount());
+			Assert::AreEqual(1, data.Levels[6].Width);
+			Assert::AreEqual(1, data.Levels[6].Height);
+			Assert::AreEqual(2, data.Levels[4].Height);
+
+			int32 contentSize = 0;
+			for (const TextureLevelData& l : data.Levels)
+			{
+				contentSize += l.LevelSize;
+				for (int32 i = 0; i < l.LevelSize; i++)
+					Assert::AreEqual((char)0x80, l.ContentData[i]);
+			}
+			Assert::AreEqual(contentSize, data.ContentSize);
+
+			data.Format = FMT_DXT1;
+			Assert::IsFalse(data.GenerateMipmaps());
+		}
+
+		TEST_METHOD(PixelFormat_CompressConstant)
+		{
+			// a color 565 can represent exactly, so nothing is lost in any block
+			const uint32 color = 0x80FF0000;
+			const int32 width = 10;
+			const int32 height = 7;
+
+			List<uint32> src;
+			src.ReserveDiscard(width * height);
+			for (int32 i = 0; i < src.getCount(); i++)
+				src[i] = color;
+
+			DataBox srcBox(width, height, 1, width * 4, width * height * 4, src.getElements(), FMT_A8R8G8B8);
+
+			const BlockCompressionQuality qualities[] = { BlockCompressionQuality::Fast, BlockCompressionQuality::Normal, BlockCompressionQuality::Best };
+			for (BlockCompressionQuality quality : qualities)
+			{
+				const int32 blockRowSize = PixelFormatUtils::GetMemorySize(width, 1, 1, FMT_DXT5);
+				const int32 size = PixelFormatUtils::GetMemorySize(width, height, 1, FMT_DXT5);
+				Assert::AreEqual(3 * 16, blockRowSize);
+				Assert::AreEqual(3 * 2 * 16, size);
+
+				List<byte> blocks;
+				blocks.ReserveDiscard(size);
+				DataBox blockBox(width, height, 1, blockRowSize, size, blocks.getElements(), FMT_DXT5);
+				Assert::IsTrue(PixelFormatUtils::Compress(srcBox, blockBox, BlockCompressionOptions(quality)));
+
+				List<uint32> dst;
+				dst.ReserveDiscard(width * height);
+				DataBox dstBox(width, height, 1, width * 4, width * height * 4, dst.getElements(), FMT_A8R8G8B8);
+				Assert::IsTrue(PixelFormatUtils::Decompress(blockBox, dstBox));
+
+				for (int32 i = 0; i < dst.getCount(); i++)
+					Assert::AreEqual(color, dst[i]);
+			}
+
+			Assert::IsFalse(PixelFormatUtils::CanCompress(FMT_A8R8G8B8, FMT_DXT2));
+			Assert::IsFalse(PixelFormatUtils::CanCompress(FMT_DXT1, FMT_DXT5));
+			Assert::IsTrue(PixelFormatUtils::CanConvert(FMT_DXT1, FMT_A8R8G8B8));
+		}
+
+		TEST_METHOD(PixelFormat_ConvertSIMDLevels)
+		{
+			// odd sizes leave partial groups for the lower levels
+			const int32 width = 77;
+			const int32 height = 5;
+			const MathSIMDLevel levels[] = { MathSIMDLevel::SSE2, MathSIMDLevel::AVX2 };
+
+			// big enough for the widest format
+			List<byte> src;
+			src.ReserveDiscard(width * height * 16);
+
+			List<byte> expected;
+			List<byte> dst;
+			expected.ReserveDiscard(src.getCount());
+			dst.ReserveDiscard(src.getCount());
+
+			for (int32 i = FMT_Unknown + 1; i < FMT_Count; i++)
+			{
+				PixelFormat srcFmt = static_cast<PixelFormat>(i);
+				if (PixelFormatUtils::IsCompressed(srcFmt) || PixelFormatUtils::GetBPP(srcFmt) == 0)
+					continue;
+
+				// keep float sources in range, random bits would give nans
+				if (srcFmt == FMT_A32B32G32R32F)
+				{
+					float* f = reinterpret_cast<float*>(src.getElements());
+					for (int32 j = 0; j < width * height * 4; j++)
+						f[j] = (j % 300) / 299.0f;
+				}
+				else if (srcFmt == FMT_A16B16G16R16F)
+				{
+					uint16* h = reinterpret_cast<uint16*>(src.getElements());
+					for (int32 j = 0; j < width * height * 4; j++)
+						h[j] = Math::R32ToR16((j % 300) / 299.0f);
+				}
+				else
+				{
+					for (int32 j = 0; j < src.getCount(); j++)
+						src[j] = (byte)(j * 97 + (j >> 5));
+				}
+
+				DataBox srcBox(width, height, 1, PixelFormatUtils::GetMemorySize(width, 1, 1, srcFmt),
+					PixelFormatUtils::GetMemorySize(width, height, 1, srcFmt), src.getElements(), srcFmt);
+
+				for (int32 j = FMT_Unknown + 1; j < FMT_Count; j++)
+				{
+					PixelFormat dstFmt = static_cast<PixelFormat>(j);
+					if (PixelFormatUtils::IsCompressed(dstFmt) || PixelFormatUtils::GetBPP(dstFmt) == 0)
+						continue;
+
+					const int32 dstSize = PixelFormatUtils::GetMemorySize(width, height, 1, dstFmt);
+
+					memset(expected.getElements(), 0xcd, expected.getCount());
+					DataBox expectedBox(width, height, 1, PixelFormatUtils::GetMemorySize(width, 1, 1, dstFmt), dstSize, expected.getElements(), dstFmt);
+
+					SetMathSIMDLevelLimit(MathSIMDLevel::Scalar);
+					if (!PixelFormatUtils::ConvertPixels(srcBox, expectedBox, false))
+						continue;
+
+					for (MathSIMDLevel level : levels)
+					{
+						SetMathSIMDLevelLimit(level);
+
+						memset(dst.getElements(), 0xcd, dst.getCount());
+						DataBox dstBox(width, height, 1, PixelFormatUtils::GetMemorySize(width, 1, 1, dstFmt), dstSize, dst.getElements(), dstFmt);
+						Assert::IsTrue(PixelFormatUtils::ConvertPixels(srcBox, dstBox, false));
+
+						Assert::AreEqual(0, memcmp(expected.getElements(), dst.getElements(), dst.getCount()),
+							(PixelFormatUtils::ToString(srcFmt) + L" -> " + PixelFormatUtils::ToString(dstFmt)).c_str());
+					}
+				}
+			}
+
+			SetMathSIMDLevelLimit(MathSIMDLevel::AVX2);
+		}
+	};
+}
@@ -0,0 +1,145 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Apoc3D::Scene;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(SceneRenderGraphTest)
+	{
+	public:
+		TEST_METHOD(SceneRenderGraph_CullAndAlias)
+		{
+			SceneVariable a, b, c, d, unused;
+			InitRenderTarget(a, L"A");
+			InitRenderTarget(b, L"B");
+			InitRenderTarget(c, L"C");
+			InitRenderTarget(d, L"D");
+			InitRenderTarget(unused, L"Unused");
+
+			List<SceneVariable*> vars = { &a, &b, &c, &d, &unused };
+			List<ScenePassData> passes;
+
+			// 0: scene to A, 1: A to B, 2: B to C, 3: C to the back buffer
+			passes.Add(MakePass(&a, nullptr, true));
+			passes.Add(MakePass(&b, &a, false));
+			passes.Add(MakePass(&c, &b, false));
+			passes.Add(MakePass(nullptr, &c, false));
+
+			// 4: scene to D, 5: D to A. Nothing reads A after that.
+			passes.Add(MakePass(&d, nullptr, true));
+			passes.Add(MakePass(&a, &d, false));
+
+			SceneRenderGraph graph;
+			graph.Compile(passes, vars);
+
+			Assert::AreEqual(4, graph.getLivePasses().getCount());
+			for (int32 i = 0; i < 4; i++)
+				Assert::AreEqual(i, graph.getLivePasses()[i]);
+
+			// A is used by passes 0-1, C by 2-3
+			Assert::AreEqual(2, graph.getSlotCount());
+			Assert::AreEqual(graph.getSlot(&a), graph.getSlot(&c));
+			Assert::AreNotEqual(graph.getSlot(&a), graph.getSlot(&b));
+			Assert::AreEqual(SceneRenderGraph::NoSlot, graph.getSlot(&d));
+			Assert::AreEqual(SceneRenderGraph::NoSlot, graph.getSlot(&unused));
+
+			// code reading D keeps the passes writing it
+			Assert::IsTrue(graph.MarkExternal(&d));
+			Assert::IsFalse(graph.MarkExternal(&d));
+			graph.Compile(passes, vars);
+
+			Assert::IsTrue(graph.isPassLive(4));
+			Assert::IsFalse(graph.isPassLive(5));
+			Assert::AreEqual(SceneRenderGraph::NoSlot, graph.getSlot(&d));
+		}
+
+		TEST_METHOD(SceneRenderGraph_KeepsOutputs)
+		{
+			SceneVariable view, accum, temp;
+			InitRenderTarget(view, L"View");
+			InitRenderTarget(accum, L"Accum");
+			InitRenderTarget(temp, L"Temp");
+
+			List<SceneVariable*> vars = { &view, &accum, &temp };
+			List<ScenePassData> passes;
+
+			// the previous frame's accumulation is read before being drawn to again
+			passes.Add(MakePass(&temp, &accum, false));
+			passes.Add(MakePass(&accum, &temp, false));
+			// nothing in the script reads View
+			passes.Add(MakePass(&view, nullptr, true));
+
+			SceneRenderGraph graph;
+			graph.Compile(passes, vars);
+
+			Assert::AreEqual(3, graph.getLivePasses().getCount());
+			Assert::AreEqual(3, graph.getSlotCount());
+		}
+
+	private:
+		static void InitRenderTarget(SceneVariable& var, const String& name)
+		{
+			var.Name = name;
+			var.Type = SceneVariableType::RenderTarget;
+
+			float scale = 1;
+			var.Value[2] = reinterpret_cast<const uint&>(scale);
+			var.Value[3] = reinterpret_cast<const uint&>(scale);
+			var.Value[4] = FMT_A8R8G8B8;
+		}
+
+		static SceneOpArg ImmediateArg(uint value)
+		{
+			SceneOpArg arg;
+			arg.IsImmediate = true;
+			arg.Var = nullptr;
+			memset(arg.DefaultValue, 0, sizeof(arg.DefaultValue));
+			arg.DefaultValue[0] = value;
+			return arg;
+		}
+
+		static SceneOpArg VarArg(SceneVariable* var)
+		{
+			SceneOpArg arg;
+			arg.IsImmediate = false;
+			arg.Var = var;
+			memset(arg.DefaultValue, 0, sizeof(arg.DefaultValue));
+			return arg;
+		}
+
+		/** A pass drawing the scene, or a quad using src, to dst or the back buffer */
+		static ScenePassData MakePass(SceneVariable* dst, SceneVariable* src, bool renderScene)
+		{
+			ScenePassData pass;
+			pass.SelectorID = 0;
+			pass.CameraID = 0;
+
+			SceneInstruction useRT(SOP_UseRT);
+			useRT.Args.Add(ImmediateArg(0));
+			useRT.Args.Add(dst ? VarArg(dst) : ImmediateArg(0));
+			pass.Instructions.Add(useRT);
+
+			SceneInstruction clear(SOP_Clear);
+			clear.Args.Add(ImmediateArg(1));
+			for (int32 i = 0; i < 5; i++)
+				clear.Args.Add(ImmediateArg(0));
+			pass.Instructions.Add(clear);
+
+			if (renderScene)
+			{
+				pass.Instructions.Add(SceneInstruction(SOP_Render));
+			}
+			else
+			{
+				SceneInstruction quad(SOP_RenderQuad);
+				quad.Args.Add(ImmediateArg(0));
+				quad.Args.Add(ImmediateArg(0));
+				if (src)
+					quad.Args.Add(VarArg(src));
+				pass.Instructions.Add(quad);
+			}
+			return pass;
+		}
+	};
+}
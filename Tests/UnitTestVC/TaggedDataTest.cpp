@@ -157,6 +157,87 @@ namespace UnitTestVC
 
 		}
 
+		/** Checks the raw entries written by TaggedDataTest_InPlace through a reader on the given stream */
+		void CheckInPlaceAccess(Stream* strm, const char* payload, int32 payloadSize)
+		{
+			TaggedDataReader inData(strm);
+			inData.SuspendStreamRelease();
+			Assert::IsTrue(inData.isMapped());
+
+			int64 size = 0;
+			const char* ptr = inData.TryGetDataPointer("Payload", &size);
+			Assert::IsNotNull(ptr);
+			Assert::AreEqual((int64)payloadSize, size);
+			Assert::AreEqual(0, memcmp(ptr, payload, payloadSize));
+
+			Assert::IsNull(inData.TryGetDataPointer("Missing"));
+
+			// entry streams keep their own positions
+			Stream* s1 = inData.GetDataStream("Payload");
+			Stream* s2 = inData.GetDataStream("Tail");
+
+			char buf[256];
+			Assert::AreEqual((int64)payloadSize, s1->getLength());
+			s1->setPosition(10);
+			Assert::AreEqual((int64)20, s2->Read(buf, 20));
+			Assert::AreEqual(0, memcmp(buf, payload + 100, 20));
+
+			Assert::AreEqual((int64)payloadSize - 10, s1->Read(buf, payloadSize));
+			Assert::AreEqual(0, memcmp(buf, payload + 10, payloadSize - 10));
+
+			delete s1;
+			delete s2;
+		}
+
+		TEST_METHOD(TaggedDataTest_InPlace)
+		{
+			const int32 payloadSize = 200;
+			char payload[payloadSize];
+			for (int32 i = 0; i < payloadSize; i++)
+				payload[i] = (char)(i * 31 + 7);
+
+			TaggedDataWriter outData(true);
+			outData.AddEntryStream("Payload", [&](Stream* s) { s->Write(payload, payloadSize); });
+			outData.AddEntryStream("Tail", [&](Stream* s) { s->Write(payload + 100, 100); });
+
+			MemoryOutStream buffer(0xffff);
+			outData.Save(buffer);
+
+			// in memory
+			{
+				MemoryStream ms(buffer.getDataPointer(), buffer.getLength());
+				CheckInPlaceAccess(&ms, payload, payloadSize);
+			}
+
+			// mapped from a file
+			const String fileName = L"TaggedDataInPlace.tmp";
+			{
+				FileOutStream fs(fileName);
+				fs.Write(buffer.getDataPointer(), buffer.getLength());
+			}
+			{
+				MappedFileStream ms(fileName);
+				CheckInPlaceAccess(&ms, payload, payloadSize);
+			}
+
+			// read from a file, nothing in place
+			{
+				FileStream fs(fileName);
+				TaggedDataReader inData(&fs);
+				inData.SuspendStreamRelease();
+				Assert::IsFalse(inData.isMapped());
+				Assert::IsNull(inData.TryGetDataPointer("Payload"));
+
+				char buf[payloadSize];
+				Stream* s = inData.GetDataStream("Payload");
+				Assert::AreEqual((int64)payloadSize, s->Read(buf, payloadSize));
+				Assert::AreEqual(0, memcmp(buf, payload, payloadSize));
+				delete s;
+			}
+
+			_wremove(fileName.c_str());
+		}
+
 
 	};
 
@@ -0,0 +1,171 @@
+#include "TestCommon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Apoc3D::Core;
+
+namespace UnitTestVC
+{
+	TEST_CLASS(TaskSchedulerTest)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Setup)
+		{
+			TaskScheduler::WorkerCount = 3;
+			TaskScheduler::Initialize();
+		}
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			TaskScheduler::Finalize();
+			TaskScheduler::WorkerCount = -1;
+		}
+
+		TEST_METHOD(TaskScheduler_ParallelFor)
+		{
+			TaskScheduler& ts = TaskScheduler::getSingleton();
+
+			List<int32> data;
+			data.ReserveDiscard(10000);
+
+			for (int32 rep = 0; rep < 10; rep++)
+			{
+				ts.ParallelFor(0, data.getCount(), [&](int32 s, int32 e)
+				{
+					for (int32 i = s; i < e; i++)
+						data[i]++;
+				});
+			}
+
+			for (int32 i = 0; i < data.getCount(); i++)
+				Assert::AreEqual(10, data[i]);
+
+			int32 calls = 0;
+			ts.ParallelFor(5, 5, [&](int32, int32) { calls++; });
+			Assert::AreEqual(0, calls);
+		}
+
+		TEST_METHOD(TaskScheduler_Dependencies)
+		{
+			TaskScheduler& ts = TaskScheduler::getSingleton();
+
+			for (int32 rep = 0; rep < 100; rep++)
+			{
+				std::atomic<int32> stage(0);
+				std::atomic<bool> ordered(true);
+
+				TaskHandle a = ts.Submit([&]() { stage = 1; });
+				TaskHandle b = ts.ContinueWith(a, [&]() { if (stage < 1) ordered = false; });
+				TaskHandle c = ts.ContinueWith(a, [&]() { if (stage < 1) ordered = false; });
+				TaskHandle d = ts.Submit([&]() { stage = 2; }, { b, c });
+
+				ts.Wait(d);
+
+				Assert::IsTrue(ordered);
+				Assert::AreEqual(2, (int32)stage);
+				Assert::IsTrue(a.isDone() && b.isDone() && c.isDone());
+			}
+		}
+
+		TEST_METHOD(TaskScheduler_Nested)
+		{
+			TaskScheduler& ts = TaskScheduler::getSingleton();
+
+			std::atomic<int32> sum(0);
+			List<TaskHandle> tasks;
+			for (int32 i = 0; i < 50; i++)
+			{
+				tasks.Add(ts.Submit([&]()
+				{
+					ts.ParallelFor(0, 1000, [&](int32 s, int32 e) { sum += e - s; }, 10);
+				}));
+			}
+			ts.WaitAll(tasks.getElements(), tasks.getCount());
+
+			Assert::AreEqual(50000, (int32)sum);
+		}
+
+		TEST_METHOD(TaskScheduler_MainThread)
+		{
+			TaskScheduler& ts = TaskScheduler::getSingleton();
+
+			std::thread::id mainThread = std::this_thread::get_id();
+			bool ranOnMain = false;
+
+			TaskHandle bg = ts.Submit([]() {});
+			TaskHandle m = ts.ContinueWith(bg, [&]() { ranOnMain = std::this_thread::get_id() == mainThread; }, TaskAffinity::MainThread);
+
+			ts.Wait(bg);
+			while (!m.isDone())
+				ts.RunMainThreadTasks();
+
+			Assert::IsTrue(ranOnMain);
+		}
+
+		TEST_METHOD(TaskScheduler_Background)
+		{
+			TaskScheduler& ts = TaskScheduler::getSingleton();
+
+			std::thread::id mainThread = std::this_thread::get_id();
+			std::atomic<int32> ranOnMain(0);
+
+			List<TaskHandle> tasks;
+			for (int32 i = 0; i < 50; i++)
+			{
+				tasks.Add(ts.Submit([&]()
+				{
+					if (std::this_thread::get_id() == mainThread)
+						ranOnMain++;
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}, TaskAffinity::Background));
+			}
+
+			// neither the main thread's chunks nor its waits pick up background tasks
+			int32 sum = 0;
+			std::mutex sumLock;
+			ts.ParallelFor(0, 1000, [&](int32 s, int32 e) { std::lock_guard<std::mutex> lock(sumLock); sum += e - s; }, 10);
+			ts.WaitAll(tasks.getElements(), tasks.getCount());
+
+			Assert::AreEqual(1000, sum);
+			Assert::AreEqual(0, (int32)ranOnMain);
+		}
+
+		class CountingWorker : public BackgroundWorker<int32>
+		{
+		public:
+			CountingWorker() { StartPooled(); }
+			~CountingWorker() { StopBackground(); }
+
+			std::atomic<int32> Sum{ 0 };
+
+		protected:
+			void BackgroundMainProcess(int32& item) override { Sum += item; }
+		};
+
+		TEST_METHOD(TaskScheduler_NoWorkers)
+		{
+			TaskScheduler::Finalize();
+			TaskScheduler::WorkerCount = 0;
+			TaskScheduler::Initialize();
+
+			TaskScheduler& ts = TaskScheduler::getSingleton();
+			Assert::AreEqual(0, ts.getWorkerCount());
+
+			bool ran = false;
+			TaskHandle task = ts.Submit([&]() { ran = true; });
+
+			CountingWorker worker;
+			for (int32 i = 1; i <= 10; i++)
+				worker.AddWorkItem(i);
+
+			// nothing runs until the main thread gets to it
+			ts.RunMainThreadTasks();
+
+			Assert::IsTrue(ran);
+			Assert::IsTrue(task.isDone());
+			Assert::AreEqual(55, (int32)worker.Sum);
+
+			int32 sum = 0;
+			ts.ParallelFor(0, 100, [&](int32 s, int32 e) { sum += e - s; });
+			Assert::AreEqual(100, sum);
+		}
+	};
+}